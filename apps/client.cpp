@@ -0,0 +1,153 @@
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct Param
+{
+    std::string socket;
+    std::vector<std::string> args;
+
+    Param() : socket("csrt.sock") {}
+};
+
+Param ParseParam(int argc, char **argv);
+
+int main(int argc, char **argv)
+{
+    Param param = ParseParam(argc, argv);
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (param.socket.size() >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "[error] socket path \"%s\" is too long.\n",
+                param.socket.c_str());
+        return 1;
+    }
+    strcpy(address.sun_path, param.socket.c_str());
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr *>(&address),
+                          sizeof(address)) != 0)
+    {
+        fprintf(stderr, "[error] cannot connect to \"%s\": %s.\n",
+                param.socket.c_str(), strerror(errno));
+        return 1;
+    }
+
+    // 任务的每个参数占一行，以空行结束
+    std::string request;
+    for (const std::string &arg : param.args)
+        request += arg + '\n';
+    request += '\n';
+    if (write(fd, request.data(), request.size()) !=
+        static_cast<ssize_t>(request.size()))
+    {
+        fprintf(stderr, "[error] cannot send job: %s.\n", strerror(errno));
+        close(fd);
+        return 1;
+    }
+
+    // 原样输出服务端转发的渲染进度，最后一行为任务的状态
+    std::string tail;
+    char buffer[4096];
+    ssize_t size = 0;
+    while ((size = read(fd, buffer, sizeof(buffer))) > 0)
+    {
+        fwrite(buffer, 1, size, stderr);
+        tail.append(buffer, size);
+        if (tail.size() > 64)
+            tail.erase(0, tail.size() - 64);
+    }
+    close(fd);
+
+    const std::string done = "[done]\n";
+    if (tail.size() >= done.size() &&
+        tail.compare(tail.size() - done.size(), done.size(), done) == 0)
+        return 0;
+    if (tail.find("[failed]") == std::string::npos)
+        fprintf(stderr, "\n[error] connection closed before job finished.\n");
+    return 1;
+}
+
+Param ParseParam(int argc, char **argv)
+{
+    Param param;
+    bool stop = false, has_output = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (argv[i] == std::string("--socket") && i + 1 < argc)
+        {
+            param.socket = argv[++i];
+        }
+        else if (argv[i] == std::string("--help"))
+        {
+            std::cerr << "Submit a job to the rendering server.\n\n";
+            std::cerr << "Command Format:\n";
+            std::cerr << "  '[--socket 'file path'] "
+                         "--input/-i 'config path' "
+                         "[--output/-o 'file path] "
+                         "[--width/-w 'value'] "
+                         "[--height/-h 'value'] "
+                         "[--spp/-s 'value'] "
+                         "[--fov 'degrees'] "
+                         "[--eye 'x,y,z'] "
+                         "[--look-at 'x,y,z'] "
+                         "[--up 'x,y,z'] "
+                         "[--crop 'x,y,width,height'] "
+                         "[--crop-base 'file path'] "
+                         "[--stream] "
+                         "[--exr-float]' or "
+                         "'[--socket 'file path'] --stop'.\n\n";
+            std::cerr << "Option:\n";
+            std::cerr << "  '--socket': path of the Unix domain socket of "
+                         "'RayTracerServer',\n"
+                         "      default: 'csrt.sock'.\n";
+            std::cerr << "  '--input' or '-i': mitsuba format xml file, "
+                         "kept in memory by the server.\n";
+            std::cerr << "  '--fov', '--eye', '--look-at', '--up': override "
+                         "the camera of the scene.\n";
+            std::cerr << "  '--input', '--output', '--crop-base': relative "
+                         "paths are resolved against\n"
+                         "      the working directory of the client.\n";
+            std::cerr << "  '--stop': stop the server.\n";
+            std::cerr << "  other options are the same as 'RayTracer'.\n\n";
+            exit(0);
+        }
+        else if ((argv[i] == std::string("--input") ||
+                  argv[i] == std::string("-i") ||
+                  argv[i] == std::string("--output") ||
+                  argv[i] == std::string("-o") ||
+                  argv[i] == std::string("--crop-base")) &&
+                 i + 1 < argc)
+        {
+            // 服务端的工作目录与客户端不同，相对路径按客户端的工作目录转换为绝对路径
+            if (argv[i] == std::string("--output") ||
+                argv[i] == std::string("-o"))
+                has_output = true;
+            param.args.push_back(argv[i]);
+            param.args.push_back(std::filesystem::absolute(argv[++i]).string());
+        }
+        else
+        {
+            if (argv[i] == std::string("--stop"))
+                stop = true;
+            param.args.push_back(argv[i]);
+        }
+    }
+    // 未指定输出路径时，结果仍写入客户端的工作目录
+    if (!stop && !has_output)
+    {
+        param.args.push_back("--output");
+        param.args.push_back(std::filesystem::absolute("result.png").string());
+    }
+    return param;
+}
\ No newline at end of file
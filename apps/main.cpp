@@ -1,5 +1,11 @@
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
 #include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <vector>
 
 #include "csrt/ray_tracer.hpp"
 
@@ -7,20 +13,82 @@ struct Param
 {
     csrt::BackendType type;
     bool preview;
+    bool affinity;
+    bool numa;
+    bool numa_replicate;
     int width;
     int height;
     int sample_count;
+    int num_threads;
+    int tile_size;
+    int crop_x;
+    int crop_y;
+    int crop_width;
+    int crop_height;
+    bool adaptive;
+    bool resume;
+    bool sensors;
+    int spp_pass;
+    int spp_min;
+    float threshold;
+    int guiding_passes;
+    int rrs_spp;
+    int ris_candidates;
+    int flush_passes;
+    double flush_interval;
+    double time_limit;
+    bool coarse_preview;
+    bool stream;
+    bool exr_float;
+    double checkpoint_interval;
+    std::string sampler;
     std::string input;
     std::string output;
+    std::string heatmap;
+    std::string checkpoint;
+    std::string partial;
+    std::string crop_base;
+    std::string camera_path;
+    std::string jobs;
+    uint64_t cache_size;
+    csrt::PartitionInfo partition;
 
     Param()
-        : type(csrt::BackendType::kCpu), preview(false), width(0), height(0),
-          sample_count(0), input(""), output("result.png")
+        : type(csrt::BackendType::kCpu), preview(false), affinity(false),
+          numa(false), numa_replicate(false), width(0), height(0),
+          sample_count(0), num_threads(0), tile_size(0), crop_x(0), crop_y(0),
+          crop_width(0), crop_height(0), adaptive(false), resume(false),
+          sensors(false), spp_pass(0), spp_min(0), threshold(0),
+          guiding_passes(0), rrs_spp(0), ris_candidates(0), flush_passes(-1),
+          flush_interval(-1), time_limit(0), coarse_preview(false),
+          stream(false), exr_float(false), checkpoint_interval(0),
+          sampler(""), input(""), output("result.png"), heatmap(""),
+          checkpoint(""), partial(""), crop_base(""), camera_path(""),
+          jobs(""), cache_size(2048)
     {
     }
 };
 
+void PrintHelp();
 Param ParseParam(int argc, char **argv);
+bool Render(const Param &param_in, int argc, char **argv);
+std::vector<std::string> SplitJobLine(const std::string &line);
+void ApplyCameraParam(const Param &param, csrt::Camera::Info *info);
+std::string GetSequenceFilename(const std::string &output, const size_t index,
+                                const size_t num_frame);
+uint64_t HashScene(const std::string &input,
+                   const csrt::RendererConfig &config);
+uint64_t HashCheckpoint(const uint64_t scene_hash,
+                        const csrt::RendererConfig &config);
+
+// 收到 SIGINT 或 SIGTERM 后中止渲染，输出已绘制的部分；再次收到时直接退出
+std::atomic<bool> g_stop(false);
+
+void HandleStop(int signal)
+{
+    g_stop = true;
+    std::signal(signal, SIG_DFL);
+}
 
 int main(int argc, char **argv)
 {
@@ -28,11 +96,96 @@ int main(int argc, char **argv)
     cudaDeviceReset();
 #endif
 
-    Param param = ParseParam(argc, argv);
+    PrintHelp();
+    Param param;
+    try
+    {
+        param = ParseParam(argc, argv);
+    }
+    catch (const std::exception &e)
+    {
+        fprintf(stderr, "[error] %s\n", e.what());
+        return 1;
+    }
+    std::signal(SIGINT, HandleStop);
+    std::signal(SIGTERM, HandleStop);
+    if (param.jobs.empty())
+        return Render(param, argc, argv) ? 0 : 1;
+
+    // 依次渲染任务列表中的场景，每个任务的参数在命令行参数之后追加，可以覆盖命令行参数
+    std::ifstream file(param.jobs);
+    if (!file)
+    {
+        fprintf(stderr, "[error] cannot open job list \"%s\".\n",
+                param.jobs.c_str());
+        return 1;
+    }
+    csrt::GetAssetCache().SetCapacity(param.cache_size << 20);
+    int num_job = 0, num_failed = 0;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        const size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+            continue;
+        if (g_stop)
+        {
+            fprintf(stderr, "[info] stopped, skip the remaining jobs.\n");
+            break;
+        }
+
+        fprintf(stderr, "[info] job %d: \"%s\".\n", ++num_job,
+                line.c_str());
+        // 参数有误的任务记为失败，继续执行之后的任务
+        Param param_job;
+        try
+        {
+            std::vector<std::string> tokens = SplitJobLine(line);
+            // 资源缓存在所有任务之间共享，容量只能在命令行中设置
+            if (std::find(tokens.begin(), tokens.end(), "--cache-size") !=
+                tokens.end())
+            {
+                throw csrt::MyException(
+                    "'--cache-size' is only supported on the command line.");
+            }
+            std::vector<char *> args(argv, argv + argc);
+            for (std::string &token : tokens)
+                args.push_back(&token[0]);
+            param_job = ParseParam(static_cast<int>(args.size()), args.data());
+        }
+        catch (const std::exception &e)
+        {
+            fprintf(stderr, "[error] job %d: %s\n", num_job, e.what());
+            ++num_failed;
+            continue;
+        }
+        param_job.jobs.clear();
+        if (!Render(param_job, argc, argv))
+            ++num_failed;
+    }
+    fprintf(stderr, "[info] %d job(s) finished, %d failed.\n", num_job,
+            num_failed);
+    csrt::GetAssetCache().PrintStatistics();
+    return num_failed > 0 ? 1 : 0;
+}
+
+// argc 与 argv 只用于初始化实时预览的窗口，未启用预览时不使用
+bool Render(const Param &param_in, [[maybe_unused]] int argc,
+            [[maybe_unused]] char **argv)
+{
+    Param param = param_in;
     csrt::RendererConfig confg;
+    std::vector<csrt::Camera::Info> cameras;
     try
     {
         confg = csrt::LoadConfig(param.input);
+        if (!param.camera_path.empty())
+        {
+            cameras =
+                csrt::LoadCameraPath(param.camera_path, confg.camera);
+        }
+        else if (param.sensors)
+            cameras = confg.cameras;
     }
     catch (const csrt::MyException &e)
     {
@@ -40,16 +193,112 @@ int main(int argc, char **argv)
 #ifdef ENABLE_CUDA
         cudaDeviceReset();
 #endif
-        return 0;
+        return false;
     }
 
     confg.backend_type = param.type;
-    if (param.width > 0)
-        confg.camera.width = param.width;
-    if (param.height > 0)
-        confg.camera.height = param.height;
-    if (param.sample_count > 0)
-        confg.camera.spp = param.sample_count;
+    if (param.num_threads > 0)
+        confg.schedule.num_threads = param.num_threads;
+    if (param.tile_size > 0)
+        confg.schedule.tile_size = param.tile_size;
+    confg.schedule.affinity = param.affinity;
+    confg.schedule.numa = param.numa || param.numa_replicate;
+    confg.schedule.numa_replicate = param.numa_replicate;
+    if (param.spp_pass > 0)
+        confg.progressive.spp_pass = param.spp_pass;
+    if (param.flush_passes >= 0)
+        confg.progressive.flush_passes = param.flush_passes;
+    if (param.flush_interval >= 0)
+        confg.progressive.flush_interval = param.flush_interval;
+    if (param.time_limit > 0)
+        confg.progressive.time_limit = param.time_limit;
+    confg.progressive.preview = param.coarse_preview;
+    confg.adaptive.enable = param.adaptive;
+    if (param.spp_min > 0)
+        confg.adaptive.spp_min = param.spp_min;
+    if (param.threshold > 0)
+        confg.adaptive.threshold = param.threshold;
+    confg.adaptive.heatmap = param.heatmap;
+    if (param.guiding_passes > 0)
+    {
+        confg.integrator.guiding = true;
+        confg.integrator.guiding_passes = param.guiding_passes;
+    }
+    if (param.rrs_spp > 0)
+    {
+        confg.integrator.rrs = true;
+        confg.integrator.rrs_spp =
+            static_cast<uint32_t>(std::max(param.rrs_spp, 2));
+    }
+    if (param.ris_candidates > 0)
+    {
+        confg.integrator.ris = true;
+        confg.integrator.ris_candidates =
+            static_cast<uint32_t>(param.ris_candidates);
+    }
+    ApplyCameraParam(param, &confg.camera);
+    for (csrt::Camera::Info &info : cameras)
+        ApplyCameraParam(param, &info);
+    if (!cameras.empty())
+    {
+        // 绘制多个相机时，检查点、部分累积结果等与单幅图像对应的输出不再适用
+        confg.camera = cameras[0];
+        if (!param.checkpoint.empty() || param.partition.sample_end > 0 ||
+            param.partition.num_tile_part > 1 || !param.heatmap.empty() ||
+            !param.crop_base.empty())
+        {
+            fprintf(stderr,
+                    "[warning] checkpoint, partial result, heatmap and crop "
+                    "base are disabled when rendering multiple cameras.\n");
+            param.checkpoint.clear();
+            param.partition = csrt::PartitionInfo();
+            param.heatmap.clear();
+            param.crop_base.clear();
+            confg.adaptive.heatmap.clear();
+        }
+    }
+    confg.checkpoint.filename = param.checkpoint;
+    confg.checkpoint.resume = param.resume;
+    if (param.checkpoint_interval > 0)
+        confg.checkpoint.interval = param.checkpoint_interval;
+    confg.partition = param.partition;
+    if (param.partition.sample_end > 0 || param.partition.num_tile_part > 1)
+    {
+        // 部分累积结果只有在各进程使用相同的样本分布时才能精确地合并
+        confg.partition.filename =
+            param.partial.empty()
+                ? param.output.substr(0, param.output.find_last_of(".")) +
+                      ".film"
+                : param.partial;
+        if (confg.adaptive.enable || confg.progressive.time_limit > 0)
+        {
+            fprintf(stderr, "[warning] adaptive sampling and time limit are "
+                            "disabled when rendering a partial result.\n");
+            confg.adaptive.enable = false;
+            confg.progressive.time_limit = 0;
+        }
+    }
+    confg.stream.enable = param.stream;
+    confg.stream.exr_half = !param.exr_float;
+    if (param.stream &&
+        (!confg.checkpoint.filename.empty() ||
+         !confg.partition.filename.empty() ||
+         confg.progressive.time_limit > 0 || !param.crop_base.empty()))
+    {
+        fprintf(stderr, "[warning] checkpoint, partial result, time limit and "
+                        "crop base are disabled when streaming the output.\n");
+        confg.checkpoint.filename.clear();
+        confg.partition = csrt::PartitionInfo();
+        confg.progressive.time_limit = 0;
+        param.crop_base.clear();
+    }
+    if (!param.crop_base.empty() && csrt::GetSuffix(param.output) != "png")
+    {
+        // 裁剪窗口只能写入 PNG 图像的副本
+        fprintf(stderr, "[warning] crop base is disabled when the output is "
+                        "not png.\n");
+        param.crop_base.clear();
+    }
     if (param.preview)
     {
         fprintf(
@@ -61,7 +310,17 @@ int main(int argc, char **argv)
     csrt::RayTracer *ray_tracer = nullptr;
     try
     {
+        // 只有输出检查点或部分累积结果时才需要场景的哈希值；裁剪窗口越界时
+        // GetCropWindow 抛出 MyException，与创建光线追踪器的错误一并处理
+        if (!confg.checkpoint.filename.empty() ||
+            !confg.partition.filename.empty())
+        {
+            confg.partition.scene_hash = HashScene(param.input, confg);
+            confg.checkpoint.scene_hash =
+                HashCheckpoint(confg.partition.scene_hash, confg);
+        }
         ray_tracer = new csrt::RayTracer(confg);
+        ray_tracer->SetStopToken(&g_stop);
     }
     catch (const csrt::MyException &e)
     {
@@ -69,7 +328,7 @@ int main(int argc, char **argv)
 #ifdef ENABLE_CUDA
         cudaDeviceReset();
 #endif
-        return 0;
+        return false;
     }
 
     try
@@ -79,7 +338,20 @@ int main(int argc, char **argv)
             ray_tracer->Preview(argc, argv, param.output);
         else
 #endif
-            ray_tracer->Draw(param.output);
+            if (!cameras.empty())
+        {
+            std::vector<std::string> outputs;
+            for (size_t k = 0; k < cameras.size(); ++k)
+            {
+                outputs.push_back(
+                    GetSequenceFilename(param.output, k, cameras.size()));
+            }
+            ray_tracer->DrawSequence(cameras, outputs);
+        }
+        else
+        {
+            ray_tracer->Draw(param.output, param.crop_base);
+        }
     }
     catch (const csrt::MyException &e)
     {
@@ -88,14 +360,14 @@ int main(int argc, char **argv)
 #ifdef ENABLE_CUDA
         cudaDeviceReset();
 #endif
-        return 0;
+        return false;
     }
 
     delete ray_tracer;
-    return 0;
+    return true;
 }
 
-Param ParseParam(int argc, char **argv)
+void PrintHelp()
 {
     std::cerr << "A Simple Ray Tracer.\n\n";
     std::cerr << "Command Format:\n";
@@ -104,7 +376,39 @@ Param ParseParam(int argc, char **argv)
                  "[--output/-o 'file path] "
                  "[--width/-w 'value'] "
                  "[--height/-h 'value'] "
-                 "[--spp/-s 'value']'.\n\n";
+                 "[--spp/-s 'value'] "
+                 "[--sampler 'type'] "
+                 "[--threads/-t 'value'] "
+                 "[--tile-size 'value'] "
+                 "[--affinity] "
+                 "[--numa] "
+                 "[--numa-replicate] "
+                 "[--progressive 'value'] "
+                 "[--flush-interval 'seconds'] "
+                 "[--flush-passes 'value'] "
+                 "[--time-limit 'seconds'] "
+                 "[--coarse-preview] "
+                 "[--stream] "
+                 "[--exr-float] "
+                 "[--adaptive] "
+                 "[--spp-min 'value'] "
+                 "[--threshold 'value'] "
+                 "[--heatmap 'file path'] "
+                 "[--guiding 'passes'] "
+                 "[--rrs 'spp'] "
+                 "[--ris 'candidates'] "
+                 "[--checkpoint 'file path'] "
+                 "[--checkpoint-interval 'seconds'] "
+                 "[--resume] "
+                 "[--sample-range 'begin:end'] "
+                 "[--tiles 'index/count'] "
+                 "[--partial 'file path'] "
+                 "[--crop 'x,y,width,height'] "
+                 "[--crop-base 'file path'] "
+                 "[--sensors] "
+                 "[--camera-path 'file path'] "
+                 "[--jobs 'file path'] "
+                 "[--cache-size 'MiB']'.\n\n";
     std::cerr << "Option:\n";
     std::cerr << "  --'cpu' or '-c': use CPU for offline rendering.\n"
                  "      if not specify specify CPU/CUDA/preview, use CPU.\n";
@@ -117,15 +421,120 @@ Param ParseParam(int argc, char **argv)
     std::cerr
         << "  '--input' or '-i': read config from mitsuba format xml file.\n";
     std::cerr << "  '--output' or '-o': output path for rendering result\n"
-                 "      only PNG format, default: 'result.png'.\n";
+                 "      EXR (half), PFM or PNG by suffix, default: "
+                 "'result.png'.\n";
     std::cerr << "      press 's' key to save when real-time previewing.\n";
+    std::cerr << "      on SIGINT (Ctrl-C) or SIGTERM, CPU rendering stops "
+                 "after the current tiles\n"
+                 "      and writes the partial result with a sample count "
+                 "map '*_samples.png'.\n";
     std::cerr
         << "  '--width' or '-w': specify the width of rendering picture.\n";
     std::cerr
         << "  '--height' or '-h': specify the height of rendering picture.\n";
     std::cerr
-        << "  '--spp' or '-s': specify the number of samples per pixel.\n\n";
+        << "  '--spp' or '-s': specify the number of samples per pixel.\n";
+    std::cerr << "  '--sampler': specify the sampler, 'independent', 'sobol' "
+                 "(Owen-scrambled Sobol)\n"
+                 "      or 'zsobol' (blue-noise ordered Sobol), default: "
+                 "read from config file.\n";
+    std::cerr << "  '--threads' or '-t': specify the number of CPU rendering "
+                 "threads,\n"
+                 "      default: the number of hardware threads.\n";
+    std::cerr << "  '--tile-size': specify the edge length of CPU rendering "
+                 "tiles in pixels,\n"
+                 "      default: 8.\n";
+    std::cerr << "  '--affinity': pin each CPU rendering thread to a logical "
+                 "processor.\n";
+    std::cerr << "  '--numa': split CPU rendering threads evenly over NUMA "
+                 "nodes,\n"
+                 "      and keep neighbouring tiles on the same node, no "
+                 "effect on single-node machines.\n";
+    std::cerr << "  '--numa-replicate': like '--numa', and build a copy of "
+                 "the scene data on each node.\n";
+    std::cerr << "  '--progressive': render in passes of the given samples "
+                 "per pixel on CPU,\n"
+                 "      and write intermediate results in the background.\n";
+    std::cerr << "  '--flush-interval': write an intermediate result every "
+                 "given seconds,\n"
+                 "      0 to disable, default: 10.\n";
+    std::cerr << "  '--flush-passes': write an intermediate result every "
+                 "given passes,\n"
+                 "      0 to disable, default: 0.\n";
+    std::cerr << "  '--time-limit': keep adding CPU rendering passes until "
+                 "the given seconds run out,\n"
+                 "      spp is ignored and the achieved spp is reported.\n";
+    std::cerr << "  '--coarse-preview': before the CPU rendering passes, "
+                 "write previews at 1/16\n"
+                 "      and 1/4 resolution, whose samples are reused by "
+                 "the passes.\n";
+    std::cerr << "  '--stream': render CPU bands of rows one after another "
+                 "and stream them to the output,\n"
+                 "      without keeping the whole image in memory.\n";
+    std::cerr << "  '--exr-float': write EXR output as 32-bit float instead "
+                 "of half.\n";
+    std::cerr << "  '--adaptive': spend samples only on CPU rendering tiles "
+                 "that have not converged,\n"
+                 "      the number of samples per pixel is limited by spp.\n";
+    std::cerr << "  '--spp-min': specify the minimum number of samples per "
+                 "pixel for adaptive sampling,\n"
+                 "      default: 16.\n";
+    std::cerr << "  '--threshold': specify the relative error threshold for "
+                 "adaptive sampling,\n"
+                 "      default: 0.05.\n";
+    std::cerr << "  '--heatmap': output path for the sample count heatmap "
+                 "of adaptive sampling.\n";
+    std::cerr << "  '--guiding': train path guiding on CPU for the given "
+                 "passes before rendering,\n"
+                 "      pass k renders 2^k spp, whose samples are discarded.\n";
+    std::cerr << "  '--rrs': estimate pixels with the given spp (at least 2) "
+                 "before rendering on CPU,\n"
+                 "      then terminate or split paths to minimize variance "
+                 "times cost.\n";
+    std::cerr << "  '--ris': resample the given number of unshadowed light "
+                 "candidates per shading point\n"
+                 "      and trace one shadow ray for the chosen one.\n";
+    std::cerr << "  '--checkpoint': file path for saving CPU rendering "
+                 "progress,\n"
+                 "      saved periodically and when stopped by SIGINT or "
+                 "SIGTERM.\n";
+    std::cerr << "  '--checkpoint-interval': save a checkpoint every given "
+                 "seconds,\n"
+                 "      default: 600.\n";
+    std::cerr << "  '--resume': continue rendering from the checkpoint.\n";
+    std::cerr << "  '--sample-range': render only samples [begin, end) of "
+                 "each pixel on CPU,\n"
+                 "      and write a partial result for 'RayTracerMerge'.\n";
+    std::cerr << "  '--tiles': render only the index-th of count interleaved "
+                 "groups of tiles on CPU,\n"
+                 "      and write a partial result for 'RayTracerMerge'.\n";
+    std::cerr << "  '--partial': output path for the partial result,\n"
+                 "      default: output path with suffix '.film'.\n";
+    std::cerr << "  '--crop': render only the given pixel rectangle on CPU,\n"
+                 "      with the same samples as a full-frame render.\n";
+    std::cerr << "  '--crop-base': write the crop window into a copy of the "
+                 "given full-frame PNG,\n"
+                 "      default: write the crop window as a standalone "
+                 "image.\n";
+    std::cerr << "  '--sensors': render every sensor in the config file,\n"
+                 "      the scene is loaded once and output paths are "
+                 "numbered.\n";
+    std::cerr << "  '--camera-path': render every camera in the given file, "
+                 "one per line as\n"
+                 "      'eye.x eye.y eye.z look_at.x look_at.y look_at.z "
+                 "up.x up.y up.z [fov]'.\n";
+    std::cerr << "  '--jobs': render every line of the given file as a job,\n"
+                 "      whose options are appended to the command line "
+                 "options,\n"
+                 "      quote paths with spaces in single or double "
+                 "quotes.\n";
+    std::cerr << "  '--cache-size': specify the size in MiB of the asset "
+                 "cache shared by jobs,\n"
+                 "      0 to disable, default: 2048.\n\n";
+}
 
+Param ParseParam(int argc, char **argv)
+{
     Param param;
     for (int i = 0; i < argc; ++i)
     {
@@ -166,6 +575,173 @@ Param ParseParam(int argc, char **argv)
         {
             param.sample_count = std::atoi(argv[i + 1]);
         }
+        else if (argv[i] == std::string("--sampler") && i + 1 < argc)
+        {
+            param.sampler = argv[i + 1];
+            if (param.sampler != "independent" && param.sampler != "sobol" &&
+                param.sampler != "zsobol")
+            {
+                throw csrt::MyException("unsupport sampler type \"" +
+                                        param.sampler + "\".");
+            }
+        }
+        else if ((argv[i] == std::string("--threads") ||
+                  argv[i] == std::string("-t")) &&
+                 i + 1 < argc)
+        {
+            param.num_threads = std::atoi(argv[i + 1]);
+        }
+        else if (argv[i] == std::string("--tile-size") && i + 1 < argc)
+        {
+            param.tile_size = std::atoi(argv[i + 1]);
+        }
+        else if (argv[i] == std::string("--affinity"))
+        {
+            param.affinity = true;
+        }
+        else if (argv[i] == std::string("--numa"))
+        {
+            param.numa = true;
+        }
+        else if (argv[i] == std::string("--numa-replicate"))
+        {
+            param.numa_replicate = true;
+        }
+        else if (argv[i] == std::string("--progressive") && i + 1 < argc)
+        {
+            param.spp_pass = std::atoi(argv[i + 1]);
+        }
+        else if (argv[i] == std::string("--flush-interval") && i + 1 < argc)
+        {
+            param.flush_interval = std::atof(argv[i + 1]);
+        }
+        else if (argv[i] == std::string("--flush-passes") && i + 1 < argc)
+        {
+            param.flush_passes = std::atoi(argv[i + 1]);
+        }
+        else if (argv[i] == std::string("--time-limit") && i + 1 < argc)
+        {
+            param.time_limit = std::atof(argv[i + 1]);
+        }
+        else if (argv[i] == std::string("--coarse-preview"))
+        {
+            param.coarse_preview = true;
+        }
+        else if (argv[i] == std::string("--stream"))
+        {
+            param.stream = true;
+        }
+        else if (argv[i] == std::string("--exr-float"))
+        {
+            param.exr_float = true;
+        }
+        else if (argv[i] == std::string("--adaptive"))
+        {
+            param.adaptive = true;
+        }
+        else if (argv[i] == std::string("--spp-min") && i + 1 < argc)
+        {
+            param.spp_min = std::atoi(argv[i + 1]);
+        }
+        else if (argv[i] == std::string("--threshold") && i + 1 < argc)
+        {
+            param.threshold = static_cast<float>(std::atof(argv[i + 1]));
+        }
+        else if (argv[i] == std::string("--heatmap") && i + 1 < argc)
+        {
+            param.heatmap = argv[i + 1];
+        }
+        else if (argv[i] == std::string("--guiding") && i + 1 < argc)
+        {
+            param.guiding_passes = std::atoi(argv[i + 1]);
+        }
+        else if (argv[i] == std::string("--rrs") && i + 1 < argc)
+        {
+            param.rrs_spp = std::atoi(argv[i + 1]);
+        }
+        else if (argv[i] == std::string("--ris") && i + 1 < argc)
+        {
+            param.ris_candidates = std::atoi(argv[i + 1]);
+        }
+        else if (argv[i] == std::string("--checkpoint") && i + 1 < argc)
+        {
+            param.checkpoint = argv[i + 1];
+        }
+        else if (argv[i] == std::string("--checkpoint-interval") &&
+                 i + 1 < argc)
+        {
+            param.checkpoint_interval = std::atof(argv[i + 1]);
+        }
+        else if (argv[i] == std::string("--resume"))
+        {
+            param.resume = true;
+        }
+        else if (argv[i] == std::string("--sample-range") && i + 1 < argc)
+        {
+            unsigned int begin = 0, end = 0;
+            if (sscanf(argv[i + 1], "%u:%u", &begin, &end) != 2 ||
+                begin >= end)
+            {
+                throw csrt::MyException("invalid sample range \"" +
+                                        std::string(argv[i + 1]) + "\".");
+            }
+            param.partition.sample_begin = begin;
+            param.partition.sample_end = end;
+        }
+        else if (argv[i] == std::string("--tiles") && i + 1 < argc)
+        {
+            unsigned int index = 0, count = 0;
+            if (sscanf(argv[i + 1], "%u/%u", &index, &count) != 2 ||
+                index >= count)
+            {
+                throw csrt::MyException("invalid tile group \"" +
+                                        std::string(argv[i + 1]) + "\".");
+            }
+            param.partition.tile_part = index;
+            param.partition.num_tile_part = count;
+        }
+        else if (argv[i] == std::string("--partial") && i + 1 < argc)
+        {
+            param.partial = argv[i + 1];
+        }
+        else if (argv[i] == std::string("--crop") && i + 1 < argc)
+        {
+            if (sscanf(argv[i + 1], "%d,%d,%d,%d", &param.crop_x,
+                       &param.crop_y, &param.crop_width,
+                       &param.crop_height) != 4 ||
+                param.crop_x < 0 || param.crop_y < 0 ||
+                param.crop_width <= 0 || param.crop_height <= 0)
+            {
+                throw csrt::MyException("invalid crop window \"" +
+                                        std::string(argv[i + 1]) + "\".");
+            }
+        }
+        else if (argv[i] == std::string("--crop-base") && i + 1 < argc)
+        {
+            param.crop_base = argv[i + 1];
+        }
+        else if (argv[i] == std::string("--sensors"))
+        {
+            param.sensors = true;
+        }
+        else if (argv[i] == std::string("--camera-path") && i + 1 < argc)
+        {
+            param.camera_path = argv[i + 1];
+        }
+        else if (argv[i] == std::string("--jobs") && i + 1 < argc)
+        {
+            param.jobs = argv[i + 1];
+        }
+        else if (argv[i] == std::string("--cache-size") && i + 1 < argc)
+        {
+            char *end = nullptr;
+            param.cache_size = std::strtoull(argv[i + 1], &end, 10);
+            if (end == argv[i + 1] || *end != '\0')
+            {
+                throw csrt::MyException("invalid cache size \"" +
+                                        std::string(argv[i + 1]) + "\".");
+            }
+        }
         else if ((argv[i] == std::string("--input") ||
                   argv[i] == std::string("-i")) &&
                  i + 1 < argc)
@@ -185,15 +761,152 @@ Param ParseParam(int argc, char **argv)
     }
 
     std::string suffix = csrt::GetSuffix(param.output);
-    if (suffix != "png")
+    if (suffix != "png" && suffix != "exr" && suffix != "pfm")
     {
-        fprintf(
-            stderr,
-            "[warning] only support png output, ignore output format \"%s\".",
-            suffix.c_str());
+        fprintf(stderr,
+                "[warning] only support png, exr and pfm output, ignore "
+                "output format \"%s\".\n",
+                suffix.c_str());
         param.output =
             param.output.substr(0, param.output.find_last_of(".")) + ".png";
     }
 
     return param;
 }
+
+std::vector<std::string> SplitJobLine(const std::string &line)
+{
+    // 参数以空白分隔，单引号或双引号括起的部分（可以含有空白）属于同一个参数，
+    // 引号本身不属于参数；反斜杠不作转义，以免改变 Windows 的路径
+    std::vector<std::string> tokens;
+    std::string token;
+    bool in_token = false;
+    char quote = 0;
+    for (const char c : line)
+    {
+        if (quote != 0)
+        {
+            if (c == quote)
+                quote = 0;
+            else
+                token += c;
+        }
+        else if (c == '\'' || c == '"')
+        {
+            quote = c;
+            in_token = true;
+        }
+        else if (c == ' ' || c == '\t' || c == '\r')
+        {
+            if (in_token)
+                tokens.push_back(token);
+            token.clear();
+            in_token = false;
+        }
+        else
+        {
+            token += c;
+            in_token = true;
+        }
+    }
+    if (quote != 0)
+        throw csrt::MyException("unmatched quote in job line.");
+    if (in_token)
+        tokens.push_back(token);
+    return tokens;
+}
+
+uint64_t HashScene(const std::string &input,
+                   const csrt::RendererConfig &config)
+{
+    // 场景文件的内容，其引用的网格、纹理等文件的路径与大小，以及命令行可以覆盖的
+    // 相机参数、采样器、路径引导、效率感知的俄罗斯轮盘赌和重抽样的直接光照。
+    // 资源文件可能有数 GB，解析时已经读取过一遍，这里不再读取内容；部分累积结果
+    // 可能来自复制了场景的其它机器，修改时间不同，因而只比较大小
+    uint64_t hash = csrt::HashFile(input);
+    for (const std::string &filename : config.asset_files)
+    {
+        const uintmax_t size = csrt::StampFile(filename).size;
+        hash = csrt::HashBytes(filename.data(), filename.size(), hash);
+        hash = csrt::HashBytes(&size, sizeof(size), hash);
+    }
+    const uint32_t camera[4] = {
+        static_cast<uint32_t>(config.camera.width),
+        static_cast<uint32_t>(config.camera.height), config.camera.spp,
+        static_cast<uint32_t>(config.camera.sampler)};
+    uint64_t hash_scene = csrt::HashBytes(camera, sizeof(camera), hash);
+    if (config.integrator.guiding)
+    {
+        hash_scene = csrt::HashBytes(&config.integrator.guiding_passes,
+                                     sizeof(config.integrator.guiding_passes),
+                                     hash_scene);
+    }
+    if (config.integrator.rrs)
+    {
+        hash_scene = csrt::HashBytes(&config.integrator.rrs_spp,
+                                     sizeof(config.integrator.rrs_spp),
+                                     hash_scene);
+    }
+    if (config.integrator.ris)
+    {
+        hash_scene = csrt::HashBytes(&config.integrator.ris_candidates,
+                                     sizeof(config.integrator.ris_candidates),
+                                     hash_scene);
+    }
+    return hash_scene;
+}
+
+uint64_t HashCheckpoint(const uint64_t scene_hash,
+                        const csrt::RendererConfig &config)
+{
+    // 检查点只累积裁剪窗口内、本进程负责的图块组的像素，二者不同的检查点不能继续渲染
+    const csrt::Tile crop = csrt::GetCropWindow(config.camera);
+    const uint32_t region[6] = {crop.x_begin,
+                                crop.y_begin,
+                                crop.x_end,
+                                crop.y_end,
+                                config.partition.tile_part,
+                                config.partition.num_tile_part};
+    uint64_t hash = csrt::HashBytes(region, sizeof(region), scene_hash);
+    // 检查点在本机继续渲染，资源文件的修改时间改变（大小不变）时也不能继续
+    for (const std::string &filename : config.asset_files)
+    {
+        const auto time =
+            csrt::StampFile(filename).time.time_since_epoch().count();
+        hash = csrt::HashBytes(&time, sizeof(time), hash);
+    }
+    return hash;
+}
+
+void ApplyCameraParam(const Param &param, csrt::Camera::Info *info)
+{
+    if (param.width > 0)
+        info->width = param.width;
+    if (param.height > 0)
+        info->height = param.height;
+    if (param.sample_count > 0)
+        info->spp = param.sample_count;
+    if (param.sampler == "independent")
+        info->sampler = csrt::SamplerType::kIndependent;
+    else if (param.sampler == "sobol")
+        info->sampler = csrt::SamplerType::kSobol;
+    else if (param.sampler == "zsobol")
+        info->sampler = csrt::SamplerType::kZSobol;
+    info->crop_x = param.crop_x;
+    info->crop_y = param.crop_y;
+    info->crop_width = param.crop_width;
+    info->crop_height = param.crop_height;
+}
+
+std::string GetSequenceFilename(const std::string &output, const size_t index,
+                                const size_t num_frame)
+{
+    // 在扩展名之前加上帧序号，如 'result_0001.png'，序号至少 4 位
+    int num_digit = 1;
+    for (size_t n = num_frame; n >= 10; n /= 10)
+        ++num_digit;
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "_%0*zu", std::max(4, num_digit), index);
+    const size_t pos_dot = output.find_last_of(".");
+    return output.substr(0, pos_dot) + buffer + output.substr(pos_dot);
+}
\ No newline at end of file
@@ -0,0 +1,146 @@
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "csrt/renderer/film.hpp"
+#include "csrt/utils.hpp"
+
+struct Param
+{
+    std::string output;
+    std::vector<std::string> inputs;
+
+    Param() : output("result.png") {}
+};
+
+Param ParseParam(int argc, char **argv);
+
+int main(int argc, char **argv)
+{
+    Param param = ParseParam(argc, argv);
+    if (param.inputs.empty())
+    {
+        std::cerr << "[error] no partial result to merge.\n";
+        return 1;
+    }
+
+    try
+    {
+        const csrt::CheckpointHeader first =
+            csrt::Film::LoadHeader(param.inputs[0]);
+        const uint32_t width = first.width, height = first.height;
+        const uint64_t num_pixel = static_cast<uint64_t>(width) * height;
+
+        // 记录每个部分结果绘制过的像素，用于检查样本区间相交的部分结果是否重复绘制了同一像素
+        struct Part
+        {
+            uint32_t sample_begin;
+            uint32_t sample_end;
+            std::vector<bool> drawn;
+        };
+        std::vector<Part> parts;
+
+        csrt::Film merged(width, height);
+        for (const std::string &input : param.inputs)
+        {
+            const csrt::CheckpointHeader header =
+                csrt::Film::LoadHeader(input);
+            if (header.width != width || header.height != height ||
+                header.scene_hash != first.scene_hash)
+            {
+                throw csrt::MyException("partial result '" + input +
+                                        "' belongs to another rendering.");
+            }
+
+            csrt::Film film(width, height, header.sample_begin);
+            film.Load(input);
+
+            Part part = {header.sample_begin,
+                         header.sample_begin + header.spp_done,
+                         std::vector<bool>(num_pixel)};
+            for (uint32_t j = 0; j < height; ++j)
+            {
+                for (uint32_t i = 0; i < width; ++i)
+                    part.drawn[j * width + i] = *film.count(i, j) > 0;
+            }
+            for (const Part &other : parts)
+            {
+                if (part.sample_begin >= other.sample_end ||
+                    other.sample_begin >= part.sample_end)
+                    continue;
+                for (uint64_t k = 0; k < num_pixel; ++k)
+                {
+                    if (part.drawn[k] && other.drawn[k])
+                    {
+                        throw csrt::MyException(
+                            "partial result '" + input +
+                            "' overlaps with a previous one.");
+                    }
+                }
+            }
+            parts.push_back(std::move(part));
+
+            merged.Merge(film);
+            fprintf(stderr, "[info] merge \"%s\", samples [%u, %u).\n",
+                    input.c_str(), header.sample_begin,
+                    header.sample_begin + header.spp_done);
+        }
+
+        fprintf(stderr, "[info] average spp: %.2f.\n",
+                static_cast<double>(merged.num_sample()) / num_pixel);
+        std::vector<float> frame(num_pixel * 3);
+        merged.Resolve(frame.data());
+        csrt::image_io::Write(frame.data(), width, height, param.output);
+    }
+    catch (const csrt::MyException &e)
+    {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+
+    return 0;
+}
+
+Param ParseParam(int argc, char **argv)
+{
+    std::cerr << "Merge partial results of a distributed rendering.\n\n";
+    std::cerr << "Command Format:\n";
+    std::cerr << "  '[--output/-o 'file path'] 'partial result path' ...'.\n\n";
+    std::cerr << "Option:\n";
+    std::cerr << "  '--output' or '-o': output path for merged result\n"
+                 "      PNG, EXR or PFM format, default: 'result.png'.\n\n";
+
+    Param param;
+    for (int i = 1; i < argc; ++i)
+    {
+        if ((argv[i] == std::string("--output") ||
+             argv[i] == std::string("-o")) &&
+            i + 1 < argc)
+        {
+            param.output = argv[++i];
+        }
+        else if (argv[i] == std::string("--help"))
+        {
+            exit(0);
+        }
+        else
+        {
+            param.inputs.push_back(argv[i]);
+        }
+    }
+
+    std::string suffix = csrt::GetSuffix(param.output);
+    // PFM 保存未量化的浮点数，可以与单进程绘制的结果逐位比较
+    if (suffix != "png" && suffix != "exr" && suffix != "pfm")
+    {
+        fprintf(stderr,
+                "[warning] only support png, exr and pfm output, ignore output "
+                "format \"%s\".\n",
+                suffix.c_str());
+        param.output =
+            param.output.substr(0, param.output.find_last_of(".")) + ".png";
+    }
+
+    return param;
+}
\ No newline at end of file
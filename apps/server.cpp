@@ -0,0 +1,550 @@
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "csrt/ray_tracer.hpp"
+
+struct Param
+{
+    csrt::BackendType type;
+    bool affinity;
+    bool numa;
+    bool numa_replicate;
+    int num_threads;
+    int tile_size;
+    int max_scenes;
+    std::string socket;
+
+    Param()
+        : type(csrt::BackendType::kCpu), affinity(false), numa(false),
+          numa_replicate(false), num_threads(0), tile_size(0), max_scenes(4),
+          socket("csrt.sock")
+    {
+    }
+};
+
+// 一项渲染任务，未指定的相机参数取场景文件中的值
+struct Job
+{
+    bool stop;
+    bool set_eye;
+    bool set_look_at;
+    bool set_up;
+    bool stream;
+    bool exr_float;
+    int width;
+    int height;
+    int sample_count;
+    float fov_x;
+    csrt::Vec3 eye;
+    csrt::Vec3 look_at;
+    csrt::Vec3 up;
+    int crop_x;
+    int crop_y;
+    int crop_width;
+    int crop_height;
+    std::string input;
+    std::string output;
+    std::string crop_base;
+
+    Job()
+        : stop(false), set_eye(false), set_look_at(false), set_up(false),
+          stream(false), exr_float(false), width(0), height(0),
+          sample_count(0), fov_x(0), crop_x(0), crop_y(0), crop_width(0),
+          crop_height(0), input(""), output("result.png"), crop_base("")
+    {
+    }
+};
+
+// 常驻内存的场景，场景文件或其引用的资源文件的内容、或者输出方式改变后重新加载
+struct Scene
+{
+    std::string input;
+    // 场景文件与 assets 中各个文件的内容的哈希值
+    uint64_t hash;
+    // 解析场景文件时读取的纹理、环境光照与网格等文件
+    std::vector<std::string> assets;
+    // 计算 hash 时场景文件与 assets 中各个文件的大小与最后修改时间。两者都未改变时
+    // 认为文件内容未改变，不再重新计算哈希值，避免每个任务都读取一遍数 GB 的网格与纹理
+    std::vector<csrt::FileStamp> stamps;
+    // 流式输出在构建时决定是否分配整幅图像
+    csrt::StreamInfo stream;
+    // 场景文件中的相机参数
+    csrt::Camera::Info camera;
+    std::unique_ptr<csrt::RayTracer> ray_tracer;
+};
+
+Param ParseParam(int argc, char **argv);
+bool ReceiveJob(const int fd, std::vector<std::string> *args);
+Job ParseJob(const std::vector<std::string> &args);
+uint64_t HashScene(const std::string &input,
+                   const std::vector<std::string> &assets);
+std::vector<csrt::FileStamp> StampScene(const std::string &input,
+                                        const std::vector<std::string> &assets);
+void RunJob(const Param &param, const Job &job, std::list<Scene> *scenes);
+
+int main(int argc, char **argv)
+{
+#ifdef ENABLE_CUDA
+    cudaDeviceReset();
+#endif
+
+    Param param;
+    try
+    {
+        param = ParseParam(argc, argv);
+    }
+    catch (const std::exception &e)
+    {
+        fprintf(stderr, "[error] %s\n", e.what());
+        return 1;
+    }
+
+    // 客户端提前断开连接时，向其写入不应终止服务进程
+    std::signal(SIGPIPE, SIG_IGN);
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (param.socket.size() >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "[error] socket path \"%s\" is too long.\n",
+                param.socket.c_str());
+        return 1;
+    }
+    strcpy(address.sun_path, param.socket.c_str());
+
+    // 只删除上次运行遗留的套接字文件，同名的其它文件保持不变
+    struct stat info = {};
+    if (lstat(param.socket.c_str(), &info) == 0)
+    {
+        if (!S_ISSOCK(info.st_mode))
+        {
+            fprintf(stderr, "[error] \"%s\" exists and is not a socket.\n",
+                    param.socket.c_str());
+            return 1;
+        }
+        unlink(param.socket.c_str());
+    }
+
+    const int fd_server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd_server < 0 ||
+        bind(fd_server, reinterpret_cast<sockaddr *>(&address),
+             sizeof(address)) != 0 ||
+        listen(fd_server, 16) != 0)
+    {
+        fprintf(stderr, "[error] cannot listen on \"%s\": %s.\n",
+                param.socket.c_str(), strerror(errno));
+        return 1;
+    }
+    fprintf(stderr, "[info] listening on \"%s\" ...\n", param.socket.c_str());
+
+    // 按最近使用的顺序排列，超出数量上限时释放最久未使用的场景
+    std::list<Scene> scenes;
+    bool running = true;
+    while (running)
+    {
+        const int fd_client = accept(fd_server, nullptr, nullptr);
+        if (fd_client < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "[error] cannot accept connection: %s.\n",
+                    strerror(errno));
+            break;
+        }
+
+        std::vector<std::string> args;
+        if (!ReceiveJob(fd_client, &args))
+        {
+            close(fd_client);
+            continue;
+        }
+
+        // 任务执行期间将标准错误输出重定向到客户端，渲染进度等信息原样转发给客户端
+        fflush(stderr);
+        const int fd_stderr = dup(STDERR_FILENO);
+        dup2(fd_client, STDERR_FILENO);
+        bool success = true;
+        try
+        {
+            const Job job = ParseJob(args);
+            if (job.stop)
+            {
+                fprintf(stderr, "[info] stop rendering server.\n");
+                running = false;
+            }
+            else
+            {
+                RunJob(param, job, &scenes);
+            }
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << e.what() << '\n';
+            success = false;
+        }
+        fflush(stderr);
+        dup2(fd_stderr, STDERR_FILENO);
+        close(fd_stderr);
+
+        // 最后一行为任务的状态，供客户端判断任务是否成功
+        const std::string status = success ? "\n[done]\n" : "\n[failed]\n";
+        if (write(fd_client, status.data(), status.size()) < 0)
+        {
+            fprintf(stderr, "[warning] client disconnected before job "
+                            "finished.\n");
+        }
+        close(fd_client);
+        fprintf(stderr, "[info] job %s.\n", success ? "done" : "failed");
+    }
+
+    scenes.clear();
+    close(fd_server);
+    unlink(param.socket.c_str());
+#ifdef ENABLE_CUDA
+    cudaDeviceReset();
+#endif
+    return 0;
+}
+
+Param ParseParam(int argc, char **argv)
+{
+    std::cerr << "A Simple Ray Tracer, rendering server.\n\n";
+    std::cerr << "Command Format:\n";
+    std::cerr << "  '[-c/--cpu/-g/--gpu] "
+                 "[--socket 'file path'] "
+                 "[--max-scenes 'value'] "
+                 "[--threads/-t 'value'] "
+                 "[--tile-size 'value'] "
+                 "[--affinity] "
+                 "[--numa] "
+                 "[--numa-replicate]'.\n\n";
+    std::cerr << "Option:\n";
+    std::cerr << "  --'cpu' or '-c': use CPU for offline rendering.\n"
+                 "      if not specify specify CPU/CUDA, use CPU.\n";
+    std::cerr << "  --'gpu' or '-g': use CUDA for offline rendering,\n"
+                 "      no effect if disbale CUDA when compiling.\n"
+                 "      if not specify specify CPU/CUDA, use CPU.\n";
+    std::cerr << "  '--socket': path of the Unix domain socket to listen on,\n"
+                 "      default: 'csrt.sock'.\n";
+    std::cerr << "  '--max-scenes': specify the number of scenes kept in "
+                 "memory between jobs,\n"
+                 "      default: 4.\n";
+    std::cerr << "  '--threads' or '-t': specify the number of CPU rendering "
+                 "threads,\n"
+                 "      default: the number of hardware threads.\n";
+    std::cerr << "  '--tile-size': specify the edge length of CPU rendering "
+                 "tiles in pixels,\n"
+                 "      default: 8.\n";
+    std::cerr << "  '--affinity': pin each CPU rendering thread to a logical "
+                 "processor.\n";
+    std::cerr << "  '--numa': split CPU rendering threads evenly over NUMA "
+                 "nodes,\n"
+                 "      and keep neighbouring tiles on the same node, no "
+                 "effect on single-node machines.\n";
+    std::cerr << "  '--numa-replicate': like '--numa', and build a copy of "
+                 "the scene data on each node.\n\n";
+    std::cerr << "Jobs are submitted by 'RayTracerClient'.\n\n";
+
+    Param param;
+    for (int i = 0; i < argc; ++i)
+    {
+        if (argv[i] == std::string("--cpu") || argv[i] == std::string("-c"))
+        {
+            param.type = csrt::BackendType::kCpu;
+        }
+#ifdef ENABLE_CUDA
+        else if (argv[i] == std::string("--gpu") ||
+                 argv[i] == std::string("-g"))
+        {
+            param.type = csrt::BackendType::kCuda;
+        }
+#endif
+        else if (argv[i] == std::string("--socket") && i + 1 < argc)
+        {
+            param.socket = argv[i + 1];
+        }
+        else if (argv[i] == std::string("--max-scenes") && i + 1 < argc)
+        {
+            param.max_scenes = std::max(1, std::stoi(argv[i + 1]));
+        }
+        else if ((argv[i] == std::string("--threads") ||
+                  argv[i] == std::string("-t")) &&
+                 i + 1 < argc)
+        {
+            param.num_threads = std::stoi(argv[i + 1]);
+        }
+        else if (argv[i] == std::string("--tile-size") && i + 1 < argc)
+        {
+            param.tile_size = std::stoi(argv[i + 1]);
+        }
+        else if (argv[i] == std::string("--affinity"))
+        {
+            param.affinity = true;
+        }
+        else if (argv[i] == std::string("--numa"))
+        {
+            param.numa = true;
+        }
+        else if (argv[i] == std::string("--numa-replicate"))
+        {
+            param.numa_replicate = true;
+        }
+        else if (argv[i] == std::string("--help"))
+        {
+            exit(0);
+        }
+    }
+
+    return param;
+}
+
+bool ReceiveJob(const int fd, std::vector<std::string> *args)
+{
+    // 任务的每个参数占一行，以空行结束
+    std::string line;
+    char c = 0;
+    while (read(fd, &c, 1) == 1)
+    {
+        if (c != '\n')
+        {
+            line.push_back(c);
+        }
+        else if (line.empty())
+        {
+            return true;
+        }
+        else
+        {
+            args->push_back(line);
+            line.clear();
+        }
+    }
+    return false;
+}
+
+Job ParseJob(const std::vector<std::string> &args)
+{
+    auto ParseVec3 = [](const std::string &text, csrt::Vec3 *value)
+    {
+        if (sscanf(text.c_str(), "%f,%f,%f", &value->x, &value->y,
+                   &value->z) != 3)
+        {
+            throw csrt::MyException("invalid vector \"" + text + "\".");
+        }
+    };
+
+    Job job;
+    const size_t num_arg = args.size();
+    for (size_t i = 0; i < num_arg; ++i)
+    {
+        if (args[i] == "--stop")
+        {
+            job.stop = true;
+        }
+        else if ((args[i] == "--input" || args[i] == "-i") && i + 1 < num_arg)
+        {
+            job.input = args[++i];
+        }
+        else if ((args[i] == "--output" || args[i] == "-o") &&
+                 i + 1 < num_arg)
+        {
+            job.output = args[++i];
+        }
+        else if ((args[i] == "--width" || args[i] == "-w") && i + 1 < num_arg)
+        {
+            job.width = std::stoi(args[++i]);
+        }
+        else if ((args[i] == "--height" || args[i] == "-h") &&
+                 i + 1 < num_arg)
+        {
+            job.height = std::stoi(args[++i]);
+        }
+        else if ((args[i] == "--spp" || args[i] == "-s") && i + 1 < num_arg)
+        {
+            job.sample_count = std::stoi(args[++i]);
+        }
+        else if (args[i] == "--fov" && i + 1 < num_arg)
+        {
+            job.fov_x = std::stof(args[++i]);
+        }
+        else if (args[i] == "--eye" && i + 1 < num_arg)
+        {
+            ParseVec3(args[++i], &job.eye);
+            job.set_eye = true;
+        }
+        else if (args[i] == "--look-at" && i + 1 < num_arg)
+        {
+            ParseVec3(args[++i], &job.look_at);
+            job.set_look_at = true;
+        }
+        else if (args[i] == "--up" && i + 1 < num_arg)
+        {
+            ParseVec3(args[++i], &job.up);
+            job.set_up = true;
+        }
+        else if (args[i] == "--crop" && i + 1 < num_arg)
+        {
+            if (sscanf(args[++i].c_str(), "%d,%d,%d,%d", &job.crop_x,
+                       &job.crop_y, &job.crop_width, &job.crop_height) != 4)
+            {
+                throw csrt::MyException("invalid crop window \"" + args[i] +
+                                        "\".");
+            }
+        }
+        else if (args[i] == "--crop-base" && i + 1 < num_arg)
+        {
+            job.crop_base = args[++i];
+        }
+        else if (args[i] == "--stream")
+        {
+            job.stream = true;
+        }
+        else if (args[i] == "--exr-float")
+        {
+            job.exr_float = true;
+        }
+        else
+        {
+            throw csrt::MyException("unknown job option \"" + args[i] + "\".");
+        }
+    }
+
+    if (!job.stop && job.input.empty())
+        throw csrt::MyException("no input scene for the job.");
+    const std::string suffix = csrt::GetSuffix(job.output);
+    if (suffix != "png" && suffix != "exr" && suffix != "pfm")
+        throw csrt::MyException("only support png, exr and pfm output.");
+    if (job.stream && !job.crop_base.empty())
+    {
+        throw csrt::MyException(
+            "crop base is not supported when streaming the output.");
+    }
+    if (!job.crop_base.empty() && suffix != "png")
+        throw csrt::MyException("crop base only supports png output.");
+    return job;
+}
+
+uint64_t HashScene(const std::string &input,
+                   const std::vector<std::string> &assets)
+{
+    uint64_t hash = csrt::HashFile(input);
+    for (const std::string &filename : assets)
+        hash = csrt::HashFile(filename, hash);
+    return hash;
+}
+
+std::vector<csrt::FileStamp> StampScene(const std::string &input,
+                                        const std::vector<std::string> &assets)
+{
+    // 无法获取时记为无效值，之后总是重新计算哈希值
+    std::vector<csrt::FileStamp> stamps;
+    stamps.reserve(assets.size() + 1);
+    stamps.push_back(csrt::StampFile(input));
+    for (const std::string &filename : assets)
+        stamps.push_back(csrt::StampFile(filename));
+    return stamps;
+}
+
+void RunJob(const Param &param, const Job &job, std::list<Scene> *scenes)
+{
+    if (!std::ifstream(job.input))
+        throw csrt::MyException("cannot open scene \"" + job.input + "\".");
+    csrt::StreamInfo stream;
+    stream.enable = job.stream;
+    stream.exr_half = !job.exr_float;
+
+    auto it = scenes->begin();
+    while (it != scenes->end() && it->input != job.input)
+        ++it;
+    // 文件的大小与修改时间都未改变时直接复用，否则比较内容的哈希值，
+    // 内容未改变（如只是修改时间改变）时更新记录的大小与修改时间
+    bool unchanged = false;
+    if (it != scenes->end())
+    {
+        const std::vector<csrt::FileStamp> stamps =
+            StampScene(job.input, it->assets);
+        unchanged = stamps == it->stamps;
+        if (!unchanged && it->hash == HashScene(job.input, it->assets))
+        {
+            it->stamps = stamps;
+            unchanged = true;
+        }
+    }
+    if (unchanged && it->stream.enable == stream.enable &&
+        it->stream.exr_half == stream.exr_half)
+    {
+        scenes->splice(scenes->begin(), *scenes, it);
+        fprintf(stderr, "[info] reuse resident scene \"%s\".\n",
+                job.input.c_str());
+    }
+    else
+    {
+        if (it != scenes->end())
+            scenes->erase(it);
+        while (scenes->size() >= static_cast<size_t>(param.max_scenes))
+            scenes->pop_back();
+
+        csrt::RendererConfig config = csrt::LoadConfig(job.input);
+        config.backend_type = param.type;
+        if (param.num_threads > 0)
+            config.schedule.num_threads = param.num_threads;
+        if (param.tile_size > 0)
+            config.schedule.tile_size = param.tile_size;
+        config.schedule.affinity = param.affinity;
+        config.schedule.numa = param.numa || param.numa_replicate;
+        config.schedule.numa_replicate = param.numa_replicate;
+        config.stream = stream;
+
+        Scene scene;
+        scene.input = job.input;
+        scene.assets = config.asset_files;
+        scene.stamps = StampScene(job.input, scene.assets);
+        scene.hash = HashScene(job.input, scene.assets);
+        scene.stream = stream;
+        scene.camera = config.camera;
+        scene.ray_tracer = std::make_unique<csrt::RayTracer>(config);
+        scenes->push_front(std::move(scene));
+        fprintf(stderr,
+                "[info] load scene \"%s\" with %zu asset file(s), %zu "
+                "scene(s) resident.\n",
+                job.input.c_str(), scenes->front().assets.size(),
+                scenes->size());
+    }
+
+    Scene &scene = scenes->front();
+    csrt::Camera::Info info = scene.camera;
+    if (job.width > 0)
+        info.width = job.width;
+    if (job.height > 0)
+        info.height = job.height;
+    if (job.sample_count > 0)
+        info.spp = job.sample_count;
+    if (job.fov_x > 0)
+        info.fov_x = job.fov_x;
+    if (job.set_eye)
+        info.eye = job.eye;
+    if (job.set_look_at)
+        info.look_at = job.look_at;
+    if (job.set_up)
+        info.up = job.up;
+    info.crop_x = job.crop_x;
+    info.crop_y = job.crop_y;
+    info.crop_width = job.crop_width;
+    info.crop_height = job.crop_height;
+    scene.ray_tracer->SetCamera(info);
+    scene.ray_tracer->Draw(job.output, job.crop_base);
+}
\ No newline at end of file
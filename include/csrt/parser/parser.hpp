@@ -2,6 +2,7 @@
 #define CSRT__PARSER__PARSER_HPP
 
 #include <string>
+#include <vector>
 
 #include "../renderer/renderer.hpp"
 
@@ -10,6 +11,11 @@ namespace csrt
 
 RendererConfig LoadConfig(const std::string &filename);
 
+// 读取相机路径文件，每行一个相机：eye、look_at、up 三个向量共 9 个数，可选的第 10 个数为
+// 水平方向的可视角度。以 '#' 开头的行为注释。分辨率、样本数量等其余参数取 base 的值
+std::vector<Camera::Info> LoadCameraPath(const std::string &filename,
+                                         const Camera::Info &base);
+
 } // namespace csrt
 
 #endif
\ No newline at end of file
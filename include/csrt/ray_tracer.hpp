@@ -1,7 +1,9 @@
 #ifndef CSRT__RAY_TRACER_HPP
 #define CSRT__RAY_TRACER_HPP
 
+#include <atomic>
 #include <string>
+#include <vector>
 
 #include "parser/parser.hpp"
 #include "renderer/renderer.hpp"
@@ -15,7 +17,31 @@ public:
     RayTracer(const RendererConfig &config);
     ~RayTracer() { ReleaseData(); }
 
-    void Draw(const std::string &output_filename) const;
+    // 设置了裁剪窗口时，base_filename 为空则只输出窗口内的像素，
+    // 否则将窗口内的像素写入整幅图像 base_filename 的副本。
+    // 输出格式由扩展名决定，见 image_io::Write
+    void Draw(const std::string &output_filename,
+              const std::string &base_filename = "") const;
+
+    // 不经过磁盘，将结果（RGB，线性颜色，未经色调映射与量化）绘制到调用者提供的 frame 中。
+    // frame 为相机的整幅图像（宽 × 高 × 3 个 float），尚无样本与裁剪窗口外的像素为 0。
+    // CPU 后端每完成一个图块即将其写入 frame 并调用 callbacks.tile，不写入中间结果；
+    // 中止的方式与上面的 Draw 相同，中止时 frame 中为已绘制部分的结果
+    void Draw(float *frame, const DrawCallbacks &callbacks = {}) const;
+
+    // 更换相机（视角、分辨率、样本数量与裁剪窗口），保留已构建的场景
+    void SetCamera(const Camera::Info &info);
+
+    // 依次使用 cameras 中的相机绘制同一场景，第 k 帧写入 output_filenames[k]。
+    // 图像在后台线程中编码与写入，与下一帧的绘制同时进行
+    void DrawSequence(const std::vector<Camera::Info> &cameras,
+                      const std::vector<std::string> &output_filenames);
+
+    // 设置停止标志，宿主程序可以在其它线程或信号处理函数中将其置位以中止 CPU 渲染：
+    // 各渲染线程完成当前图块后停止，已绘制的部分按每个像素实际的样本数量归一化后输出，
+    // 同时输出样本数量图；设置了检查点时还会写入检查点，之后可以继续渲染。
+    // 停止标志由调用者持有，为空时不能中止渲染
+    void SetStopToken(const std::atomic<bool> *stop) { stop_ = stop; }
 
 #ifdef ENABLE_VIEWER
     void Preview(int argc, char **argv, const std::string &output_filename);
@@ -23,9 +49,30 @@ public:
 
 private:
     void ReleaseData();
+    // CPU 后端分多轮绘制，用于渐进式渲染、自适应采样与可中止的渲染。
+    // frame_out 不为空时绘制到 frame_out 中，不写入任何图像文件
+    void DrawPasses(const std::string &output_filename,
+                    const std::string &base_filename, float *frame_out,
+                    const DrawCallbacks *callbacks) const;
+    // CPU 后端按行带绘制，每个行带绘制完所有样本后即流式写入 output_filename，
+    // 不在内存中保存整幅图像
+    void DrawStream(const std::string &output_filename) const;
+    std::vector<float> CropFrame(const float *frame) const;
+    void WriteFrame(const float *frame, const std::string &filename,
+                    const std::string &base_filename) const;
 
     BackendType backend_type_;
+    ProgressiveInfo progressive_;
+    CheckpointInfo checkpoint_;
+    PartitionInfo partition_;
+    AdaptiveInfo adaptive_;
+    StreamInfo stream_;
+    uint32_t spp_;
+    Tile crop_;
     Renderer* renderer_;
+    // 绘制序列时写入图像的后台线程，为空时在绘制结束后直接写入
+    AsyncImageWriter *writer_;
+    const std::atomic<bool> *stop_;
     float *frame_;
 #ifdef ENABLE_VIEWER
     float *frame_srgb_;
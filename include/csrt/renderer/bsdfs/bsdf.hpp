@@ -3,6 +3,7 @@
 
 #include "../../tensor.hpp"
 #include "../../utils.hpp"
+#include "../sampler.hpp"
 #include "../textures/texture.hpp"
 #include "conductor.hpp"
 #include "dielectric.hpp"
@@ -104,7 +105,7 @@ public:
                        Texture *texture_buffer, float *brdf_avg_buffer,
                        float *albedo_avg_buffer);
 
-    QUALIFIER_D_H void Sample(uint32_t *seed, BsdfSampleRec *rec) const;
+    QUALIFIER_D_H void Sample(Sampler *sampler, BsdfSampleRec *rec) const;
     QUALIFIER_D_H void Evaluate(BsdfSampleRec *rec) const;
 
     QUALIFIER_D_H Vec3 ApplyBumpMapping(const Vec3 &normal, const Vec3 &tangent,
@@ -114,6 +115,12 @@ public:
     QUALIFIER_D_H Vec3 GetRadiance(const Vec2 &texcoord) const;
 
     QUALIFIER_D_H bool IsEmitter() const;
+    // 是否可以按路径引导抽样入射方向。镜面与光泽材质的反射集中在少数方向，
+    // 仍只按 BSDF 抽样
+    QUALIFIER_D_H bool IsGuidable() const;
+    // 是否为漫反射材质。随机渐进式光子映射在这样的表面记录可见点与光子，
+    // 其它表面的反射集中在少数方向，光子密度估计的偏差过大，继续追踪
+    QUALIFIER_D_H bool IsDiffuse() const;
     QUALIFIER_D_H bool IsTwosided() const { return data_.twosided; }
     QUALIFIER_D_H bool IsTransparent(const Vec2 &texcoord,
                                      uint32_t *seed) const;
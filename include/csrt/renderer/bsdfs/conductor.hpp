@@ -9,6 +9,7 @@ namespace csrt
 {
 
 struct BsdfSampleRec;
+class Sampler;
 
 struct ConductorInfo
 {
@@ -31,7 +32,7 @@ struct ConductorData
     float *albedo_avg_buffer = nullptr;
 };
 
-QUALIFIER_D_H void SampleConductor(const ConductorData &data, uint32_t *seed,
+QUALIFIER_D_H void SampleConductor(const ConductorData &data, Sampler *sampler,
                                    BsdfSampleRec *rec);
 
 QUALIFIER_D_H void EvaluateConductor(const ConductorData &data,
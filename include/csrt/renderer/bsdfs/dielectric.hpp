@@ -9,6 +9,7 @@ namespace csrt
 {
 
 struct BsdfSampleRec;
+class Sampler;
 
 struct DielectricInfo
 {
@@ -34,8 +35,8 @@ struct DielectricData
     Texture *specular_transmittance = nullptr;
 };
 
-QUALIFIER_D_H void SampleDielectric(const DielectricData &data, uint32_t *seed,
-                                    BsdfSampleRec *rec);
+QUALIFIER_D_H void SampleDielectric(const DielectricData &data,
+                                    Sampler *sampler, BsdfSampleRec *rec);
 
 QUALIFIER_D_H void EvaluateDielectric(const DielectricData &data,
                                       BsdfSampleRec *rec);
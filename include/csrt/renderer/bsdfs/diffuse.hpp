@@ -9,6 +9,7 @@ namespace csrt
 {
 
 struct BsdfSampleRec;
+class Sampler;
 
 struct DiffuseInfo
 {
@@ -20,7 +21,7 @@ struct DiffuseData
     Texture *diffuse_reflectance = nullptr;
 };
 
-QUALIFIER_D_H void SampleDiffuse(const DiffuseData &data, uint32_t *seed,
+QUALIFIER_D_H void SampleDiffuse(const DiffuseData &data, Sampler *sampler,
                                  BsdfSampleRec *rec);
 
 QUALIFIER_D_H void EvaluateDiffuse(const DiffuseData &data, BsdfSampleRec *rec);
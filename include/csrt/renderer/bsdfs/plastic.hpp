@@ -9,6 +9,7 @@ namespace csrt
 {
 
 struct BsdfSampleRec;
+class Sampler;
 
 struct PlasticInfo
 {
@@ -27,7 +28,7 @@ struct PlasticData
     Texture *specular_reflectance = nullptr;
 };
 
-QUALIFIER_D_H void SamplePlastic(const PlasticData &data, uint32_t *seed,
+QUALIFIER_D_H void SamplePlastic(const PlasticData &data, Sampler *sampler,
                                  BsdfSampleRec *rec);
 
 QUALIFIER_D_H void EvaluatePlastic(const PlasticData &data, BsdfSampleRec *rec);
@@ -9,6 +9,7 @@ namespace csrt
 {
 
 struct BsdfSampleRec;
+class Sampler;
 
 struct RoughDiffuseInfo
 {
@@ -25,7 +26,7 @@ struct RoughDiffuseData
 };
 
 QUALIFIER_D_H void SampleRoughDiffuse(const RoughDiffuseData &data,
-                                      uint32_t *seed, BsdfSampleRec *rec);
+                                      Sampler *sampler, BsdfSampleRec *rec);
 
 QUALIFIER_D_H void EvaluateRoughDiffuse(const RoughDiffuseData &data,
                                         BsdfSampleRec *rec);
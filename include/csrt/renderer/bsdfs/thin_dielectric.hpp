@@ -10,7 +10,7 @@ namespace csrt
 {
 
 QUALIFIER_D_H void SampleThinDielectric(const DielectricData &data,
-                                        uint32_t *seed, BsdfSampleRec *rec);
+                                        Sampler *sampler, BsdfSampleRec *rec);
 
 QUALIFIER_D_H void EvaluateThinDielectric(const DielectricData &data,
                                           BsdfSampleRec *rec);
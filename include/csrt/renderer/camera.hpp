@@ -2,6 +2,7 @@
 #define CSRT__RENDERER__CAMERA_HPP
 
 #include "../tensor.hpp"
+#include "sampler.hpp"
 
 namespace csrt
 {
@@ -12,12 +13,21 @@ public:
     struct Info
     {
         uint32_t spp = 64;
+        // 生成路径所需随机数的采样器
+        SamplerType sampler = SamplerType::kIndependent;
         int width = 1024;
         int height = 1024;
         float fov_x = 19.5;
         Vec3 eye = {0.0f, 1.0f, 6.8f};
         Vec3 look_at = {0.0f, 1.0f, 0.0f};
         Vec3 up = {0.0f, 1.0f, 0.0f};
+        // 裁剪窗口，CPU 后端只绘制 [crop_x, crop_x + crop_width) ×
+        // [crop_y, crop_y + crop_height) 中的像素，宽或高为 0 时绘制整幅图像。
+        // 窗口内像素的样本位置与随机数种子和绘制整幅图像时相同
+        int crop_x = 0;
+        int crop_y = 0;
+        int crop_width = 0;
+        int crop_height = 0;
     };
 
     QUALIFIER_D_H Camera();
@@ -27,6 +37,7 @@ public:
     QUALIFIER_D_H int height() const { return height_; }
     QUALIFIER_D_H uint32_t spp() const { return spp_; }
     QUALIFIER_D_H float spp_inv() const { return spp_inv_; }
+    QUALIFIER_D_H SamplerType sampler() const { return sampler_; }
     QUALIFIER_D_H float fov_x() const { return fov_x_; }
     QUALIFIER_D_H Vec3 eye() const { return eye_; }
     QUALIFIER_D_H Vec3 front() const { return front_; }
@@ -38,6 +49,7 @@ private:
     int height_;
     uint32_t spp_;
     float spp_inv_;
+    SamplerType sampler_;
     float fov_x_;
     float fov_y_;
     Vec3 eye_;
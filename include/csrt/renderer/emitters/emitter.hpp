@@ -9,6 +9,7 @@
 #include "constant_light.hpp"
 #include "directional_light.hpp"
 #include "envmap.hpp"
+#include "light_bvh.hpp"
 #include "point_light.hpp"
 #include "spot_light.hpp"
 #include "sun.hpp"
@@ -80,7 +81,8 @@ public:
                           Texture *texture_buffer);
 
     QUALIFIER_D_H void InitEnvMap(const int width, const int height,
-                                  const float normalization, float *pixels);
+                                  AliasEntry *alias_rows,
+                                  AliasEntry *alias_cols, float *pdf_map);
 
     QUALIFIER_D_H EmitterSampleRec Sample(const Vec3 &origin, const float xi_0,
                                           const float xi_1) const;
@@ -88,6 +90,15 @@ public:
     QUALIFIER_D_H float Pdf(const Vec3 &look_dir) const;
     QUALIFIER_D_H Vec3 Evaluate(const Vec3 &look_dir) const;
 
+    // 抽样点光源或聚光灯发出的光线，返回光线的起点、方向 dir 和方向的概率密度，
+    // 其它光源的概率密度为 0。沿 dir 的辐射强度为 Evaluate({true, true, 1, dir})
+    QUALIFIER_D_H Vec3 SampleEmission(const float xi_0, const float xi_1,
+                                      Vec3 *dir, float *pdf) const;
+    QUALIFIER_D_H float PdfEmission(const Vec3 &dir) const;
+
+    // 位于无穷远处的光源（平行光、太阳和环境光），不参与光源层次包围盒
+    QUALIFIER_D_H bool IsInfinite() const;
+
 private:
     uint32_t id_;
     EmitterData data_;
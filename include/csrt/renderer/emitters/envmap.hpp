@@ -21,20 +21,22 @@ struct EnvMapData
 {
     int width = 0;
     int height = 0;
-    float normalization = 0;
     Texture *radiance = nullptr;
-    float *cdf_cols;    // 像素列的累积分布函数
-    float *cdf_rows;    // 像素行的累积分布函数
-    float *weight_rows; // 像素行的权重
+    AliasEntry *alias_rows; // 按边缘分布抽样像素行的别名表
+    AliasEntry *alias_cols; // 逐行存放的按条件分布抽样像素列的别名表
+    float *pdf_map;         // 各像素对应立体角测度下的概率密度
     Mat4 to_world = {};
     Mat4 to_local = {};
 };
 
-
-void CreateEnvMapCdfPdf(const int width, const int height,
-                        const Texture &radiance, std::vector<float> *cdf_cols,
-                        std::vector<float> *cdf_rows,
-                        std::vector<float> *weight_rows, float *normalization);
+// 构建按亮度抽样环境映射的别名表与概率密度表。像素 (x, y) 被选中的概率正比于其
+// 亮度与所张立体角之积，在像素内按立体角均匀抽样，因此概率密度在像素内是常数。
+// 像素 (x, y) 的列别名表项和概率密度都位于下标 y * width + x 处
+void CreateEnvMapAliasTable(const int width, const int height,
+                            const Texture &radiance,
+                            std::vector<AliasEntry> *alias_rows,
+                            std::vector<AliasEntry> *alias_cols,
+                            std::vector<float> *pdf_map);
 
 QUALIFIER_D_H void SampleEnvMap(const EnvMapData &data, const Vec3 &origin,
                                 const float xi_0, const float xi_1,
@@ -0,0 +1,78 @@
+#ifndef CSRT__RENDERER__EMITTERS__LIGHT_BVH_HPP
+#define CSRT__RENDERER__EMITTERS__LIGHT_BVH_HPP
+
+#include <vector>
+
+#include "../../rtcore/accel/aabb.hpp"
+#include "../../tensor.hpp"
+#include "../../utils.hpp"
+
+namespace csrt
+{
+
+// 光源的空间范围、朝向与功率，用于估计光源对着色点的贡献
+struct LightBounds
+{
+    // 发光表面的两面都发光
+    bool two_sided = false;
+    // 光源的功率（亮度），为 0 表示光源不参与光源层次包围盒
+    float power = 0;
+    // 发光表面的法线都位于以 axis 为轴的圆锥之内，cos_theta_o 为其半顶角的余弦
+    float cos_theta_o = 1;
+    // 每个发光点只向与其法线夹角不超过 theta_e 的方向发光
+    float cos_theta_e = 0;
+    Vec3 axis = {0, 0, 1};
+    AABB aabb = {};
+
+    // 光源对位于 position、法线为 normal 的着色点的贡献的保守估计，
+    // normal 为零向量时（例如参与介质中的散射点）不考虑着色点的朝向
+    QUALIFIER_D_H float Importance(const Vec3 &position,
+                                   const Vec3 &normal) const;
+};
+
+struct LightBvhNode
+{
+    bool leaf = true;
+    // 叶节点对应的光源 ID，或者中间节点的右子节点 ID，左子节点紧随当前节点之后
+    uint32_t id = kInvalidId;
+    LightBounds bounds = {};
+};
+
+// 光源层次包围盒（light BVH），按每个光源对着色点贡献的估计值随机地逐层选择子节点，
+// 从而在大量光源中抽样一个光源。参考 Conty Estevez and Kulla, "Importance
+// Sampling of Many Lights with Adaptive Tree Splitting", HPG 2018
+class LightBvh
+{
+public:
+    QUALIFIER_D_H LightBvh();
+    QUALIFIER_D_H LightBvh(const LightBvhNode *nodes,
+                           const uint64_t *bit_trails);
+
+    // 抽样一个光源，返回其 ID 和被选中的概率；没有可以照亮着色点的光源时返回 kInvalidId
+    QUALIFIER_D_H uint32_t Sample(const Vec3 &position, const Vec3 &normal,
+                                  float xi, float *pdf) const;
+    // 在同一个着色点抽样时，选中光源 id_light 的概率
+    QUALIFIER_D_H float Pdf(const Vec3 &position, const Vec3 &normal,
+                            const uint32_t id_light) const;
+    // 不考虑着色点，按光源的功率抽样一个光源（例如作为光路的起点），返回其 ID 和
+    // 被选中的概率；没有光源时返回 kInvalidId
+    QUALIFIER_D_H uint32_t SamplePower(float xi, float *pdf) const;
+    // 按光源的功率抽样时，选中光源 id_light 的概率
+    QUALIFIER_D_H float PdfPower(const uint32_t id_light) const;
+
+private:
+    const LightBvhNode *nodes_;
+    // 从根节点到各个光源所在叶节点的路径，第 k 位为 1 表示在第 k 层选择右子节点
+    const uint64_t *bit_trails_;
+};
+
+constexpr uint64_t kInvalidBitTrail = ~0ull;
+
+// 按 SAOH（surface area orientation heuristic）自顶向下地构建光源层次包围盒，
+// 返回所有节点，以及每个光源的路径（不参与的光源为 kInvalidBitTrail）
+std::vector<LightBvhNode> BuildLightBvh(const std::vector<LightBounds> &lights,
+                                        std::vector<uint64_t> *bit_trails);
+
+} // namespace csrt
+
+#endif
\ No newline at end of file
@@ -30,6 +30,14 @@ QUALIFIER_D_H Vec3 EvaluatePointLight(const PointLightData &data,
 QUALIFIER_D_H float PdfPointLight(const PointLightData &data,
                                   const Vec3 &look_dir);
 
+// 抽样点光源发出的光线，返回光线的起点、方向 dir 和方向的概率密度
+QUALIFIER_D_H Vec3 SamplePointLightEmission(const PointLightData &data,
+                                            const float xi_0, const float xi_1,
+                                            Vec3 *dir, float *pdf);
+
+QUALIFIER_D_H float PdfPointLightEmission(const PointLightData &data,
+                                          const Vec3 &dir);
+
 } // namespace csrt
 
 #endif
\ No newline at end of file
@@ -32,6 +32,7 @@ struct SpotLightData
     Vec3 intensity = {};
     Vec3 position = {};
     Mat4 to_local = {};
+    Mat4 to_world = {};
 };
 
 QUALIFIER_D_H void SampleSpotLight(const SpotLightData &data,
@@ -47,6 +48,14 @@ QUALIFIER_D_H Vec3 EvaluateSpotLight(const SpotLightData &data,
 QUALIFIER_D_H float PdfSpotLight(const SpotLightData &data,
                                  const Vec3 &look_dir);
 
+// 在聚光灯的照射范围之内均匀地抽样发出的光线，返回光线的起点、方向 dir 和方向的概率密度
+QUALIFIER_D_H Vec3 SampleSpotLightEmission(const SpotLightData &data,
+                                           const float xi_0, const float xi_1,
+                                           Vec3 *dir, float *pdf);
+
+QUALIFIER_D_H float PdfSpotLightEmission(const SpotLightData &data,
+                                         const Vec3 &dir);
+
 } // namespace csrt
 
 #endif
\ No newline at end of file
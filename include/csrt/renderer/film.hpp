@@ -0,0 +1,120 @@
+#ifndef CSRT__RENDERER__FILM_HPP
+#define CSRT__RENDERER__FILM_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace csrt
+{
+
+// 累积值使用定点数，整数加法满足结合律，分多个进程绘制的结果合并后与一次绘制逐位相同
+constexpr double kFilmFixedScale = 1099511627776.0; // 2^40
+
+// 检查点与部分累积结果文件的头部。头部之后依次存放 RGB 累积值、亮度统计量与样本数量，
+// 各数组的起始位置按 64 字节对齐，按本机字节序存储，可以直接内存映射读取
+struct CheckpointHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    // 已绘制的样本数量，即下一轮绘制的起始样本序号相对于 sample_begin 的偏移
+    uint32_t spp_done;
+    // 已完成的轮数
+    uint32_t index_pass;
+    // 第一个样本的序号
+    uint32_t sample_begin;
+    // 场景的哈希值，继续渲染时用于检查检查点文件是否属于同一场景
+    uint64_t scene_hash;
+    uint32_t reserved[6];
+};
+
+// CPU 后端逐像素累积的渲染结果，可以分多轮向其中追加样本。
+// 像素的第 k 个样本的序号为 sample_begin + k，随机数种子由像素与样本序号决定。
+// film 可以只覆盖图像中从第 y_begin 行开始的 height 行，像素坐标仍使用图像中的坐标，
+// 用于按行带流式输出超大图像；Resolve 等输出整个 film 的函数只写入这些行
+class Film
+{
+public:
+    Film(const uint32_t width, const uint32_t height,
+         const uint32_t sample_begin = 0, const uint32_t y_begin = 0);
+
+    // 清空累积的样本
+    void Reset();
+
+    // 累加另一个 film 的累积结果，两者的尺寸须一致。亮度统计量按 Chan 等人的方法合并
+    void Merge(const Film &other);
+
+    // 将累积的辐射亮度除以每个像素的样本数量，写入 RGB 格式的 frame
+    void Resolve(float *frame) const;
+    // 只处理 [x_begin, x_end) × [y_begin, y_end) 中的像素，frame 仍与整个 film 对应
+    void Resolve(const uint32_t x_begin, const uint32_t y_begin,
+                 const uint32_t x_end, const uint32_t y_end,
+                 float *frame) const;
+
+    // 低分辨率预览：已有样本的像素与 Resolve 相同，其余像素由坐标均为 stride
+    // 整数倍的网格点双线性插值得到，写入 RGB 格式的 frame。没有样本的网格点不参与插值
+    void ResolvePreview(const uint32_t stride, float *frame) const;
+
+    // 将每个像素的样本数量以热力图的形式写入 RGB 格式的 frame，
+    // 样本数量为 0 时为黑色，达到 spp_max 时为白色
+    void ResolveSampleCount(const uint32_t spp_max, float *frame) const;
+
+    // 像素 (i, j) 亮度均值的相对标准误差，样本数量不足 2 时返回无穷大
+    float RelativeError(const uint32_t i, const uint32_t j) const;
+
+    // 所有像素的样本数量之和
+    uint64_t num_sample() const;
+
+    // 将累积结果连同 header 写入检查点文件：先写入临时文件，再重命名为 filename，
+    // 写入过程中被中断也不会破坏已有的检查点
+    void Save(const std::string &filename, CheckpointHeader header) const;
+    // 内存映射检查点文件并读出累积结果，返回文件头部。
+    // 文件的尺寸与第一个样本的序号须与 film 一致
+    CheckpointHeader Load(const std::string &filename);
+    // 只读取检查点文件的头部
+    static CheckpointHeader LoadHeader(const std::string &filename);
+
+    uint32_t width() const { return width_; }
+    uint32_t height() const { return height_; }
+    uint32_t sample_begin() const { return sample_begin_; }
+    uint32_t y_begin() const { return y_begin_; }
+
+    // 像素 (i, j) 的 RGB 累积值，以 kFilmFixedScale 为单位的定点数
+    uint64_t *sum(const uint32_t i, const uint32_t j)
+    {
+        return sum_.data() +
+               (static_cast<uint64_t>(j - y_begin_) * width_ + i) * 3;
+    }
+    // 像素 (i, j) 已绘制的样本数量
+    uint32_t *count(const uint32_t i, const uint32_t j)
+    {
+        return count_.data() +
+               static_cast<uint64_t>(j - y_begin_) * width_ + i;
+    }
+    const uint32_t *count(const uint32_t i, const uint32_t j) const
+    {
+        return count_.data() +
+               static_cast<uint64_t>(j - y_begin_) * width_ + i;
+    }
+    // 像素 (i, j) 亮度的均值与离差平方和，由 Welford 算法逐样本更新
+    float *luminance_stats(const uint32_t i, const uint32_t j)
+    {
+        return stats_.data() +
+               (static_cast<uint64_t>(j - y_begin_) * width_ + i) * 2;
+    }
+
+private:
+    uint32_t width_;
+    uint32_t height_;
+    uint32_t sample_begin_;
+    uint32_t y_begin_;
+    std::vector<uint64_t> sum_;
+    std::vector<float> stats_;
+    std::vector<uint32_t> count_;
+};
+
+} // namespace csrt
+
+#endif
\ No newline at end of file
@@ -0,0 +1,24 @@
+#ifndef CSRT__RENDERER__INTEGRATORS__BDPT_HPP
+#define CSRT__RENDERER__INTEGRATORS__BDPT_HPP
+
+#include "path.hpp"
+
+namespace csrt
+{
+
+struct IntegratorData;
+
+// 光源子路径与相机子路径各自最多记录的顶点数量，更长的路径只能由其它策略得到
+constexpr uint32_t kMaxBdptVertex = 16;
+
+// 双向路径追踪（BDPT）。从按功率抽样的光源出发追踪光源子路径，从相机出发追踪相机子路径，
+// 连接两者的顶点得到各种长度的光路，按幂启发式的多重重要抽样合并所有策略。
+// 不包含把光源子路径连接到相机的策略（t = 1）；位于无穷远处的光源与 path 一样按
+// 阴影光线和次生光线抽样；不考虑参与介质。参考 Veach, "Robust Monte Carlo Methods
+// for Light Transport Simulation", 1997, chapter 10
+QUALIFIER_D_H Vec3 ShadeBdpt(const IntegratorData *data, const Vec3 &eye,
+                             const Vec3 &look_dir, Sampler *sampler);
+
+} // namespace csrt
+
+#endif
\ No newline at end of file
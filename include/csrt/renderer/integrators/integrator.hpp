@@ -1,7 +1,9 @@
 #ifndef CSRT__RENDERER__INTEGRATORS__INTEGRATOR_HPP
 #define CSRT__RENDERER__INTEGRATORS__INTEGRATOR_HPP
 
+#include "bdpt.hpp"
 #include "path.hpp"
+#include "sppm.hpp"
 #include "volpath.hpp"
 
 namespace csrt
@@ -11,6 +13,8 @@ enum class IntegratorType
 {
     kPath,
     kVolPath,
+    kBdpt,
+    kSppm,
 };
 
 struct IntegratorInfo
@@ -24,13 +28,36 @@ struct IntegratorInfo
     uint32_t depth_rr = 0;
     // 光线追踪的最大深度
     uint32_t depth_max = kMaxUint;
+    // 是否启用路径引导（仅 CPU 后端与 path、volpath 积分器）：正式绘制之前先训练 SD-tree，
+    // 之后在漫反射表面按学到的入射辐射亮度与 BSDF 混合抽样次生光线
+    bool guiding = false;
+    // 训练的轮数，第 k 轮（从 0 开始）为每个像素绘制 2^k 个样本，训练的样本不计入结果
+    uint32_t guiding_passes = 5;
+    // 按 SD-tree 而非 BSDF 抽样次生光线的概率
+    float guiding_fraction = 0.5f;
+    // 是否启用效率感知的俄罗斯轮盘赌与路径分裂（仅 CPU 与 path 积分器）：正式绘制之前
+    // 先以少量样本估计各像素的亮度以及各处继续追踪的收益与代价，之后按路径通量决定终止
+    // 或分裂路径，取代固定概率的俄罗斯轮盘赌，不受 depth_rr 约束
+    bool rrs = false;
+    // 预绘制时每个像素的样本数量（至少为 2），这些样本不计入结果
+    uint32_t rrs_spp = 4;
+    // 是否按重抽样重要性抽样（RIS）求直接光照（仅 path 积分器）：每个着色点先抽样多个
+    // 不检查遮挡的候选点，按 BSDF 与光源辐射亮度之积选出一个，只发出一条阴影光线
+    bool ris = false;
+    // 每个着色点抽样的候选点数量
+    uint32_t ris_candidates = 16;
+    // 随机渐进式光子映射（仅 CPU 后端）每一轮追踪的光子数量
+    uint32_t sppm_photons = 250000;
+    // 可见点的初始半径，为 0 时按场景尺寸与图像分辨率自动选取
+    float sppm_radius = 0;
+    // 每一轮保留的新光子的比例，越小半径缩小得越快
+    float sppm_alpha = 0.7f;
 };
 
 struct IntegratorData
 {
     // 光线跟踪算法基本信息
     IntegratorInfo info = {};
-    uint32_t size_cdf_area_light = 0;
     float pdf_rr_rcp = 0;
 
     // 面光源数量
@@ -59,8 +86,16 @@ struct IntegratorData
     uint32_t *map_id_area_light_instance = nullptr;
     // 从实例 ID 到相应面光源 ID 的映射
     uint32_t *map_id_instance_area_light = nullptr;
-    // 面光源抽样权重的累积分布函数
-    float *cdf_area_light = nullptr;
+    // 点光源、聚光灯和面光源的层次包围盒。光源 ID 小于 num_emitter 时对应 emitters
+    // 中的光源，否则对应 ID 为光源 ID 减去 num_emitter 的面光源
+    LightBvh light_bvh = {};
+
+    // 路径引导所用的 SD-tree，为空时只按 BSDF 抽样
+    const GuidingField *guiding = nullptr;
+
+    // 效率感知的俄罗斯轮盘赌与路径分裂所用的网格，为空或没有像素亮度估计时
+    // 使用固定概率的俄罗斯轮盘赌
+    const RrsField *rrs = nullptr;
 
     // 顶层加速结构
     TLAS *tlas = nullptr;
@@ -74,8 +109,15 @@ public:
     QUALIFIER_D_H Integrator() : data_{} {}
     QUALIFIER_D_H Integrator(const IntegratorData &data) : data_(data) {}
 
+    // path 不为空时，记录路径上可引导的散射点，用于训练路径引导。
+    // id_pixel 为样本所属像素的序号（行优先），用于查找像素的亮度估计。
+    // rrs_path 不为空时，记录路径上各个散射点之后的辐射亮度与代价，用于构建 RRS 网格
     QUALIFIER_D_H Vec3 Shade(const Vec3 &eye, const Vec3 &look_dir,
-                             uint32_t *seed) const;
+                             Sampler *sampler, GuidingPath *path = nullptr,
+                             const uint32_t id_pixel = kInvalidId,
+                             RrsPath *rrs_path = nullptr) const;
+
+    QUALIFIER_D_H const IntegratorData *data() const { return &data_; }
 
 private:
     IntegratorData data_;
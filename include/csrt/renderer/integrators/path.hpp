@@ -7,24 +7,53 @@
 #include "../bsdfs/bsdf.hpp"
 #include "../emitters/emitter.hpp"
 #include "../medium/medium.hpp"
+#include "../sampler.hpp"
+#include "rrs_cache.hpp"
+#include "sd_tree.hpp"
 
 namespace csrt
 {
 
 struct IntegratorData;
 
+// pixel 为样本所属像素的亮度估计，为 0 时使用固定概率的俄罗斯轮盘赌
 QUALIFIER_D_H Vec3 ShadePath(const IntegratorData *data, const Vec3 &eye,
-                             const Vec3 &look_dir, uint32_t *seed);
+                             const Vec3 &look_dir, Sampler *sampler,
+                             const float pixel = 0,
+                             GuidingPath *path = nullptr,
+                             RrsPath *rrs_path = nullptr);
 
 QUALIFIER_D_H Vec3 EvaluateDirectLightPath(const IntegratorData *data,
                                            const Hit &hit, const Vec3 &wo,
-                                           uint32_t *seed);
+                                           Sampler *sampler);
+
+// 逐个抽样位于无穷远处的光源得到阴影光线，返回其贡献的直接光照
+QUALIFIER_D_H Vec3 EvaluateInfiniteLightPath(const IntegratorData *data,
+                                             const Hit &hit, const Vec3 &wo,
+                                             Sampler *sampler);
 
 QUALIFIER_D_H BsdfSampleRec EvaluateRayPath(const Vec3 &wi, const Vec3 &wo,
                                             const Hit &hit, Bsdf *bsdf);
 
 QUALIFIER_D_H BsdfSampleRec SampleRayPath(const Vec3 &wo, const Hit &hit,
-                                          Bsdf *bsdf, uint32_t *seed);
+                                          Bsdf *bsdf, Sampler *sampler);
+
+// 启用路径引导且着色点可以引导时，按 SD-tree 与 BSDF 的混合分布抽样次生光线，
+// rec.pdf 为混合分布的概率密度（one-sample MIS）；否则与 SampleRayPath 相同
+QUALIFIER_D_H BsdfSampleRec SampleRayPathGuided(const IntegratorData *data,
+                                                const Vec3 &wo, const Hit &hit,
+                                                Bsdf *bsdf, Sampler *sampler);
+
+// SampleRayPathGuided 抽样到入射方向 wi 的概率密度，pdf_bsdf 为按 BSDF 抽样的概率密度，
+// 用于阴影光线的多重重要抽样
+QUALIFIER_D_H float PdfRayPathGuided(const IntegratorData *data,
+                                     const Vec3 &wi, const Hit &hit,
+                                     Bsdf *bsdf, const float pdf_bsdf);
+
+// 记录路径上刚刚抽样过次生光线的散射点，L 为此时路径已经累积的辐射亮度
+QUALIFIER_D_H void RecordGuidingVertex(const BsdfSampleRec &rec,
+                                       const Vec3 &attenuation, const Vec3 &L,
+                                       Bsdf *bsdf, GuidingPath *path);
 
 } // namespace csrt
 
@@ -0,0 +1,120 @@
+#ifndef CSRT__RENDERER__INTEGRATORS__RRS_CACHE_HPP
+#define CSRT__RENDERER__INTEGRATORS__RRS_CACHE_HPP
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "../../rtcore/accel/aabb.hpp"
+#include "../../tensor.hpp"
+#include "../../utils.hpp"
+
+namespace csrt
+{
+
+// 路径上一个决定是否继续追踪的散射点
+struct RrsVertex
+{
+    Vec3 position = {};
+    // 到达该散射点时路径通量的亮度
+    float throughput = 0;
+    // 到达该散射点时路径已经累积的辐射亮度的亮度
+    float radiance = 0;
+    // 散射点的深度
+    uint32_t depth = 0;
+};
+
+// 每条路径最多记录的散射点数量，更深的散射点不参与估计
+constexpr uint32_t kMaxRrsVertex = 16;
+
+// 预绘制时一条路径的散射点，以及最终的深度与辐射亮度的亮度
+struct RrsPath
+{
+    uint32_t num_vertex = 0;
+    RrsVertex vertices[kMaxRrsVertex];
+    uint32_t depth = 0;
+    float L = 0;
+};
+
+// 效率感知的俄罗斯轮盘赌与路径分裂（RRS）的只读视图。
+// 在散射点 x 继续追踪的路径数量（小于 1 时为生存概率）取
+//     q = 通量 / 像素亮度 × sqrt(M2(x) / C(x) × 每个样本的平均代价 / 每个样本的平均相对方差)，
+// 其中 M2(x) 与 C(x) 为从 x 继续追踪得到的辐射亮度的二阶矩与代价（散射点数量），
+// 此时图像的相对方差与绘制代价之积最小。像素亮度与以上各项都来自一轮预绘制，
+// M2(x) 与 C(x) 按均匀网格统计。参考 Rath et al., "EARS: Efficiency-Aware Russian
+// Roulette and Splitting", SIGGRAPH 2022
+class RrsField
+{
+public:
+    QUALIFIER_D_H RrsField();
+    QUALIFIER_D_H RrsField(const uint32_t num_pixel, const float *pixels,
+                           const Vec3 &origin, const float cell_size,
+                           const uint32_t *resolution, const float *factors);
+
+    // 像素 id_pixel 的亮度估计，没有估计时返回 0
+    QUALIFIER_D_H float Pixel(const uint32_t id_pixel) const
+    {
+        return id_pixel < num_pixel_ ? pixels_[id_pixel] : 0;
+    }
+    // 位置所在网格单元的系数，即上式中的平方根项
+    QUALIFIER_D_H float Factor(const Vec3 &position) const;
+
+private:
+    uint32_t num_pixel_;
+    const float *pixels_;
+    Vec3 origin_;
+    float cell_size_rcp_;
+    uint32_t resolution_[3];
+    const float *factors_;
+};
+
+// 在 CPU 上由预绘制构建的 RRS 网格
+class RrsCache
+{
+public:
+    RrsCache(const AABB &aabb);
+
+    // 丢弃已有的估计并按图像尺寸重新分配，此后所有像素的亮度估计均为 0
+    void Reset(const uint32_t width, const uint32_t height);
+    // 写入预绘制得到的像素 (i, j) 的亮度的均值与方差
+    void SetPixel(const uint32_t i, const uint32_t j, const float mean,
+                  const float variance)
+    {
+        const uint64_t offset = static_cast<uint64_t>(j) * width_ + i;
+        means_[offset] = mean;
+        variances_[offset] = variance;
+    }
+    // 记录一条路径上各个散射点之后的辐射亮度与代价，可以被多个线程同时调用
+    void Record(const RrsPath &path);
+    // 对 [x_begin, x_end) × [y_begin, y_end) 中的像素亮度做盒式滤波以抑制预绘制的噪声，
+    // 并求出各网格单元的系数。区域全黑时像素亮度估计保持为 0
+    void Build(const uint32_t x_begin, const uint32_t y_begin,
+               const uint32_t x_end, const uint32_t y_end);
+
+    const RrsField *field() const { return &field_; }
+
+private:
+    uint32_t LocateCell(const Vec3 &position) const;
+
+    uint32_t width_;
+    uint32_t height_;
+    std::vector<float> means_;
+    std::vector<float> variances_;
+    std::vector<float> pixels_;
+    Vec3 origin_;
+    float cell_size_;
+    uint32_t resolution_[3];
+    std::vector<float> factors_;
+    // 各网格单元记录的辐射亮度平方之和（定点数）、代价之和与散射点数量
+    std::unique_ptr<std::atomic<uint64_t>[]> moments_;
+    std::unique_ptr<std::atomic<uint64_t>[]> costs_;
+    std::unique_ptr<std::atomic<uint32_t>[]> counts_;
+    // 预绘制的路径数量与代价之和
+    std::atomic<uint64_t> num_path_;
+    std::atomic<uint64_t> cost_total_;
+    RrsField field_;
+};
+
+} // namespace csrt
+
+#endif
\ No newline at end of file
@@ -0,0 +1,124 @@
+#ifndef CSRT__RENDERER__INTEGRATORS__SD_TREE_HPP
+#define CSRT__RENDERER__INTEGRATORS__SD_TREE_HPP
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "../../rtcore/accel/aabb.hpp"
+#include "../../tensor.hpp"
+#include "../../utils.hpp"
+
+namespace csrt
+{
+
+// 路径上一个按路径引导抽样过入射方向的散射点
+struct GuidingVertex
+{
+    Vec3 position = {};
+    // 抽样得到的入射方向，由散射点指向光线的来源
+    Vec3 dir = {};
+    // 从相机到该散射点、且已乘上该点散射权重的路径通量
+    Vec3 throughput = {};
+    // 合并该散射点的直接光照之后，路径已经累积的辐射亮度
+    Vec3 radiance = {};
+    // 抽样该入射方向的概率密度
+    float pdf = 0;
+};
+
+// 每条路径最多记录的散射点数量，更深的散射点不参与训练
+constexpr uint32_t kMaxGuidingVertex = 16;
+
+// 训练路径引导时，一条路径的散射点与最终的辐射亮度
+struct GuidingPath
+{
+    uint32_t num_vertex = 0;
+    GuidingVertex vertices[kMaxGuidingVertex];
+    Vec3 L = {};
+};
+
+// 空间二叉树的节点，按深度依次沿 x、y、z 轴将包围盒对半划分
+struct STreeNode
+{
+    // 为 0 表示叶节点，否则为左子节点 ID，右子节点紧随其后
+    uint32_t child = 0;
+    // 叶节点用于抽样的方向四叉树的根节点 ID，没有学到辐射亮度时为 kInvalidId
+    uint32_t id_root = kInvalidId;
+};
+
+// 方向四叉树的节点，将 [0, 1)^2 划分为四个象限，象限序号为 (u >= 0.5) + 2 (v >= 0.5)
+struct DTreeNode
+{
+    // 各个象限的辐射亮度之和
+    float sum[4] = {};
+    // 各个象限的子节点 ID，为 0 表示象限不再划分
+    uint32_t child[4] = {};
+};
+
+// 路径引导所用的 SD-tree（空间二叉树与方向四叉树）的只读视图。
+// 方向 (x, y, z) 映射到 [0, 1)^2 中的 ((z + 1) / 2, phi / 2π)，该映射保持面积比例。
+// 参考 Müller et al., "Practical Path Guiding for Efficient Light-Transport
+// Simulation", EGSR 2017
+class GuidingField
+{
+public:
+    QUALIFIER_D_H GuidingField();
+    QUALIFIER_D_H GuidingField(const Vec3 &origin, const float size,
+                               const STreeNode *s_nodes,
+                               const DTreeNode *d_nodes);
+
+    // 位置所在的空间叶节点用于抽样的方向四叉树的根节点 ID，不能引导时返回 kInvalidId
+    QUALIFIER_D_H uint32_t Locate(const Vec3 &position) const;
+    // 按方向四叉树抽样一个入射方向，返回立体角测度下的概率密度
+    QUALIFIER_D_H Vec3 Sample(const uint32_t id_root, const Vec2 &xi,
+                              float *pdf) const;
+    // 按方向四叉树抽样到入射方向 dir 的概率密度（立体角测度）
+    QUALIFIER_D_H float Pdf(const uint32_t id_root, const Vec3 &dir) const;
+
+private:
+    // 包含场景的立方体
+    Vec3 origin_;
+    float size_;
+    const STreeNode *s_nodes_;
+    const DTreeNode *d_nodes_;
+};
+
+// 在 CPU 上训练的 SD-tree。每一轮训练中，各渲染线程并发地将路径记录到正在学习的
+// 方向四叉树中，累加使用定点数的原子操作，结果与线程的执行顺序无关；
+// 一轮结束后由 Update 根据学到的辐射亮度细分空间二叉树与方向四叉树
+class SdTree
+{
+public:
+    SdTree(const AABB &aabb);
+
+    // 丢弃学到的辐射亮度，回到只有一个空间叶节点的初始状态
+    void Reset();
+    // 记录一条路径上各个散射点的入射辐射亮度，可以被多个线程同时调用
+    void Record(const GuidingPath &path);
+    // 结束一轮每个像素 spp 个样本的训练，用学到的辐射亮度替换抽样所用的方向四叉树，
+    // 并细分空间二叉树与下一轮学习的方向四叉树。不能与 Record 同时调用
+    void Update(const uint32_t spp);
+
+    const GuidingField *field() const { return &field_; }
+
+private:
+    uint32_t LocateLeaf(const Vec3 &position) const;
+
+    Vec3 origin_;
+    float size_;
+    GuidingField field_;
+    std::vector<STreeNode> s_nodes_;
+    // 抽样所用的方向四叉树
+    std::vector<DTreeNode> sample_nodes_;
+    // 正在学习的方向四叉树的结构，以及各空间节点对应的根节点 ID
+    std::vector<DTreeNode> build_nodes_;
+    std::vector<uint32_t> build_roots_;
+    // 正在学习的方向四叉树各象限的辐射亮度之和（定点数），与 build_nodes_ 对应
+    std::unique_ptr<std::atomic<uint64_t>[]> build_sums_;
+    // 各空间节点记录的散射点数量
+    std::unique_ptr<std::atomic<uint32_t>[]> counts_;
+};
+
+} // namespace csrt
+
+#endif
\ No newline at end of file
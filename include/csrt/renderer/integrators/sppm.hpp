@@ -0,0 +1,136 @@
+#ifndef CSRT__RENDERER__INTEGRATORS__SPPM_HPP
+#define CSRT__RENDERER__INTEGRATORS__SPPM_HPP
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "../../rtcore/accel/aabb.hpp"
+#include "../../tensor.hpp"
+#include "../../utils.hpp"
+#include "../sampler.hpp"
+#include "path.hpp"
+
+namespace csrt
+{
+
+struct IntegratorData;
+
+// 像素在一轮中的可见点：相机路径穿过光泽与镜面表面之后，到达的第一个漫反射表面
+// 或参与介质中的散射点
+struct SppmVisiblePoint
+{
+    // 是否有可见点
+    bool valid = false;
+    // 位于景物表面时为表面上的交点，位于参与介质之中时只有位置
+    Hit hit = {};
+    Bsdf *bsdf = nullptr;
+    // 位于参与介质之中时为所在的参与介质，否则为空
+    Medium *medium = nullptr;
+    // 指向相机路径上前一个顶点的方向
+    Vec3 wo = {};
+    // 从相机到该点、且已乘上参与介质散射系数的路径通量
+    Vec3 beta = {};
+    // 本轮相机路径贡献的直接光照，更新像素时才累积，使中断的一轮不影响结果
+    Vec3 ld = {};
+};
+
+// 像素跨越各轮的渐进式估计。景物表面与参与介质中的可见点分别按面积与体积估计光子密度，
+// 各自维护半径、光子数量与累积通量
+struct SppmPixel
+{
+    SppmVisiblePoint vp;
+    // 各轮直接光照之和，以 kFilmFixedScale 为单位的定点数
+    uint64_t ld[3] = {};
+    float radius_surface = 0;
+    float radius_volume = 0;
+    float count_surface = 0;
+    float count_volume = 0;
+    Vec3 tau_surface = {};
+    Vec3 tau_volume = {};
+};
+
+// 在 CPU 上逐轮绘制的随机渐进式光子映射（SPPM）。每一轮先为每个像素追踪一条相机路径，
+// 累积直接光照并记录可见点，可见点按所在的网格单元插入哈希网格；再并行地从按功率抽样的
+// 光源出发追踪固定数量的光子，光子到达漫反射表面或在参与介质中散射时，把通量累加到
+// 半径之内的可见点上；最后按 Hachisuka 与 Jensen 的方法缩小各像素的半径。
+// 光子只在抵达之后即被消耗，不存储，哈希网格的节点数量不超过像素数量的 8 倍，
+// 每一轮占用的内存只由图像尺寸决定。参考 Hachisuka and Jensen, "Stochastic
+// Progressive Photon Mapping", SIGGRAPH Asia 2009，以及 pbrt-v3 的 SPPMIntegrator
+class Sppm
+{
+public:
+    // aabb 为场景的包围盒，infinite_lights 为位于无穷远处的光源 ID，
+    // has_finite_light 为光源层次包围盒中是否有光源。
+    // radius 为可见点的初始半径，为 0 时按场景尺寸与图像分辨率自动选取
+    Sppm(const AABB &aabb, const std::vector<uint32_t> &infinite_lights,
+         const bool has_finite_light, const uint32_t num_photon,
+         const float radius, const float alpha);
+
+    // 丢弃已有的估计并按图像尺寸重新分配，所有像素的半径恢复为初始半径
+    void Reset(const uint32_t width, const uint32_t height);
+    // 一轮开始之前清空哈希网格
+    void BeginIteration();
+    // 追踪像素 id_pixel 的相机路径，求出直接光照，记录可见点并插入哈希网格，
+    // 可以被多个线程同时调用
+    void TraceCamera(const IntegratorData *data, const uint32_t id_pixel,
+                     const Vec3 &eye, const Vec3 &look_dir, Sampler *sampler);
+    // 追踪一个光子，把通量累加到附近的可见点上，可以被多个线程同时调用
+    void TracePhoton(const IntegratorData *data, Sampler *sampler);
+    // 一轮的光子追踪完成之后调用。有光子的通量超出定点数的范围时，缩小缩放系数、
+    // 清空本轮收集的光子并返回 false，调用者须重新追踪本轮的所有光子
+    bool CheckFluxRange();
+    // 一轮结束之后更新像素 id_pixel 的半径与累积通量，并把该像素各轮的辐射亮度之和写入
+    // sum（以 kFilmFixedScale 为单位的定点数），可以被多个线程同时调用
+    void Update(const uint32_t id_pixel, uint64_t *sum);
+    // 所有像素更新之后，下一轮网格单元的边长取当前最大半径的两倍
+    void EndIteration();
+
+    uint32_t num_photon() const { return num_photon_; }
+
+private:
+    // 把像素 id_pixel 的可见点插入其半径所覆盖的每个网格单元
+    void Insert(const uint32_t id_pixel);
+    // 把到达 position 的光子的通量 beta 累加到附近的可见点上，
+    // medium 不为空时光子在参与介质中散射，否则位于漫反射表面上，dir 为光子的传播方向
+    void Deposit(const Vec3 &position, const Medium *medium, const Vec3 &dir,
+                 const Vec3 &beta);
+
+    // 哈希网格的节点，key 为网格单元的整数坐标拼接而成的键
+    struct GridNode
+    {
+        uint64_t key;
+        uint32_t id_pixel;
+        uint32_t next;
+    };
+
+    std::vector<uint32_t> infinite_lights_;
+    bool has_finite_light_;
+    uint32_t num_photon_;
+    float radius_init_;
+    float alpha_;
+    // 场景的包围球
+    Vec3 center_;
+    float radius_scene_;
+
+    uint32_t width_;
+    uint32_t height_;
+    std::vector<SppmPixel> pixels_;
+    // 当前一轮各可见点收集的光子数量，以及光子通量与 BSDF 或相函数之积
+    // （未除以光子数量的定点数）
+    std::unique_ptr<std::atomic<uint32_t>[]> counts_;
+    std::unique_ptr<std::atomic<uint64_t>[]> fluxes_;
+    // 定点数的缩放系数，只会按 2 的整数次幂缩小；本轮超出上限的最大通量（浮点数的位模式）
+    double flux_scale_;
+    std::atomic<uint32_t> flux_max_;
+
+    // 哈希网格各个桶的链表头，以及从 node_count_ 开始依次分配的节点
+    float cell_size_;
+    std::unique_ptr<std::atomic<uint32_t>[]> heads_;
+    std::vector<GridNode> nodes_;
+    std::atomic<uint32_t> node_count_;
+};
+
+} // namespace csrt
+
+#endif
\ No newline at end of file
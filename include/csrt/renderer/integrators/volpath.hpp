@@ -15,15 +15,16 @@ struct MediumHit
 };
 
 QUALIFIER_D_H Vec3 ShadeVolPath(const IntegratorData *data, const Vec3 &eye,
-                                const Vec3 &look_dir, uint32_t *seed);
+                                const Vec3 &look_dir, Sampler *sampler,
+                                GuidingPath *path = nullptr);
 
 QUALIFIER_D_H Vec3 EvaluateDirectLightVolPath(const IntegratorData *data,
                                               const Hit &hit, const Vec3 &wo,
-                                              uint32_t *seed);
+                                              Sampler *sampler);
 
 QUALIFIER_D_H Vec3 EvaluateDirectLightVolPath(const IntegratorData *data,
                                               const MediumHit &hit, const Vec3 &wo,
-                                              uint32_t *seed);
+                                              Sampler *sampler);
 
 } // namespace csrt
 
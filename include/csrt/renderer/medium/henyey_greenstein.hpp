@@ -7,8 +7,9 @@ namespace csrt
 {
 
 struct PhaseSampleRec;
+class Sampler;
 
-QUALIFIER_D_H void SampleHenyeyGreensteinPhase(const Vec3 &g, uint32_t *seed,
+QUALIFIER_D_H void SampleHenyeyGreensteinPhase(const Vec3 &g, Sampler *sampler,
                                                PhaseSampleRec *rec);
 
 QUALIFIER_D_H void EvaluateHenyeyGreensteinPhase(const Vec3 &g,
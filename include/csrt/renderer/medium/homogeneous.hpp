@@ -7,6 +7,7 @@ namespace csrt
 {
 
 struct MediumSampleRec;
+class Sampler;
 
 struct HomogeneousMediumInfo
 {
@@ -23,7 +24,7 @@ struct HomogeneousMediumData
 
 QUALIFIER_D_H void SampleHomogeneousMedium(const HomogeneousMediumData &data,
                                            const float max_distance,
-                                           uint32_t *seed,
+                                           Sampler *sampler,
                                            MediumSampleRec *rec);
 
 QUALIFIER_D_H void EvaluateHomogeneousMedium(const HomogeneousMediumData &data,
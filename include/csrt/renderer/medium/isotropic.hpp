@@ -7,10 +7,11 @@ namespace csrt
 {
 
 struct PhaseSampleRec;
+class Sampler;
 
 QUALIFIER_D_H void EvaluateIsotropicPhase(PhaseSampleRec *rec);
 
-QUALIFIER_D_H void SampleIsotropicPhase(uint32_t *seed, PhaseSampleRec *rec);
+QUALIFIER_D_H void SampleIsotropicPhase(Sampler *sampler, PhaseSampleRec *rec);
 
 } // namespace csrt
 
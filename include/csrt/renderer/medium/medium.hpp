@@ -2,6 +2,7 @@
 #define CSRT__RENDERER__MEDIUM__MEDIUM_HPP
 
 #include "../../tensor.hpp"
+#include "../sampler.hpp"
 
 #include "henyey_greenstein.hpp"
 #include "isotropic.hpp"
@@ -66,11 +67,11 @@ public:
     QUALIFIER_D_H Medium() : id_(kInvalidId), data_() {}
     QUALIFIER_D_H Medium(const uint32_t id, const MediumInfo &info);
 
-    QUALIFIER_D_H void Sample(const float max_distance, uint32_t *seed,
+    QUALIFIER_D_H void Sample(const float max_distance, Sampler *sampler,
                               MediumSampleRec *rec) const;
     QUALIFIER_D_H void Evaluate(MediumSampleRec *rec) const;
 
-    QUALIFIER_D_H void SamplePhase(uint32_t *seed, PhaseSampleRec *rec) const;
+    QUALIFIER_D_H void SamplePhase(Sampler *sampler, PhaseSampleRec *rec) const;
     QUALIFIER_D_H void EvaluatePhase(PhaseSampleRec *rec) const;
 
 private:
@@ -1,6 +1,9 @@
 #ifndef CSRT__RENDERER__RENDERER_HPP
 #define CSRT__RENDERER__RENDERER_HPP
 
+#include <atomic>
+#include <functional>
+#include <string>
 #include <vector>
 
 #include "../rtcore/scene.hpp"
@@ -8,23 +11,137 @@
 #include "bsdfs/bsdf.hpp"
 #include "camera.hpp"
 #include "emitters/emitter.hpp"
+#include "film.hpp"
 #include "integrators/integrator.hpp"
 #include "medium/medium.hpp"
 #include "textures/texture.hpp"
+#include "tile_scheduler.hpp"
 
 namespace csrt
 {
 
+// CPU 后端的多线程调度参数
+struct ScheduleInfo
+{
+    // 渲染线程数量，为 0 时使用硬件支持的线程数量
+    uint32_t num_threads = 0;
+    // 图块的边长（像素）
+    uint32_t tile_size = 8;
+    // 是否将渲染线程绑定到固定的逻辑处理器
+    bool affinity = false;
+    // 是否将渲染线程均分给各个 NUMA 节点，并将相邻的图块调度到同一节点，
+    // 只有一个节点时不起作用
+    bool numa = false;
+    // 启用 numa 时，是否在每个节点上复制一份只读的场景数据（BVH、图元与纹理等），
+    // 使各节点的线程只访问本地内存，代价是占用成倍的内存与构建时间
+    bool numa_replicate = false;
+};
+
+// CPU 后端渐进式渲染的参数
+struct ProgressiveInfo
+{
+    // 每一轮为每个像素绘制的样本数量，为 0 时不使用渐进式渲染
+    uint32_t spp_pass = 0;
+    // 每隔多少秒输出一次中间结果，为 0 时不按时间输出
+    double flush_interval = 10.0;
+    // 每隔多少轮输出一次中间结果，为 0 时不按轮数输出
+    uint32_t flush_passes = 0;
+    // 渲染的时间限制（秒），大于 0 时不断追加样本直到时间耗尽，忽略 camera.spp
+    double time_limit = 0;
+    // 是否在正式绘制之前，依次以 1/16 与 1/4 的分辨率（像素数量）绘制预览并输出
+    bool preview = false;
+};
+
+// CPU 后端检查点的参数
+struct CheckpointInfo
+{
+    // 检查点文件的路径，为空时不写入检查点
+    std::string filename;
+    // 每隔多少秒写入一次检查点，渲染被中止时也会写入
+    double interval = 600.0;
+    // 是否从检查点文件继续渲染
+    bool resume = false;
+    // 场景的哈希值，继续渲染时须与检查点文件中的一致
+    uint64_t scene_hash = 0;
+};
+
+// CPU 后端多进程分布式渲染中本进程负责的部分，各进程的部分累积结果可以逐位精确地合并
+struct PartitionInfo
+{
+    // 绘制的样本序号范围 [sample_begin, sample_end)，sample_end 为 0 时取 camera.spp
+    uint32_t sample_begin = 0;
+    uint32_t sample_end = 0;
+    // 将图块按编号交错地分为 num_tile_part 组，只绘制第 tile_part 组
+    uint32_t tile_part = 0;
+    uint32_t num_tile_part = 1;
+    // 部分累积结果文件的输出路径，为空时不输出
+    std::string filename;
+    // 场景的哈希值，写入部分累积结果，合并时须一致，因而不含图块分组
+    uint64_t scene_hash = 0;
+};
+
+// CPU 后端自适应采样的参数，每个像素的样本数量上限仍为 camera.spp
+struct AdaptiveInfo
+{
+    // 是否启用自适应采样
+    bool enable = false;
+    // 每个像素至少绘制的样本数量，之后才开始估计误差
+    uint32_t spp_min = 16;
+    // 每一轮为尚未收敛的图块追加的样本数量
+    uint32_t spp_step = 8;
+    // 图块内像素亮度相对标准误差的最大值低于该阈值时，认为图块已收敛
+    float threshold = 0.05f;
+    // 样本数量热力图的输出路径，为空时不输出
+    std::string heatmap;
+};
+
+// CPU 后端按行带流式输出的参数，用于内存中放不下整幅图像的超大分辨率。
+// 逐个行带绘制完所有样本后交给后台线程写入，内存中只保留有限的几个行带
+struct StreamInfo
+{
+    // 是否按行带绘制并流式写入输出图像
+    bool enable = false;
+    // 每个行带的行数，向上取整到图块边长的整数倍
+    uint32_t band_height = 64;
+    // 输出 EXR 时使用 half 还是 float 类型
+    bool exr_half = true;
+};
+
 struct RendererConfig
 {
-    BackendType backend_type;
+    BackendType backend_type = BackendType::kCpu;
+    ScheduleInfo schedule;
+    ProgressiveInfo progressive;
+    CheckpointInfo checkpoint;
+    PartitionInfo partition;
+    AdaptiveInfo adaptive;
+    StreamInfo stream;
     Camera::Info camera;
+    // 场景文件中的所有相机，第一个与 camera 相同
+    std::vector<Camera::Info> cameras;
     IntegratorInfo integrator;
     std::vector<TextureInfo> textures;
     std::vector<BsdfInfo> bsdfs;
     std::vector<MediumInfo> media;
     std::vector<InstanceInfo> instances;
     std::vector<EmitterInfo> emitters;
+    // 解析场景文件时读取的其它文件（纹理、环境光照与网格等），
+    // 用于判断常驻内存的场景是否需要重新加载
+    std::vector<std::string> asset_files;
+};
+
+// 相机裁剪窗口对应的像素区域，未设置裁剪窗口时为整幅图像，窗口越界时抛出 MyException
+Tile GetCropWindow(const Camera::Info &info);
+
+// 将渲染器嵌入其它程序时，CPU 后端在绘制过程中调用的回调。
+// 回调在渲染线程中并发地调用，须是线程安全的，且不应长时间阻塞
+struct DrawCallbacks
+{
+    // 整体进度推进时调用，参数为 [0, 1] 中的进度，设置后不再向 stderr 输出进度
+    std::function<void(double progress)> progress;
+    // 一个图块在本轮绘制完成时调用，此时图块中的像素已按各自的样本数量归一化写入 frame。
+    // frame 即调用者提供的整幅图像，按 tile 的坐标直接读取，无需拷贝
+    std::function<void(const Tile &tile, const float *frame)> tile;
 };
 
 class Renderer
@@ -33,14 +150,54 @@ public:
     Renderer(const RendererConfig &config);
     ~Renderer() { ReleaseData(); }
 
+    // 更换相机，场景、材质与光源等数据保持不变，可以连续绘制同一场景的多个视角
+    void SetCamera(const Camera::Info &info);
+
     void Draw(float *frame) const;
+    // CPU 后端：将 film 中每个像素的样本数量补足到 count_target，
+    // 进度按整体进度中 [progress_begin, progress_end] 的区间输出。
+    // 返回实际绘制的样本总数，为 0 时说明所有像素都已收敛或达到样本数量上限。
+    // stop 不为空且被置位时，各渲染线程完成当前图块后返回。
+    // frame 不为空时，每完成一个图块即将其结果写入 frame，并调用 callbacks->tile
+    uint64_t Draw(const uint32_t count_target, const double progress_begin,
+                  const double progress_end, const Timer &timer, Film *film,
+                  const std::atomic<bool> *stop = nullptr,
+                  float *frame = nullptr,
+                  const DrawCallbacks *callbacks = nullptr) const;
+    // CPU 后端：低分辨率预览，只为坐标均为 stride 整数倍的像素补足 1 个样本。
+    // 这些样本就是正式绘制时这些像素的第一个样本，之后的 Draw 直接沿用，
+    // 结果与不预览时逐位相同。预览结果由 Film::ResolvePreview 放大到整幅图像
+    uint64_t DrawPreview(const uint32_t stride, const Timer &timer, Film *film,
+                         const std::atomic<bool> *stop = nullptr) const;
+    // CPU 后端：只绘制 region 中的像素，film 须覆盖 region 所在的行，
+    // 用于按行带流式输出超大图像。不支持多进程分布式渲染，其余与 Draw 相同
+    uint64_t DrawRegion(const Tile &region, const uint32_t count_target,
+                        const double progress_begin, const double progress_end,
+                        const Timer &timer, Film *film,
+                        const std::atomic<bool> *stop = nullptr) const;
+    // CPU 后端：启用路径引导时，在正式绘制之前从头训练 SD-tree。训练的样本与正式绘制的
+    // 样本序号不同且不计入结果，训练结果只由场景与参数决定，与线程数量和图块顺序无关。
+    // 未启用路径引导时不做任何事
+    void TrainGuiding(const Timer &timer,
+                      const std::atomic<bool> *stop = nullptr) const;
+    // CPU 后端：启用效率感知的俄罗斯轮盘赌与路径分裂时，在正式绘制之前以少量样本估计
+    // 各像素亮度的均值与方差，以及路径在各处继续追踪的二阶矩与代价，须在 TrainGuiding
+    // 之后调用，以便估计与正式绘制使用同样的抽样策略。估计的样本不计入结果，
+    // 结果只由场景与参数决定。未启用时不做任何事
+    void LearnRrs(const Timer &timer,
+                  const std::atomic<bool> *stop = nullptr) const;
 #ifdef ENABLE_VIEWER
     void Draw(const uint32_t index_frame, float *frame, float *frame_srgb) const;
 #endif
 
 private:
+    // primary 不为空时构建 primary 的场景数据副本，只用于在其它 NUMA 节点上绘制
+    Renderer(const RendererConfig &config, const Renderer *primary);
+
     void ReleaseData();
 
+    // 在主线程所在节点以外的每个 NUMA 节点上构建场景数据副本
+    void CommitReplicas(const RendererConfig &config);
     void CommitTextures(const std::vector<TextureInfo> &list_texture_info);
     void CommitBsdfs(const size_t num_texture,
                      const std::vector<BsdfInfo> &list_bsdf_info);
@@ -48,12 +205,25 @@ private:
     void CommitEmitters(const std::vector<TextureInfo> &list_texture_info,
                         const std::vector<EmitterInfo> &list_emitter_info,
                         uint32_t *id_sun, uint32_t *id_envmap);
+    // 为点光源、聚光灯和面光源构建光源层次包围盒，须在 CommitBsdfs 与 CommitEmitters
+    // 之后调用
+    void CommitLightBvh(const RendererConfig &config,
+                        const uint32_t num_area_light);
     void CommitIntegrator(const IntegratorInfo &integrator_info,
                           const uint32_t num_area_light,
                           const uint32_t num_emitter, const uint32_t id_sun,
-                          const uint32_t id_envmap);
+                          const uint32_t id_envmap,
+                          const GuidingField *guiding,
+                          const RrsField *rrs);
 
     BackendType backend_type_;
+    uint32_t tile_size_;
+    PartitionInfo partition_;
+    AdaptiveInfo adaptive_;
+    uint32_t guiding_passes_;
+    uint32_t rrs_spp_;
+    ThreadPool *thread_pool_;
+    TileScheduler *tile_scheduler_;
     Scene *scene_;
     Camera *camera_;
     Texture *textures_;
@@ -61,6 +231,18 @@ private:
     Medium *media_;
     Emitter *emitters_;
     Integrator *integrator_;
+    // 各个 NUMA 节点使用的积分器，未复制场景数据的节点使用 integrator_
+    std::vector<Integrator *> integrators_;
+    // 各个 NUMA 节点的场景数据副本，主线程所在的节点为空
+    std::vector<Renderer *> replicas_;
+    // 路径引导的 SD-tree，未启用路径引导时为空，场景数据副本共用主渲染器的 SD-tree
+    SdTree *sd_tree_;
+    // 效率感知的俄罗斯轮盘赌与路径分裂所用的 RRS 网格，未启用时为空，
+    // 场景数据副本共用主渲染器的 RRS 网格
+    RrsCache *rrs_cache_;
+    // 随机渐进式光子映射的可见点与哈希网格，未使用 sppm 积分器时为空，
+    // 只有主渲染器持有，场景数据副本只提供各节点的积分器数据
+    Sppm *sppm_;
 
     // 从实例ID到相应BSDF ID的映射
     uint32_t *map_instance_bsdf_;
@@ -68,12 +250,16 @@ private:
     uint32_t *map_area_light_instance_;
     // 从实例ID到相应面光源ID的映射
     uint32_t *map_instance_area_light_;
-    // 面光源抽样权重的累积分布函数
-    float *cdf_area_light_;
+    // 光源层次包围盒的节点
+    LightBvhNode *light_bvh_nodes_;
+    // 从根节点到各个光源所在叶节点的路径
+    uint64_t *light_bit_trails_;
     // 位图纹理像素数据
     float *pixels_;
-    // 环境映射纹理数据
-    float *data_env_map_;
+    // 抽样环境映射的行、列别名表
+    AliasEntry *env_map_alias_table_;
+    // 环境映射各像素对应立体角测度下的概率密度
+    float *env_map_pdf_;
     // Kulla-Conty LUT
     float *brdf_avg_buffer_;
     // Kulla-Conty LUT
@@ -0,0 +1,61 @@
+#ifndef CSRT__RENDERER__SAMPLER_HPP
+#define CSRT__RENDERER__SAMPLER_HPP
+
+#include "../tensor.hpp"
+#include "../utils.hpp"
+
+namespace csrt
+{
+
+enum class SamplerType
+{
+    // 伪随机数，像素内的样本位置按样本序号分层
+    kIndependent,
+    // Owen 扰乱的 Sobol 序列，每个像素使用不同的扰乱
+    kSobol,
+    // 按像素的 Morton 序排列的 Owen 扰乱 Sobol 序列，误差在屏幕空间呈蓝噪声分布
+    kZSobol,
+};
+
+// 为一条路径依次分配随机数维度的采样器，每次调用 Next1D 或 Next2D 占用一个维度。
+// 第 d 个维度的取值只由像素、样本序号与 d 决定，与绘制顺序、线程数量和分轮方式无关。
+// Sobol 序列只使用前两维，不同维度之间通过各自的 Owen 扰乱与样本序号重排去相关
+// （padding），因而维度数量没有上限。
+class Sampler
+{
+public:
+    // 像素 (i, j) 的第 s 个样本。kZSobol 根据图像尺寸与 spp 计算样本在整幅图像中的序号，
+    // 序号超出 32 位或 s 不小于 spp 向上取整到 2 的幂时（如限时渲染），退化为 kSobol
+    QUALIFIER_D_H Sampler(const SamplerType type, const uint32_t i,
+                          const uint32_t j, const uint32_t s,
+                          const uint32_t width, const uint32_t height,
+                          const uint32_t spp);
+
+    QUALIFIER_D_H SamplerType type() const { return type_; }
+
+    QUALIFIER_D_H float Next1D();
+    QUALIFIER_D_H Vec2 Next2D();
+
+    // 独立的伪随机数状态，用于消耗次数不固定、不需要分层的随机判定，
+    // 如遍历加速结构时的透明度测试，以免打乱其它维度的分配
+    QUALIFIER_D_H uint32_t *seed() { return &seed_; }
+
+private:
+    // 当前维度使用的 Sobol 序列下标
+    QUALIFIER_D_H uint32_t GetSobolIndex(const uint32_t hash) const;
+
+    SamplerType type_;
+    uint32_t dimension_;
+    uint32_t seed_;
+    // kSobol：像素的扰乱种子；kZSobol：固定的扰乱种子
+    uint32_t scramble_;
+    // kSobol：样本序号；kZSobol：像素的 Morton 码与样本序号拼接得到的序号
+    uint32_t index_;
+    // kZSobol 的序号中以 4 为底的位数，以及 spp 向上取整到 2 的幂后的对数
+    uint32_t num_base4_digits_;
+    uint32_t log2_spp_;
+};
+
+} // namespace csrt
+
+#endif
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef CSRT__RENDERER__TILE_SCHEDULER_HPP
+#define CSRT__RENDERER__TILE_SCHEDULER_HPP
+
+#include <cstdint>
+
+namespace csrt
+{
+
+// 图像中的一个矩形像素区域 [x_begin, x_end) × [y_begin, y_end)
+struct Tile
+{
+    uint32_t x_begin = 0;
+    uint32_t y_begin = 0;
+    uint32_t x_end = 0;
+    uint32_t y_end = 0;
+    // 图块在区域的图块网格中按行优先顺序的编号
+    uint64_t id = 0;
+};
+
+// 按需生成图块，不预先构建和排序像素列表。
+// 图块网格被划分为边长为 2 的幂的正方形块，块内按 Morton 序排列，块之间按行排列，
+// 以便任务下标相邻的图块在图像中也相邻。
+class TileScheduler
+{
+public:
+    // 只在 region 内划分图块，如裁剪窗口
+    TileScheduler(const Tile &region, const uint32_t tile_size);
+
+    // 任务下标的数量，包含落在图像之外而被跳过的填充下标
+    uint64_t num_task() const { return num_task_; }
+    // 图像中实际的图块数量
+    uint64_t num_tile() const
+    {
+        return static_cast<uint64_t>(num_tile_x_) * num_tile_y_;
+    }
+
+    const Tile &region() const { return region_; }
+
+    // 返回 false 表示该任务下标对应的图块落在图像之外
+    bool GetTile(const uint64_t id_task, Tile *tile) const;
+
+private:
+    Tile region_;
+    uint32_t tile_size_;
+    uint32_t num_tile_x_;
+    uint32_t num_tile_y_;
+    uint32_t log2_block_;
+    uint32_t num_block_x_;
+    uint64_t num_task_;
+};
+
+} // namespace csrt
+
+#endif
\ No newline at end of file
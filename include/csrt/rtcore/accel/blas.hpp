@@ -20,6 +20,11 @@ public:
     QUALIFIER_D_H bool IntersectAny(Bsdf *bsdf, uint32_t *seed, Ray *ray) const;
     QUALIFIER_D_H Hit Sample(const float xi_0, const float xi_1,
                              const float xi_2) const;
+    // 从 origin 处观察，按表面积选择图元后在其上抽样一点，pdf 为立体角测度下的概率密度
+    QUALIFIER_D_H Hit Sample(const Vec3 &origin, const float xi_0,
+                             const float xi_1, const float xi_2,
+                             float *pdf) const;
+    QUALIFIER_D_H float Pdf(const Vec3 &origin, const Hit &hit) const;
 
 private:
     const BvhNode *nodes_;
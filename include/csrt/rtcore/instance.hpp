@@ -67,6 +67,12 @@ public:
 
     QUALIFIER_D_H Hit Sample(const float xi_0, const float xi_1,
                              const float xi_2) const;
+    // 从 origin 处观察，抽样实例表面上的一点，pdf 为立体角测度下的概率密度
+    QUALIFIER_D_H Hit Sample(const Vec3 &origin, const float xi_0,
+                             const float xi_1, const float xi_2,
+                             float *pdf) const;
+    // 从 origin 处观察时，上述抽样方法得到实例表面上的点 hit 的概率密度
+    QUALIFIER_D_H float Pdf(const Vec3 &origin, const Hit &hit) const;
 
 private:
     uint32_t id_;
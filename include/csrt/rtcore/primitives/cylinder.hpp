@@ -28,6 +28,7 @@ struct CylinderData
 };
 
 QUALIFIER_D_H AABB GetAabbCylinder(const CylinderData &data);
+QUALIFIER_D_H float GetAreaCylinder(const CylinderData &data);
 
 QUALIFIER_D_H bool IntersectCylinder(const uint32_t id_primitive,
                                      const CylinderData &data, Bsdf *bsdf,
@@ -37,6 +38,17 @@ QUALIFIER_D_H Hit SampleCylinder(const uint32_t id_primitive,
                                  const CylinderData &data, const float xi_0,
                                  const float xi_1);
 
+// 从 origin 处观察，按表面积均匀地抽样圆柱面上朝向 origin 的一侧的一点，
+// pdf 为立体角测度下的概率密度；origin 位于圆柱面之内时抽样整个圆柱面
+QUALIFIER_D_H Hit SampleCylinder(const uint32_t id_primitive,
+                                 const CylinderData &data, const Vec3 &origin,
+                                 const float xi_0, const float xi_1,
+                                 float *pdf);
+
+// 从 origin 处观察时，上述抽样方法得到圆柱面上位于 position 的点的概率密度
+QUALIFIER_D_H float PdfCylinder(const CylinderData &data, const Vec3 &origin,
+                                const Vec3 &position);
+
 } // namespace csrt
 
 #endif
\ No newline at end of file
@@ -15,6 +15,7 @@ struct DiskData
 };
 
 QUALIFIER_D_H AABB GetAabbDisk(const DiskData &data);
+QUALIFIER_D_H float GetAreaDisk(const DiskData &data);
 
 QUALIFIER_D_H bool IntersectDisk(const uint32_t id_primitive,
                                  const DiskData &data, Bsdf *bsdf,
@@ -23,6 +24,16 @@ QUALIFIER_D_H bool IntersectDisk(const uint32_t id_primitive,
 QUALIFIER_D_H Hit SampleDisk(const uint32_t id_primitive, const DiskData &data,
                              const float xi_0, const float xi_1);
 
+// 从 origin 处观察，按表面积均匀地抽样圆盘上的一点，pdf 为立体角测度下的概率密度；
+// origin 位于圆盘背面时圆盘不可能照亮 origin，返回无效的抽样点
+QUALIFIER_D_H Hit SampleDisk(const uint32_t id_primitive, const DiskData &data,
+                             const Vec3 &origin, const float xi_0,
+                             const float xi_1, float *pdf);
+
+// 从 origin 处观察时，上述抽样方法得到圆盘上位于 position 的点的概率密度
+QUALIFIER_D_H float PdfDisk(const DiskData &data, const Vec3 &origin,
+                            const Vec3 &position);
+
 } // namespace csrt
 
 #endif
\ No newline at end of file
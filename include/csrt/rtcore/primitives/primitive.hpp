@@ -45,9 +45,14 @@ public:
     QUALIFIER_D_H Primitive(const uint32_t id, const PrimitiveData &data);
 
     QUALIFIER_D_H AABB aabb() const;
+    QUALIFIER_D_H float area() const;
     QUALIFIER_D_H bool Intersect(Bsdf *bsdf, uint32_t *seed, Ray *ray,
                                  Hit *hit) const;
     QUALIFIER_D_H Hit Sample(const float xi_0, const float xi_1) const;
+    // 从 origin 处观察，抽样景物表面上的一点，pdf 为立体角测度下的概率密度
+    QUALIFIER_D_H Hit Sample(const Vec3 &origin, const float xi_0,
+                             const float xi_1, float *pdf) const;
+    QUALIFIER_D_H float Pdf(const Vec3 &origin, const Vec3 &position) const;
 
 private:
     uint32_t id_;
@@ -17,6 +17,7 @@ struct SphereData
 };
 
 QUALIFIER_D_H AABB GetAabbSphere(const SphereData &data);
+QUALIFIER_D_H float GetAreaSphere(const SphereData &data);
 
 QUALIFIER_D_H bool IntersectSphere(const uint32_t id_primitive,
                                    const SphereData &data, Bsdf *bsdf,
@@ -26,6 +27,16 @@ QUALIFIER_D_H Hit SampleSphere(const uint32_t id_primitive,
                                const SphereData &data, const float xi_0,
                                const float xi_1);
 
+// 从 origin 处观察，在球面张成的圆锥内按立体角均匀地抽样球面上可见的一点，
+// pdf 为立体角测度下的概率密度；origin 位于球面之内时按表面积均匀抽样
+QUALIFIER_D_H Hit SampleSphere(const uint32_t id_primitive,
+                               const SphereData &data, const Vec3 &origin,
+                               const float xi_0, const float xi_1, float *pdf);
+
+// 从 origin 处观察时，上述抽样方法得到球面上位于 position 的点的概率密度
+QUALIFIER_D_H float PdfSphere(const SphereData &data, const Vec3 &origin,
+                              const Vec3 &position);
+
 } // namespace csrt
 
 #endif
\ No newline at end of file
@@ -19,6 +19,7 @@ struct TriangleData
 };
 
 QUALIFIER_D_H AABB GetAabbTriangle(const TriangleData &data);
+QUALIFIER_D_H float GetAreaTriangle(const TriangleData &data);
 
 QUALIFIER_D_H bool IntersectTriangle(const uint32_t id_primitive,
                                      const TriangleData &data, Bsdf *bsdf,
@@ -28,6 +29,17 @@ QUALIFIER_D_H Hit SampleTriangle(const uint32_t id_primitive,
                                  const TriangleData &data, const float xi_0,
                                  const float xi_1);
 
+// 从 origin 处观察，在三角形张成的球面三角形内按立体角均匀地抽样三角形上的一点，
+// pdf 为立体角测度下的概率密度；球面三角形过小或过大而数值不稳定时按表面积均匀抽样
+QUALIFIER_D_H Hit SampleTriangle(const uint32_t id_primitive,
+                                 const TriangleData &data, const Vec3 &origin,
+                                 const float xi_0, const float xi_1,
+                                 float *pdf);
+
+// 从 origin 处观察时，上述抽样方法得到三角形上位于 position 的点的概率密度
+QUALIFIER_D_H float PdfTriangle(const TriangleData &data, const Vec3 &origin,
+                                const Vec3 &position);
+
 } // namespace csrt
 
 #endif
\ No newline at end of file
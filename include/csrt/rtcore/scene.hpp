@@ -22,6 +22,7 @@ public:
     TLAS *GetTlas() const { return tlas_; };
     Instance *GetInstances() const { return instances_; }
     float *GetPdfAreaList() const { return list_pdf_area_; }
+    const std::vector<AABB> &GetAabbList() const { return list_aabb_; }
 
 private:
     void ReleaseData();
@@ -44,6 +45,8 @@ private:
     BLAS *list_blas_;
     // 场景中所有实例按面积均匀抽样时的概率（面积的倒数）
     float *list_pdf_area_;
+    // 场景中所有实例在世界坐标系下的包围盒
+    std::vector<AABB> list_aabb_;
 };
 
 } // namespace csrt
@@ -2,10 +2,16 @@
 #define CSRT__UTILS_HPP
 
 #include "defs.hpp"
+#include "utils/asset_cache.hpp"
+#include "utils/async_image_writer.hpp"
 #include "utils/image_io.hpp"
+#include "utils/mapped_file.hpp"
 #include "utils/math.hpp"
 #include "utils/memory.hpp"
 #include "utils/misc.hpp"
+#include "utils/numa.hpp"
+#include "utils/stream_image_writer.hpp"
+#include "utils/thread_pool.hpp"
 #include "utils/timer.hpp"
 
 #endif
\ No newline at end of file
@@ -0,0 +1,108 @@
+#ifndef CSRT__UTILS__ASSET_CACHE_HPP
+#define CSRT__UTILS__ASSET_CACHE_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace csrt
+{
+
+enum class AssetType
+{
+    kTexture,
+    kMesh,
+    kBlas,
+    kLut,
+    kCount
+};
+
+// 在同一进程渲染的多个场景之间共享的资源缓存，如解码后的纹理、读取的网格、
+// 构建好的 BLAS 与查找表。以资源内容（而非路径）的哈希值为键，
+// 总字节数超出容量时淘汰最久未使用的资源。容量为 0 时不缓存任何资源
+class AssetCache
+{
+public:
+    AssetCache() : capacity_(0), size_(0), num_hit_{}, num_miss_{} {}
+
+    AssetCache(const AssetCache &) = delete;
+    AssetCache &operator=(const AssetCache &) = delete;
+
+    // 设置容量（字节），超出新容量的资源立即淘汰
+    void SetCapacity(const uint64_t capacity);
+    bool enable() const { return capacity_ > 0; }
+
+    // 查找资源，未找到时返回空指针。同时统计命中率
+    template <typename T>
+    std::shared_ptr<const T> Find(const AssetType type, const uint64_t key)
+    {
+        return std::static_pointer_cast<const T>(FindEntry(type, key));
+    }
+
+    // 加入资源，size 为资源占用的字节数，超出容量的资源不加入
+    template <typename T>
+    void Insert(const AssetType type, const uint64_t key,
+                const std::shared_ptr<const T> &value, const uint64_t size)
+    {
+        InsertEntry(type, key, value, size);
+    }
+
+    // 输出各类资源的命中率与缓存占用的空间
+    void PrintStatistics() const;
+
+private:
+    struct Entry
+    {
+        AssetType type;
+        uint64_t key;
+        uint64_t size;
+        std::shared_ptr<const void> value;
+    };
+
+    std::shared_ptr<const void> FindEntry(const AssetType type,
+                                          const uint64_t key);
+    void InsertEntry(const AssetType type, const uint64_t key,
+                     const std::shared_ptr<const void> &value,
+                     const uint64_t size);
+    void Evict(const uint64_t capacity);
+
+    uint64_t capacity_;
+    uint64_t size_;
+    uint64_t num_hit_[static_cast<int>(AssetType::kCount)];
+    uint64_t num_miss_[static_cast<int>(AssetType::kCount)];
+    mutable std::mutex mutex_;
+    // 按最近使用的顺序排列
+    std::list<Entry> entries_;
+    std::map<std::pair<AssetType, uint64_t>, std::list<Entry>::iterator> map_;
+};
+
+// 进程内唯一的资源缓存
+AssetCache &GetAssetCache();
+
+// 文件内容的哈希值，文件不存在时返回 hash
+uint64_t HashFile(const std::string &filename,
+                  uint64_t hash = 0xcbf29ce484222325ull);
+
+// 文件的大小与最后修改时间，用于不读取内容地判断文件是否可能改变
+struct FileStamp
+{
+    uintmax_t size;
+    std::filesystem::file_time_type time;
+
+    bool operator==(const FileStamp &other) const
+    {
+        return size == other.size && time == other.time;
+    }
+};
+
+// 无法获取时返回无效值，与任何有效的记录都不相等
+FileStamp StampFile(const std::string &filename);
+
+} // namespace csrt
+
+#endif
\ No newline at end of file
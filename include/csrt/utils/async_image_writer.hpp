@@ -0,0 +1,59 @@
+#ifndef CSRT__UTILS__ASYNC_IMAGE_WRITER_HPP
+#define CSRT__UTILS__ASYNC_IMAGE_WRITER_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace csrt
+{
+
+// 在后台线程中编码并写入图像，渲染线程提交图像后即可继续绘制
+class AsyncImageWriter
+{
+public:
+    // max_pending 为排队等待写入（不含正在写入）的图像数量上限，为 0 时不限制
+    explicit AsyncImageWriter(const size_t max_pending = 0);
+    // 写完所有已提交的图像后退出
+    ~AsyncImageWriter();
+
+    AsyncImageWriter(const AsyncImageWriter &) = delete;
+    AsyncImageWriter &operator=(const AsyncImageWriter &) = delete;
+
+    // 提交一幅 RGB 格式的图像。replace 为 true 时，取代尚未开始写入的同名图像，
+    // 使写入跟不上渲染时只保留最新的中间结果。排队的图像达到上限时阻塞，
+    // 直到后台线程取走一幅图像
+    void Submit(std::vector<float> data, const int width, const int height,
+                const std::string &filename, const bool replace);
+
+    // 阻塞直到所有已提交的图像写入完毕
+    void Wait();
+
+private:
+    struct Job
+    {
+        int width;
+        int height;
+        std::string filename;
+        std::vector<float> data;
+    };
+
+    void WorkerLoop();
+
+    bool exit_;
+    bool busy_;
+    size_t max_pending_;
+    std::mutex mutex_;
+    std::condition_variable cv_job_;
+    std::condition_variable cv_space_;
+    std::condition_variable cv_idle_;
+    std::deque<Job> jobs_;
+    std::thread worker_;
+};
+
+} // namespace csrt
+
+#endif
\ No newline at end of file
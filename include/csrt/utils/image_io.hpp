@@ -9,13 +9,25 @@ namespace csrt
 
 namespace image_io
 {
+    // 按扩展名写入 EXR（half）、PFM 或 PNG（其余扩展名）格式的图像
     void Write(const float *data, const int width, const int height,
                std::string filename);
+    // 检查图像 base_filename 可以读取，且左上角为 (x, y) 的图像块位于其中，否则抛出 MyException
+    void CheckPatch(const int x, const int y, const int width,
+                    const int height, const std::string &base_filename);
+    // 将 RGB 格式的图像块 data 写入整幅 PNG 图像 base_filename 中左上角为 (x, y)
+    // 的位置，结果保存为 filename，图像块以外的像素保持不变。失败时抛出 MyException
+    void WritePatch(const float *data, const int x, const int y,
+                    const int width, const int height,
+                    const std::string &base_filename,
+                    const std::string &filename);
     float *Read(const std::string &filename, const float gamma,
                 const int *width_max, int *width, int *height, int *channel);
     void Resize(const float *input_pixels, int input_w, int input_h,
                 int input_stride_in_bytes, float *output_pixels, int output_w,
                 int output_h, int output_stride_in_bytes, int num_channels);
+    // 线性颜色分量到 8 位 sRGB 编码值，大于 1 的部分被截断
+    unsigned char LinearToSrgb8(const float linear);
 } // namespace image_io
 
 } // namespace csrt
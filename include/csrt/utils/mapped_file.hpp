@@ -0,0 +1,38 @@
+#ifndef CSRT__UTILS__MAPPED_FILE_HPP
+#define CSRT__UTILS__MAPPED_FILE_HPP
+
+#include <cstdint>
+#include <string>
+
+namespace csrt
+{
+
+// 以只读方式将整个文件映射到内存，失败时抛出 MyException
+class MappedFile
+{
+public:
+    MappedFile(const std::string &filename);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const unsigned char *data() const { return data_; }
+    uint64_t size() const { return size_; }
+
+private:
+    void ReleaseData();
+
+    const unsigned char *data_;
+    uint64_t size_;
+#if defined(_WIN32)
+    void *file_;
+    void *mapping_;
+#else
+    int fd_;
+#endif
+};
+
+} // namespace csrt
+
+#endif
\ No newline at end of file
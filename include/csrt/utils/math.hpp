@@ -53,13 +53,22 @@ QUALIFIER_D_H uint32_t Tea(uint32_t v0, uint32_t v1)
     return v0;
 }
 
-// Return a random sample in the range [0, 1) with a simple Linear Congruential
-// Generator.
+// Return a random sample in the range [0, 1) with a 32-bit PCG generator
+// (PCG-RXS-M-XS). The state still advances as a Linear Congruential Generator,
+// but it is permuted before output, so the low bits no longer have short
+// periods. The d-th number only depends on the initial state of the sample and
+// d, not on tile order, thread count or pass split.
 QUALIFIER_D_H constexpr float RandomFloat(uint32_t *seed)
 {
-    *seed = *seed * 1664525u + 1013904223u;
-    return static_cast<float>(*seed & 0x00ffffff) /
-           static_cast<float>(0x01000000u);
+    *seed = *seed * 747796405u + 2891336453u;
+    uint32_t word = ((*seed >> ((*seed >> 28u) + 4u)) ^ *seed) * 277803737u;
+    word = (word >> 22u) ^ word;
+    return static_cast<float>(word >> 8) / static_cast<float>(0x01000000u);
+}
+
+QUALIFIER_D_H inline float LinearRgbToLuminance(const Vec3 &rgb)
+{
+    return 0.2126f * rgb.x + 0.7152f * rgb.y + 0.0722f * rgb.z;
 }
 
 QUALIFIER_D_H float MisWeight(float pdf1, float pdf2);
@@ -70,6 +79,13 @@ QUALIFIER_D_H Vec3 SampleSphereUniform(const float xi_0, const float xi_1);
 QUALIFIER_D_H void SampleHemisCos(const float xi_0, const float xi_1, Vec3 *vec,
                                   float *pdf);
 
+// 把景物表面上位于 position、法线为 normal 的点在面积测度下的概率密度，
+// 转换为从 origin 观察时立体角测度下的概率密度，掠射时返回 0
+QUALIFIER_D_H float PdfAreaToSolidAngle(const float pdf_area,
+                                        const Vec3 &origin,
+                                        const Vec3 &position,
+                                        const Vec3 &normal);
+
 template <typename T>
 QUALIFIER_D_H T Sqr(const T &t)
 {
@@ -92,6 +108,23 @@ QUALIFIER_D_H T Lerp(const T *v, const float alpha, const float beta,
 QUALIFIER_D_H uint32_t BinarySearch(const uint32_t num, float *cdf,
                                     const float target);
 
+// Walker 别名表的一项：以概率 prob 选中本项，否则选中第 alias 项
+struct AliasEntry
+{
+    float prob = 1;
+    uint32_t alias = 0;
+};
+
+// 按非负的权重 weights 构建含 num 项的别名表（Vose 的方法），返回权重之和，
+// 权重之和不是正数时构建均匀分布的别名表
+float CreateAliasTable(const uint32_t num, const float *weights,
+                       AliasEntry *table);
+
+// 用随机数 xi 在常数时间内从别名表中抽样一项，并把 xi 重新映射为 [0, 1) 上
+// 与抽样结果无关的均匀随机数，以便继续使用
+QUALIFIER_D_H uint32_t SampleAliasTable(const uint32_t num,
+                                        const AliasEntry *table, float *xi);
+
 QUALIFIER_D_H bool SolveQuadratic(const float a, const float b, const float c,
                                   float *x0, float *x1);
 
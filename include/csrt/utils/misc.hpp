@@ -1,6 +1,8 @@
 #ifndef CSRT__UTILS__MISC_HPP
 #define CSRT__UTILS__MISC_HPP
 
+#include <cstddef>
+#include <cstdint>
 #include <exception>
 #include <string>
 
@@ -51,6 +53,19 @@ constexpr uint64_t operator"" _hash(const char *str, uint64_t)
     return Hash(str);
 }
 
+// FNV-1a 哈希，hash 为之前数据的哈希值，可以分段计算
+inline uint64_t HashBytes(const void *data, const size_t size,
+                          uint64_t hash = 0xcbf29ce484222325ull)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
 class MyException : public std::exception
 {
 public:
@@ -0,0 +1,22 @@
+#ifndef CSRT__UTILS__NUMA_HPP
+#define CSRT__UTILS__NUMA_HPP
+
+#include <cstdint>
+#include <vector>
+
+namespace csrt
+{
+
+// 进程允许使用的逻辑处理器按 NUMA 节点分组，每组为一个节点中的逻辑处理器编号。
+// 只有一个节点或无法获取拓扑（如非 Linux 系统）时返回空数组，调用者据此退化为不做任何处理
+std::vector<std::vector<int>> GetNumaNodes();
+
+// 将当前线程绑定到 cpus 中的逻辑处理器，cpus 为空时不做任何事
+void BindThread(const std::vector<int> &cpus);
+
+// 当前线程所在的逻辑处理器属于 nodes 中的第几个节点，无法获取时返回 0
+uint32_t GetCurrentNumaNode(const std::vector<std::vector<int>> &nodes);
+
+} // namespace csrt
+
+#endif
\ No newline at end of file
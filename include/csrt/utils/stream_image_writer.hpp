@@ -0,0 +1,76 @@
+#ifndef CSRT__UTILS__STREAM_IMAGE_WRITER_HPP
+#define CSRT__UTILS__STREAM_IMAGE_WRITER_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace csrt
+{
+
+// 按从上到下的顺序逐个行带地写入一幅图像，用于无法在内存中保存整幅图像的超大分辨率。
+// 编码与写入在后台线程中进行，内存中至多保留 max_pending 个尚未写入的行带。
+// 格式由扩展名决定：exr 为 ZIP 压缩的扫描线 EXR（half 或 float），
+// pfm 为 32 位浮点数，其余均为 8 位 sRGB 的 png
+class StreamImageWriter
+{
+public:
+    // 文件无法创建时抛出 MyException
+    StreamImageWriter(const std::string &filename, const int width,
+                      const int height, const bool exr_half = true,
+                      const int max_pending = 2);
+    // 未调用 Close 时以 0 补齐尚未提交的行，不抛出异常
+    ~StreamImageWriter();
+
+    StreamImageWriter(const StreamImageWriter &) = delete;
+    StreamImageWriter &operator=(const StreamImageWriter &) = delete;
+
+    // 提交紧接着已提交各行的 num_rows 行 RGB 像素，排队的行带达到上限时阻塞
+    void Submit(std::vector<float> rows, const int num_rows);
+
+    // 以 0 补齐尚未提交的行，等待所有行写入后关闭文件，写入失败时抛出 MyException
+    void Close();
+
+    // 编码器，由后台线程依次调用
+    class Encoder
+    {
+    public:
+        virtual ~Encoder() {}
+        virtual void WriteRows(const float *rows, const int num_rows) = 0;
+        // 写入所有行之后调用，补全文件的其余部分并关闭文件
+        virtual void Finish() = 0;
+    };
+
+private:
+    struct Band
+    {
+        int num_rows;
+        std::vector<float> rows;
+    };
+
+    void WorkerLoop();
+
+    std::string filename_;
+    int width_;
+    int height_;
+    int max_pending_;
+    int num_row_submitted_;
+    bool closed_;
+    bool exit_;
+    // 后台线程中第一次写入失败的原因，之后的行带不再写入
+    std::string error_;
+    std::unique_ptr<Encoder> encoder_;
+    std::mutex mutex_;
+    std::condition_variable cv_band_;
+    std::condition_variable cv_space_;
+    std::deque<Band> bands_;
+    std::thread worker_;
+};
+
+} // namespace csrt
+
+#endif
\ No newline at end of file
@@ -0,0 +1,85 @@
+#ifndef CSRT__UTILS__THREAD_POOL_HPP
+#define CSRT__UTILS__THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace csrt
+{
+
+// 常驻的工作窃取（work-stealing）线程池。
+// 每个任务批次的下标区间被均匀地划分给各个线程，线程从自己区间的头部取任务，
+// 自己的区间耗尽后，从其它线程区间的尾部窃取一半，优先窃取同一 NUMA 节点中的线程。
+class ThreadPool
+{
+public:
+    // num_threads 为 0 时使用硬件支持的线程数量；
+    // affinity 为 true 时，将第 i 个线程绑定到第 i 个逻辑处理器。
+    // numa 为 true 且机器有多个 NUMA 节点时，将线程按编号连续地均分给各个节点，
+    // 并绑定到所属节点的逻辑处理器上（affinity 为 true 时绑定到节点中的单个逻辑处理器）；
+    // 只有一个节点时 numa 不起作用。
+    ThreadPool(const uint32_t num_threads, const bool affinity,
+               const bool numa = false);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    uint32_t num_threads() const
+    {
+        return static_cast<uint32_t>(workers_.size());
+    }
+    uint32_t num_nodes() const { return num_nodes_; }
+    // 线程所属的 NUMA 节点，未启用 NUMA 时总是 0
+    uint32_t node(const uint32_t id_thread) const
+    {
+        return nodes_[id_thread];
+    }
+    // 节点中所有线程可以使用的逻辑处理器，未启用 NUMA 时为空
+    const std::vector<int> &node_cpus(const uint32_t id_node) const
+    {
+        return node_cpus_[id_node];
+    }
+
+    // 并行地对 [0, num_task) 中的每个下标调用 func(id_thread, id_task)，
+    // 阻塞直到所有任务完成。num_task 需小于 2^32；不可重入，同一时刻只能执行一个批次。
+    void ParallelFor(
+        const uint64_t num_task,
+        const std::function<void(uint32_t, uint64_t)> &func);
+
+private:
+    // 线程私有的任务区间，高 32 位为起点，低 32 位为终点，独占缓存行以避免伪共享
+    struct alignas(64) TaskRange
+    {
+        std::atomic<uint64_t> range;
+    };
+
+    void WorkerLoop(const uint32_t id_thread);
+    bool PopTask(const uint32_t id_thread, uint64_t *id_task);
+    bool StealTask(const uint32_t id_thread, uint64_t *id_task);
+    void PinThread(const uint32_t id_thread);
+
+    bool affinity_;
+    bool exit_;
+    uint32_t num_nodes_;
+    uint64_t generation_;
+    uint32_t num_active_;
+    const std::function<void(uint32_t, uint64_t)> *func_;
+    std::mutex mutex_;
+    std::condition_variable cv_start_;
+    std::condition_variable cv_finish_;
+    std::vector<TaskRange> ranges_;
+    // 每个线程所属的节点，以及每个节点的逻辑处理器
+    std::vector<uint32_t> nodes_;
+    std::vector<std::vector<int>> node_cpus_;
+    std::vector<std::thread> workers_;
+};
+
+} // namespace csrt
+
+#endif
\ No newline at end of file
@@ -11,7 +11,7 @@ public:
 
     void Reset();
     void PrintTimePassed(const std::string &work_name = "");
-    void PrintProgress(double progress);
+    void PrintProgress(double progress) const;
 
 private:
     std::chrono::steady_clock::time_point time_begin_;
@@ -0,0 +1,47 @@
+#include "csrt/parser/parser.hpp"
+
+#include <fstream>
+#include <sstream>
+
+namespace csrt
+{
+
+std::vector<Camera::Info> LoadCameraPath(const std::string &filename,
+                                         const Camera::Info &base)
+{
+    std::ifstream file(filename);
+    if (!file)
+        throw MyException("cannot find camera path file: '" + filename + "'.");
+
+    std::vector<Camera::Info> cameras;
+    std::string line;
+    for (int index_line = 1; std::getline(file, line); ++index_line)
+    {
+        const size_t begin = line.find_first_not_of(" \t\r");
+        if (begin == std::string::npos || line[begin] == '#')
+            continue;
+
+        std::istringstream iss(line);
+        Camera::Info info = base;
+        iss >> info.eye.x >> info.eye.y >> info.eye.z >> info.look_at.x >>
+            info.look_at.y >> info.look_at.z >> info.up.x >> info.up.y >>
+            info.up.z;
+        if (!iss)
+        {
+            std::ostringstream oss;
+            oss << "invalid camera at line " << index_line << " of '"
+                << filename << "'.";
+            throw MyException(oss.str());
+        }
+        float fov_x = 0;
+        if (iss >> fov_x && fov_x > 0)
+            info.fov_x = fov_x;
+        cameras.push_back(info);
+    }
+
+    if (cameras.empty())
+        throw MyException("no camera in camera path file: '" + filename + "'.");
+    return cameras;
+}
+
+} // namespace csrt
\ No newline at end of file
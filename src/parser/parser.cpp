@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <exception>
 #include <filesystem>
+#include <memory>
 #include <unordered_map>
 
 #include <pugixml.hpp>
@@ -34,7 +35,10 @@ namespace element_parser
 
 using namespace csrt;
 
-void ReadCamera(const pugi::xml_node &sensor_node);
+// 记录读取的资源文件
+void AddAssetFile(const std::string &filename);
+
+Camera::Info ReadCamera(const pugi::xml_node &sensor_node);
 
 void ReadIntegrator(const pugi::xml_node &integrator_node);
 
@@ -45,6 +49,8 @@ uint64_t ReadTexture(const pugi::xml_node &parent_node,
                      const float defalut_value);
 uint64_t ReadBitmap(const std::string &filename, const std::string &id,
                     float gamma, float scale, int *width_max);
+MeshesInfo ReadMeshes(const std::string &filename, const int index_shape,
+                      const bool flip_texcoords, const bool face_normals);
 
 uint64_t ReadMedium(const pugi::xml_node &medium_node);
 
@@ -133,9 +139,17 @@ RendererConfig LoadConfig(const std::string &filename)
     }
 
     //
-    // 解析相机参数
+    // 解析相机参数，第一个相机为默认相机
     //
-    element_parser::ReadCamera(scene_node.child("sensor"));
+    for (pugi::xml_node sensor_node : scene_node.children("sensor"))
+    {
+        local::config.cameras.push_back(
+            element_parser::ReadCamera(sensor_node));
+    }
+    if (local::config.cameras.empty())
+        local::config.cameras.push_back(
+            element_parser::ReadCamera(scene_node.child("sensor")));
+    local::config.camera = local::config.cameras[0];
 
     //
     // 解析光线跟踪算法参数
@@ -180,8 +194,9 @@ RendererConfig LoadConfig(const std::string &filename)
 
 } // namespace csrt
 
-void element_parser::ReadCamera(const pugi::xml_node &sensor_node)
+Camera::Info element_parser::ReadCamera(const pugi::xml_node &sensor_node)
 {
+    Camera::Info info;
     std::string type = sensor_node.attribute("type").as_string();
     if (type != "perspective")
     {
@@ -204,10 +219,8 @@ void element_parser::ReadCamera(const pugi::xml_node &sensor_node)
                 {
                     if (!local::map_default.count(value_str))
                     {
-                        fprintf(stderr,
-                                "[error] cannot find '%s' from config file.\n",
-                                value_str.c_str());
-                        exit(1);
+                        throw MyException("cannot find '" + value_str +
+                                          "' from config file.");
                     }
                     value_str = local::map_default.at(value_str);
                 }
@@ -224,10 +237,8 @@ void element_parser::ReadCamera(const pugi::xml_node &sensor_node)
                 {
                     if (!local::map_default.count(value_str))
                     {
-                        fprintf(stderr,
-                                "[error] cannot find '%s' from config file.\n",
-                                value_str.c_str());
-                        exit(1);
+                        throw MyException("cannot find '" + value_str +
+                                          "' from config file.");
                     }
                     value_str = local::map_default.at(value_str);
                 }
@@ -239,8 +250,8 @@ void element_parser::ReadCamera(const pugi::xml_node &sensor_node)
             break;
         }
     }
-    local::config.camera.width = width;
-    local::config.camera.height = height;
+    info.width = width;
+    info.height = height;
 
     //
     // 读取绘制图像在水平方向的可视角度
@@ -302,7 +313,7 @@ void element_parser::ReadCamera(const pugi::xml_node &sensor_node)
         break;
     }
     }
-    local::config.camera.fov_x = fov_x;
+    info.fov_x = fov_x;
 
     //
     // 读取绘制图像每个像素样本的数量
@@ -322,10 +333,8 @@ void element_parser::ReadCamera(const pugi::xml_node &sensor_node)
                 {
                     if (!local::map_default.count(value_str))
                     {
-                        fprintf(stderr,
-                                "[error] cannot find '%s' from config file.\n",
-                                value_str.c_str());
-                        exit(1);
+                        throw MyException("cannot find '" + value_str +
+                                          "' from config file.");
                     }
                     value_str = local::map_default.at(value_str);
                 }
@@ -337,7 +346,35 @@ void element_parser::ReadCamera(const pugi::xml_node &sensor_node)
             break;
         }
     }
-    local::config.camera.spp = sample_count;
+    info.spp = sample_count;
+
+    //
+    // 读取采样器的类型
+    //
+    const std::string sampler_type =
+        sensor_node.child("sampler").attribute("type").value();
+    switch (Hash(sampler_type.c_str()))
+    {
+    case ""_hash:
+    case "independent"_hash:
+    case "stratified"_hash:
+        info.sampler = SamplerType::kIndependent;
+        break;
+    case "sobol"_hash:
+    case "ldsampler"_hash:
+        info.sampler = SamplerType::kSobol;
+        break;
+    case "zsobol"_hash:
+        info.sampler = SamplerType::kZSobol;
+        break;
+    default:
+        fprintf(stderr,
+                "[warning] unsupport sampler type '%s', use 'independent' "
+                "instead.\n",
+                sampler_type.c_str());
+        info.sampler = SamplerType::kIndependent;
+        break;
+    }
 
     //
     // 读取相机的位置和朝向
@@ -352,8 +389,8 @@ void element_parser::ReadCamera(const pugi::xml_node &sensor_node)
         look_at = TransformPoint(to_world, look_at);
         up = TransformVector(to_world, up);
     }
-    local::config.camera.eye = eye, local::config.camera.look_at = look_at,
-    local::config.camera.up = up;
+    info.eye = eye, info.look_at = look_at, info.up = up;
+    return info;
 }
 
 void element_parser::ReadIntegrator(const pugi::xml_node &integrator_node)
@@ -414,6 +451,39 @@ void element_parser::ReadIntegrator(const pugi::xml_node &integrator_node)
         integrator_node, {"hide_emitters", "hideEmitters"}, false);
     info.pdf_rr =
         basic_parser::ReadFloat(integrator_node, {"rr_pdf", "rrPdf"}, 0.95f);
+    info.guiding =
+        basic_parser::ReadBoolean(integrator_node, {"guiding"}, false);
+    info.guiding_passes = static_cast<uint32_t>(std::max(
+        basic_parser::ReadInt(integrator_node,
+                              {"guiding_passes", "guidingPasses"}, 5),
+        0));
+    // 与 Mitsuba 的 guided_path 相同，给出的是按 BSDF 抽样的概率
+    const float bsdf_fraction = basic_parser::ReadFloat(
+        integrator_node, {"bsdf_sampling_fraction", "bsdfSamplingFraction"},
+        0.5f);
+    info.guiding_fraction =
+        1.0f - std::min(std::max(bsdf_fraction, 0.0f), 1.0f);
+    info.rrs = basic_parser::ReadBoolean(integrator_node, {"rrs"}, false);
+    info.rrs_spp = static_cast<uint32_t>(std::max(
+        basic_parser::ReadInt(integrator_node, {"rrs_spp", "rrsSpp"}, 4),
+        2));
+    info.ris = basic_parser::ReadBoolean(integrator_node, {"ris"}, false);
+    info.ris_candidates = static_cast<uint32_t>(std::max(
+        basic_parser::ReadInt(integrator_node,
+                              {"ris_candidates", "risCandidates"}, 16),
+        1));
+    info.sppm_photons = static_cast<uint32_t>(std::max(
+        basic_parser::ReadInt(integrator_node, {"photon_count", "photonCount"},
+                              250000),
+        1));
+    info.sppm_radius = std::max(
+        basic_parser::ReadFloat(integrator_node,
+                                {"initial_radius", "initialRadius"}, 0.0f),
+        0.0f);
+    info.sppm_alpha = std::min(
+        std::max(basic_parser::ReadFloat(integrator_node, {"alpha"}, 0.7f),
+                 kEpsilon),
+        1.0f);
 
     std::string integrator_type =
         integrator_node.attribute("type").as_string("path");
@@ -430,6 +500,16 @@ void element_parser::ReadIntegrator(const pugi::xml_node &integrator_node)
     case "path"_hash:
         info.type = IntegratorType::kPath;
         break;
+    case "guided_path"_hash:
+        info.type = IntegratorType::kPath;
+        info.guiding = true;
+        break;
+    case "bdpt"_hash:
+        info.type = IntegratorType::kBdpt;
+        break;
+    case "sppm"_hash:
+        info.type = IntegratorType::kSppm;
+        break;
     default:
         fprintf(stderr, "unsupport integrator type '%s', use 'path' instead.\n",
                 integrator_type.c_str());
@@ -641,34 +721,103 @@ element_parser::ReadTexture(const pugi::xml_node &parent_node,
     return index;
 }
 
+void element_parser::AddAssetFile(const std::string &filename)
+{
+    std::vector<std::string> &files = local::config.asset_files;
+    if (std::find(files.begin(), files.end(), filename) == files.end())
+        files.push_back(filename);
+}
+
 uint64_t element_parser::ReadBitmap(const std::string &filename,
                                     const std::string &id, float gamma,
                                     float scale, int *width_max)
 {
-    int width = 0, height = 0, channel = 1;
-    float *raw_data =
-        image_io::Read(filename, gamma, width_max, &width, &height, &channel);
-
-    const uint32_t num_element =
-        static_cast<uint32_t>(width) * height * channel;
-    for (uint32_t i = 0; i < num_element; ++i)
-        raw_data[i] *= scale;
+    AddAssetFile(filename);
+
+    // 解码结果由文件内容、gamma 与宽度上限决定，缓存时不包含 scale
+    AssetCache &cache = GetAssetCache();
+    uint64_t key = 0;
+    std::shared_ptr<const TextureInfo> cached;
+    if (cache.enable())
+    {
+        const float params[2] = {
+            gamma, static_cast<float>(width_max ? *width_max : 0)};
+        key = HashBytes(params, sizeof(params), HashFile(filename));
+        cached = cache.Find<TextureInfo>(AssetType::kTexture, key);
+    }
+    if (!cached)
+    {
+        int width = 0, height = 0, channel = 1;
+        float *raw_data = image_io::Read(filename, gamma, width_max, &width,
+                                         &height, &channel);
+        const uint64_t num_element =
+            static_cast<uint64_t>(width) * height * channel;
+        auto decoded = std::make_shared<TextureInfo>();
+        decoded->type = TextureType::kBitmap;
+        decoded->bitmap.data =
+            std::vector<float>(raw_data, raw_data + num_element);
+        SAFE_DELETE_ARRAY(raw_data);
+        decoded->bitmap.width = width;
+        decoded->bitmap.height = height;
+        decoded->bitmap.channel = channel;
+        decoded->bitmap.to_uv = {};
+        cached = decoded;
+        if (cache.enable())
+        {
+            cache.Insert(AssetType::kTexture, key, cached,
+                         num_element * sizeof(float));
+        }
+    }
 
     const uint64_t index = local::config.textures.size();
     local::map_texture[id] = index;
 
-    TextureInfo info;
-    info.type = TextureType::kBitmap;
-    info.bitmap.data = std::vector<float>(raw_data, raw_data + num_element);
-    SAFE_DELETE_ARRAY(raw_data);
-    info.bitmap.width = width;
-    info.bitmap.height = height;
-    info.bitmap.channel = channel;
-    info.bitmap.to_uv = {};
+    TextureInfo info = *cached;
+    for (float &value : info.bitmap.data)
+        value *= scale;
     local::config.textures.push_back(info);
     return index;
 }
 
+MeshesInfo element_parser::ReadMeshes(const std::string &filename,
+                                      const int index_shape,
+                                      const bool flip_texcoords,
+                                      const bool face_normals)
+{
+    AddAssetFile(filename);
+
+    AssetCache &cache = GetAssetCache();
+    uint64_t key = 0;
+    if (cache.enable())
+    {
+        const int params[3] = {index_shape, flip_texcoords, face_normals};
+        key = HashBytes(params, sizeof(params), HashFile(filename));
+        const std::shared_ptr<const MeshesInfo> cached =
+            cache.Find<MeshesInfo>(AssetType::kMesh, key);
+        if (cached)
+            return *cached;
+    }
+
+    // index_shape 为负数时读取文件中的所有形状
+    const MeshesInfo meshes =
+        index_shape < 0
+            ? model_loader::Load(filename, flip_texcoords, face_normals)
+            : model_loader::Load(filename, index_shape, flip_texcoords,
+                                 face_normals);
+    if (cache.enable())
+    {
+        const uint64_t size =
+            meshes.texcoords.size() * sizeof(Vec2) +
+            (meshes.positions.size() + meshes.normals.size() +
+             meshes.tangents.size() + meshes.bitangents.size()) *
+                sizeof(Vec3) +
+            meshes.indices.size() * sizeof(Uvec3);
+        cache.Insert(AssetType::kMesh, key,
+                     std::make_shared<const MeshesInfo>(meshes), size);
+    }
+    return meshes;
+}
+
 uint64_t element_parser::ReadMedium(const pugi::xml_node &medium_node)
 {
     std::string id = medium_node.attribute("id").as_string();
@@ -1176,18 +1325,18 @@ uint64_t element_parser::ReadShape(const pugi::xml_node &shape_node)
             bool flip_texcoords = basic_parser::ReadBoolean(
                 shape_node, {"flip_tex_coords", "flipTexCoords"}, true);
             info.meshes =
-                model_loader::Load(filename, flip_texcoords, face_normals);
+                ReadMeshes(filename, -1, flip_texcoords, face_normals);
         }
         else if (type == "serialized")
         {
             int index_shape =
                 shape_node.child("integer").attribute("value").as_int(0);
             info.meshes =
-                model_loader::Load(filename, index_shape, false, face_normals);
+                ReadMeshes(filename, index_shape, false, face_normals);
         }
         else
         {
-            info.meshes = model_loader::Load(filename, false, face_normals);
+            info.meshes = ReadMeshes(filename, -1, false, face_normals);
         }
         break;
     }
@@ -1,10 +1,46 @@
 #include "csrt/ray_tracer.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
 #include "csrt/utils.hpp"
 
+namespace
+{
+
+// 离开作用域时（包括抛出异常时）把指针置空，避免其指向已经析构的局部对象
+template <typename T>
+class ResetOnExit
+{
+public:
+    explicit ResetOnExit(T **pointer) : pointer_(pointer) {}
+    ~ResetOnExit() { *pointer_ = nullptr; }
+    ResetOnExit(const ResetOnExit &) = delete;
+    ResetOnExit &operator=(const ResetOnExit &) = delete;
+
+private:
+    T **pointer_;
+};
+
+// 中止渲染时样本数量图的输出路径：在输出路径的扩展名之前加上 "_samples"
+std::string GetSampleMapFilename(const std::string &output_filename)
+{
+    const size_t pos_slash = output_filename.find_last_of("/\\"),
+                 pos_dot = output_filename.find_last_of('.');
+    if (pos_dot == std::string::npos ||
+        (pos_slash != std::string::npos && pos_dot < pos_slash))
+        return output_filename + "_samples";
+    return output_filename.substr(0, pos_dot) + "_samples" +
+           output_filename.substr(pos_dot);
+}
+
+} // namespace
+
 #ifdef ENABLE_VIEWER
 
-#include <chrono>
 #include <gl/freeglut.h>
 
 namespace
@@ -122,8 +158,12 @@ namespace csrt
 {
 
 RayTracer::RayTracer(const csrt::RendererConfig &config)
-    : backend_type_(config.backend_type), width_(config.camera.width),
-      height_(config.camera.height), frame_(nullptr), renderer_(nullptr)
+    : backend_type_(config.backend_type), progressive_(config.progressive),
+      checkpoint_(config.checkpoint), partition_(config.partition),
+      adaptive_(config.adaptive), stream_(config.stream),
+      spp_(config.camera.spp), width_(config.camera.width),
+      height_(config.camera.height), frame_(nullptr), renderer_(nullptr),
+      writer_(nullptr), stop_(nullptr)
 #ifdef ENABLE_VIEWER
       ,
       frame_srgb_(nullptr)
@@ -131,10 +171,43 @@ RayTracer::RayTracer(const csrt::RendererConfig &config)
 {
     try
     {
+        crop_ = GetCropWindow(config.camera);
+        // 随机渐进式光子映射的各像素共享光子，只能逐轮绘制整个裁剪窗口，
+        // 像素的半径与累积通量也不保存在 film 中
+        if (backend_type_ == BackendType::kCpu &&
+            config.integrator.type == IntegratorType::kSppm &&
+            (progressive_.preview || adaptive_.enable ||
+             !checkpoint_.filename.empty() || partition_.sample_begin > 0 ||
+             partition_.sample_end > 0 || partition_.num_tile_part > 1 ||
+             stream_.enable))
+        {
+            fprintf(stderr, "[warning] preview, adaptive sampling, checkpoint, "
+                            "partial result and streaming output are disabled "
+                            "for 'sppm' integrator.\n");
+            progressive_.preview = false;
+            adaptive_ = AdaptiveInfo();
+            checkpoint_.filename.clear();
+            partition_ = PartitionInfo();
+            stream_.enable = false;
+        }
         renderer_ = new Renderer(config);
-        const uint32_t num_element =
-            config.camera.width * config.camera.height * 3;
-        frame_ = csrt::MallocArray<float>(config.backend_type, num_element);
+        // 流式输出时不分配整幅图像，行带的高度取图块边长的整数倍，使图块不跨越行带
+        if (stream_.enable)
+        {
+            const uint32_t tile_size = std::max(1u, config.schedule.tile_size);
+            stream_.band_height =
+                std::max(1u, (stream_.band_height + tile_size - 1) /
+                                 tile_size) *
+                tile_size;
+        }
+        else
+        {
+            const uint64_t num_element =
+                static_cast<uint64_t>(config.camera.width) *
+                config.camera.height * 3;
+            frame_ =
+                csrt::MallocArray<float>(config.backend_type, num_element);
+        }
     }
     catch (const MyException &e)
     {
@@ -143,6 +216,56 @@ RayTracer::RayTracer(const csrt::RendererConfig &config)
     }
 }
 
+void RayTracer::DrawSequence(const std::vector<Camera::Info> &cameras,
+                             const std::vector<std::string> &output_filenames)
+{
+    if (cameras.size() != output_filenames.size())
+        throw MyException("number of cameras and output files mismatch.");
+
+    // 第 k 帧的图像交给后台线程编码与写入，同时开始绘制第 k + 1 帧。
+    // 至多一帧排队等待写入，写入跟不上绘制时阻塞，避免内存无限增长
+    AsyncImageWriter writer(1);
+    writer_ = &writer;
+    // 在 writer 析构之前置空 writer_，无论以何种方式离开本函数
+    const ResetOnExit<AsyncImageWriter> reset_writer(&writer_);
+
+    Timer timer;
+    const size_t num_frame = cameras.size();
+    for (size_t k = 0; k < num_frame; ++k)
+    {
+        fprintf(stderr, "[info] draw frame %zu / %zu ...\n", k + 1,
+                num_frame);
+        SetCamera(cameras[k]);
+        Draw(output_filenames[k]);
+        if (stop_ != nullptr && stop_->load() && k + 1 < num_frame)
+        {
+            fprintf(stderr, "[info] stopped, skip the remaining %zu "
+                            "frame(s).\n",
+                    num_frame - k - 1);
+            break;
+        }
+    }
+    writer.Wait();
+    timer.PrintTimePassed("rendering sequence");
+}
+
+void RayTracer::SetCamera(const Camera::Info &info)
+{
+    const Tile crop = GetCropWindow(info);
+    if (!stream_.enable && (info.width != width_ || info.height != height_))
+    {
+        float *frame = csrt::MallocArray<float>(
+            backend_type_, static_cast<uint64_t>(info.width) * info.height * 3);
+        csrt::DeleteArray(backend_type_, frame_);
+        frame_ = frame;
+    }
+    renderer_->SetCamera(info);
+    width_ = info.width;
+    height_ = info.height;
+    spp_ = info.spp;
+    crop_ = crop;
+}
+
 void RayTracer::ReleaseData()
 {
     csrt::DeleteElement(BackendType::kCpu, renderer_);
@@ -152,10 +275,489 @@ void RayTracer::ReleaseData()
 #endif
 }
 
-void RayTracer::Draw(const std::string &output_filename) const
+void RayTracer::Draw(const std::string &output_filename,
+                     const std::string &base_filename) const
 {
+    if (!base_filename.empty())
+    {
+        if (GetSuffix(output_filename) != "png")
+            throw MyException("crop base only supports png output.");
+        // 绘制之前检查，以免绘制完成后才发现无法写入而丢弃结果
+        csrt::image_io::CheckPatch(crop_.x_begin, crop_.y_begin,
+                                   crop_.x_end - crop_.x_begin,
+                                   crop_.y_end - crop_.y_begin, base_filename);
+    }
+    if (stream_.enable)
+    {
+        if (!base_filename.empty())
+            throw MyException("streaming output does not support crop base.");
+        DrawStream(output_filename);
+        return;
+    }
+
+    // CPU 后端总是分轮绘制，以便在收到停止请求时输出已绘制的部分
+    if (backend_type_ == BackendType::kCpu)
+    {
+        DrawPasses(output_filename, base_filename, nullptr, nullptr);
+        return;
+    }
+
     renderer_->Draw(frame_);
-    csrt::image_io::Write(frame_, width_, height_, output_filename);
+    WriteFrame(frame_, output_filename, base_filename);
+}
+
+void RayTracer::Draw(float *frame, const DrawCallbacks &callbacks) const
+{
+    if (frame == nullptr)
+        throw MyException("invalid output frame.");
+
+    if (backend_type_ == BackendType::kCpu)
+    {
+        DrawPasses("", "", frame, &callbacks);
+        return;
+    }
+
+    // CUDA 后端一次绘制整幅图像，绘制结束后整体作为一个图块交给回调
+    renderer_->Draw(frame_);
+    std::copy(frame_, frame_ + static_cast<uint64_t>(width_) * height_ * 3,
+              frame);
+    if (callbacks.progress)
+        callbacks.progress(1.0);
+    if (callbacks.tile)
+    {
+        Tile tile;
+        tile.x_end = width_;
+        tile.y_end = height_;
+        callbacks.tile(tile, frame);
+    }
+}
+
+std::vector<float> RayTracer::CropFrame(const float *frame) const
+{
+    const uint32_t width = crop_.x_end - crop_.x_begin,
+                   height = crop_.y_end - crop_.y_begin;
+    std::vector<float> data(static_cast<uint64_t>(width) * height * 3);
+    for (uint32_t j = 0; j < height; ++j)
+    {
+        const float *src =
+            frame + ((static_cast<uint64_t>(crop_.y_begin) + j) * width_ +
+                     crop_.x_begin) *
+                        3;
+        std::copy(src, src + width * 3,
+                  data.begin() + static_cast<uint64_t>(j) * width * 3);
+    }
+    return data;
+}
+
+void RayTracer::WriteFrame(const float *frame, const std::string &filename,
+                           const std::string &base_filename) const
+{
+    const int width = static_cast<int>(crop_.x_end - crop_.x_begin),
+              height = static_cast<int>(crop_.y_end - crop_.y_begin);
+    if (!base_filename.empty())
+    {
+        const std::vector<float> data = CropFrame(frame);
+        csrt::image_io::WritePatch(data.data(), crop_.x_begin, crop_.y_begin,
+                                   width, height, base_filename, filename);
+    }
+    else if (writer_ != nullptr)
+    {
+        writer_->Submit(CropFrame(frame), width, height, filename, false);
+    }
+    else if (width == width_ && height == height_)
+    {
+        csrt::image_io::Write(frame, width_, height_, filename);
+    }
+    else
+    {
+        const std::vector<float> data = CropFrame(frame);
+        csrt::image_io::Write(data.data(), width, height, filename);
+    }
+}
+
+void RayTracer::DrawPasses(const std::string &output_filename,
+                           const std::string &base_filename, float *frame_out,
+                           const DrawCallbacks *callbacks) const
+{
+    // 多进程分布式渲染时只绘制 [sample_begin, sample_end) 中的样本
+    const uint32_t sample_begin = partition_.sample_begin,
+                   sample_end = partition_.sample_end > 0
+                                    ? partition_.sample_end
+                                    : spp_;
+    if (sample_begin >= sample_end)
+        throw MyException("invalid sample range.");
+    const uint32_t spp_total = sample_end - sample_begin;
+
+    // 检查点只在两轮之间写入，输出检查点时每轮至多绘制 adaptive_.spp_step 个样本，
+    // 以便按时间间隔写入；既不是渐进式渲染、自适应采样也不输出检查点时，一轮绘制所有样本
+    const bool progressive = progressive_.spp_pass > 0,
+               time_limited = progressive_.time_limit > 0;
+    const uint32_t spp_pass = std::max(
+        1u, progressive ? progressive_.spp_pass
+            : adaptive_.enable || !checkpoint_.filename.empty()
+                ? adaptive_.spp_step
+                : spp_total);
+    if (time_limited)
+    {
+        fprintf(stderr, "[info] begin rendering, time limit %.2f sec ...\n",
+                progressive_.time_limit);
+    }
+    else if (spp_pass < spp_total)
+    {
+        fprintf(stderr, "[info] begin rendering, %u spp per pass ...\n",
+                spp_pass);
+    }
+    else
+    {
+        fprintf(stderr, "[info] begin rendering ...\n");
+    }
+
+    Film film(width_, height_, sample_begin);
+    uint32_t spp_done = 0, index_pass = 0;
+    const bool checkpoint = !checkpoint_.filename.empty();
+    if (checkpoint && checkpoint_.resume)
+    {
+        const CheckpointHeader header = film.Load(checkpoint_.filename);
+        if (header.scene_hash != checkpoint_.scene_hash)
+        {
+            throw MyException("checkpoint file '" + checkpoint_.filename +
+                              "' belongs to another scene.");
+        }
+        spp_done = header.spp_done;
+        index_pass = header.index_pass;
+        fprintf(stderr, "[info] resume rendering from %u spp.\n", spp_done);
+    }
+    auto SaveCheckpoint = [&]()
+    {
+        CheckpointHeader header = {};
+        header.spp_done = spp_done;
+        header.index_pass = index_pass;
+        header.scene_hash = checkpoint_.scene_hash;
+        film.Save(checkpoint_.filename, header);
+        fprintf(stderr, "\n[info] save checkpoint \"%s\" at %u spp.\n",
+                checkpoint_.filename.c_str(), spp_done);
+    };
+
+    AsyncImageWriter writer;
+    const uint64_t num_element = static_cast<uint64_t>(width_) * height_ * 3;
+    const double spp_rcp = 1.0 / spp_total,
+                 time_limit_rcp = time_limited ? 1.0 / progressive_.time_limit
+                                               : 0.0;
+    Timer timer;
+    const auto time_begin = std::chrono::steady_clock::now();
+    renderer_->TrainGuiding(timer, stop_);
+    renderer_->LearnRrs(timer, stop_);
+    auto time_flush = time_begin, time_checkpoint = time_begin;
+    const uint32_t spp_resumed = spp_done;
+    uint32_t count_target = spp_done;
+    bool stopped = false;
+
+    // 低分辨率预览：依次只绘制坐标为 4 与 2 的整数倍的像素，放大后输出。
+    // 预览的样本就是这些像素正式绘制时的第一个样本，之后的各轮直接沿用
+    uint32_t stride_preview = 0;
+    if (progressive_.preview && spp_done == 0)
+    {
+        for (const uint32_t stride : {4u, 2u})
+        {
+            renderer_->DrawPreview(stride, timer, &film, stop_);
+            if (stop_ != nullptr && stop_->load())
+                break;
+            stride_preview = stride;
+            if (frame_out != nullptr)
+            {
+                film.ResolvePreview(stride, frame_out);
+                if (callbacks != nullptr && callbacks->tile)
+                    callbacks->tile(crop_, frame_out);
+            }
+            else
+            {
+                std::vector<float> frame(num_element);
+                film.ResolvePreview(stride, frame.data());
+                writer.Submit(CropFrame(frame.data()),
+                              crop_.x_end - crop_.x_begin,
+                              crop_.y_end - crop_.y_begin, output_filename,
+                              true);
+            }
+            fprintf(stderr,
+                    "[info] write preview at 1/%u resolution, %.2f sec.\n",
+                    stride * stride,
+                    std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - time_begin)
+                        .count());
+        }
+    }
+
+    while (true)
+    {
+        uint32_t num_sample = 0;
+        double progress_begin = 0, progress_end = 0;
+        if (time_limited)
+        {
+            // 按已完成各轮的平均耗时估计每个样本的耗时，第一轮只绘制 1 个样本用于估计；
+            // 每轮至多使用剩余时间的 1/4（至少 1 秒），剩余时间不足一个样本时结束
+            const double time_passed =
+                             std::chrono::duration<double>(
+                                 std::chrono::steady_clock::now() - time_begin)
+                                 .count(),
+                         time_remain = progressive_.time_limit - time_passed;
+            double time_spp = 0;
+            if (spp_done == spp_resumed)
+            {
+                num_sample = 1;
+            }
+            else
+            {
+                time_spp = time_passed / (spp_done - spp_resumed);
+                if (time_remain < time_spp)
+                    break;
+                const double time_pass =
+                    progressive ? spp_pass * time_spp
+                                : std::max(time_remain * 0.25, 1.0);
+                num_sample = static_cast<uint32_t>(std::min(
+                    std::min(time_pass, time_remain) / time_spp, 1048576.0));
+                num_sample = std::max(1u, num_sample);
+            }
+            progress_begin = time_passed * time_limit_rcp;
+            progress_end =
+                std::min(1.0, (time_passed + num_sample * time_spp) *
+                                  time_limit_rcp);
+        }
+        else
+        {
+            if (spp_done == spp_total)
+                break;
+            num_sample = std::min(spp_pass, spp_total - spp_done);
+            progress_begin = spp_done * spp_rcp;
+            progress_end = (spp_done + num_sample) * spp_rcp;
+        }
+
+        count_target = spp_done + num_sample;
+        const uint64_t num_sample_drawn =
+            renderer_->Draw(count_target, progress_begin, progress_end, timer,
+                            &film, stop_, frame_out, callbacks);
+
+        // 被中止的一轮不计入已完成的样本数量。各图块按目标数量绘制，
+        // 从检查点继续时只补齐这一轮中未完成的图块，结果与不中断时逐位相同
+        if (stop_ != nullptr && stop_->load())
+        {
+            stopped = true;
+            if (checkpoint)
+                SaveCheckpoint();
+            break;
+        }
+        const bool first_pass = spp_done == spp_resumed;
+        spp_done += num_sample;
+        ++index_pass;
+        // 上次恰好在一轮的所有图块完成后中止时，继续后的第一轮可能不绘制任何样本
+        if (num_sample_drawn == 0 && !(first_pass && checkpoint_.resume))
+            break;
+
+        // 检查点在两轮绘制之间写入，此时每个像素的累积结果与随机数种子都是完整的
+        const auto time_current = std::chrono::steady_clock::now();
+        if (checkpoint &&
+            std::chrono::duration<double>(time_current - time_checkpoint)
+                    .count() >= checkpoint_.interval)
+        {
+            SaveCheckpoint();
+            time_checkpoint = time_current;
+        }
+
+        // 绘制到调用者的缓冲区时，各图块完成时已经写入，不再输出中间结果
+        if ((!time_limited && spp_done == spp_total) || !progressive ||
+            frame_out != nullptr)
+            continue;
+
+        // 中间结果交给后台线程写入，写入跟不上时只保留最新的一幅
+        const bool flush_by_pass = progressive_.flush_passes > 0 &&
+                                   index_pass % progressive_.flush_passes == 0,
+                   flush_by_time =
+                       progressive_.flush_interval > 0 &&
+                       std::chrono::duration<double>(time_current - time_flush)
+                               .count() >= progressive_.flush_interval;
+        if (flush_by_pass || flush_by_time)
+        {
+            // 设置了裁剪窗口时，中间结果只包含窗口内的像素
+            std::vector<float> frame(num_element);
+            film.Resolve(frame.data());
+            writer.Submit(CropFrame(frame.data()), crop_.x_end - crop_.x_begin,
+                          crop_.y_end - crop_.y_begin, output_filename, true);
+            time_flush = time_current;
+        }
+    }
+    timer.PrintTimePassed("rendering");
+    if (stopped)
+    {
+        fprintf(stderr, "[info] rendering stopped, write the partial result "
+                        "normalised by the samples taken per pixel.\n");
+        if (checkpoint)
+        {
+            fprintf(stderr,
+                    "[info] resume from checkpoint \"%s\" with '--resume'.\n",
+                    checkpoint_.filename.c_str());
+        }
+    }
+
+    // 每个像素除以各自的样本数量，无论在哪一轮结束，结果都是一致的估计
+    const uint64_t num_pixel =
+        static_cast<uint64_t>(crop_.x_end - crop_.x_begin) *
+        (crop_.y_end - crop_.y_begin);
+    const double spp_average = static_cast<double>(film.num_sample()) /
+                               num_pixel;
+    if (time_limited)
+    {
+        fprintf(stderr, "[info] achieved spp: %u, average spp: %.2f.\n",
+                spp_done, spp_average);
+    }
+    else
+    {
+        fprintf(stderr, "[info] average spp: %.2f (%.2f%% of %u spp).\n",
+                spp_average, spp_average * spp_rcp * 100, spp_total);
+    }
+
+    writer.Wait();
+    // 在第一轮完成之前中止时，尚无样本的像素仍使用预览的插值结果
+    float *frame_result = frame_out != nullptr ? frame_out : frame_;
+    if (stopped && spp_done == 0 && stride_preview > 0)
+        film.ResolvePreview(stride_preview, frame_result);
+    else
+        film.Resolve(frame_result);
+    if (frame_out == nullptr)
+        WriteFrame(frame_, output_filename, base_filename);
+
+    if (!partition_.filename.empty())
+    {
+        CheckpointHeader header = {};
+        header.spp_done = spp_done;
+        header.index_pass = index_pass;
+        header.scene_hash = partition_.scene_hash;
+        film.Save(partition_.filename, header);
+        fprintf(stderr, "[info] save partial result \"%s\".\n",
+                partition_.filename.c_str());
+    }
+
+    // 中止渲染时总是输出样本数量图，以便判断哪些区域尚未收敛
+    if (!adaptive_.heatmap.empty() || (stopped && frame_out == nullptr))
+    {
+        const std::string filename = adaptive_.heatmap.empty()
+                                         ? GetSampleMapFilename(output_filename)
+                                         : adaptive_.heatmap;
+        std::vector<float> heatmap(num_element);
+        film.ResolveSampleCount(stopped ? count_target : spp_done,
+                                heatmap.data());
+        WriteFrame(heatmap.data(), filename, "");
+        if (stopped)
+        {
+            fprintf(stderr, "[info] save sample count map \"%s\".\n",
+                    filename.c_str());
+        }
+    }
+}
+
+void RayTracer::DrawStream(const std::string &output_filename) const
+{
+    if (backend_type_ != BackendType::kCpu)
+        throw MyException("streaming output only supports CPU backend.");
+    if (!checkpoint_.filename.empty() || !partition_.filename.empty() ||
+        partition_.sample_begin > 0 || partition_.sample_end > 0 ||
+        partition_.num_tile_part > 1 || progressive_.time_limit > 0)
+    {
+        throw MyException("streaming output does not support checkpoints, "
+                          "partial results or time limits.");
+    }
+
+    // 自适应采样时每轮为未收敛的图块追加样本，否则一轮绘制所有样本
+    const uint32_t spp_pass =
+        adaptive_.enable ? std::max(1u, adaptive_.spp_step) : spp_;
+    fprintf(stderr, "[info] begin rendering, %u rows per band ...\n",
+            stream_.band_height);
+
+    const uint32_t width = crop_.x_end - crop_.x_begin,
+                   height = crop_.y_end - crop_.y_begin;
+    StreamImageWriter writer(output_filename, width, height,
+                             stream_.exr_half);
+    std::unique_ptr<StreamImageWriter> writer_heatmap;
+    if (!adaptive_.heatmap.empty())
+    {
+        writer_heatmap.reset(new StreamImageWriter(
+            adaptive_.heatmap, width, height, stream_.exr_half));
+    }
+
+    // 行带只保留裁剪窗口内的列
+    auto CropBand = [&](const float *frame, const uint32_t num_rows)
+    {
+        std::vector<float> data(static_cast<uint64_t>(width) * num_rows * 3);
+        for (uint32_t j = 0; j < num_rows; ++j)
+        {
+            const float *src =
+                frame + (static_cast<uint64_t>(j) * width_ + crop_.x_begin) * 3;
+            std::copy(src, src + width * 3,
+                      data.begin() + static_cast<uint64_t>(j) * width * 3);
+        }
+        return data;
+    };
+
+    Timer timer;
+    renderer_->TrainGuiding(timer, stop_);
+    renderer_->LearnRrs(timer, stop_);
+    const double spp_rcp = 1.0 / spp_, height_rcp = 1.0 / height;
+    uint64_t num_sample = 0;
+    bool stopped = false;
+    for (uint32_t y_begin = crop_.y_begin; y_begin < crop_.y_end && !stopped;
+         y_begin += stream_.band_height)
+    {
+        Tile band = crop_;
+        band.y_begin = y_begin;
+        band.y_end = std::min(y_begin + stream_.band_height, crop_.y_end);
+        const uint32_t num_rows = band.y_end - band.y_begin;
+        const double progress_begin = (band.y_begin - crop_.y_begin) *
+                                      height_rcp,
+                     progress_scale = num_rows * height_rcp;
+
+        Film film(width_, num_rows, 0, band.y_begin);
+        uint32_t count_done = 0;
+        while (count_done < spp_)
+        {
+            const uint32_t count_target = std::min(count_done + spp_pass, spp_);
+            const uint64_t num_sample_drawn = renderer_->DrawRegion(
+                band, count_target,
+                progress_begin + progress_scale * count_done * spp_rcp,
+                progress_begin + progress_scale * count_target * spp_rcp,
+                timer, &film, stop_);
+            count_done = count_target;
+            if (stop_ != nullptr && stop_->load())
+            {
+                stopped = true;
+                break;
+            }
+            if (num_sample_drawn == 0)
+                break;
+        }
+        num_sample += film.num_sample();
+
+        // 被中止的行带按每个像素实际的样本数量归一化后写入，其余的行以 0 补齐
+        std::vector<float> frame(static_cast<uint64_t>(width_) * num_rows * 3);
+        film.Resolve(frame.data());
+        writer.Submit(CropBand(frame.data(), num_rows), num_rows);
+        if (writer_heatmap)
+        {
+            film.ResolveSampleCount(spp_, frame.data());
+            writer_heatmap->Submit(CropBand(frame.data(), num_rows), num_rows);
+        }
+    }
+    timer.PrintTimePassed("rendering");
+    if (stopped)
+    {
+        fprintf(stderr, "[info] rendering stopped, rows not reached are "
+                        "written as black.\n");
+    }
+    const double spp_average =
+        static_cast<double>(num_sample) / (static_cast<uint64_t>(width) * height);
+    fprintf(stderr, "[info] average spp: %.2f (%.2f%% of %u spp).\n",
+            spp_average, spp_average * spp_rcp * 100, spp_);
+
+    writer.Close();
+    if (writer_heatmap)
+        writer_heatmap->Close();
 }
 
 #ifdef ENABLE_VIEWER
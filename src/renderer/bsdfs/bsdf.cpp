@@ -185,27 +185,27 @@ QUALIFIER_D_H Bsdf::Bsdf(const uint32_t id, const BsdfInfo &info,
     }
 }
 
-QUALIFIER_D_H void Bsdf::Sample(uint32_t *seed, BsdfSampleRec *rec) const
+QUALIFIER_D_H void Bsdf::Sample(Sampler *sampler, BsdfSampleRec *rec) const
 {
     switch (data_.type)
     {
     case BsdfType::kDiffuse:
-        SampleDiffuse(data_.diffuse, seed, rec);
+        SampleDiffuse(data_.diffuse, sampler, rec);
         break;
     case BsdfType::kRoughDiffuse:
-        SampleRoughDiffuse(data_.rough_diffuse, seed, rec);
+        SampleRoughDiffuse(data_.rough_diffuse, sampler, rec);
         break;
     case BsdfType::kConductor:
-        SampleConductor(data_.conductor, seed, rec);
+        SampleConductor(data_.conductor, sampler, rec);
         break;
     case BsdfType::kDielectric:
-        SampleDielectric(data_.dielectric, seed, rec);
+        SampleDielectric(data_.dielectric, sampler, rec);
         break;
     case BsdfType::kThinDielectric:
-        SampleThinDielectric(data_.dielectric, seed, rec);
+        SampleThinDielectric(data_.dielectric, sampler, rec);
         break;
     case BsdfType::kPlastic:
-        SamplePlastic(data_.plastic, seed, rec);
+        SamplePlastic(data_.plastic, sampler, rec);
         break;
     }
 }
@@ -269,6 +269,18 @@ QUALIFIER_D_H bool Bsdf::IsEmitter() const
     return data_.type == BsdfType::kAreaLight;
 }
 
+QUALIFIER_D_H bool Bsdf::IsGuidable() const
+{
+    return data_.type == BsdfType::kDiffuse ||
+           data_.type == BsdfType::kRoughDiffuse;
+}
+
+QUALIFIER_D_H bool Bsdf::IsDiffuse() const
+{
+    return data_.type == BsdfType::kDiffuse ||
+           data_.type == BsdfType::kRoughDiffuse;
+}
+
 QUALIFIER_D_H bool Bsdf::IsTransparent(const Vec2 &texcoord,
                                        uint32_t *seed) const
 {
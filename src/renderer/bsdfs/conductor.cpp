@@ -31,7 +31,7 @@ QUALIFIER_D_H Vec3 EvaluateMultipleScatter(const ConductorData &data,
 namespace csrt
 {
 
-QUALIFIER_D_H void SampleConductor(const ConductorData &data, uint32_t *seed,
+QUALIFIER_D_H void SampleConductor(const ConductorData &data, Sampler *sampler,
                                    BsdfSampleRec *rec)
 {
     // 根据GGX法线分布函数重要抽样微平面法线，生成入射光线方向
@@ -39,8 +39,8 @@ QUALIFIER_D_H void SampleConductor(const ConductorData &data, uint32_t *seed,
     float D = 0;
     const float alpha_u = data.roughness_u->GetColor(rec->texcoord).x,
                 alpha_v = data.roughness_v->GetColor(rec->texcoord).x;
-    SampleGgx(RandomFloat(seed), RandomFloat(seed), alpha_u, alpha_v, &h_local,
-              &D);
+    const Vec2 u = sampler->Next2D();
+    SampleGgx(u.u, u.v, alpha_u, alpha_v, &h_local, &D);
     const Vec3 h_world = rec->ToWorld(h_local);
 
     const float H_dot_O = Dot(rec->wo, h_world);
@@ -41,8 +41,8 @@ namespace csrt
 {
 
 
-QUALIFIER_D_H void SampleDielectric(const DielectricData &data, uint32_t *seed,
-                                    BsdfSampleRec *rec)
+QUALIFIER_D_H void SampleDielectric(const DielectricData &data,
+                                    Sampler *sampler, BsdfSampleRec *rec)
 {
     const float scale = 1.2f - 0.2f * sqrt(abs(Dot(-rec->wo, rec->normal)));
     const float alpha_u = data.roughness_u->GetColor(rec->texcoord).x * scale,
@@ -51,8 +51,8 @@ QUALIFIER_D_H void SampleDielectric(const DielectricData &data, uint32_t *seed,
     // 根据GGX法线分布函数重要抽样微平面法线
     Vec3 h_local(0);
     float D = 0;
-    SampleGgx(RandomFloat(seed), RandomFloat(seed), alpha_u, alpha_v, &h_local,
-              &D);
+    const Vec2 u = sampler->Next2D();
+    SampleGgx(u.u, u.v, alpha_u, alpha_v, &h_local, &D);
     const Vec3 h_world = rec->ToWorld(h_local);
     float H_dot_O = Dot(rec->wo, h_world);
     if (H_dot_O < kEpsilonFloat)
@@ -72,7 +72,7 @@ QUALIFIER_D_H void SampleDielectric(const DielectricData &data, uint32_t *seed,
     const bool full_reflect = !Ray::Refract(-rec->wo, h_world, eta, &wt);
     float F = FresnelSchlick(H_dot_O, data.reflectivity);
     const Vec3 wo_local = rec->ToLocal(rec->wo);
-    if (full_reflect || RandomFloat(seed) < F)
+    if (full_reflect || sampler->Next1D() < F)
     { // 抽样反射光线
         rec->wi = -Ray::Reflect(-rec->wo, h_world);
         const float N_dot_I = Dot(-rec->wi, rec->normal);
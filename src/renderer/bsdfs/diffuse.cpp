@@ -9,21 +9,26 @@ namespace csrt
 QUALIFIER_D_H void EvaluateDiffuse(const DiffuseData &data, BsdfSampleRec *rec)
 {
     // 反射光线与法线方向应该位于同侧
-    rec->pdf = Dot(rec->wo, rec->normal);
-    if (rec->pdf < kEpsilon)
+    if (Dot(rec->wo, rec->normal) < kEpsilon)
+        return;
+
+    // 反推余弦加权重要抽样时的概率
+    const float N_dot_I = Dot(-rec->wi, rec->normal);
+    rec->pdf = k1DivPi * N_dot_I;
+    if (rec->pdf <= 0.0f)
         return;
     rec->valid = true;
 
     const Vec3 albedo = data.diffuse_reflectance->GetColor(rec->texcoord);
-    const float N_dot_I = Dot(-rec->wi, rec->normal);
     rec->attenuation = albedo * k1DivPi * N_dot_I;
 }
 
-QUALIFIER_D_H void SampleDiffuse(const DiffuseData &data, uint32_t *seed,
+QUALIFIER_D_H void SampleDiffuse(const DiffuseData &data, Sampler *sampler,
                                  BsdfSampleRec *rec)
 {
     Vec3 wi_local;
-    SampleHemisCos(RandomFloat(seed), RandomFloat(seed), &wi_local, &rec->pdf);
+    const Vec2 u = sampler->Next2D();
+    SampleHemisCos(u.u, u.v, &wi_local, &rec->pdf);
     if (rec->pdf < kEpsilon)
         return;
     rec->wi = -rec->ToWorld(wi_local);
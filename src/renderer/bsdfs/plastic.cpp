@@ -8,7 +8,7 @@
 namespace csrt
 {
 
-QUALIFIER_D_H void SamplePlastic(const PlasticData &data, uint32_t *seed,
+QUALIFIER_D_H void SamplePlastic(const PlasticData &data, Sampler *sampler,
                                  BsdfSampleRec *rec)
 {
     // 计算塑料清漆层和基底层反射的权重
@@ -28,9 +28,10 @@ QUALIFIER_D_H void SamplePlastic(const PlasticData &data, uint32_t *seed,
     float D = 0;
     const float alpha = data.roughness->GetColor(rec->texcoord).x;
     float N_dot_I = 0;
-    if (RandomFloat(seed) < pdf_spec)
+    if (sampler->Next1D() < pdf_spec)
     { // 抽样塑料清漆层
-        SampleGgx(RandomFloat(seed), RandomFloat(seed), alpha, &h_local, &D);
+        const Vec2 u = sampler->Next2D();
+        SampleGgx(u.u, u.v, alpha, &h_local, &D);
         h_world = rec->ToWorld(h_local);
 
         rec->wi = -Ray::Reflect(-rec->wo, h_world);
@@ -50,8 +51,8 @@ QUALIFIER_D_H void SamplePlastic(const PlasticData &data, uint32_t *seed,
     { // 抽样塑料基底层
         Vec3 wi_local = Vec3(0);
         float pdf_diff_local = 0.0f;
-        SampleHemisCos(RandomFloat(seed), RandomFloat(seed), &wi_local,
-                       &pdf_diff_local);
+        const Vec2 u = sampler->Next2D();
+        SampleHemisCos(u.u, u.v, &wi_local, &pdf_diff_local);
         rec->wi = -rec->ToWorld(wi_local);
 
         N_dot_I = Dot(-rec->wi, rec->normal);
@@ -97,11 +97,12 @@ namespace csrt
 {
 
 QUALIFIER_D_H void SampleRoughDiffuse(const RoughDiffuseData &data,
-                                      uint32_t *seed, BsdfSampleRec *rec)
+                                      Sampler *sampler, BsdfSampleRec *rec)
 {
     // 余弦加权重要抽样入射光线的方向
     Vec3 wi;
-    SampleHemisCos(RandomFloat(seed), RandomFloat(seed), &wi, &rec->pdf);
+    const Vec2 u = sampler->Next2D();
+    SampleHemisCos(u.u, u.v, &wi, &rec->pdf);
     if (rec->pdf < kEpsilon)
         return;
 
@@ -117,9 +118,13 @@ QUALIFIER_D_H void SampleRoughDiffuse(const RoughDiffuseData &data,
 QUALIFIER_D_H void EvaluateRoughDiffuse(const RoughDiffuseData &data,
                                         BsdfSampleRec *rec)
 {
+    // 反射光线与法线方向应该位于同侧
+    if (Dot(rec->wo, rec->normal) < kEpsilon)
+        return;
+
     // 反推余弦加权重要抽样时的概率
-    rec->pdf = Dot(rec->wo, rec->normal);
-    if (rec->pdf < kEpsilon)
+    rec->pdf = k1DivPi * Dot(-rec->wi, rec->normal);
+    if (rec->pdf <= 0.0f)
         return;
     rec->valid = true;
 
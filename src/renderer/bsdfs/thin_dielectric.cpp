@@ -9,15 +9,15 @@ namespace csrt
 {
 
 QUALIFIER_D_H void SampleThinDielectric(const DielectricData &data,
-                                        uint32_t *seed, BsdfSampleRec *rec)
+                                        Sampler *sampler, BsdfSampleRec *rec)
 {
     // 根据GGX法线分布函数重要抽样微平面法线，生成入射光线方向
     Vec3 h_local(0);
     float D = 0;
     const float alpha_u = data.roughness_u->GetColor(rec->texcoord).x,
                 alpha_v = data.roughness_v->GetColor(rec->texcoord).x;
-    SampleGgx(RandomFloat(seed), RandomFloat(seed), alpha_u, alpha_v, &h_local,
-              &D);
+    const Vec2 u = sampler->Next2D();
+    SampleGgx(u.u, u.v, alpha_u, alpha_v, &h_local, &D);
     const Vec3 h_world = rec->ToWorld(h_local);
 
     const float H_dot_O = Dot(rec->wo, h_world);
@@ -40,7 +40,7 @@ QUALIFIER_D_H void SampleThinDielectric(const DielectricData &data,
     if (F < 1.0f)
         F *= 2.0f / (1.0f + F);
 
-    if (RandomFloat(seed) < F)
+    if (sampler->Next1D() < F)
     {
         rec->pdf *= F;
         if (rec->pdf < kEpsilon)
@@ -8,7 +8,8 @@ namespace csrt
 {
 
 QUALIFIER_D_H Camera::Camera()
-    : spp_(64), width_(1024), height_(1024), fov_x_(19.5f),
+    : width_(1024), height_(1024), spp_(64),
+      sampler_(SamplerType::kIndependent), fov_x_(19.5f),
       eye_{0.0f, 1.0f, 6.8f}, up_{0.0f, 1.0f, 0.0f}
 {
     const Vec3 look_at = {0.0f, 1.0f, 0.0f};
@@ -24,8 +25,9 @@ QUALIFIER_D_H Camera::Camera()
 }
 
 QUALIFIER_D_H Camera::Camera(const Camera::Info &info)
-    : spp_(info.spp), spp_inv_(1.0f / info.spp), width_(info.width),
-      height_(info.height), fov_x_(info.fov_x), eye_(info.eye), up_(info.up)
+    : width_(info.width), height_(info.height), spp_(info.spp),
+      spp_inv_(1.0f / info.spp), sampler_(info.sampler), fov_x_(info.fov_x),
+      eye_(info.eye), up_(info.up)
 {
     fov_y_ = info.fov_x * info.height / info.width;
     front_ = Normalize(info.look_at - info.eye);
@@ -143,6 +143,7 @@ QUALIFIER_D_H Emitter::Emitter(const uint32_t id, const EmitterInfo &info,
                                  : texture_buffer + info.spot.id_texture;
         data_.spot.position = TransformPoint(info.spot.to_world, {0, 0, 0});
         data_.spot.to_local = info.spot.to_world.Inverse();
+        data_.spot.to_world = info.spot.to_world;
         break;
     case EmitterType::kDirectional:
         data_.directional = info.directional;
@@ -164,14 +165,14 @@ QUALIFIER_D_H Emitter::Emitter(const uint32_t id, const EmitterInfo &info,
 }
 
 QUALIFIER_D_H void Emitter::InitEnvMap(const int width, const int height,
-                                       const float normalization, float *pixels)
+                                       AliasEntry *alias_rows,
+                                       AliasEntry *alias_cols, float *pdf_map)
 {
     data_.envmap.width = width;
     data_.envmap.height = height;
-    data_.envmap.normalization = normalization;
-    data_.envmap.cdf_cols = pixels;
-    data_.envmap.cdf_rows = pixels + height + 1;
-    data_.envmap.weight_rows = pixels + (height + 1) + height;
+    data_.envmap.alias_rows = alias_rows;
+    data_.envmap.alias_cols = alias_cols;
+    data_.envmap.pdf_map = pdf_map;
 }
 
 QUALIFIER_D_H EmitterSampleRec Emitter::Sample(const Vec3 &origin,
@@ -260,4 +261,46 @@ QUALIFIER_D_H float Emitter::Pdf(const Vec3 &look_dir) const
     return 0;
 }
 
-} // namespace csrt
+QUALIFIER_D_H Vec3 Emitter::SampleEmission(const float xi_0, const float xi_1,
+                                           Vec3 *dir, float *pdf) const
+{
+    *pdf = 0;
+    switch (data_.type)
+    {
+    case EmitterType::kPoint:
+        return SamplePointLightEmission(data_.point, xi_0, xi_1, dir, pdf);
+    case EmitterType::kSpot:
+        return SampleSpotLightEmission(data_.spot, xi_0, xi_1, dir, pdf);
+    default:
+        return {};
+    }
+}
+
+QUALIFIER_D_H float Emitter::PdfEmission(const Vec3 &dir) const
+{
+    switch (data_.type)
+    {
+    case EmitterType::kPoint:
+        return PdfPointLightEmission(data_.point, dir);
+    case EmitterType::kSpot:
+        return PdfSpotLightEmission(data_.spot, dir);
+    default:
+        return 0;
+    }
+}
+
+QUALIFIER_D_H bool Emitter::IsInfinite() const
+{
+    switch (data_.type)
+    {
+    case EmitterType::kDirectional:
+    case EmitterType::kSun:
+    case EmitterType::kEnvMap:
+    case EmitterType::kConstant:
+        return true;
+    default:
+        return false;
+    }
+}
+
+} // namespace csrt
\ No newline at end of file
@@ -2,88 +2,83 @@
 
 #include "csrt/renderer/emitters/emitter.hpp"
 
-namespace
-{
-using namespace csrt;
-
-QUALIFIER_D_H float LinearRgbToLuminance(const Vec3 &rgb)
-{
-    return 0.2126f * rgb.x + 0.7152f * rgb.y + 0.0722f * rgb.z;
-}
-
-} // namespace
-
 namespace csrt
 {
 
 
-void CreateEnvMapCdfPdf(const int width, const int height,
-                        const Texture &radiance, std::vector<float> *cdf_cols,
-                        std::vector<float> *cdf_rows,
-                        std::vector<float> *weight_rows, float *normalization)
+void CreateEnvMapAliasTable(const int width, const int height,
+                            const Texture &radiance,
+                            std::vector<AliasEntry> *alias_rows,
+                            std::vector<AliasEntry> *alias_cols,
+                            std::vector<float> *pdf_map)
 {
     const float width_inv = 1.0f / width;
     const float height_inv = 1.0f / height;
 
-    *cdf_rows = std::vector<float>(height + 1);
-    *weight_rows = std::vector<float>(height);
-    *cdf_cols = std::vector<float>((width + 1) * height);
+    *alias_rows = std::vector<AliasEntry>(height);
+    *alias_cols = std::vector<AliasEntry>(width * height);
+    *pdf_map = std::vector<float>(width * height);
 
-    float sum_row = 0.0f;
-    (*cdf_rows)[0] = 0;
+    std::vector<float> weight_rows(height);
     for (int y = 0; y < height; ++y)
     {
-        float sum_col = 0.0f;
-        (*cdf_cols)[0 + 0] = 0;
+        float *luminance = pdf_map->data() + y * width;
         for (int x = 0; x < width; ++x)
         {
             const Vec3 rgb = radiance.GetColor({x * width_inv, y * height_inv});
-            sum_col += LinearRgbToLuminance(rgb);
-            (*cdf_cols)[y * (width + 1) + (x + 1)] = sum_col;
+            luminance[x] = LinearRgbToLuminance(rgb);
+            if (!std::isfinite(luminance[x]))
+            {
+                throw MyException("The environment map contains an invalid "
+                                  "floating point value (nan/inf).");
+            }
+            luminance[x] = fmaxf(luminance[x], 0.0f);
         }
 
-        (*cdf_cols)[y * (width + 1) + width] = 1.0f;
-        const float normalization_col = 1.0f / sum_col;
-        for (int x = 1; x < width; ++x)
-            (*cdf_cols)[y * (width + 1) + width - x] *= normalization_col;
+        const float sum_col = CreateAliasTable(width, luminance,
+                                               alias_cols->data() + y * width);
 
-        const float weight = sinf((y + 0.5f) * kPi / height);
-        (*weight_rows)[y] = weight;
-        sum_row += sum_col * weight;
-        (*cdf_rows)[y + 1] = sum_row;
+        // 同一行的像素所张的立体角相同，正比于纬度带上下边界的 cos(theta) 之差
+        const float solid_angle = cosf(y * kPi * height_inv) -
+                                  cosf((y + 1) * kPi * height_inv);
+        weight_rows[y] = sum_col * solid_angle;
     }
 
-    (*cdf_rows)[height] = 1.0f;
-    const float normalization_row = 1.0f / sum_row;
-    for (int y = 1; y < height; ++y)
-        (*cdf_rows)[height - y] *= normalization_row;
+    const float sum_row =
+        CreateAliasTable(height, weight_rows.data(), alias_rows->data());
 
-    if (!std::isfinite(sum_row))
-    {
-        throw MyException("The environment map contains an invalid floating "
-                             "point value (nan/inf).");
-    }
-
-    *normalization = 1.0 / (sum_row * (k2Pi * width_inv) * (kPi * height_inv));
+    // 像素被选中的概率为 L * omega / sum，omega 为像素所张的立体角，
+    // 故立体角测度下的概率密度为 L / sum
+    const float normalization =
+        (sum_row > 0) ? 1.0f / (sum_row * (k2Pi * width_inv)) : 0.0f;
+    for (float &pdf : *pdf_map)
+        pdf *= normalization;
 }
 
 QUALIFIER_D_H void SampleEnvMap(const EnvMapData &data, const Vec3 &origin,
                                 const float xi_0, const float xi_1,
                                 EmitterSampleRec *rec)
 {
-    uint32_t row = BinarySearch(data.height + 1, data.cdf_rows, xi_0) - 1;
-    float *const &cdf_col = data.cdf_cols + row * (data.width + 1);
-    uint32_t col = BinarySearch(data.width + 1, cdf_col, xi_1) - 1;
-
-    Vec3 vec_local = SphericalToCartesian(row * kPi / data.height,
-                                          col * k2Pi / data.width, 1),
-         vec = TransformVector(data.to_world, vec_local);
+    float xi_row = xi_0, xi_col = xi_1;
+    const uint32_t row =
+        SampleAliasTable(data.height, data.alias_rows, &xi_row);
+    const uint32_t col = SampleAliasTable(
+        data.width, data.alias_cols + row * data.width, &xi_col);
+
+    // 复用重新映射后的随机数，在像素内按立体角均匀抽样
+    const float cos_theta = Lerp(cosf(row * kPi / data.height),
+                                 cosf((row + 1) * kPi / data.height), xi_row),
+                sin_theta = sqrtf(fmaxf(0.0f, 1.0f - Sqr(cos_theta))),
+                phi = (col + xi_col) * k2Pi / data.width;
+    const Vec3 vec_local = {cosf(phi) * sin_theta, cos_theta,
+                            sinf(phi) * sin_theta},
+               vec = Normalize(TransformVector(data.to_world, vec_local));
 
     *rec = {
         true,      // valid
         false,     // harsh
         kMaxFloat, // distance
-        vec        // wi
+        -vec       // wi
     };
 }
 
@@ -111,25 +106,12 @@ QUALIFIER_D_H float PdfEnvMap(const EnvMapData &data, const Vec3 &look_dir)
     const Vec3 dir = TransformVector(data.to_local, look_dir);
     float phi = 0, theta = 0;
     CartesianToSpherical(dir, &theta, &phi, nullptr);
-    const Vec2 texcoord = {phi * k1Div2Pi, theta * k1DivPi};
-    const Vec3 color = data.radiance->GetColor(texcoord);
 
-    const float row =
-        fminf(fmaxf(texcoord.u * data.height, 0), data.height - 1);
-    const int row_int = static_cast<int>(row);
-    const float t = row - row_int;
-    if (t == 0)
-    {
-        return LinearRgbToLuminance(color) * data.weight_rows[row_int] *
-               data.normalization / fmaxf(fabs(sinf(theta)), 1e-4f);
-    }
-    else
-    {
-        return LinearRgbToLuminance(color) *
-               Lerp(data.weight_rows[row_int], data.weight_rows[row_int + 1],
-                    t) *
-               data.normalization / fmaxf(fabs(sinf(theta)), 1e-4f);
-    }
+    int row = static_cast<int>(theta * k1DivPi * data.height),
+        col = static_cast<int>(phi * k1Div2Pi * data.width);
+    row = (row < data.height) ? row : data.height - 1;
+    col = (col < data.width) ? col : data.width - 1;
+    return data.pdf_map[row * data.width + col];
 }
 
 } // namespace csrt
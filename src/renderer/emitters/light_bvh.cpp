@@ -0,0 +1,455 @@
+#include "csrt/renderer/emitters/light_bvh.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+namespace
+{
+
+using namespace csrt;
+
+constexpr int kNumBucket = 12;
+constexpr uint32_t kMaxDepth = 64;
+constexpr float kOneMinusEpsilon = 0x1.fffffep-1f;
+
+QUALIFIER_D_H float SafeSqrt(const float x) { return sqrtf(fmaxf(x, 0.0f)); }
+
+QUALIFIER_D_H float SafeAcos(const float x)
+{
+    return acosf(fminf(fmaxf(x, -1.0f), 1.0f));
+}
+
+// cos(max(0, a - b))
+QUALIFIER_D_H float CosSubClamped(const float sin_a, const float cos_a,
+                                  const float sin_b, const float cos_b)
+{
+    if (cos_a > cos_b)
+        return 1;
+    return cos_a * cos_b + sin_a * sin_b;
+}
+
+// sin(max(0, a - b))
+QUALIFIER_D_H float SinSubClamped(const float sin_a, const float cos_a,
+                                  const float sin_b, const float cos_b)
+{
+    if (cos_a > cos_b)
+        return 0;
+    return sin_a * cos_b - cos_a * sin_b;
+}
+
+bool IsEmpty(const AABB &aabb) { return aabb.min().x > aabb.max().x; }
+
+// 绕单位向量 axis 旋转 theta
+Vec3 RotateAroundAxis(const Vec3 &v, const Vec3 &axis, const float theta)
+{
+    const float cos_theta = cosf(theta), sin_theta = sinf(theta);
+    return v * cos_theta + Cross(axis, v) * sin_theta +
+           axis * (Dot(axis, v) * (1.0f - cos_theta));
+}
+
+// 同时包含两个方向圆锥的最小圆锥
+void UnionCone(const Vec3 &axis_a, const float cos_a, const Vec3 &axis_b,
+               const float cos_b, Vec3 *axis, float *cos_theta)
+{
+    const float theta_a = SafeAcos(cos_a), theta_b = SafeAcos(cos_b),
+                theta_d = SafeAcos(Dot(axis_a, axis_b));
+    if (fminf(theta_d + theta_b, kPi) <= theta_a)
+    {
+        *axis = axis_a;
+        *cos_theta = cos_a;
+        return;
+    }
+    if (fminf(theta_d + theta_a, kPi) <= theta_b)
+    {
+        *axis = axis_b;
+        *cos_theta = cos_b;
+        return;
+    }
+
+    const float theta_o = (theta_a + theta_d + theta_b) * 0.5f;
+    const Vec3 axis_r = Cross(axis_a, axis_b);
+    if (theta_o >= kPi || Length(axis_r) < kEpsilonFloat)
+    {
+        *axis = axis_a;
+        *cos_theta = -1;
+        return;
+    }
+    *axis = Normalize(
+        RotateAroundAxis(axis_a, Normalize(axis_r), theta_o - theta_a));
+    *cos_theta = cosf(theta_o);
+}
+
+LightBounds Union(const LightBounds &a, const LightBounds &b)
+{
+    if (a.power == 0)
+        return b;
+    if (b.power == 0)
+        return a;
+
+    LightBounds result;
+    result.two_sided = a.two_sided || b.two_sided;
+    result.power = a.power + b.power;
+    UnionCone(a.axis, a.cos_theta_o, b.axis, b.cos_theta_o, &result.axis,
+              &result.cos_theta_o);
+    result.cos_theta_e = fminf(a.cos_theta_e, b.cos_theta_e);
+    result.aabb = a.aabb + b.aabb;
+    return result;
+}
+
+// 按 SAOH 估计的代价：功率、发光方向所覆盖的立体角与包围盒表面积的乘积，
+// 另外惩罚沿 dim 方向过于扁平的包围盒
+float EvaluateCost(const LightBounds &bounds, const AABB &aabb_parent,
+                   const int dim)
+{
+    const float theta_o = SafeAcos(bounds.cos_theta_o),
+                theta_e = SafeAcos(bounds.cos_theta_e),
+                theta_w = fminf(theta_o + theta_e, kPi),
+                sin_theta_o = SafeSqrt(1.0f - Sqr(bounds.cos_theta_o));
+    const float omega =
+        k2Pi * (1.0f - bounds.cos_theta_o) +
+        kPiDiv2 * (2.0f * theta_w * sin_theta_o -
+                   cosf(theta_o - 2.0f * theta_w) -
+                   2.0f * theta_o * sin_theta_o + bounds.cos_theta_o);
+
+    const Vec3 diagonal_parent = aabb_parent.max() - aabb_parent.min(),
+               diagonal = bounds.aabb.max() - bounds.aabb.min();
+    const float extent_max = fmaxf(fmaxf(diagonal_parent.x, diagonal_parent.y),
+                                   diagonal_parent.z),
+                k_r = diagonal_parent[dim] > 0
+                          ? extent_max / diagonal_parent[dim]
+                          : 1.0f,
+                area = 2.0f * (diagonal.x * diagonal.y +
+                               diagonal.y * diagonal.z +
+                               diagonal.z * diagonal.x);
+    return bounds.power * omega * k_r * area;
+}
+
+struct LightRef
+{
+    uint32_t id;
+    LightBounds bounds;
+};
+
+uint32_t BuildLightBvhTopDown(const uint32_t begin, const uint32_t end,
+                              const uint64_t bit_trail, const uint32_t depth,
+                              std::vector<LightRef> *lights,
+                              std::vector<LightBvhNode> *nodes,
+                              std::vector<uint64_t> *bit_trails)
+{
+    if (depth >= kMaxDepth)
+    {
+        std::ostringstream oss;
+        oss << "light BVH is deeper than " << kMaxDepth << " levels.";
+        throw MyException(oss.str());
+    }
+
+    const uint32_t id_node = static_cast<uint32_t>(nodes->size());
+    nodes->push_back(LightBvhNode());
+    if (end - begin == 1)
+    {
+        const LightRef &light = (*lights)[begin];
+        (*nodes)[id_node].id = light.id;
+        (*nodes)[id_node].bounds = light.bounds;
+        (*bit_trails)[light.id] = bit_trail;
+        return id_node;
+    }
+
+    LightBounds bounds;
+    AABB aabb_centroid;
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        bounds = Union(bounds, (*lights)[i].bounds);
+        aabb_centroid += (*lights)[i].bounds.aabb.center();
+    }
+
+    // 在 3 个坐标轴方向上分桶，选择代价最小的划分
+    float cost_min = kMaxFloat;
+    int dim_min = -1, bucket_min = -1;
+    const Vec3 centroid_min = aabb_centroid.min(),
+               centroid_extent = aabb_centroid.max() - aabb_centroid.min();
+    auto GetBucket = [&](const LightRef &light, const int dim)
+    {
+        const float offset =
+            (light.bounds.aabb.center()[dim] - centroid_min[dim]) /
+            centroid_extent[dim];
+        return std::min(static_cast<int>(offset * kNumBucket), kNumBucket - 1);
+    };
+    for (int dim = 0; dim < 3; ++dim)
+    {
+        if (centroid_extent[dim] <= 0)
+            continue;
+
+        LightBounds buckets[kNumBucket];
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            const int b = GetBucket((*lights)[i], dim);
+            buckets[b] = Union(buckets[b], (*lights)[i].bounds);
+        }
+
+        for (int i = 0; i < kNumBucket - 1; ++i)
+        {
+            LightBounds below, above;
+            for (int j = 0; j <= i; ++j)
+                below = Union(below, buckets[j]);
+            for (int j = i + 1; j < kNumBucket; ++j)
+                above = Union(above, buckets[j]);
+            if (below.power == 0 || above.power == 0)
+                continue;
+
+            const float cost = EvaluateCost(below, bounds.aabb, dim) +
+                               EvaluateCost(above, bounds.aabb, dim);
+            if (cost < cost_min)
+            {
+                cost_min = cost;
+                dim_min = dim;
+                bucket_min = i;
+            }
+        }
+    }
+
+    uint32_t mid = (begin + end) / 2;
+    if (dim_min != -1)
+    {
+        auto IsBelow = [&](const LightRef &light)
+        { return GetBucket(light, dim_min) <= bucket_min; };
+        mid = static_cast<uint32_t>(std::partition(lights->begin() + begin,
+                                                   lights->begin() + end,
+                                                   IsBelow) -
+                                    lights->begin());
+    }
+    if (mid == begin || mid == end)
+    { // 所有光源的中心重合或代价无法区分时，按光源序号平分
+        mid = (begin + end) / 2;
+    }
+
+    BuildLightBvhTopDown(begin, mid, bit_trail, depth + 1, lights, nodes,
+                         bit_trails);
+    const uint32_t id_right = BuildLightBvhTopDown(
+        mid, end, bit_trail | (1ull << depth), depth + 1, lights, nodes,
+        bit_trails);
+
+    (*nodes)[id_node].leaf = false;
+    (*nodes)[id_node].id = id_right;
+    (*nodes)[id_node].bounds = bounds;
+    return id_node;
+}
+
+} // namespace
+
+namespace csrt
+{
+
+QUALIFIER_D_H float LightBounds::Importance(const Vec3 &position,
+                                            const Vec3 &normal) const
+{
+    // 以包围盒的外接球近似光源的空间范围
+    const Vec3 center = aabb.center();
+    const float radius = Length(aabb.max() - aabb.min()) * 0.5f,
+                distance_sqr = Dot(position - center, position - center),
+                d2 = fmaxf(distance_sqr, radius);
+    const Vec3 wi = Normalize(position - center);
+
+    // 包围球相对于着色点所张圆锥的半顶角 theta_b
+    float cos_theta_b = -1;
+    if (distance_sqr >= Sqr(radius))
+        cos_theta_b = SafeSqrt(1.0f - Sqr(radius) / distance_sqr);
+    const float sin_theta_b = SafeSqrt(1.0f - Sqr(cos_theta_b));
+
+    // 光源各点指向着色点的方向与发光表面法线之间的最小夹角
+    // theta' = max(0, theta_w - theta_o - theta_b)
+    float cos_theta_w = Dot(axis, wi);
+    if (two_sided)
+        cos_theta_w = fabsf(cos_theta_w);
+    const float sin_theta_w = SafeSqrt(1.0f - Sqr(cos_theta_w)),
+                sin_theta_o = SafeSqrt(1.0f - Sqr(cos_theta_o)),
+                cos_theta_x = CosSubClamped(sin_theta_w, cos_theta_w,
+                                            sin_theta_o, cos_theta_o),
+                sin_theta_x = SinSubClamped(sin_theta_w, cos_theta_w,
+                                            sin_theta_o, cos_theta_o),
+                cos_theta_p = CosSubClamped(sin_theta_x, cos_theta_x,
+                                            sin_theta_b, cos_theta_b);
+    if (cos_theta_p <= cos_theta_e)
+        return 0;
+
+    float importance = power * cos_theta_p / d2;
+    if (normal.x != 0 || normal.y != 0 || normal.z != 0)
+    { // 光源方向与着色点法线之间的最小夹角，不区分着色点的正反面
+        const float cos_theta_i = fabsf(Dot(wi, normal)),
+                    sin_theta_i = SafeSqrt(1.0f - Sqr(cos_theta_i));
+        importance *=
+            CosSubClamped(sin_theta_i, cos_theta_i, sin_theta_b, cos_theta_b);
+    }
+    return fmaxf(importance, 0.0f);
+}
+
+QUALIFIER_D_H LightBvh::LightBvh() : nodes_(nullptr), bit_trails_(nullptr) {}
+
+QUALIFIER_D_H LightBvh::LightBvh(const LightBvhNode *nodes,
+                                 const uint64_t *bit_trails)
+    : nodes_(nodes), bit_trails_(bit_trails)
+{
+}
+
+QUALIFIER_D_H uint32_t LightBvh::Sample(const Vec3 &position,
+                                        const Vec3 &normal, float xi,
+                                        float *pdf) const
+{
+    if (nodes_ == nullptr)
+        return kInvalidId;
+
+    float pmf = 1;
+    uint32_t id_node = 0;
+    while (!nodes_[id_node].leaf)
+    {
+        const uint32_t id_left = id_node + 1, id_right = nodes_[id_node].id;
+        const float importance_left =
+                        nodes_[id_left].bounds.Importance(position, normal),
+                    importance_right =
+                        nodes_[id_right].bounds.Importance(position, normal);
+        if (importance_left == 0 && importance_right == 0)
+            return kInvalidId;
+
+        // 复用随机数 xi 逐层选择子节点
+        const float pdf_left =
+            importance_left / (importance_left + importance_right);
+        if (xi < pdf_left)
+        {
+            id_node = id_left;
+            xi = fminf(xi / pdf_left, kOneMinusEpsilon);
+            pmf *= pdf_left;
+        }
+        else
+        {
+            id_node = id_right;
+            xi = fminf((xi - pdf_left) / (1.0f - pdf_left), kOneMinusEpsilon);
+            pmf *= 1.0f - pdf_left;
+        }
+    }
+
+    if (id_node == 0 && nodes_[0].bounds.Importance(position, normal) == 0)
+        return kInvalidId;
+    *pdf = pmf;
+    return nodes_[id_node].id;
+}
+
+QUALIFIER_D_H float LightBvh::Pdf(const Vec3 &position, const Vec3 &normal,
+                                  const uint32_t id_light) const
+{
+    if (nodes_ == nullptr || bit_trails_[id_light] == kInvalidBitTrail)
+        return 0;
+
+    float pmf = 1;
+    uint32_t id_node = 0;
+    uint64_t bit_trail = bit_trails_[id_light];
+    while (!nodes_[id_node].leaf)
+    {
+        const uint32_t id_left = id_node + 1, id_right = nodes_[id_node].id;
+        const float importance_left =
+                        nodes_[id_left].bounds.Importance(position, normal),
+                    importance_right =
+                        nodes_[id_right].bounds.Importance(position, normal);
+        if (importance_left == 0 && importance_right == 0)
+            return 0;
+
+        if (bit_trail & 1)
+        {
+            pmf *= importance_right / (importance_left + importance_right);
+            id_node = id_right;
+        }
+        else
+        {
+            pmf *= importance_left / (importance_left + importance_right);
+            id_node = id_left;
+        }
+        bit_trail >>= 1;
+    }
+
+    if (id_node == 0 && nodes_[0].bounds.Importance(position, normal) == 0)
+        return 0;
+    return pmf;
+}
+
+QUALIFIER_D_H uint32_t LightBvh::SamplePower(float xi, float *pdf) const
+{
+    if (nodes_ == nullptr)
+        return kInvalidId;
+
+    float pmf = 1;
+    uint32_t id_node = 0;
+    while (!nodes_[id_node].leaf)
+    {
+        const uint32_t id_left = id_node + 1, id_right = nodes_[id_node].id;
+        const float power_left = nodes_[id_left].bounds.power,
+                    power_right = nodes_[id_right].bounds.power;
+
+        // 复用随机数 xi 逐层选择子节点
+        const float pdf_left = power_left / (power_left + power_right);
+        if (xi < pdf_left)
+        {
+            id_node = id_left;
+            xi = fminf(xi / pdf_left, kOneMinusEpsilon);
+            pmf *= pdf_left;
+        }
+        else
+        {
+            id_node = id_right;
+            xi = fminf((xi - pdf_left) / (1.0f - pdf_left), kOneMinusEpsilon);
+            pmf *= 1.0f - pdf_left;
+        }
+    }
+
+    *pdf = pmf;
+    return nodes_[id_node].id;
+}
+
+QUALIFIER_D_H float LightBvh::PdfPower(const uint32_t id_light) const
+{
+    if (nodes_ == nullptr || bit_trails_[id_light] == kInvalidBitTrail)
+        return 0;
+
+    float pmf = 1;
+    uint32_t id_node = 0;
+    uint64_t bit_trail = bit_trails_[id_light];
+    while (!nodes_[id_node].leaf)
+    {
+        const uint32_t id_left = id_node + 1, id_right = nodes_[id_node].id;
+        const float power_left = nodes_[id_left].bounds.power,
+                    power_right = nodes_[id_right].bounds.power;
+        if (bit_trail & 1)
+        {
+            pmf *= power_right / (power_left + power_right);
+            id_node = id_right;
+        }
+        else
+        {
+            pmf *= power_left / (power_left + power_right);
+            id_node = id_left;
+        }
+        bit_trail >>= 1;
+    }
+    return pmf;
+}
+
+std::vector<LightBvhNode> BuildLightBvh(const std::vector<LightBounds> &lights,
+                                        std::vector<uint64_t> *bit_trails)
+{
+    *bit_trails = std::vector<uint64_t>(lights.size(), kInvalidBitTrail);
+
+    std::vector<LightRef> refs;
+    for (uint32_t i = 0; i < static_cast<uint32_t>(lights.size()); ++i)
+    {
+        if (lights[i].power > 0 && !IsEmpty(lights[i].aabb))
+            refs.push_back({i, lights[i]});
+    }
+
+    std::vector<LightBvhNode> nodes;
+    if (!refs.empty())
+    {
+        nodes.reserve(2 * refs.size() - 1);
+        BuildLightBvhTopDown(0, static_cast<uint32_t>(refs.size()), 0, 0,
+                             &refs, &nodes, bit_trails);
+    }
+    return nodes;
+}
+
+} // namespace csrt
\ No newline at end of file
@@ -21,7 +21,7 @@ QUALIFIER_D_H void SamplePointLight(const PointLightData &data,
 QUALIFIER_D_H Vec3 EvaluatePointLight(const PointLightData &data,
                                       const EmitterSampleRec *rec)
 {
-    return {};
+    return data.intensity * Sqr(1.0f / rec->distance);
 }
 
 QUALIFIER_D_H Vec3 EvaluatePointLight(const PointLightData &data,
@@ -36,4 +36,19 @@ QUALIFIER_D_H float PdfPointLight(const PointLightData &data,
     return 0;
 }
 
+QUALIFIER_D_H Vec3 SamplePointLightEmission(const PointLightData &data,
+                                            const float xi_0, const float xi_1,
+                                            Vec3 *dir, float *pdf)
+{
+    *dir = SampleSphereUniform(xi_0, xi_1);
+    *pdf = k1Div4Pi;
+    return data.position;
+}
+
+QUALIFIER_D_H float PdfPointLightEmission(const PointLightData &data,
+                                          const Vec3 &dir)
+{
+    return k1Div4Pi;
+}
+
 } // namespace csrt
\ No newline at end of file
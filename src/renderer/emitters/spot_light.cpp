@@ -55,4 +55,23 @@ QUALIFIER_D_H float PdfSpotLight(const SpotLightData &data,
     return 0;
 }
 
+QUALIFIER_D_H Vec3 SampleSpotLightEmission(const SpotLightData &data,
+                                           const float xi_0, const float xi_1,
+                                           Vec3 *dir, float *pdf)
+{
+    const Vec3 dir_local = SampleConeUniform(data.cos_cutoff_angle, xi_0, xi_1);
+    *dir = Normalize(TransformVector(data.to_world, dir_local));
+    *pdf = 1.0f / (k2Pi * (1.0f - data.cos_cutoff_angle));
+    return data.position;
+}
+
+QUALIFIER_D_H float PdfSpotLightEmission(const SpotLightData &data,
+                                         const Vec3 &dir)
+{
+    const Vec3 dir_local = TransformVector(data.to_local, dir);
+    if (dir_local.z < data.cos_cutoff_angle)
+        return 0;
+    return 1.0f / (k2Pi * (1.0f - data.cos_cutoff_angle));
+}
+
 } // namespace csrt
\ No newline at end of file
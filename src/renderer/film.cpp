@@ -0,0 +1,314 @@
+#include "csrt/renderer/film.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "csrt/utils.hpp"
+
+namespace
+{
+
+using namespace csrt;
+
+constexpr char kCheckpointMagic[8] = {'C', 'S', 'R', 'T', 'F', 'I', 'L', 'M'};
+// 版本 3：随机数发生器改为 PCG，旧版本的检查点与部分累积结果不能继续或合并
+constexpr uint32_t kCheckpointVersion = 3;
+constexpr uint64_t kCheckpointAlignment = 64;
+
+static_assert(sizeof(CheckpointHeader) == kCheckpointAlignment,
+              "unexpected checkpoint header size.");
+
+uint64_t AlignOffset(const uint64_t offset)
+{
+    return (offset + kCheckpointAlignment - 1) / kCheckpointAlignment *
+           kCheckpointAlignment;
+}
+
+CheckpointHeader ReadCheckpointHeader(const MappedFile &file,
+                                      const std::string &filename)
+{
+    CheckpointHeader header = {};
+    if (file.size() < sizeof(header))
+        throw MyException("invalid checkpoint file '" + filename + "'.");
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, kCheckpointMagic, sizeof(header.magic)) != 0 ||
+        header.version != kCheckpointVersion)
+        throw MyException("invalid checkpoint file '" + filename + "'.");
+    return header;
+}
+
+} // namespace
+
+namespace csrt
+{
+
+Film::Film(const uint32_t width, const uint32_t height,
+           const uint32_t sample_begin, const uint32_t y_begin)
+    : width_(width), height_(height), sample_begin_(sample_begin),
+      y_begin_(y_begin)
+{
+    const uint64_t num_pixel = static_cast<uint64_t>(width) * height;
+    sum_ = std::vector<uint64_t>(num_pixel * 3);
+    stats_ = std::vector<float>(num_pixel * 2);
+    count_ = std::vector<uint32_t>(num_pixel);
+    Reset();
+}
+
+void Film::Reset()
+{
+    std::fill(sum_.begin(), sum_.end(), 0);
+    std::fill(stats_.begin(), stats_.end(), 0.0f);
+    std::fill(count_.begin(), count_.end(), 0);
+}
+
+void Film::Merge(const Film &other)
+{
+    if (other.width_ != width_ || other.height_ != height_)
+        throw MyException("cannot merge films of different sizes.");
+
+    const uint64_t num_pixel = static_cast<uint64_t>(width_) * height_;
+    for (uint64_t i = 0; i < num_pixel; ++i)
+    {
+        for (int channel = 0; channel < 3; ++channel)
+            sum_[i * 3 + channel] += other.sum_[i * 3 + channel];
+
+        const uint32_t count_a = count_[i], count_b = other.count_[i],
+                       count = count_a + count_b;
+        if (count_b == 0)
+            continue;
+        const float mean_a = stats_[i * 2], mean_b = other.stats_[i * 2],
+                    delta = mean_b - mean_a,
+                    weight_b = static_cast<float>(count_b) / count;
+        stats_[i * 2] = mean_a + delta * weight_b;
+        stats_[i * 2 + 1] += other.stats_[i * 2 + 1] +
+                             delta * delta * count_a * weight_b;
+        count_[i] = count;
+    }
+}
+
+void Film::Resolve(float *frame) const
+{
+    const uint64_t num_pixel = static_cast<uint64_t>(width_) * height_;
+    for (uint64_t i = 0; i < num_pixel; ++i)
+    {
+        const double scale =
+            count_[i] == 0 ? 0.0 : 1.0 / (kFilmFixedScale * count_[i]);
+        for (int channel = 0; channel < 3; ++channel)
+        {
+            frame[i * 3 + channel] =
+                static_cast<float>(sum_[i * 3 + channel] * scale);
+        }
+    }
+}
+
+void Film::Resolve(const uint32_t x_begin, const uint32_t y_begin,
+                   const uint32_t x_end, const uint32_t y_end,
+                   float *frame) const
+{
+    for (uint32_t j = y_begin; j < y_end; ++j)
+    {
+        for (uint32_t i = x_begin; i < x_end; ++i)
+        {
+            const uint64_t index =
+                static_cast<uint64_t>(j - y_begin_) * width_ + i;
+            const double scale = count_[index] == 0
+                                     ? 0.0
+                                     : 1.0 / (kFilmFixedScale * count_[index]);
+            for (int channel = 0; channel < 3; ++channel)
+            {
+                frame[index * 3 + channel] =
+                    static_cast<float>(sum_[index * 3 + channel] * scale);
+            }
+        }
+    }
+}
+
+void Film::ResolvePreview(const uint32_t stride, float *frame) const
+{
+    // 最后一个网格点，图像边缘超出它的像素只在一侧有网格点
+    const uint32_t x_last = (width_ - 1) / stride * stride,
+                   y_last = (height_ - 1) / stride * stride;
+    for (uint32_t j = 0; j < height_; ++j)
+    {
+        const uint32_t y0 = j / stride * stride,
+                       y1 = std::min(y0 + stride, y_last);
+        const double ty = y1 > y0 ? static_cast<double>(j - y0) / stride : 0;
+        for (uint32_t i = 0; i < width_; ++i)
+        {
+            const uint64_t offset = (static_cast<uint64_t>(j) * width_ + i) * 3;
+            const uint32_t count = count_[offset / 3];
+            if (count != 0)
+            {
+                const double scale = 1.0 / (kFilmFixedScale * count);
+                for (int channel = 0; channel < 3; ++channel)
+                {
+                    frame[offset + channel] =
+                        static_cast<float>(sum_[offset + channel] * scale);
+                }
+                continue;
+            }
+
+            const uint32_t x0 = i / stride * stride,
+                           x1 = std::min(x0 + stride, x_last);
+            const double tx =
+                x1 > x0 ? static_cast<double>(i - x0) / stride : 0;
+            const uint32_t xs[4] = {x0, x1, x0, x1}, ys[4] = {y0, y0, y1, y1};
+            const double weights[4] = {(1 - tx) * (1 - ty), tx * (1 - ty),
+                                       (1 - tx) * ty, tx * ty};
+            // 权重取一个很小的下限，网格点缺失（如裁剪窗口的边缘）时仍能使用其它网格点
+            double color[3] = {0, 0, 0}, weight_sum = 0;
+            for (int k = 0; k < 4; ++k)
+            {
+                const uint64_t index =
+                    static_cast<uint64_t>(ys[k]) * width_ + xs[k];
+                if (count_[index] == 0)
+                    continue;
+                const double weight = std::max(weights[k], 1e-6),
+                             scale = weight / (kFilmFixedScale * count_[index]);
+                for (int channel = 0; channel < 3; ++channel)
+                    color[channel] += sum_[index * 3 + channel] * scale;
+                weight_sum += weight;
+            }
+            for (int channel = 0; channel < 3; ++channel)
+            {
+                frame[offset + channel] = static_cast<float>(
+                    weight_sum > 0 ? color[channel] / weight_sum : 0);
+            }
+        }
+    }
+}
+
+void Film::ResolveSampleCount(const uint32_t spp_max, float *frame) const
+{
+    // 黑-红-黄-白的热度色阶
+    const float spp_max_rcp = 1.0f / std::max(1u, spp_max);
+    const uint64_t num_pixel = static_cast<uint64_t>(width_) * height_;
+    for (uint64_t i = 0; i < num_pixel; ++i)
+    {
+        const float t = std::min(count_[i] * spp_max_rcp, 1.0f) * 3.0f;
+        frame[i * 3] = std::min(t, 1.0f);
+        frame[i * 3 + 1] = std::min(std::max(t - 1.0f, 0.0f), 1.0f);
+        frame[i * 3 + 2] = std::max(t - 2.0f, 0.0f);
+    }
+}
+
+float Film::RelativeError(const uint32_t i, const uint32_t j) const
+{
+    const uint64_t index = static_cast<uint64_t>(j - y_begin_) * width_ + i;
+    const uint32_t count = count_[index];
+    if (count < 2)
+        return std::numeric_limits<float>::infinity();
+
+    // 均值的标准误差除以均值，分母加上一个小量，避免暗处像素的误差被过度放大
+    const float mean = stats_[index * 2], m2 = stats_[index * 2 + 1],
+                variance = m2 / (count - 1);
+    return std::sqrt(variance / count) / (mean + 0.01f);
+}
+
+uint64_t Film::num_sample() const
+{
+    uint64_t num = 0;
+    for (const uint32_t count : count_)
+        num += count;
+    return num;
+}
+
+void Film::Save(const std::string &filename, CheckpointHeader header) const
+{
+    std::memcpy(header.magic, kCheckpointMagic, sizeof(header.magic));
+    header.version = kCheckpointVersion;
+    header.width = width_;
+    header.height = height_;
+    header.sample_begin = sample_begin_;
+
+    const std::string filename_temp = filename + ".tmp";
+    FILE *file = fopen(filename_temp.c_str(), "wb");
+    if (file == nullptr)
+        throw MyException("cannot create file '" + filename_temp + "'.");
+
+    uint64_t offset = 0;
+    bool ok = true;
+    auto WriteArray = [&](const void *data, const uint64_t size)
+    {
+        static const char padding[kCheckpointAlignment] = {};
+        const uint64_t offset_aligned = AlignOffset(offset);
+        ok = ok &&
+             fwrite(padding, 1, offset_aligned - offset, file) ==
+                 offset_aligned - offset &&
+             fwrite(data, 1, size, file) == size;
+        offset = offset_aligned + size;
+    };
+    WriteArray(&header, sizeof(header));
+    WriteArray(sum_.data(), sum_.size() * sizeof(uint64_t));
+    WriteArray(stats_.data(), stats_.size() * sizeof(float));
+    WriteArray(count_.data(), count_.size() * sizeof(uint32_t));
+
+    // 重命名之前确保数据已写入磁盘
+    ok = ok && fflush(file) == 0;
+#if defined(_WIN32)
+    ok = ok && _commit(_fileno(file)) == 0;
+#else
+    ok = ok && fsync(fileno(file)) == 0;
+#endif
+    ok = (fclose(file) == 0) && ok;
+    if (!ok)
+    {
+        std::remove(filename_temp.c_str());
+        throw MyException("cannot write file '" + filename_temp + "'.");
+    }
+
+    std::error_code error;
+    std::filesystem::rename(filename_temp, filename, error);
+    if (error)
+    {
+        std::remove(filename_temp.c_str());
+        throw MyException("cannot rename '" + filename_temp + "' to '" +
+                          filename + "'.");
+    }
+}
+
+CheckpointHeader Film::LoadHeader(const std::string &filename)
+{
+    MappedFile file(filename);
+    return ReadCheckpointHeader(file, filename);
+}
+
+CheckpointHeader Film::Load(const std::string &filename)
+{
+    MappedFile file(filename);
+
+    const CheckpointHeader header = ReadCheckpointHeader(file, filename);
+    if (header.width != width_ || header.height != height_ ||
+        header.sample_begin != sample_begin_)
+    {
+        throw MyException("checkpoint file '" + filename +
+                          "' does not match.");
+    }
+
+    uint64_t offset = sizeof(header);
+    auto ReadArray = [&](void *data, const uint64_t size)
+    {
+        offset = AlignOffset(offset);
+        if (offset + size > file.size())
+            throw MyException("checkpoint file '" + filename +
+                              "' is truncated.");
+        std::memcpy(data, file.data() + offset, size);
+        offset += size;
+    };
+    ReadArray(sum_.data(), sum_.size() * sizeof(uint64_t));
+    ReadArray(stats_.data(), stats_.size() * sizeof(float));
+    ReadArray(count_.data(), count_.size() * sizeof(uint32_t));
+    return header;
+}
+
+} // namespace csrt
\ No newline at end of file
@@ -0,0 +1,692 @@
+#include "csrt/renderer/integrators/bdpt.hpp"
+
+#include "csrt/renderer/integrators/integrator.hpp"
+
+namespace
+{
+
+using namespace csrt;
+
+// 子路径上的一个顶点
+struct BdptVertex
+{
+    // 点光源与聚光灯上的顶点只有位置，法线为零向量；面光源上的顶点的法线为发光表面的正面
+    Hit hit;
+    // 顶点所在表面的 BSDF，点光源与聚光灯上的顶点为空
+    Bsdf *bsdf;
+    // 指向子路径上前一个顶点（或相机）的方向
+    Vec3 wo;
+    // 子路径到达该顶点时的通量，不含该顶点的散射
+    Vec3 beta;
+    // 沿子路径的方向、以及沿相反的方向抽样得到该顶点的概率密度（面积测度）
+    float pdf_fwd;
+    float pdf_rev;
+    // 光源上的顶点对应的光源 ID（与光源层次包围盒一致）
+    uint32_t id_light;
+};
+
+// 连接两条子路径之后需要重新计算的概率密度（面积测度）。
+// 光源子路径有 s 个顶点、相机子路径有 t 个顶点，连接的两个端点分别为 y_{s-1} 与 z_{t-1}
+struct BdptConnection
+{
+    // 沿相机子路径的方向抽样得到 y_{s-1} 与 y_{s-2}
+    float pdf_light_end = 0;
+    float pdf_light_prev = 0;
+    // 沿光源子路径的方向抽样得到 z_{t-1} 与 z_{t-2}。s = 0 时 z_{t-1} 位于光源上，
+    // 分别为按功率抽样得到 z_{t-1} 与从 z_{t-1} 发出的光线到达 z_{t-2} 的概率密度
+    float pdf_camera_end = 0;
+    float pdf_camera_prev = 0;
+    // 在光路的倒数第二个顶点（自光源数起的第二个顶点）按光源层次包围盒抽样得到光源上的顶点
+    float pdf_nee = 0;
+};
+
+QUALIFIER_D_H float Ratio(const float numerator, const float denominator)
+{
+    return denominator > 0.0f ? numerator / denominator : 0.0f;
+}
+
+// 从 from 抽样方向的概率密度 pdf（立体角测度）转换为抽样得到顶点 to 的概率密度（面积测度）
+QUALIFIER_D_H float ToArea(const float pdf, const Vec3 &from,
+                           const BdptVertex &to)
+{
+    const Vec3 d_vec = to.hit.position - from;
+    const float distance_sqr = Dot(d_vec, d_vec);
+    if (distance_sqr == 0.0f)
+        return 0;
+    const float cos_theta = fabsf(Dot(to.hit.normal, d_vec)) /
+                            sqrtf(distance_sqr);
+    return pdf * cos_theta / distance_sqr;
+}
+
+// 使法线 normal 与方向 dir 位于同一侧
+QUALIFIER_D_H Vec3 FaceForward(const Vec3 &normal, const Vec3 &dir)
+{
+    return Dot(normal, dir) < 0.0f ? -normal : normal;
+}
+
+QUALIFIER_D_H Bsdf *GetBsdf(const IntegratorData *data, const Hit &hit)
+{
+    if (data->map_instance_bsdf[hit.id_instance] == kInvalidId)
+        return nullptr;
+    return data->bsdfs + data->map_instance_bsdf[hit.id_instance];
+}
+
+// 求取光线与场景的交点，穿过没有 BSDF 的表面（参与介质的边界）
+QUALIFIER_D_H Hit IntersectSurface(const IntegratorData *data, uint32_t *seed,
+                                   Ray *ray)
+{
+    for (;;)
+    {
+        const Hit hit = data->tlas->Intersect(
+            data->bsdfs, data->map_instance_bsdf, seed, ray);
+        if (!hit.valid || GetBsdf(data, hit) != nullptr)
+            return hit;
+        *ray = Ray(hit.position, ray->dir);
+    }
+}
+
+// from 与 to 之间是否没有被其它物体遮挡，没有 BSDF 的表面不遮挡光线
+QUALIFIER_D_H bool Visible(const IntegratorData *data, const Vec3 &from,
+                           const Vec3 &to, uint32_t *seed)
+{
+    Vec3 origin = from;
+    for (;;)
+    {
+        const Vec3 d_vec = to - origin;
+        const float distance = Length(d_vec);
+        if (distance <= 2.0f * kEpsilonDistance)
+            return true;
+        Ray ray = {origin, d_vec / distance};
+        ray.t_max = distance - kEpsilonDistance;
+        if (!data->tlas->IntersectAny(data->bsdfs, data->map_instance_bsdf,
+                                      seed, &ray))
+            return true;
+
+        // 被遮挡时，检查遮挡物是否都是没有 BSDF 的表面
+        ray = {origin, d_vec / distance};
+        ray.t_max = distance - kEpsilonDistance;
+        const Hit hit = data->tlas->Intersect(
+            data->bsdfs, data->map_instance_bsdf, seed, &ray);
+        if (!hit.valid)
+            return true;
+        if (GetBsdf(data, hit) != nullptr)
+            return false;
+        origin = hit.position;
+    }
+}
+
+// 光源上的顶点 light 向 position 发光时，方向的概率密度（立体角测度）
+QUALIFIER_D_H float PdfEmission(const IntegratorData *data,
+                                const BdptVertex &light, const Vec3 &position)
+{
+    const Vec3 dir = Normalize(position - light.hit.position);
+    if (light.id_light < data->num_emitter)
+        return data->emitters[light.id_light].PdfEmission(dir);
+
+    const float cos_theta = Dot(light.hit.normal, dir);
+    if (light.bsdf->IsTwosided())
+        return 0.5f * fabsf(cos_theta) * k1DivPi;
+    return cos_theta > 0.0f ? cos_theta * k1DivPi : 0.0f;
+}
+
+// 在位于 position、法线为 normal 的着色点按光源层次包围盒抽样，得到光源上的顶点 light
+// 的概率密度（面积测度，点光源与聚光灯为选中光源的概率）
+QUALIFIER_D_H float PdfLightNee(const IntegratorData *data,
+                                const BdptVertex &light, const Vec3 &position,
+                                const Vec3 &normal)
+{
+    const float pdf_light =
+        data->light_bvh.Pdf(position, normal, light.id_light);
+    if (pdf_light == 0.0f || light.id_light < data->num_emitter)
+        return pdf_light;
+
+    // 抽样面光源时只会得到光源朝向着色点的一面
+    const Vec3 d_vec = position - light.hit.position;
+    const float distance_sqr = Dot(d_vec, d_vec),
+                cos_theta_prime = Dot(light.hit.normal, d_vec) /
+                                  sqrtf(distance_sqr);
+    if (cos_theta_prime < kEpsilonFloat)
+        return 0;
+    return pdf_light *
+           data->instances[light.hit.id_instance].Pdf(position, light.hit) *
+           cos_theta_prime / distance_sqr;
+}
+
+// 由光源子路径的 s 个顶点与相机子路径的 t 个顶点连接而成的光路的多重重要抽样权重。
+// 光路的顶点自光源起依次为 x_0, ..., x_{n-1}，按幂启发式比较各种 s 的概率密度，
+// 每条子路径最多有 kMaxBdptVertex 个顶点，相机子路径至少有一个顶点
+QUALIFIER_D_H float MisWeightBdpt(const BdptVertex *light, const uint32_t s,
+                                  const BdptVertex *camera, const uint32_t t,
+                                  const BdptConnection &conn,
+                                  const bool delta_light)
+{
+    // 沿光源子路径的方向、以及沿相机子路径的方向抽样得到各个顶点的概率密度
+    const uint32_t n = s + t;
+    float pdf_light[2 * kMaxBdptVertex], pdf_camera[2 * kMaxBdptVertex];
+    for (uint32_t i = 0; i < s; ++i)
+    {
+        pdf_light[i] = light[i].pdf_fwd;
+        pdf_camera[i] = light[i].pdf_rev;
+    }
+    for (uint32_t k = 0; k < t; ++k)
+    {
+        pdf_light[n - 1 - k] = camera[k].pdf_rev;
+        pdf_camera[n - 1 - k] = camera[k].pdf_fwd;
+    }
+    if (s >= 1)
+        pdf_camera[s - 1] = conn.pdf_light_end;
+    if (s >= 2)
+        pdf_camera[s - 2] = conn.pdf_light_prev;
+    pdf_light[s] = conn.pdf_camera_end;
+    if (t >= 2)
+        pdf_light[s + 1] = conn.pdf_camera_prev;
+
+    // s = 1 时按光源层次包围盒抽样光源上的顶点，s >= 2 时按功率抽样，
+    // 两者的概率之比需要单独计算
+    const float pl0 = pdf_light[0], pl1 = pdf_light[1], pc0 = pdf_camera[0],
+                pc1 = pdf_camera[1], pnee = conn.pdf_nee;
+    const uint32_t s_min = n > kMaxBdptVertex ? n - kMaxBdptVertex : 0,
+                   s_max = n - 1 < kMaxBdptVertex ? n - 1 : kMaxBdptVertex;
+
+    // 其它策略与当前策略的概率密度之比
+    float sum = 0, ratio = 1;
+    for (uint32_t i = s + 1; i <= s_max; ++i)
+    {
+        if (i == 1)
+            ratio = Ratio(pnee, pc0);
+        else if (i == 2)
+            ratio = s == 0 ? Ratio(pl0 * pl1, pc0 * pc1)
+                           : Ratio(pl0 * pl1, pnee * pc1);
+        else
+            ratio *= Ratio(pdf_light[i - 1], pdf_camera[i - 1]);
+        sum += ratio * ratio;
+    }
+
+    ratio = 1;
+    uint32_t i = s;
+    while (i > s_min && i > 2)
+    {
+        --i;
+        ratio *= Ratio(pdf_camera[i], pdf_light[i]);
+        sum += ratio * ratio;
+    }
+    if (s >= 2)
+    {
+        if (s_min <= 1)
+            sum += Sqr(ratio * Ratio(pnee * pc1, pl0 * pl1));
+        if (s_min == 0 && !delta_light)
+            sum += Sqr(ratio * Ratio(pc0 * pc1, pl0 * pl1));
+    }
+    else if (s == 1 && s_min == 0 && !delta_light)
+    {
+        sum += Sqr(Ratio(pc0, pnee));
+    }
+    return 1.0f / (1.0f + sum);
+}
+
+// 从按功率抽样的光源出发追踪光源子路径，最多记录 num_max 个顶点，返回顶点数量
+QUALIFIER_D_H uint32_t GenerateLightPath(const IntegratorData *data,
+                                         const uint32_t num_max,
+                                         Sampler *sampler, BdptVertex *light)
+{
+    uint32_t *seed = sampler->seed();
+    const float xi_light = sampler->Next1D(), xi_0 = sampler->Next1D();
+    const Vec2 xi = sampler->Next2D(), xi_dir = sampler->Next2D();
+    if (num_max < 2)
+        return 0;
+
+    float pdf_light = 0;
+    const uint32_t id_light = data->light_bvh.SamplePower(xi_light, &pdf_light);
+    if (id_light == kInvalidId || pdf_light == 0.0f)
+        return 0;
+
+    // 抽样光源上的一点与发出光线的方向
+    BdptVertex &vertex_light = light[0];
+    vertex_light.hit = Hit();
+    vertex_light.bsdf = nullptr;
+    vertex_light.wo = {};
+    vertex_light.pdf_rev = 0;
+    vertex_light.id_light = id_light;
+    Vec3 dir, beta;
+    float pdf_dir = 0;
+    if (id_light < data->num_emitter)
+    {
+        const Emitter &emitter = data->emitters[id_light];
+        vertex_light.hit.position =
+            emitter.SampleEmission(xi_dir.u, xi_dir.v, &dir, &pdf_dir);
+        if (pdf_dir <= 0.0f)
+            return 0;
+        // 单位距离处的辐射强度
+        const EmitterSampleRec rec = {true, true, 1.0f, dir};
+        vertex_light.pdf_fwd = pdf_light;
+        beta = emitter.Evaluate(rec) / (pdf_light * pdf_dir);
+    }
+    else
+    {
+        const uint32_t id_instance =
+            data->map_id_area_light_instance[id_light - data->num_emitter];
+        Hit hit = data->instances[id_instance].Sample(xi_0, xi.u, xi.v);
+        if (!hit.valid)
+            return 0;
+        hit.id_instance = id_instance;
+        Bsdf *bsdf = GetBsdf(data, hit);
+
+        // 两面都发光时，复用随机数等概率地选择发光的一面
+        Vec3 normal = hit.normal;
+        float xi_cos = xi_dir.u, pdf_side = 1;
+        if (bsdf->IsTwosided())
+        {
+            pdf_side = 0.5f;
+            if (xi_cos < 0.5f)
+            {
+                xi_cos = 2.0f * xi_cos;
+            }
+            else
+            {
+                xi_cos = 2.0f * xi_cos - 1.0f;
+                normal = -normal;
+            }
+        }
+        Vec3 dir_local;
+        SampleHemisCos(xi_cos, xi_dir.v, &dir_local, &pdf_dir);
+        pdf_dir *= pdf_side;
+        if (pdf_dir <= 0.0f)
+            return 0;
+        dir = LocalToWorld(dir_local, normal);
+
+        const float pdf_area = data->list_pdf_area_instance[id_instance];
+        vertex_light.hit = hit;
+        vertex_light.bsdf = bsdf;
+        vertex_light.pdf_fwd = pdf_light * pdf_area;
+        beta = bsdf->GetRadiance(hit.texcoord) * dir_local.z /
+               (pdf_light * pdf_area * pdf_dir);
+    }
+
+    // 追踪光源发出的光线
+    uint32_t num = 1;
+    Vec3 position = vertex_light.hit.position;
+    float pdf = pdf_dir;
+    while (num < num_max)
+    {
+        Ray ray = {position, dir};
+        const Hit hit = IntersectSurface(data, seed, &ray);
+        if (!hit.valid)
+            break;
+        Bsdf *bsdf = GetBsdf(data, hit);
+        if ((hit.inside && !bsdf->IsTwosided()) || bsdf->IsEmitter())
+        { // 光线抵达景物的背面且景物的背面吸收一切光照，或者抵达其它光源
+            break;
+        }
+
+        BdptVertex &vertex = light[num];
+        vertex = {hit, bsdf, -dir, beta, 0, 0, kInvalidId};
+        vertex.pdf_fwd = ToArea(pdf, position, vertex);
+        ++num;
+        if (num >= num_max)
+            break;
+
+        if (num >= data->info.depth_rr)
+        {
+            if (sampler->Next1D() >= data->info.pdf_rr)
+                break;
+            beta *= data->pdf_rr_rcp;
+        }
+
+        // 按 BSDF 抽样光线的出射方向，光照沿 dir 到达当前顶点，之后沿 dir_next 离开
+        const BsdfSampleRec rec = SampleRayPath(vertex.wo, hit, bsdf, sampler);
+        if (!rec.valid)
+            break;
+        const Vec3 dir_next = -rec.wi;
+        const BsdfSampleRec rec_adjoint =
+            EvaluateRayPath(dir, dir_next, hit, bsdf);
+        const float cos_theta_in = fabsf(Dot(hit.normal, vertex.wo));
+        if (!rec_adjoint.valid || cos_theta_in < kEpsilonFloat)
+            break;
+
+        beta *= rec_adjoint.attenuation *
+                (fabsf(Dot(hit.normal, dir_next)) / (cos_theta_in * rec.pdf));
+        if (fmaxf(fmaxf(beta.x, beta.y), beta.z) < kEpsilon)
+            break;
+        light[num - 2].pdf_rev =
+            ToArea(rec_adjoint.pdf, hit.position, light[num - 2]);
+
+        position = hit.position;
+        dir = dir_next;
+        pdf = rec.pdf;
+    }
+    return num;
+}
+
+// 策略 s = 1：在相机子路径的第 t 个顶点按光源层次包围盒抽样光源上的一点
+QUALIFIER_D_H Vec3 ConnectLight(const IntegratorData *data,
+                                const BdptVertex *camera, const uint32_t t,
+                                Sampler *sampler)
+{
+    uint32_t *seed = sampler->seed();
+    const BdptVertex &vertex_camera = camera[t - 1];
+    const float xi_light = sampler->Next1D(), xi_0 = sampler->Next1D();
+    const Vec2 xi = sampler->Next2D();
+    float pdf_light = 0;
+    const uint32_t id_light =
+        data->light_bvh.Sample(vertex_camera.hit.position,
+                               vertex_camera.hit.normal, xi_light, &pdf_light);
+    if (id_light == kInvalidId)
+        return {0};
+
+    BdptVertex vertex_light;
+    vertex_light.hit = Hit();
+    vertex_light.bsdf = nullptr;
+    vertex_light.id_light = id_light;
+    vertex_light.pdf_rev = 0;
+    BdptConnection conn;
+    Vec3 radiance;
+    const bool delta_light = id_light < data->num_emitter;
+    if (delta_light)
+    {
+        const Emitter &emitter = data->emitters[id_light];
+        const EmitterSampleRec rec =
+            emitter.Sample(vertex_camera.hit.position, xi.u, xi.v);
+        if (!rec.valid)
+            return {0};
+        vertex_light.hit.position =
+            vertex_camera.hit.position - rec.distance * rec.wi;
+        vertex_light.pdf_fwd = data->light_bvh.PdfPower(id_light);
+        conn.pdf_nee = pdf_light;
+        radiance = emitter.Evaluate(rec) / pdf_light;
+    }
+    else
+    {
+        const uint32_t id_instance =
+            data->map_id_area_light_instance[id_light - data->num_emitter];
+        float pdf_area_light = 0;
+        Hit hit = data->instances[id_instance].Sample(
+            vertex_camera.hit.position, xi_0, xi.u, xi.v, &pdf_area_light);
+        if (!hit.valid || pdf_area_light <= 0.0f)
+            return {0};
+        hit.id_instance = id_instance;
+
+        const Vec3 d_vec = vertex_camera.hit.position - hit.position;
+        const float distance_sqr = Dot(d_vec, d_vec),
+                    cos_theta_prime = Dot(d_vec, hit.normal) /
+                                      sqrtf(distance_sqr);
+        if (cos_theta_prime < kEpsilonFloat)
+            return {0};
+
+        Bsdf *bsdf = GetBsdf(data, hit);
+        vertex_light.hit = hit;
+        vertex_light.bsdf = bsdf;
+        vertex_light.pdf_fwd = data->light_bvh.PdfPower(id_light) *
+                               data->list_pdf_area_instance[id_instance];
+        conn.pdf_nee =
+            pdf_light * pdf_area_light * cos_theta_prime / distance_sqr;
+        radiance = bsdf->GetRadiance(hit.texcoord) /
+                   (pdf_light * pdf_area_light);
+    }
+
+    const Vec3 dir = Normalize(vertex_camera.hit.position -
+                               vertex_light.hit.position);
+    const BsdfSampleRec rec = EvaluateRayPath(
+        dir, vertex_camera.wo, vertex_camera.hit, vertex_camera.bsdf);
+    if (!rec.valid)
+        return {0};
+    const Vec3 L = radiance * rec.attenuation * vertex_camera.beta;
+    if (fmaxf(fmaxf(L.x, L.y), L.z) <= 0.0f)
+        return {0};
+
+    if (!Visible(data, vertex_light.hit.position, vertex_camera.hit.position,
+                 seed))
+        return {0};
+
+    conn.pdf_light_end =
+        ToArea(rec.pdf, vertex_camera.hit.position, vertex_light);
+    conn.pdf_camera_end =
+        ToArea(PdfEmission(data, vertex_light, vertex_camera.hit.position),
+               vertex_light.hit.position, vertex_camera);
+    if (t >= 2)
+    {
+        const BsdfSampleRec rec_prev =
+            EvaluateRayPath(-vertex_camera.wo, -dir, vertex_camera.hit,
+                            vertex_camera.bsdf);
+        conn.pdf_camera_prev =
+            ToArea(rec_prev.valid ? rec_prev.pdf : 0.0f,
+                   vertex_camera.hit.position, camera[t - 2]);
+    }
+    return MisWeightBdpt(&vertex_light, 1, camera, t, conn, delta_light) * L;
+}
+
+// 策略 s >= 2：连接光源子路径的第 s 个顶点与相机子路径的第 t 个顶点
+QUALIFIER_D_H Vec3 ConnectVertices(const IntegratorData *data,
+                                   const BdptVertex *light, const uint32_t s,
+                                   const BdptVertex *camera, const uint32_t t,
+                                   uint32_t *seed)
+{
+    const BdptVertex &vertex_light = light[s - 1],
+                     &vertex_camera = camera[t - 1];
+    const Vec3 d_vec = vertex_camera.hit.position - vertex_light.hit.position;
+    const float distance_sqr = Dot(d_vec, d_vec);
+    if (distance_sqr < Sqr(kEpsilonDistance))
+        return {0};
+    const Vec3 dir = d_vec / sqrtf(distance_sqr);
+
+    // 光照沿 -vertex_light.wo 到达光源子路径的端点，之后沿 dir 到达相机子路径的端点
+    const BsdfSampleRec rec_light = EvaluateRayPath(
+        -vertex_light.wo, dir, vertex_light.hit, vertex_light.bsdf);
+    const float cos_theta_in =
+        fabsf(Dot(vertex_light.hit.normal, vertex_light.wo));
+    if (!rec_light.valid || cos_theta_in < kEpsilonFloat)
+        return {0};
+    const BsdfSampleRec rec_camera = EvaluateRayPath(
+        dir, vertex_camera.wo, vertex_camera.hit, vertex_camera.bsdf);
+    if (!rec_camera.valid)
+        return {0};
+
+    const Vec3 L = vertex_light.beta * rec_light.attenuation *
+                   rec_camera.attenuation * vertex_camera.beta *
+                   (fabsf(Dot(vertex_light.hit.normal, dir)) /
+                    (cos_theta_in * distance_sqr));
+    if (fmaxf(fmaxf(L.x, L.y), L.z) <= 0.0f)
+        return {0};
+
+    if (!Visible(data, vertex_light.hit.position, vertex_camera.hit.position,
+                 seed))
+        return {0};
+
+    BdptConnection conn;
+    conn.pdf_light_end =
+        ToArea(rec_camera.pdf, vertex_camera.hit.position, vertex_light);
+    conn.pdf_light_prev =
+        ToArea(rec_light.pdf, vertex_light.hit.position, light[s - 2]);
+    const BsdfSampleRec rec_end = EvaluateRayPath(
+        -dir, vertex_light.wo, vertex_light.hit, vertex_light.bsdf);
+    conn.pdf_camera_end = ToArea(rec_end.valid ? rec_end.pdf : 0.0f,
+                                 vertex_light.hit.position, vertex_camera);
+    if (t >= 2)
+    {
+        const BsdfSampleRec rec_prev =
+            EvaluateRayPath(-vertex_camera.wo, -dir, vertex_camera.hit,
+                            vertex_camera.bsdf);
+        conn.pdf_camera_prev =
+            ToArea(rec_prev.valid ? rec_prev.pdf : 0.0f,
+                   vertex_camera.hit.position, camera[t - 2]);
+    }
+
+    // 在光源子路径的第二个顶点抽样光源时，着色点的法线朝向光路上的下一个顶点
+    const Vec3 position_next =
+        s >= 3 ? light[2].hit.position : vertex_camera.hit.position;
+    conn.pdf_nee = PdfLightNee(
+        data, light[0], light[1].hit.position,
+        FaceForward(light[1].hit.normal,
+                    position_next - light[1].hit.position));
+
+    const bool delta_light = light[0].id_light < data->num_emitter;
+    return MisWeightBdpt(light, s, camera, t, conn, delta_light) * L;
+}
+
+// 策略 s = 0：相机子路径的第 t 个顶点位于面光源上时，该顶点的辐射亮度的权重
+QUALIFIER_D_H float MisWeightEmitter(const IntegratorData *data,
+                                     const BdptVertex *camera,
+                                     const uint32_t t)
+{
+    const BdptVertex &vertex_prev = camera[t - 2];
+    BdptVertex vertex_light = camera[t - 1];
+    if (vertex_light.hit.inside)
+        vertex_light.hit.normal = -vertex_light.hit.normal;
+    vertex_light.id_light =
+        data->num_emitter +
+        data->map_id_instance_area_light[vertex_light.hit.id_instance];
+
+    BdptConnection conn;
+    conn.pdf_camera_end =
+        data->light_bvh.PdfPower(vertex_light.id_light) *
+        data->list_pdf_area_instance[vertex_light.hit.id_instance];
+    conn.pdf_camera_prev =
+        ToArea(PdfEmission(data, vertex_light, vertex_prev.hit.position),
+               vertex_light.hit.position, vertex_prev);
+    conn.pdf_nee = PdfLightNee(data, vertex_light, vertex_prev.hit.position,
+                               vertex_prev.hit.normal);
+    return MisWeightBdpt(nullptr, 0, camera, t, conn, false);
+}
+
+} // namespace
+
+namespace csrt
+{
+
+QUALIFIER_D_H Vec3 ShadeBdpt(const IntegratorData *data, const Vec3 &eye,
+                             const Vec3 &look_dir, Sampler *sampler)
+{
+    Vec3 L(0);
+    // 遍历加速结构时的透明度测试使用独立的伪随机数，不占用采样器的维度
+    uint32_t *seed = sampler->seed();
+
+    //
+    // 求取原初光线与场景的交点
+    //
+    Ray ray = {eye, look_dir};
+    Hit hit;
+    if (data->tlas)
+        hit = IntersectSurface(data, seed, &ray);
+
+    if (!hit.valid)
+    { // 原初光线逃逸出场景
+        if (data->id_envmap != kInvalidId)
+        {
+            L += data->emitters[data->id_envmap].Evaluate(look_dir);
+        }
+        if (data->id_sun != kInvalidId)
+        {
+            L += data->emitters[data->id_sun].Evaluate(look_dir);
+        }
+        return L;
+    }
+
+    Bsdf *bsdf = GetBsdf(data, hit);
+    if (hit.inside && !bsdf->IsTwosided())
+    { // 原初光线溯源至景物的背面，且景物的背面吸收一切光照
+        return {0};
+    }
+    else if (bsdf->IsEmitter())
+    { // 原初光线溯源至光源，返回直接光照
+        if (data->info.hide_emitters)
+            return {0};
+        else
+            return bsdf->GetRadiance(hit.texcoord);
+    }
+
+    // 与 path 一致，光路最多有 depth_max 个位于景物表面的顶点（含光源上的顶点），
+    // 但总是包含直接光照
+    const uint32_t num_max =
+        data->info.depth_max > 2 ? data->info.depth_max : 2;
+
+    // 追踪光源子路径
+    BdptVertex light[kMaxBdptVertex];
+    const uint32_t num_light = GenerateLightPath(
+        data, num_max - 1 < kMaxBdptVertex ? num_max - 1 : kMaxBdptVertex,
+        sampler, light);
+
+    // 追踪相机子路径，在每个顶点连接光源子路径
+    BdptVertex camera[kMaxBdptVertex];
+    camera[0] = {hit, bsdf, -look_dir, Vec3(1), 1, 0, kInvalidId};
+    uint32_t t = 1;
+    for (;;)
+    {
+        const BdptVertex &vertex = camera[t - 1];
+        if (t + 1 <= num_max)
+        {
+            L += vertex.beta * EvaluateInfiniteLightPath(data, vertex.hit,
+                                                         vertex.wo, sampler);
+            L += ConnectLight(data, camera, t, sampler);
+        }
+        for (uint32_t s = 2; s <= num_light && s + t <= num_max; ++s)
+            L += ConnectVertices(data, light, s, camera, t, seed);
+
+        if (t >= num_max || t >= kMaxBdptVertex)
+            break;
+
+        // 抽样次生光线
+        const BsdfSampleRec rec =
+            SampleRayPath(vertex.wo, vertex.hit, vertex.bsdf, sampler);
+        if (!rec.valid)
+            break;
+        if (t >= 2)
+        {
+            const BsdfSampleRec rec_rev = EvaluateRayPath(
+                -vertex.wo, -rec.wi, vertex.hit, vertex.bsdf);
+            camera[t - 2].pdf_rev =
+                ToArea(rec_rev.valid ? rec_rev.pdf : 0.0f,
+                       vertex.hit.position, camera[t - 2]);
+        }
+
+        // 累积场景的反射率
+        Vec3 beta = vertex.beta * rec.attenuation / rec.pdf;
+        if (fmaxf(fmaxf(beta.x, beta.y), beta.z) < kEpsilon)
+            break;
+
+        ray = Ray(rec.position, -rec.wi);
+        hit = IntersectSurface(data, seed, &ray);
+        if (!hit.valid)
+        { // 次生光线逃逸出场景
+            if (data->id_envmap != kInvalidId)
+            {
+                const Vec3 radiance =
+                    data->emitters[data->id_envmap].Evaluate(-rec.wi);
+                const float pdf_direct =
+                                data->emitters[data->id_envmap].Pdf(-rec.wi),
+                            weight_bsdf = MisWeight(rec.pdf, pdf_direct);
+                L += weight_bsdf * beta * radiance;
+            }
+            break;
+        }
+
+        bsdf = GetBsdf(data, hit);
+        if (hit.inside && !bsdf->IsTwosided())
+        { // 次生光线溯源至景物的背面，且景物的背面吸收一切光照
+            break;
+        }
+
+        BdptVertex &vertex_next = camera[t];
+        vertex_next = {hit, bsdf, rec.wi, beta, 0, 0, kInvalidId};
+        vertex_next.pdf_fwd = ToArea(rec.pdf, rec.position, vertex_next);
+        ++t;
+
+        if (bsdf->IsEmitter())
+        { // 次生光线溯源至光源，累积直接光照，并停止溯源
+            if (Dot(rec.wi, hit.normal) < kEpsilonFloat)
+                break;
+            L += MisWeightEmitter(data, camera, t) * beta *
+                 bsdf->GetRadiance(hit.texcoord);
+            break;
+        }
+
+        if (t >= data->info.depth_rr)
+        {
+            if (sampler->Next1D() >= data->info.pdf_rr)
+                break;
+            vertex_next.beta *= data->pdf_rr_rcp;
+        }
+    }
+
+    return L;
+}
+
+} // namespace csrt
\ No newline at end of file
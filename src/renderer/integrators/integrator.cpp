@@ -4,15 +4,29 @@ namespace csrt
 {
 
 QUALIFIER_D_H Vec3 Integrator::Shade(const Vec3 &eye, const Vec3 &look_dir,
-                                     uint32_t *seed) const
+                                     Sampler *sampler, GuidingPath *path,
+                                     const uint32_t id_pixel,
+                                     RrsPath *rrs_path) const
 {
+    // 记录路径时只追踪单条路径，不分裂
+    const float pixel =
+        (data_.rrs != nullptr && path == nullptr && rrs_path == nullptr)
+            ? data_.rrs->Pixel(id_pixel)
+            : 0.0f;
     switch (data_.info.type)
     {
     case IntegratorType::kPath:
-        return ShadePath(&data_, eye, look_dir, seed);
+        return ShadePath(&data_, eye, look_dir, sampler, pixel, path,
+                         rrs_path);
         break;
     case IntegratorType::kVolPath:
-        return ShadeVolPath(&data_, eye, look_dir, seed);
+        return ShadeVolPath(&data_, eye, look_dir, sampler, path);
+        break;
+    case IntegratorType::kBdpt:
+        return ShadeBdpt(&data_, eye, look_dir, sampler);
+        break;
+    case IntegratorType::kSppm:
+        // 随机渐进式光子映射由 Renderer 逐轮绘制，不逐个样本着色
         break;
     }
     return {};
@@ -2,13 +2,262 @@
 
 #include "csrt/renderer/integrators/integrator.hpp"
 
+namespace
+{
+
+using namespace csrt;
+
+// 光源上的一个抽样点：不考虑遮挡时贡献的直接光照，以及检查遮挡所用的阴影光线
+struct LightSample
+{
+    Vec3 L;
+    Ray ray;
+};
+
+// 抽样光源 emitter，求出不考虑遮挡时贡献的直接光照，pdf_light 为选中该光源的概率，
+// 返回 false 表示没有贡献
+QUALIFIER_D_H bool SampleEmitterPath(const IntegratorData *data,
+                                     const Emitter &emitter,
+                                     const float pdf_light, const Vec2 &xi,
+                                     const Hit &hit, const Vec3 &wo,
+                                     LightSample *sample)
+{
+    const EmitterSampleRec rec = emitter.Sample(hit.position, xi.u, xi.v);
+    if (!rec.valid)
+        return false;
+
+    if (Dot(-rec.wi, hit.normal) < kEpsilonFloat)
+        return false;
+
+    Bsdf *bsdf = nullptr;
+    if (data->map_instance_bsdf[hit.id_instance] != kInvalidId)
+        bsdf = data->bsdfs + data->map_instance_bsdf[hit.id_instance];
+
+    const BsdfSampleRec rec1 = EvaluateRayPath(rec.wi, wo, hit, bsdf);
+    if (!rec1.valid)
+        return false;
+
+    const Vec3 radiance = emitter.Evaluate(rec);
+    if (rec.harsh)
+    {
+        sample->L = radiance * rec1.attenuation / pdf_light;
+    }
+    else
+    {
+        const float pdf_direct = pdf_light * emitter.Pdf(-rec.wi);
+        if (pdf_direct <= kEpsilonFloat)
+            return false;
+        const float weight_direct = MisWeight(
+            pdf_direct, PdfRayPathGuided(data, rec.wi, hit, bsdf, rec1.pdf));
+        sample->L = weight_direct * radiance * (rec1.attenuation / pdf_direct);
+    }
+
+    // 光源与当前着色点之间不能被其它物体遮挡
+    sample->ray = Ray(hit.position, -rec.wi);
+    sample->ray.t_max = rec.distance - kEpsilonDistance;
+    return true;
+}
+
+// 按立体角抽样面光源 index_area_light 上的一点，求出不考虑遮挡时贡献的直接光照，
+// pdf_light 为选中该面光源的概率，返回 false 表示没有贡献
+QUALIFIER_D_H bool SampleAreaLightPath(const IntegratorData *data,
+                                       const uint32_t index_area_light,
+                                       const float pdf_light, const float xi_0,
+                                       const Vec2 &xi, const Hit &hit,
+                                       const Vec3 &wo, LightSample *sample)
+{
+    const uint32_t id_area_light_instance =
+        data->map_id_area_light_instance[index_area_light];
+    float pdf_area_light = 0;
+    const Hit hit_pre = data->instances[id_area_light_instance].Sample(
+        hit.position, xi_0, xi.u, xi.v, &pdf_area_light);
+    if (!hit_pre.valid || pdf_area_light <= 0.0f)
+        return false;
+
+    const Vec3 d_vec = hit.position - hit_pre.position;
+    const float distance = Length(d_vec);
+    const Vec3 wi = Normalize(d_vec);
+    const float cos_theta_prime = Dot(wi, hit_pre.normal);
+    if (cos_theta_prime < kEpsilonFloat)
+        return false;
+    if (Dot(-wi, hit.normal) < kEpsilonFloat)
+        return false;
+
+    Bsdf *bsdf = nullptr;
+    if (data->map_instance_bsdf[hit.id_instance] != kInvalidId)
+        bsdf = data->bsdfs + data->map_instance_bsdf[hit.id_instance];
+
+    const BsdfSampleRec rec = EvaluateRayPath(wi, wo, hit, bsdf);
+    if (!rec.valid)
+        return false;
+
+    // 根据多重重要抽样（MIS，multiple importance sampling）合并抽样面光源得到的阴影光线贡献的直接光照
+    const float pdf_direct = pdf_light * pdf_area_light,
+                weight_direct = MisWeight(
+                    pdf_direct, PdfRayPathGuided(data, wi, hit, bsdf, rec.pdf));
+    Bsdf *bsdf_pre =
+        data->bsdfs + data->map_instance_bsdf[id_area_light_instance];
+    const Vec3 radiance = bsdf_pre->GetRadiance(hit_pre.texcoord);
+    sample->L = weight_direct * radiance * (rec.attenuation / pdf_direct);
+
+    // 抽样点与当前着色点之间不能被其它物体遮挡
+    sample->ray = Ray(hit_pre.position, wi);
+    sample->ray.t_max = distance - kEpsilonDistance;
+    return true;
+}
+
+// 根据光源层次包围盒抽样一个点光源、聚光灯或面光源上的一点，
+// 求出不考虑遮挡时贡献的直接光照，返回 false 表示没有贡献
+QUALIFIER_D_H bool SampleLightPath(const IntegratorData *data, const Hit &hit,
+                                   const Vec3 &wo, Sampler *sampler,
+                                   LightSample *sample)
+{
+    const float xi_light = sampler->Next1D(), xi_0 = sampler->Next1D();
+    const Vec2 xi = sampler->Next2D();
+    float pdf_light = 0;
+    const uint32_t id_light =
+        data->light_bvh.Sample(hit.position, hit.normal, xi_light, &pdf_light);
+    if (id_light == kInvalidId)
+        return false;
+
+    if (id_light < data->num_emitter)
+    {
+        return SampleEmitterPath(data, data->emitters[id_light], pdf_light, xi,
+                                 hit, wo, sample);
+    }
+    else
+    {
+        return SampleAreaLightPath(data, id_light - data->num_emitter,
+                                   pdf_light, xi_0, xi, hit, wo, sample);
+    }
+}
+
+// 光源上的抽样点与着色点之间是否没有遮挡
+QUALIFIER_D_H bool IsVisiblePath(const IntegratorData *data,
+                                 const LightSample &sample, uint32_t *seed)
+{
+    Ray ray_test = sample.ray;
+    return !data->tlas->IntersectAny(data->bsdfs, data->map_instance_bsdf,
+                                     seed, &ray_test);
+}
+
+// 按重抽样重要性抽样（RIS，resampled importance sampling）求直接光照：
+// 根据光源层次包围盒抽样多个候选点而不检查遮挡，以不考虑遮挡时贡献的亮度为目标分布，
+// 用加权蓄水池抽样选出一个候选点，只为它发出一条阴影光线。候选点的权重即为其贡献的亮度，
+// 结果为选中的候选点的贡献除以其亮度，再乘以所有候选点权重的平均值。
+// 候选点的贡献已经按多重重要抽样加权，按 BSDF 抽样到光源时的权重因而保持不变。
+// 参考 Talbot et al., "Importance Resampling for Global Illumination", EGSR 2005
+QUALIFIER_D_H Vec3 EvaluateResampledLightPath(const IntegratorData *data,
+                                              const Hit &hit, const Vec3 &wo,
+                                              Sampler *sampler)
+{
+    constexpr float kOneMinusEpsilon = 1.0f - kEpsilonFloat * 0.5f;
+    const uint32_t num_candidate = data->info.ris_candidates;
+    float xi_select = sampler->Next1D(), weight_sum = 0;
+    LightSample selected = {};
+    for (uint32_t k = 0; k < num_candidate; ++k)
+    {
+        LightSample candidate;
+        if (!SampleLightPath(data, hit, wo, sampler, &candidate))
+            continue;
+        const float weight = LinearRgbToLuminance(candidate.L);
+        if (!(weight > 0.0f))
+            continue;
+
+        // 以 weight / weight_sum 的概率替换选中的候选点，复用重新映射后的随机数
+        weight_sum += weight;
+        const float ratio = weight / weight_sum;
+        if (xi_select < ratio)
+        {
+            selected = candidate;
+            xi_select = fminf(xi_select / ratio, kOneMinusEpsilon);
+        }
+        else
+        {
+            xi_select = fminf((xi_select - ratio) / (1.0f - ratio),
+                              kOneMinusEpsilon);
+        }
+    }
+    if (weight_sum <= 0.0f ||
+        !IsVisiblePath(data, selected, sampler->seed()))
+        return {0};
+
+    return selected.L * (weight_sum / (num_candidate *
+                                       LinearRgbToLuminance(selected.L)));
+}
+
+// 效率感知的俄罗斯轮盘赌的生存概率下限，避免生存的路径的通量过大
+constexpr float kMinSurvive = 0.05f;
+// 一个散射点最多分裂出的路径数量
+constexpr uint32_t kMaxSplit = 8;
+// 一条路径最多同时等待追踪的分支数量
+constexpr uint32_t kMaxPathBranch = 8;
+
+// 路径分裂得到的、尚待追踪的分支
+struct PathBranch
+{
+    Hit hit;
+    Bsdf *bsdf;
+    Vec3 wo;
+    Vec3 attenuation;
+    uint32_t depth;
+};
+
+// 决定路径是否继续追踪位于 position 的第 depth 个散射点，pixel 为像素的亮度估计。
+// 返回继续追踪的路径数量（不超过 max_split），为 0 时终止，大于 1 时分裂。
+// attenuation 相应地除以生存概率或乘以分裂数量的倒数，使结果符合应有的数学期望
+QUALIFIER_D_H uint32_t RouletteSplit(const IntegratorData *data,
+                                     const uint32_t depth, const float pixel,
+                                     const Vec3 &position,
+                                     const uint32_t max_split,
+                                     Sampler *sampler, Vec3 *attenuation)
+{
+    if (depth >= data->info.depth_max)
+        return 0;
+
+    if (pixel <= 0)
+    { // 固定概率的俄罗斯轮盘赌
+        if (depth < data->info.depth_rr)
+            return 1;
+        if (sampler->Next1D() >= data->info.pdf_rr)
+            return 0;
+        *attenuation *= data->pdf_rr_rcp;
+        return 1;
+    }
+
+    // 效率最优的路径数量 q，小于 1 时为生存概率，否则随机取整为相邻的整数，期望仍为 q
+    const uint32_t num_max = max_split < kMaxSplit ? max_split : kMaxSplit;
+    const float q = fminf(fmaxf(LinearRgbToLuminance(*attenuation) / pixel *
+                                    data->rrs->Factor(position),
+                                kMinSurvive),
+                          static_cast<float>(num_max));
+    if (q < 1.0f)
+    {
+        if (sampler->Next1D() >= q)
+            return 0;
+        *attenuation *= 1.0f / q;
+        return 1;
+    }
+    uint32_t num_split = static_cast<uint32_t>(q);
+    if (num_split < num_max && sampler->Next1D() < q - num_split)
+        ++num_split;
+    *attenuation *= 1.0f / q;
+    return num_split;
+}
+
+} // namespace
+
 namespace csrt
 {
 
 QUALIFIER_D_H Vec3 ShadePath(const IntegratorData *data, const Vec3 &eye,
-                             const Vec3 &look_dir, uint32_t *seed)
+                             const Vec3 &look_dir, Sampler *sampler,
+                             const float pixel, GuidingPath *path,
+                             RrsPath *rrs_path)
 {
     Vec3 L(0);
+    // 遍历加速结构时的透明度测试使用独立的伪随机数，不占用采样器的维度
+    uint32_t *seed = sampler->seed();
 
     //
     // 求取原初光线与场景的交点
@@ -53,185 +302,169 @@ QUALIFIER_D_H Vec3 ShadePath(const IntegratorData *data, const Vec3 &eye,
         }
     }
 
+    // 路径分裂得到的、尚待追踪的分支
+    PathBranch branches[kMaxPathBranch];
+    uint32_t num_branch = 0, depth = 1;
     Vec3 attenuation(1), wo = -look_dir;
-    for (uint32_t depth = 1;
-         depth < data->info.depth_rr || (depth < data->info.depth_max &&
-                                         RandomFloat(seed) < data->info.pdf_rr);
-         ++depth)
+    for (;;)
     {
-        // 按表面积进行抽样得到阴影光线，合并阴影光线贡献的直接光照
-        L += attenuation * EvaluateDirectLightPath(data, hit, wo, seed);
+        for (;;)
+        {
+            // 分支的深度都小于最大深度，只有原初光线的交点可能达到；最大深度为 1 时
+            // 只累积原初光线直接溯源至的光源的辐射亮度，不计算直接光照
+            if (depth >= data->info.depth_max)
+                break;
 
-        // 抽样次生光线光线
-        BsdfSampleRec rec = SampleRayPath(wo, hit, bsdf, seed);
-        if (!rec.valid)
-            break;
+            // 按表面积进行抽样得到阴影光线，合并阴影光线贡献的直接光照
+            L += attenuation * EvaluateDirectLightPath(data, hit, wo, sampler);
 
-        // 累积场景的反射率
-        attenuation *= rec.attenuation / rec.pdf;
-        if (fmaxf(fmaxf(attenuation.x, attenuation.y), attenuation.z) <
-            kEpsilon)
-            break;
+            // 抽样次生光线光线
+            BsdfSampleRec rec =
+                SampleRayPathGuided(data, wo, hit, bsdf, sampler);
+            if (!rec.valid)
+                break;
 
-        // 溯源光线
-        ray = Ray(rec.position, -rec.wi);
-        hit = data->tlas->Intersect(data->bsdfs, data->map_instance_bsdf, seed,
-                                    &ray);
+            // 累积场景的反射率
+            attenuation *= rec.attenuation / rec.pdf;
+            if (fmaxf(fmaxf(attenuation.x, attenuation.y), attenuation.z) <
+                kEpsilon)
+                break;
+            RecordGuidingVertex(rec, attenuation, L, bsdf, path);
+
+            // 溯源光线，记录当前着色点，用于计算按光源层次包围盒抽样到下一个交点的概率
+            const Vec3 position_pre = hit.position, normal_pre = hit.normal;
+            ray = Ray(rec.position, -rec.wi);
+            hit = data->tlas->Intersect(data->bsdfs, data->map_instance_bsdf,
+                                        seed, &ray);
+
+            if (!hit.valid)
+            { // 次生光线逃逸出场景
+                if (data->id_envmap != kInvalidId)
+                {
+                    const Vec3 radiance =
+                        data->emitters[data->id_envmap].Evaluate(-rec.wi);
+                    const float
+                        pdf_direct =
+                            data->emitters[data->id_envmap].Pdf(-rec.wi),
+                        weight_bsdf = MisWeight(rec.pdf, pdf_direct);
+                    L += weight_bsdf * attenuation * radiance;
+                }
+                break;
+            }
 
-        if (!hit.valid)
-        { // 次生光线逃逸出场景
-            if (data->id_envmap != kInvalidId)
+            bsdf = nullptr;
+            if (data->map_instance_bsdf[hit.id_instance] != kInvalidId)
+                bsdf = data->bsdfs + data->map_instance_bsdf[hit.id_instance];
+
+            if (bsdf != nullptr)
             {
-                const Vec3 radiance =
-                    data->emitters[data->id_envmap].Evaluate(-rec.wi);
-                const float pdf_direct =
-                                data->emitters[data->id_envmap].Pdf(-rec.wi),
-                            weight_bsdf = MisWeight(rec.pdf, pdf_direct);
-                L += weight_bsdf * attenuation * radiance;
+                if (hit.inside && !bsdf->IsTwosided())
+                { // 次生光线溯源至景物的背面，且景物的背面吸收一切光照
+                    break;
+                }
+                else if (bsdf->IsEmitter())
+                { // 原初光线溯源至光源，累积直接光照，并停止溯源
+                    const float cos_theta_prime = Dot(rec.wi, hit.normal);
+                    if (cos_theta_prime < kEpsilonFloat)
+                        break;
+                    const uint32_t id_light =
+                        data->num_emitter +
+                        data->map_id_instance_area_light[hit.id_instance];
+                    // 抽样光源时只会得到光源朝向着色点的一面
+                    float pdf_direct = 0;
+                    if (!hit.inside)
+                    {
+                        pdf_direct =
+                            data->light_bvh.Pdf(position_pre, normal_pre,
+                                                id_light) *
+                            data->instances[hit.id_instance].Pdf(position_pre,
+                                                                 hit);
+                    }
+                    const float weight_bsdf = MisWeight(rec.pdf, pdf_direct);
+                    // 场景中的面光源以类似漫反射的形式向各个方向均匀地发光
+                    const Vec3 radiance = bsdf->GetRadiance(hit.texcoord),
+                               L_dir = weight_bsdf * attenuation * radiance;
+                    L += L_dir;
+                    break;
+                }
             }
-            break;
-        }
-
-        bsdf = nullptr;
-        if (data->map_instance_bsdf[hit.id_instance] != kInvalidId)
-            bsdf = data->bsdfs + data->map_instance_bsdf[hit.id_instance];
 
-        if (bsdf != nullptr)
-        {
-            if (hit.inside && !bsdf->IsTwosided())
-            { // 次生光线溯源至景物的背面，且景物的背面吸收一切光照
-                break;
+            // 原初光线溯源至不发光的景物表面，被散射，决定是否终止或分裂路径
+            wo = rec.wi;
+            ++depth;
+            if (rrs_path != nullptr && rrs_path->num_vertex < kMaxRrsVertex)
+            {
+                rrs_path->vertices[rrs_path->num_vertex++] = {
+                    hit.position, LinearRgbToLuminance(attenuation),
+                    LinearRgbToLuminance(L), depth};
             }
-            else if (bsdf->IsEmitter())
-            { // 原初光线溯源至光源，累积直接光照，并停止溯源
-                const float cos_theta_prime = Dot(rec.wi, hit.normal);
-                if (cos_theta_prime < kEpsilonFloat)
-                    break;
-                const uint32_t id_instance_area_light =
-                    data->map_id_instance_area_light[hit.id_instance];
-                const float
-                    pdf_area =
-                        (data->cdf_area_light[id_instance_area_light + 1] -
-                         data->cdf_area_light[id_instance_area_light]) *
-                        data->list_pdf_area_instance[hit.id_instance],
-                    pdf_direct = pdf_area * Sqr(ray.t_max) / cos_theta_prime,
-                    weight_bsdf = MisWeight(rec.pdf, pdf_direct);
-                // 场景中的面光源以类似漫反射的形式向各个方向均匀地发光
-                const Vec3 radiance = bsdf->GetRadiance(hit.texcoord),
-                           L_dir = weight_bsdf * attenuation * radiance;
-                L += L_dir;
+            const uint32_t num_path =
+                RouletteSplit(data, depth, pixel, hit.position,
+                              kMaxPathBranch - num_branch + 1, sampler,
+                              &attenuation);
+            if (num_path == 0)
                 break;
-            }
+            for (uint32_t k = 1; k < num_path; ++k)
+                branches[num_branch++] = {hit, bsdf, wo, attenuation, depth};
         }
 
-        // 原初光线溯源至不发光的景物表面，被散射
-        wo = rec.wi;
-        if (depth >= data->info.depth_rr)
-        { // 根据俄罗斯轮盘赌算法的概率处理场景的反射率，使之符合应有的数学期望
-            attenuation *= data->pdf_rr_rcp;
-        }
+        // 当前路径终止，继续追踪下一个分支
+        if (num_branch == 0)
+            break;
+        const PathBranch &branch = branches[--num_branch];
+        hit = branch.hit;
+        bsdf = branch.bsdf;
+        wo = branch.wo;
+        attenuation = branch.attenuation;
+        depth = branch.depth;
     }
 
+    if (path != nullptr)
+        path->L = L;
+    if (rrs_path != nullptr)
+    {
+        rrs_path->depth = depth;
+        rrs_path->L = LinearRgbToLuminance(L);
+    }
     return L;
 }
 
 QUALIFIER_D_H Vec3 EvaluateDirectLightPath(const IntegratorData *data,
                                            const Hit &hit, const Vec3 &wo,
-                                           uint32_t *seed)
+                                           Sampler *sampler)
+{
+    Vec3 L = EvaluateInfiniteLightPath(data, hit, wo, sampler);
+    if (data->info.ris)
+        return L + EvaluateResampledLightPath(data, hit, wo, sampler);
+
+    // 根据光源层次包围盒抽样一个点光源、聚光灯或面光源
+    LightSample sample;
+    if (SampleLightPath(data, hit, wo, sampler, &sample) &&
+        IsVisiblePath(data, sample, sampler->seed()))
+        L += sample.L;
+    return L;
+}
+
+QUALIFIER_D_H Vec3 EvaluateInfiniteLightPath(const IntegratorData *data,
+                                             const Hit &hit, const Vec3 &wo,
+                                             Sampler *sampler)
 {
     Vec3 L(0);
+    uint32_t *seed = sampler->seed();
 
+    // 逐个抽样位于无穷远处的光源
     for (uint32_t i = 0; i < data->num_emitter; ++i)
     {
-        Emitter *emitter = data->emitters + i;
-
-        EmitterSampleRec rec =
-            emitter->Sample(hit.position, RandomFloat(seed), RandomFloat(seed));
-
-        // 光源与当前着色点之间不能被其它物体遮挡
-        Ray ray_test = {hit.position, -rec.wi};
-        ray_test.t_max = rec.distance - kEpsilonDistance;
-        if (data->tlas->IntersectAny(data->bsdfs, data->map_instance_bsdf, seed,
-                                     &ray_test))
-            continue;
-
-        if (Dot(-rec.wi, hit.normal) < kEpsilonFloat)
-            continue;
-
-        Bsdf *bsdf = nullptr;
-        if (data->map_instance_bsdf[hit.id_instance] != kInvalidId)
-            bsdf = data->bsdfs + data->map_instance_bsdf[hit.id_instance];
-
-        const BsdfSampleRec rec1 = EvaluateRayPath(rec.wi, wo, hit, bsdf);
-        if (!rec1.valid)
-            continue;
-
-        const Vec3 radiance = emitter->Evaluate(rec);
-        if (rec.harsh)
-        {
-            L += radiance * rec1.attenuation;
-        }
-        else
+        if (data->emitters[i].IsInfinite())
         {
-            const float pdf_direct = emitter->Pdf(-rec.wi);
-            if (pdf_direct > kEpsilonFloat)
-            {
-                const float weight_direct = MisWeight(pdf_direct, rec1.pdf);
-                L += weight_direct * radiance * (rec1.attenuation / pdf_direct);
-            }
+            const Vec2 xi = sampler->Next2D();
+            LightSample sample;
+            if (SampleEmitterPath(data, data->emitters[i], 1.0f, xi, hit, wo,
+                                  &sample) &&
+                IsVisiblePath(data, sample, seed))
+                L += sample.L;
         }
     }
-
-    if (data->num_area_light != 0)
-    {
-        // 抽样得到的面光源上一点
-        const uint32_t index_area_light =
-                           BinarySearch(data->size_cdf_area_light,
-                                        data->cdf_area_light,
-                                        RandomFloat(seed)) -
-                           1,
-                       id_area_light_instance =
-                           data->map_id_area_light_instance[index_area_light];
-        const Hit hit_pre = data->instances[id_area_light_instance].Sample(
-            RandomFloat(seed), RandomFloat(seed), RandomFloat(seed));
-
-        // 抽样点与当前着色点之间不能被其它物体遮挡
-        const Vec3 d_vec = hit.position - hit_pre.position;
-        const float distance = Length(d_vec);
-        Ray ray_test = {hit_pre.position, Normalize(d_vec)};
-        ray_test.t_max = distance - kEpsilonDistance;
-        if (data->tlas->IntersectAny(data->bsdfs, data->map_instance_bsdf, seed,
-                                     &ray_test))
-            return L;
-
-        const Vec3 wi = Normalize(d_vec);
-        const float cos_theta_prime = Dot(wi, hit_pre.normal);
-        if (cos_theta_prime < kEpsilonFloat)
-            return L;
-        if (Dot(-wi, hit.normal) < kEpsilonFloat)
-            return L;
-
-        Bsdf *bsdf = nullptr;
-        if (data->map_instance_bsdf[hit.id_instance] != kInvalidId)
-            bsdf = data->bsdfs + data->map_instance_bsdf[hit.id_instance];
-
-        const BsdfSampleRec rec = EvaluateRayPath(wi, wo, hit, bsdf);
-        if (!rec.valid)
-            return L;
-
-        // 根据多重重要抽样（MIS，multiple importance sampling）合并按表面积进行抽样得到的阴影光线贡献的直接光照
-        const float pdf_area =
-                        (data->cdf_area_light[index_area_light + 1] -
-                         data->cdf_area_light[index_area_light]) *
-                        data->list_pdf_area_instance[id_area_light_instance],
-                    pdf_direct = pdf_area * Sqr(distance) / cos_theta_prime,
-                    weight_direct = MisWeight(pdf_direct, rec.pdf);
-        Bsdf *bsdf_pre =
-            data->bsdfs + data->map_instance_bsdf[id_area_light_instance];
-        const Vec3 radiance = bsdf_pre->GetRadiance(hit_pre.texcoord);
-        L += weight_direct * radiance * (rec.attenuation / pdf_direct);
-    }
-
     return L;
 }
 
@@ -266,7 +499,7 @@ QUALIFIER_D_H BsdfSampleRec EvaluateRayPath(const Vec3 &wi, const Vec3 &wo,
 }
 
 QUALIFIER_D_H BsdfSampleRec SampleRayPath(const Vec3 &wo, const Hit &hit,
-                                          Bsdf *bsdf, uint32_t *seed)
+                                          Bsdf *bsdf, Sampler *sampler)
 {
     BsdfSampleRec rec;
     rec.wo = wo;
@@ -283,7 +516,7 @@ QUALIFIER_D_H BsdfSampleRec SampleRayPath(const Vec3 &wo, const Hit &hit,
             rec.inside = !rec.inside;
             rec.normal = -rec.normal;
         }
-        bsdf->Sample(seed, &rec);
+        bsdf->Sample(sampler, &rec);
     }
     else
     {
@@ -295,4 +528,70 @@ QUALIFIER_D_H BsdfSampleRec SampleRayPath(const Vec3 &wo, const Hit &hit,
     return rec;
 }
 
+QUALIFIER_D_H BsdfSampleRec SampleRayPathGuided(const IntegratorData *data,
+                                                const Vec3 &wo, const Hit &hit,
+                                                Bsdf *bsdf, Sampler *sampler)
+{
+    uint32_t id_root = kInvalidId;
+    if (data->guiding != nullptr && bsdf != nullptr && bsdf->IsGuidable())
+        id_root = data->guiding->Locate(hit.position);
+    if (id_root == kInvalidId)
+        return SampleRayPath(wo, hit, bsdf, sampler);
+
+    // 以 guiding_fraction 的概率按 SD-tree 抽样，否则按 BSDF 抽样，
+    // 两种情况都使用混合分布的概率密度，结果是无偏的
+    const float fraction = data->info.guiding_fraction,
+                xi_select = sampler->Next1D();
+    const Vec2 xi = sampler->Next2D();
+    if (xi_select < fraction)
+    {
+        float pdf_guiding = 0;
+        const Vec3 dir = data->guiding->Sample(id_root, xi, &pdf_guiding);
+        BsdfSampleRec rec = EvaluateRayPath(-dir, wo, hit, bsdf);
+        if (rec.valid)
+            rec.pdf = fraction * pdf_guiding + (1.0f - fraction) * rec.pdf;
+        return rec;
+    }
+    else
+    {
+        BsdfSampleRec rec = SampleRayPath(wo, hit, bsdf, sampler);
+        if (rec.valid)
+        {
+            rec.pdf = fraction * data->guiding->Pdf(id_root, -rec.wi) +
+                      (1.0f - fraction) * rec.pdf;
+        }
+        return rec;
+    }
+}
+
+QUALIFIER_D_H float PdfRayPathGuided(const IntegratorData *data,
+                                     const Vec3 &wi, const Hit &hit,
+                                     Bsdf *bsdf, const float pdf_bsdf)
+{
+    if (data->guiding == nullptr || bsdf == nullptr || !bsdf->IsGuidable())
+        return pdf_bsdf;
+    const uint32_t id_root = data->guiding->Locate(hit.position);
+    if (id_root == kInvalidId)
+        return pdf_bsdf;
+    const float fraction = data->info.guiding_fraction;
+    return fraction * data->guiding->Pdf(id_root, -wi) +
+           (1.0f - fraction) * pdf_bsdf;
+}
+
+QUALIFIER_D_H void RecordGuidingVertex(const BsdfSampleRec &rec,
+                                       const Vec3 &attenuation, const Vec3 &L,
+                                       Bsdf *bsdf, GuidingPath *path)
+{
+    if (path == nullptr || bsdf == nullptr || !bsdf->IsGuidable() ||
+        path->num_vertex >= kMaxGuidingVertex)
+        return;
+
+    GuidingVertex &vertex = path->vertices[path->num_vertex++];
+    vertex.position = rec.position;
+    vertex.dir = -rec.wi;
+    vertex.throughput = attenuation;
+    vertex.radiance = L;
+    vertex.pdf = rec.pdf;
+}
+
 } // namespace csrt
@@ -0,0 +1,253 @@
+#include "csrt/renderer/integrators/rrs_cache.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+using namespace csrt;
+
+// 盒式滤波的半径（像素）
+constexpr uint32_t kFilterRadius = 3;
+// 网格在包围盒最长的轴上的单元数量
+constexpr uint32_t kGridResolution = 32;
+// 记录辐射亮度平方所用定点数的缩放系数与上限
+constexpr double kMomentFixedScale = 65536.0;
+constexpr double kMaxMomentFixed = 0x1p40;
+// 记录的散射点少于该数量的网格单元改用所有单元的统计值
+constexpr uint32_t kMinCellCount = 8;
+// 像素亮度估计的下限（相对于平均值），避免预绘制的噪声使黑暗的像素分裂每条路径
+constexpr float kMinPixelRatio = 1.0f / 4.0f;
+
+QUALIFIER_D_H uint32_t LocateCell(const Vec3 &origin,
+                                  const float cell_size_rcp,
+                                  const uint32_t *resolution,
+                                  const Vec3 &position)
+{
+    uint32_t index[3];
+    for (int dim = 0; dim < 3; ++dim)
+    {
+        const float x = (position[dim] - origin[dim]) * cell_size_rcp;
+        index[dim] = x > 0.0f ? static_cast<uint32_t>(x) : 0;
+        if (index[dim] >= resolution[dim])
+            index[dim] = resolution[dim] - 1;
+    }
+    return (index[2] * resolution[1] + index[1]) * resolution[0] + index[0];
+}
+
+} // namespace
+
+namespace csrt
+{
+
+QUALIFIER_D_H RrsField::RrsField()
+    : num_pixel_(0), pixels_(nullptr), origin_{}, cell_size_rcp_(1),
+      resolution_{1, 1, 1}, factors_(nullptr)
+{
+}
+
+QUALIFIER_D_H RrsField::RrsField(const uint32_t num_pixel, const float *pixels,
+                                 const Vec3 &origin, const float cell_size,
+                                 const uint32_t *resolution,
+                                 const float *factors)
+    : num_pixel_(num_pixel), pixels_(pixels), origin_(origin),
+      cell_size_rcp_(1.0f / cell_size),
+      resolution_{resolution[0], resolution[1], resolution[2]},
+      factors_(factors)
+{
+}
+
+QUALIFIER_D_H float RrsField::Factor(const Vec3 &position) const
+{
+    return factors_[LocateCell(origin_, cell_size_rcp_, resolution_,
+                               position)];
+}
+
+RrsCache::RrsCache(const AABB &aabb)
+    : width_(0), height_(0), origin_{}, cell_size_(1), resolution_{1, 1, 1},
+      num_path_(0), cost_total_(0)
+{
+    const Vec3 extent = aabb.max() - aabb.min();
+    const float size = fmaxf(fmaxf(extent.x, extent.y), extent.z);
+    if (size > 0.0f)
+    { // 略微放大，使场景边界上的点也位于网格之内
+        cell_size_ = size * 1.001f / kGridResolution;
+        for (int dim = 0; dim < 3; ++dim)
+        {
+            resolution_[dim] = std::min(
+                kGridResolution,
+                static_cast<uint32_t>(std::ceil(extent[dim] / cell_size_)) +
+                    1);
+        }
+        origin_ = aabb.center() - 0.5f * cell_size_ *
+                                      Vec3(static_cast<float>(resolution_[0]),
+                                           static_cast<float>(resolution_[1]),
+                                           static_cast<float>(resolution_[2]));
+    }
+    const uint32_t num_cell = resolution_[0] * resolution_[1] * resolution_[2];
+    factors_.assign(num_cell, 0.0f);
+    moments_.reset(new std::atomic<uint64_t>[num_cell]);
+    costs_.reset(new std::atomic<uint64_t>[num_cell]);
+    counts_.reset(new std::atomic<uint32_t>[num_cell]);
+    Reset(0, 0);
+}
+
+void RrsCache::Reset(const uint32_t width, const uint32_t height)
+{
+    width_ = width;
+    height_ = height;
+    const uint64_t num_pixel = static_cast<uint64_t>(width) * height;
+    means_.assign(num_pixel, 0.0f);
+    variances_.assign(num_pixel, 0.0f);
+    pixels_.assign(num_pixel, 0.0f);
+    for (size_t i = 0; i < factors_.size(); ++i)
+    {
+        moments_[i].store(0, std::memory_order_relaxed);
+        costs_[i].store(0, std::memory_order_relaxed);
+        counts_[i].store(0, std::memory_order_relaxed);
+    }
+    num_path_.store(0, std::memory_order_relaxed);
+    cost_total_.store(0, std::memory_order_relaxed);
+    field_ = RrsField(0, nullptr, origin_, cell_size_, resolution_,
+                      factors_.data());
+}
+
+uint32_t RrsCache::LocateCell(const Vec3 &position) const
+{
+    return ::LocateCell(origin_, 1.0f / cell_size_, resolution_, position);
+}
+
+void RrsCache::Record(const RrsPath &path)
+{
+    num_path_.fetch_add(1, std::memory_order_relaxed);
+    cost_total_.fetch_add(path.depth, std::memory_order_relaxed);
+    for (uint32_t i = 0; i < path.num_vertex; ++i)
+    {
+        const RrsVertex &vertex = path.vertices[i];
+        if (vertex.throughput <= 0.0f)
+            continue;
+
+        // 该散射点之后的路径贡献的辐射亮度，除以路径通量即为从该散射点继续追踪得到的
+        // 辐射亮度，代价为此后的散射点数量（含该散射点）
+        const double radiance =
+                         static_cast<double>(path.L - vertex.radiance) /
+                         vertex.throughput,
+                     moment = std::min(
+                         radiance * radiance * kMomentFixedScale,
+                         kMaxMomentFixed);
+        const uint32_t id_cell = LocateCell(vertex.position);
+        moments_[id_cell].fetch_add(static_cast<uint64_t>(moment + 0.5),
+                                    std::memory_order_relaxed);
+        costs_[id_cell].fetch_add(path.depth - vertex.depth + 1,
+                                  std::memory_order_relaxed);
+        counts_[id_cell].fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void RrsCache::Build(const uint32_t x_begin, const uint32_t y_begin,
+                     const uint32_t x_end, const uint32_t y_end)
+{
+    if (x_begin >= x_end || y_begin >= y_end)
+        return;
+
+    // 先按行、再按列求窗口内的平均值，窗口超出区域的部分不计入
+    std::vector<float> temp(means_.size(), 0.0f);
+    for (uint32_t j = y_begin; j < y_end; ++j)
+    {
+        const uint64_t offset = static_cast<uint64_t>(j) * width_;
+        const float *src = means_.data() + offset;
+        float *dst = temp.data() + offset;
+        for (uint32_t i = x_begin; i < x_end; ++i)
+        {
+            const uint32_t first = std::max(i, x_begin + kFilterRadius) -
+                                   kFilterRadius,
+                           last = std::min(i + kFilterRadius + 1, x_end);
+            float sum = 0;
+            for (uint32_t k = first; k < last; ++k)
+                sum += src[k];
+            dst[i] = sum / (last - first);
+        }
+    }
+
+    double mean = 0;
+    for (uint32_t j = y_begin; j < y_end; ++j)
+    {
+        const uint32_t first = std::max(j, y_begin + kFilterRadius) -
+                               kFilterRadius,
+                       last = std::min(j + kFilterRadius + 1, y_end);
+        for (uint32_t i = x_begin; i < x_end; ++i)
+        {
+            float sum = 0;
+            for (uint32_t k = first; k < last; ++k)
+                sum += temp[static_cast<uint64_t>(k) * width_ + i];
+            const float value = sum / (last - first);
+            pixels_[static_cast<uint64_t>(j) * width_ + i] = value;
+            mean += value;
+        }
+    }
+    const double num_pixel =
+        static_cast<double>(x_end - x_begin) * (y_end - y_begin);
+    mean /= num_pixel;
+
+    // 每个样本的平均相对方差，以滤波后的亮度为基准
+    const float pixel_min = static_cast<float>(mean) * kMinPixelRatio;
+    double variance = 0;
+    for (uint32_t j = y_begin; j < y_end; ++j)
+    {
+        const uint64_t offset = static_cast<uint64_t>(j) * width_;
+        for (uint32_t i = x_begin; i < x_end; ++i)
+        {
+            float &pixel = pixels_[offset + i];
+            pixel = std::max(pixel, pixel_min);
+            variance += variances_[offset + i] / (pixel * pixel);
+        }
+    }
+    variance /= num_pixel;
+    const uint64_t num_path = num_path_.load(std::memory_order_relaxed);
+    if (!(mean > 0) || !(variance > 0) || num_path == 0)
+    {
+        std::fill(pixels_.begin(), pixels_.end(), 0.0f);
+        return;
+    }
+    const double cost = static_cast<double>(cost_total_.load(
+                            std::memory_order_relaxed)) /
+                        num_path;
+
+    // 记录的散射点过少的网格单元使用所有单元的统计值
+    uint64_t moment_total = 0, cost_vertex_total = 0, count_total = 0;
+    for (size_t i = 0; i < factors_.size(); ++i)
+    {
+        moment_total += moments_[i].load(std::memory_order_relaxed);
+        cost_vertex_total += costs_[i].load(std::memory_order_relaxed);
+        count_total += counts_[i].load(std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < factors_.size(); ++i)
+    {
+        uint64_t moment_cell = moments_[i].load(std::memory_order_relaxed),
+                 cost_cell = costs_[i].load(std::memory_order_relaxed),
+                 count = counts_[i].load(std::memory_order_relaxed);
+        if (count < kMinCellCount)
+        {
+            moment_cell = moment_total;
+            cost_cell = cost_vertex_total;
+            count = count_total;
+        }
+        if (count == 0 || cost_cell == 0)
+        { // 没有路径抵达第二个散射点，不会用到系数
+            factors_[i] = 0.0f;
+            continue;
+        }
+        const double moment_mean =
+                         static_cast<double>(moment_cell) /
+                         kMomentFixedScale / count,
+                     cost_mean = static_cast<double>(cost_cell) / count;
+        factors_[i] = static_cast<float>(
+            std::sqrt(moment_mean / cost_mean * cost / variance));
+    }
+
+    field_ = RrsField(static_cast<uint32_t>(pixels_.size()), pixels_.data(),
+                      origin_, cell_size_, resolution_, factors_.data());
+}
+
+} // namespace csrt
\ No newline at end of file
@@ -0,0 +1,399 @@
+#include "csrt/renderer/integrators/sd_tree.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+using namespace csrt;
+
+// 记录辐射亮度所用定点数的缩放系数
+constexpr double kGuidingFixedScale = 16777216.0;
+// 空间叶节点一轮每个像素 1 个样本时记录的散射点数量超过该值即对半划分，
+// 阈值随每个像素的样本数量的平方根增长
+constexpr double kSTreeThreshold = 12000.0;
+constexpr uint32_t kMaxSTreeDepth = 48;
+// 象限的辐射亮度超过整个方向四叉树的该比例时进一步划分
+constexpr float kDTreeThreshold = 0.01f;
+constexpr uint32_t kMaxDTreeDepth = 20;
+constexpr float kOneMinusEpsilon = 0x1.fffffep-1f;
+
+QUALIFIER_D_H Vec2 DirToCanonical(const Vec3 &dir)
+{
+    const float cos_theta = fminf(fmaxf(dir.z, -1.0f), 1.0f);
+    float phi = atan2f(dir.y, dir.x) * k1Div2Pi;
+    if (phi < 0.0f)
+        phi += 1.0f;
+    return {fminf((cos_theta + 1.0f) * 0.5f, kOneMinusEpsilon),
+            fminf(phi, kOneMinusEpsilon)};
+}
+
+QUALIFIER_D_H Vec3 CanonicalToDir(const Vec2 &p)
+{
+    const float cos_theta = 2.0f * p.u - 1.0f,
+                sin_theta = sqrtf(fmaxf(1.0f - cos_theta * cos_theta, 0.0f)),
+                phi = k2Pi * p.v;
+    return {sin_theta * cosf(phi), sin_theta * sinf(phi), cos_theta};
+}
+
+// 位置所在的空间叶节点 ID，包围立方体之外的位置视为在最近的叶节点中
+QUALIFIER_D_H uint32_t LocateSTree(const STreeNode *nodes, const Vec3 &origin,
+                                   const float size, const Vec3 &position)
+{
+    Vec3 p = (position - origin) / size;
+    for (int axis = 0; axis < 3; ++axis)
+        p[axis] = fminf(fmaxf(p[axis], 0.0f), kOneMinusEpsilon);
+
+    uint32_t id = 0, depth = 0;
+    while (nodes[id].child != 0)
+    {
+        const int axis = depth % 3;
+        p[axis] *= 2.0f;
+        if (p[axis] < 1.0f)
+        {
+            id = nodes[id].child;
+        }
+        else
+        {
+            p[axis] -= 1.0f;
+            id = nodes[id].child + 1;
+        }
+        ++depth;
+    }
+    return id;
+}
+
+// 将 build 中以 id 为根的方向四叉树连同学到的辐射亮度复制到 learned 的末尾，
+// 返回复制后的根节点 ID
+uint32_t CopyLearned(const std::vector<DTreeNode> &build,
+                     const std::atomic<uint64_t> *sums, const uint32_t id,
+                     std::vector<DTreeNode> *learned)
+{
+    const uint32_t id_new = static_cast<uint32_t>(learned->size());
+    learned->push_back({});
+    for (int c = 0; c < 4; ++c)
+    {
+        (*learned)[id_new].sum[c] = static_cast<float>(
+            sums[id * 4 + c].load(std::memory_order_relaxed) /
+            kGuidingFixedScale);
+    }
+    for (int c = 0; c < 4; ++c)
+    {
+        if (build[id].child[c] != 0)
+        {
+            const uint32_t id_child =
+                CopyLearned(build, sums, build[id].child[c], learned);
+            (*learned)[id_new].child[c] = id_child;
+        }
+    }
+    return id_new;
+}
+
+// 划分节点 id_node 中辐射亮度超过阈值的象限。sum 为各象限的辐射亮度，
+// 取自学到的节点 id_learned；学到的方向四叉树在此没有划分时，假设辐射亮度均匀分布
+void RefineDTree(const std::vector<DTreeNode> &learned,
+                 const uint32_t id_learned, const float *sum,
+                 const float total, const uint32_t depth,
+                 const uint32_t id_node, std::vector<DTreeNode> *nodes)
+{
+    if (depth >= kMaxDTreeDepth)
+        return;
+
+    for (int c = 0; c < 4; ++c)
+    {
+        if (sum[c] <= kDTreeThreshold * total)
+            continue;
+
+        uint32_t id_learned_child = kInvalidId;
+        float sum_child[4] = {sum[c] * 0.25f, sum[c] * 0.25f, sum[c] * 0.25f,
+                              sum[c] * 0.25f};
+        if (id_learned != kInvalidId && learned[id_learned].child[c] != 0)
+        {
+            id_learned_child = learned[id_learned].child[c];
+            std::copy(learned[id_learned_child].sum,
+                      learned[id_learned_child].sum + 4, sum_child);
+        }
+
+        const uint32_t id_child = static_cast<uint32_t>(nodes->size());
+        nodes->push_back({});
+        (*nodes)[id_node].child[c] = id_child;
+        RefineDTree(learned, id_learned_child, sum_child, total, depth + 1,
+                    id_child, nodes);
+    }
+}
+
+} // namespace
+
+namespace csrt
+{
+
+QUALIFIER_D_H GuidingField::GuidingField()
+    : origin_{}, size_(1), s_nodes_(nullptr), d_nodes_(nullptr)
+{
+}
+
+QUALIFIER_D_H GuidingField::GuidingField(const Vec3 &origin, const float size,
+                                         const STreeNode *s_nodes,
+                                         const DTreeNode *d_nodes)
+    : origin_(origin), size_(size), s_nodes_(s_nodes), d_nodes_(d_nodes)
+{
+}
+
+QUALIFIER_D_H uint32_t GuidingField::Locate(const Vec3 &position) const
+{
+    if (s_nodes_ == nullptr)
+        return kInvalidId;
+    return s_nodes_[LocateSTree(s_nodes_, origin_, size_, position)].id_root;
+}
+
+QUALIFIER_D_H Vec3 GuidingField::Sample(const uint32_t id_root,
+                                        const Vec2 &xi, float *pdf) const
+{
+    Vec2 u = xi, origin = {0, 0};
+    float size = 1, pdf_square = 1;
+    uint32_t id = id_root;
+    while (true)
+    {
+        const float *sum = d_nodes_[id].sum,
+                    total = sum[0] + sum[1] + sum[2] + sum[3];
+
+        // 先按左右两半的辐射亮度选择 u 方向，再在选中的一半中选择 v 方向
+        const float pdf_right = (sum[1] + sum[3]) / total;
+        int x = 0;
+        if (u.u < 1.0f - pdf_right)
+        {
+            u.u = fminf(u.u / (1.0f - pdf_right), kOneMinusEpsilon);
+        }
+        else
+        {
+            x = 1;
+            u.u = fminf((u.u - (1.0f - pdf_right)) / pdf_right,
+                        kOneMinusEpsilon);
+        }
+        const float pdf_top = sum[x + 2] / (sum[x] + sum[x + 2]);
+        int y = 0;
+        if (u.v < 1.0f - pdf_top)
+        {
+            u.v = fminf(u.v / (1.0f - pdf_top), kOneMinusEpsilon);
+        }
+        else
+        {
+            y = 1;
+            u.v = fminf((u.v - (1.0f - pdf_top)) / pdf_top, kOneMinusEpsilon);
+        }
+
+        const int c = x + 2 * y;
+        pdf_square *= 4.0f * sum[c] / total;
+        size *= 0.5f;
+        origin.u += x * size;
+        origin.v += y * size;
+        if (d_nodes_[id].child[c] == 0)
+            break;
+        id = d_nodes_[id].child[c];
+    }
+
+    *pdf = pdf_square * k1Div4Pi;
+    return CanonicalToDir({origin.u + u.u * size, origin.v + u.v * size});
+}
+
+QUALIFIER_D_H float GuidingField::Pdf(const uint32_t id_root,
+                                      const Vec3 &dir) const
+{
+    Vec2 p = DirToCanonical(dir);
+    float pdf_square = 1;
+    uint32_t id = id_root;
+    while (true)
+    {
+        const float *sum = d_nodes_[id].sum,
+                    total = sum[0] + sum[1] + sum[2] + sum[3];
+        p.u *= 2.0f;
+        p.v *= 2.0f;
+        const int x = p.u >= 1.0f, y = p.v >= 1.0f, c = x + 2 * y;
+        p.u -= x;
+        p.v -= y;
+        pdf_square *= 4.0f * sum[c] / total;
+        if (pdf_square <= 0.0f || d_nodes_[id].child[c] == 0)
+            break;
+        id = d_nodes_[id].child[c];
+    }
+    return pdf_square * k1Div4Pi;
+}
+
+SdTree::SdTree(const AABB &aabb) : origin_{}, size_(1)
+{
+    const Vec3 extent = aabb.max() - aabb.min();
+    const float size = fmaxf(fmaxf(extent.x, extent.y), extent.z);
+    if (size > 0.0f)
+    { // 略微放大，使场景边界上的点也位于立方体之内
+        size_ = size * 1.001f;
+        origin_ = aabb.center() - Vec3(size_ * 0.5f);
+    }
+    Reset();
+}
+
+void SdTree::Reset()
+{
+    s_nodes_ = {STreeNode()};
+    sample_nodes_.clear();
+    build_nodes_ = {DTreeNode()};
+    build_roots_ = {0};
+    build_sums_.reset(new std::atomic<uint64_t>[4]);
+    for (int c = 0; c < 4; ++c)
+        build_sums_[c].store(0, std::memory_order_relaxed);
+    counts_.reset(new std::atomic<uint32_t>[1]);
+    counts_[0].store(0, std::memory_order_relaxed);
+    field_ = GuidingField(origin_, size_, s_nodes_.data(), nullptr);
+}
+
+uint32_t SdTree::LocateLeaf(const Vec3 &position) const
+{
+    return LocateSTree(s_nodes_.data(), origin_, size_, position);
+}
+
+void SdTree::Record(const GuidingPath &path)
+{
+    for (uint32_t i = 0; i < path.num_vertex; ++i)
+    {
+        const GuidingVertex &vertex = path.vertices[i];
+        const uint32_t id_leaf = LocateLeaf(vertex.position);
+        counts_[id_leaf].fetch_add(1, std::memory_order_relaxed);
+        if (vertex.pdf <= 0.0f)
+            continue;
+
+        // 该散射点之后的路径贡献的辐射亮度，除以路径通量即为沿抽样方向的入射辐射亮度
+        Vec3 radiance_in = {};
+        for (int channel = 0; channel < 3; ++channel)
+        {
+            if (vertex.throughput[channel] > 0.0f)
+            {
+                radiance_in[channel] =
+                    (path.L[channel] - vertex.radiance[channel]) /
+                    vertex.throughput[channel];
+            }
+        }
+        const double value = static_cast<double>(LinearRgbToLuminance(
+                                 radiance_in)) /
+                             vertex.pdf * kGuidingFixedScale;
+        if (!(value >= 1.0) || value > 0x1p40)
+            continue;
+        const uint64_t fixed = static_cast<uint64_t>(value + 0.5);
+
+        Vec2 p = DirToCanonical(vertex.dir);
+        uint32_t id = build_roots_[id_leaf];
+        while (true)
+        {
+            p.u *= 2.0f;
+            p.v *= 2.0f;
+            const int x = p.u >= 1.0f, y = p.v >= 1.0f, c = x + 2 * y;
+            p.u -= x;
+            p.v -= y;
+            build_sums_[id * 4 + c].fetch_add(fixed,
+                                              std::memory_order_relaxed);
+            if (build_nodes_[id].child[c] == 0)
+                break;
+            id = build_nodes_[id].child[c];
+        }
+    }
+}
+
+void SdTree::Update(const uint32_t spp)
+{
+    //
+    // 学到的辐射亮度成为下一轮抽样所用的方向四叉树
+    //
+    std::vector<DTreeNode> learned;
+    std::vector<uint32_t> learned_roots(s_nodes_.size(), kInvalidId);
+    for (size_t i = 0; i < s_nodes_.size(); ++i)
+    {
+        if (s_nodes_[i].child != 0)
+            continue;
+        const uint32_t id_root = build_roots_[i];
+        uint64_t total = 0;
+        for (int c = 0; c < 4; ++c)
+            total += build_sums_[id_root * 4 + c].load(
+                std::memory_order_relaxed);
+        if (total > 0)
+        {
+            learned_roots[i] =
+                CopyLearned(build_nodes_, build_sums_.get(), id_root, &learned);
+        }
+    }
+
+    //
+    // 记录的散射点过多的空间叶节点对半划分，假设散射点在其中均匀分布，
+    // 子节点沿用父节点学到的方向四叉树
+    //
+    struct Entry
+    {
+        uint32_t id;
+        uint32_t depth;
+        double count;
+    };
+    const double threshold =
+        kSTreeThreshold * std::sqrt(static_cast<double>(spp));
+    std::vector<Entry> stack = {
+        {0, 0, static_cast<double>(counts_[0].load())}};
+    while (!stack.empty())
+    {
+        const Entry entry = stack.back();
+        stack.pop_back();
+        const uint32_t id_child = s_nodes_[entry.id].child;
+        if (id_child != 0)
+        {
+            for (uint32_t k = 0; k < 2; ++k)
+            {
+                stack.push_back(
+                    {id_child + k, entry.depth + 1,
+                     static_cast<double>(counts_[id_child + k].load())});
+            }
+            continue;
+        }
+        if (entry.count <= threshold || entry.depth >= kMaxSTreeDepth)
+            continue;
+
+        const uint32_t id_new = static_cast<uint32_t>(s_nodes_.size());
+        s_nodes_[entry.id].child = id_new;
+        for (uint32_t k = 0; k < 2; ++k)
+        {
+            s_nodes_.push_back(STreeNode());
+            learned_roots.push_back(learned_roots[entry.id]);
+            stack.push_back({id_new + k, entry.depth + 1, entry.count * 0.5});
+        }
+    }
+
+    //
+    // 按学到的辐射亮度细分下一轮学习的方向四叉树
+    //
+    sample_nodes_ = std::move(learned);
+    build_nodes_.clear();
+    build_roots_.assign(s_nodes_.size(), 0);
+    for (size_t i = 0; i < s_nodes_.size(); ++i)
+    {
+        s_nodes_[i].id_root = kInvalidId;
+        if (s_nodes_[i].child != 0)
+            continue;
+        s_nodes_[i].id_root = learned_roots[i];
+
+        const uint32_t id_node = static_cast<uint32_t>(build_nodes_.size());
+        build_roots_[i] = id_node;
+        build_nodes_.push_back({});
+        if (learned_roots[i] == kInvalidId)
+            continue;
+        const float *sum = sample_nodes_[learned_roots[i]].sum;
+        RefineDTree(sample_nodes_, learned_roots[i], sum,
+                    sum[0] + sum[1] + sum[2] + sum[3], 1, id_node,
+                    &build_nodes_);
+    }
+
+    build_sums_.reset(new std::atomic<uint64_t>[build_nodes_.size() * 4]);
+    for (size_t i = 0; i < build_nodes_.size() * 4; ++i)
+        build_sums_[i].store(0, std::memory_order_relaxed);
+    counts_.reset(new std::atomic<uint32_t>[s_nodes_.size()]);
+    for (size_t i = 0; i < s_nodes_.size(); ++i)
+        counts_[i].store(0, std::memory_order_relaxed);
+    field_ = GuidingField(origin_, size_, s_nodes_.data(),
+                          sample_nodes_.data());
+}
+
+} // namespace csrt
\ No newline at end of file
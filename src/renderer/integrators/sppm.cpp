@@ -0,0 +1,905 @@
+#include "csrt/renderer/integrators/sppm.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "csrt/renderer/film.hpp"
+#include "csrt/renderer/integrators/integrator.hpp"
+
+namespace
+{
+
+using namespace csrt;
+
+// 自动选取初始半径时，半径相当于场景包围球的半径除以图像较长边的像素数量的倍数
+constexpr float kRadiusPixelRatio = 5.0f;
+// 哈希网格的节点数量相对于像素数量的倍数。网格单元的边长不小于可见点半径的两倍，
+// 每个可见点至多覆盖 8 个网格单元
+constexpr uint32_t kNodePerPixel = 8;
+// 网格单元的整数坐标在键中所占的位数，以及使之非负的偏移量
+constexpr uint32_t kCellBits = 21;
+constexpr int64_t kCellOffset = int64_t(1) << (kCellBits - 1);
+// 记录光子通量所用定点数的初始缩放系数与单个光子的上限。累加的是未除以光子数量的通量，
+// 定点数的精度因而与每一轮的光子数量无关；超出上限时缩小缩放系数，见 CheckFluxRange
+constexpr double kFluxFixedScale = 16777216.0;
+constexpr double kMaxFluxFixed = 0x1p40;
+// 写入胶片的辐射亮度之和的上限，避免定点数溢出
+constexpr double kMaxFilmValue = 0x1p22;
+
+QUALIFIER_D_H Bsdf *GetBsdf(const IntegratorData *data, const Hit &hit)
+{
+    if (data->map_instance_bsdf[hit.id_instance] == kInvalidId)
+        return nullptr;
+    return data->bsdfs + data->map_instance_bsdf[hit.id_instance];
+}
+
+// 沿 dir 传播、与景物表面相交于 hit 的光线途经的参与介质，没有时为空
+QUALIFIER_D_H Medium *GetMedium(const IntegratorData *data, const Hit &hit,
+                                const Vec3 &dir)
+{
+    const bool inside = Dot(-dir, hit.normal) > 0 ? hit.inside : !hit.inside;
+    const uint32_t id_medium = inside ? hit.id_medium_int : hit.id_medium_ext;
+    if (id_medium == kInvalidId)
+        return nullptr;
+    return data->media + id_medium;
+}
+
+// 散射点对从方向 wi 入射、传播了 distance 的光照的响应，hit 不为空时散射点位于景物表面，
+// 否则位于参与介质 medium_phase 之中。medium 为入射光照途经的参与介质，
+// 只计入透射率而不除以抽样的概率，直接光照来自阴影光线而不是距离抽样
+bool EvaluateScatterSppm(const Hit *hit, Bsdf *bsdf, Medium *medium_phase,
+                         Medium *medium, const Vec3 &wi, const Vec3 &wo,
+                         const float distance, Vec3 *attenuation, float *pdf)
+{
+    if (hit != nullptr && Dot(-wi, hit->normal) < kEpsilonFloat)
+        return false;
+
+    Vec3 transmittance = {1.0f};
+    if (medium != nullptr)
+    {
+        MediumSampleRec medium_rec;
+        medium_rec.distance = distance;
+        medium->Evaluate(&medium_rec);
+        if (!medium_rec.valid)
+            return false;
+        transmittance = medium_rec.attenuation;
+    }
+
+    if (hit != nullptr)
+    {
+        const BsdfSampleRec rec = EvaluateRayPath(wi, wo, *hit, bsdf);
+        if (!rec.valid)
+            return false;
+        *attenuation = transmittance * rec.attenuation;
+        *pdf = rec.pdf;
+    }
+    else
+    {
+        PhaseSampleRec phase_rec;
+        phase_rec.wi = wi;
+        phase_rec.wo = wo;
+        medium_phase->EvaluatePhase(&phase_rec);
+        if (!phase_rec.valid)
+            return false;
+        *attenuation = transmittance * phase_rec.attenuation;
+        *pdf = phase_rec.pdf;
+    }
+    return true;
+}
+
+// 逐个抽样位于无穷远处的光源，并根据光源层次包围盒抽样一个点光源、聚光灯或面光源，
+// 返回阴影光线贡献的直接光照。mis 为假时散射点之后不再按 BSDF 抽样次生光线，阴影光线的权重为 1
+Vec3 SampleDirectLightSppm(const IntegratorData *data, const Vec3 &position,
+                           const Vec3 &normal, const Hit *hit, Bsdf *bsdf,
+                           Medium *medium_phase, Medium *medium,
+                           const Vec3 &wo, const bool mis, Sampler *sampler)
+{
+    Vec3 L(0);
+    uint32_t *seed = sampler->seed();
+
+    // 位于无穷远处的光源
+    for (uint32_t i = 0; i < data->num_emitter; ++i)
+    {
+        const Emitter &emitter = data->emitters[i];
+        if (!emitter.IsInfinite())
+            continue;
+        const Vec2 xi = sampler->Next2D();
+        const EmitterSampleRec rec = emitter.Sample(position, xi.u, xi.v);
+        if (!rec.valid)
+            continue;
+        Ray ray_test = {position, -rec.wi};
+        ray_test.t_max = rec.distance - kEpsilonDistance;
+        if (data->tlas->IntersectAny(data->bsdfs, data->map_instance_bsdf,
+                                     seed, &ray_test))
+            continue;
+        Vec3 attenuation;
+        float pdf_scatter = 0;
+        if (!EvaluateScatterSppm(hit, bsdf, medium_phase, medium, rec.wi, wo,
+                                 rec.distance, &attenuation, &pdf_scatter))
+            continue;
+        const Vec3 radiance = emitter.Evaluate(rec);
+        if (rec.harsh)
+        {
+            L += radiance * attenuation;
+            continue;
+        }
+        const float pdf_direct = emitter.Pdf(-rec.wi);
+        if (pdf_direct <= kEpsilonFloat)
+            continue;
+        const float weight = mis ? MisWeight(pdf_direct, pdf_scatter) : 1.0f;
+        L += weight * radiance * attenuation / pdf_direct;
+    }
+
+    // 根据光源层次包围盒抽样一个点光源、聚光灯或面光源
+    const float xi_light = sampler->Next1D(), xi_0 = sampler->Next1D();
+    const Vec2 xi = sampler->Next2D();
+    float pdf_light = 0;
+    const uint32_t id_light =
+        data->light_bvh.Sample(position, normal, xi_light, &pdf_light);
+    if (id_light == kInvalidId || pdf_light <= 0.0f)
+        return L;
+
+    if (id_light < data->num_emitter)
+    {
+        const Emitter &emitter = data->emitters[id_light];
+        const EmitterSampleRec rec = emitter.Sample(position, xi.u, xi.v);
+        if (!rec.valid)
+            return L;
+        Ray ray_test = {position, -rec.wi};
+        ray_test.t_max = rec.distance - kEpsilonDistance;
+        if (data->tlas->IntersectAny(data->bsdfs, data->map_instance_bsdf,
+                                     seed, &ray_test))
+            return L;
+        Vec3 attenuation;
+        float pdf_scatter = 0;
+        if (!EvaluateScatterSppm(hit, bsdf, medium_phase, medium, rec.wi, wo,
+                                 rec.distance, &attenuation, &pdf_scatter))
+            return L;
+        const Vec3 radiance = emitter.Evaluate(rec);
+        if (rec.harsh)
+            return L + radiance * attenuation / pdf_light;
+        const float pdf_direct = pdf_light * emitter.Pdf(-rec.wi);
+        if (pdf_direct <= kEpsilonFloat)
+            return L;
+        const float weight = mis ? MisWeight(pdf_direct, pdf_scatter) : 1.0f;
+        return L + weight * radiance * attenuation / pdf_direct;
+    }
+
+    const uint32_t id_instance =
+        data->map_id_area_light_instance[id_light - data->num_emitter];
+    float pdf_area = 0;
+    const Hit hit_pre = data->instances[id_instance].Sample(
+        position, xi_0, xi.u, xi.v, &pdf_area);
+    if (!hit_pre.valid || pdf_area <= 0.0f)
+        return L;
+
+    const Vec3 d_vec = position - hit_pre.position;
+    const float distance = Length(d_vec);
+    const Vec3 wi = d_vec / distance;
+    Ray ray_test = {hit_pre.position, wi};
+    ray_test.t_max = distance - kEpsilonDistance;
+    if (data->tlas->IntersectAny(data->bsdfs, data->map_instance_bsdf, seed,
+                                 &ray_test))
+        return L;
+    if (Dot(wi, hit_pre.normal) < kEpsilonFloat)
+        return L;
+
+    Vec3 attenuation;
+    float pdf_scatter = 0;
+    if (!EvaluateScatterSppm(hit, bsdf, medium_phase, medium, wi, wo, distance,
+                             &attenuation, &pdf_scatter))
+        return L;
+    const float pdf_direct = pdf_light * pdf_area,
+                weight = mis ? MisWeight(pdf_direct, pdf_scatter) : 1.0f;
+    Bsdf *bsdf_pre = data->bsdfs + data->map_instance_bsdf[id_instance];
+    return L + weight * (bsdf_pre->GetRadiance(hit_pre.texcoord) *
+                         attenuation / pdf_direct);
+}
+
+// 追踪相机路径：在光泽与镜面表面按 BSDF 抽样次生光线，并按多重重要抽样合并阴影光线与
+// 次生光线贡献的直接光照；到达漫反射表面或在参与介质中散射时记录可见点并停止追踪。
+// 返回路径贡献的直接光照（含可见点处由阴影光线贡献的直接光照）
+Vec3 TraceCameraPath(const IntegratorData *data, const Vec3 &eye,
+                     const Vec3 &look_dir, Sampler *sampler,
+                     SppmVisiblePoint *vp)
+{
+    Vec3 L(0), beta(1);
+    uint32_t *seed = sampler->seed();
+    vp->valid = false;
+    if (data->tlas == nullptr)
+        return L;
+
+    Ray ray = {eye, look_dir};
+    // 上一个散射点按 BSDF 抽样次生光线的概率密度与位置，用于合并直接光照。
+    // 原初光线、以及穿过没有 BSDF 的表面之后，阴影光线不可能抵达同一个光源，不需合并
+    float pdf_sample = 0;
+    bool mis = false;
+    Vec3 position_pre = {}, normal_pre = {};
+    // 光线发生散射之后所在的参与介质
+    Medium *medium_scatter = nullptr;
+    uint32_t depth = 0;
+    for (;;)
+    {
+        const Hit hit = data->tlas->Intersect(
+            data->bsdfs, data->map_instance_bsdf, seed, &ray);
+
+        // 处理参与介质的影响
+        Medium *medium = medium_scatter;
+        if (medium == nullptr && hit.valid)
+            medium = GetMedium(data, hit, ray.dir);
+        medium_scatter = nullptr;
+        if (medium != nullptr)
+        {
+            MediumSampleRec medium_rec;
+            medium->Sample(ray.t_max, sampler, &medium_rec);
+            if (medium_rec.valid)
+            {
+                beta *= medium_rec.attenuation / medium_rec.pdf;
+                if (medium_rec.scattered)
+                { // 光线在参与介质中散射，记录可见点
+                    const Vec3 position =
+                        ray.origin + ray.dir * medium_rec.distance;
+                    L += beta * SampleDirectLightSppm(
+                                    data, position, {}, nullptr, nullptr,
+                                    medium, medium, -ray.dir, false, sampler);
+                    vp->valid = true;
+                    vp->hit = Hit();
+                    vp->hit.position = position;
+                    vp->bsdf = nullptr;
+                    vp->medium = medium;
+                    vp->wo = -ray.dir;
+                    vp->beta = beta;
+                    return L;
+                }
+            }
+        }
+
+        if (!hit.valid)
+        { // 光线逃逸出场景
+            if (data->id_envmap != kInvalidId)
+            {
+                const Emitter &envmap = data->emitters[data->id_envmap];
+                const float weight =
+                    mis ? MisWeight(pdf_sample, envmap.Pdf(ray.dir)) : 1.0f;
+                L += weight * beta * envmap.Evaluate(ray.dir);
+            }
+            if (depth == 0 && data->id_sun != kInvalidId)
+                L += beta * data->emitters[data->id_sun].Evaluate(ray.dir);
+            return L;
+        }
+
+        Bsdf *bsdf = GetBsdf(data, hit);
+        if (bsdf == nullptr)
+        { // 穿过参与介质的边界
+            mis = false;
+            ray = Ray(hit.position, ray.dir);
+            continue;
+        }
+        if (hit.inside && !bsdf->IsTwosided())
+        { // 光线溯源至景物的背面，且景物的背面吸收一切光照
+            return L;
+        }
+        if (bsdf->IsEmitter())
+        { // 光线溯源至光源，累积直接光照，并停止溯源
+            if (depth == 0 && data->info.hide_emitters)
+                return L;
+            if (depth > 0 && Dot(ray.dir, hit.normal) > -kEpsilonFloat)
+                return L;
+            float weight = 1;
+            if (mis)
+            { // 抽样光源时只会得到光源朝向散射点的一面
+                float pdf_direct = 0;
+                if (!hit.inside)
+                {
+                    const uint32_t id_light =
+                        data->num_emitter +
+                        data->map_id_instance_area_light[hit.id_instance];
+                    pdf_direct =
+                        data->light_bvh.Pdf(position_pre, normal_pre,
+                                            id_light) *
+                        data->instances[hit.id_instance].Pdf(position_pre,
+                                                             hit);
+                }
+                weight = MisWeight(pdf_sample, pdf_direct);
+            }
+            return L + weight * beta * bsdf->GetRadiance(hit.texcoord);
+        }
+
+        const Vec3 wo = -ray.dir;
+        Medium *medium_light = GetMedium(data, hit, ray.dir);
+        if (bsdf->IsDiffuse())
+        { // 到达漫反射表面，记录可见点
+            L += beta * SampleDirectLightSppm(data, hit.position, hit.normal,
+                                              &hit, bsdf, nullptr,
+                                              medium_light, wo, false,
+                                              sampler);
+            vp->valid = true;
+            vp->hit = hit;
+            vp->bsdf = bsdf;
+            vp->medium = nullptr;
+            vp->wo = wo;
+            vp->beta = beta;
+            return L;
+        }
+
+        // 光泽与镜面表面，达到最大深度时终止，否则根据俄罗斯轮盘赌算法决定是否继续追踪
+        ++depth;
+        if (depth >= data->info.depth_max)
+            return L;
+        if (depth >= data->info.depth_rr)
+        {
+            if (sampler->Next1D() >= data->info.pdf_rr)
+                return L;
+            beta *= data->pdf_rr_rcp;
+        }
+
+        L += beta * SampleDirectLightSppm(data, hit.position, hit.normal, &hit,
+                                          bsdf, nullptr, medium_light, wo,
+                                          true, sampler);
+        const BsdfSampleRec rec = SampleRayPath(wo, hit, bsdf, sampler);
+        if (!rec.valid)
+            return L;
+        beta *= rec.attenuation / rec.pdf;
+        if (fmaxf(fmaxf(beta.x, beta.y), beta.z) < kEpsilon)
+            return L;
+        pdf_sample = rec.pdf;
+        mis = true;
+        position_pre = hit.position;
+        normal_pre = hit.normal;
+        ray = Ray(rec.position, -rec.wi);
+    }
+}
+
+QUALIFIER_D_H int64_t LocateCell(const float x, const float cell_size_rcp)
+{
+    return static_cast<int64_t>(std::floor(x * cell_size_rcp));
+}
+
+QUALIFIER_D_H uint64_t GetCellKey(const int64_t x, const int64_t y,
+                                  const int64_t z)
+{
+    constexpr uint64_t mask = (uint64_t(1) << kCellBits) - 1;
+    return (static_cast<uint64_t>(x + kCellOffset) & mask) |
+           ((static_cast<uint64_t>(y + kCellOffset) & mask) << kCellBits) |
+           ((static_cast<uint64_t>(z + kCellOffset) & mask)
+            << (2 * kCellBits));
+}
+
+// 键对应的桶，先混合各位，使相邻的网格单元分散到不同的桶中
+QUALIFIER_D_H uint32_t GetBucket(uint64_t key, const uint32_t num_bucket)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ull;
+    key ^= key >> 33;
+    return static_cast<uint32_t>(key % num_bucket);
+}
+
+// 以 scale 为缩放系数把 value 累加到定点数 dst 上。超出单个光子的上限时不累加，
+// 而是把 value 记入 flux_max（正浮点数的位模式与数值同序，按整数取最大值）
+void AddFlux(const float value, const double scale,
+             std::atomic<uint32_t> *flux_max, std::atomic<uint64_t> *dst)
+{
+    if (!std::isfinite(value))
+        return;
+    const double fixed = static_cast<double>(value) * scale;
+    if (fixed > kMaxFluxFixed)
+    {
+        uint32_t bits = 0;
+        std::memcpy(&bits, &value, sizeof(bits));
+        uint32_t current = flux_max->load(std::memory_order_relaxed);
+        while (current < bits &&
+               !flux_max->compare_exchange_weak(current, bits,
+                                                std::memory_order_relaxed))
+        {
+        }
+    }
+    else if (fixed > 0.0)
+    {
+        dst->fetch_add(static_cast<uint64_t>(fixed + 0.5),
+                       std::memory_order_relaxed);
+    }
+}
+
+// 按 Hachisuka 与 Jensen 的方法缩小半径：保留 alpha 比例的新光子，
+// 半径按光子密度不变的原则缩小，dim 为估计光子密度的维数
+void UpdateEstimate(const float alpha, const float dim, const uint32_t m,
+                    const Vec3 &flux, float *radius, float *count, Vec3 *tau)
+{
+    const float count_next = *count + alpha * m,
+                ratio = count_next / (*count + m);
+    *radius *= std::pow(ratio, 1.0f / dim);
+    *count = count_next;
+    *tau = (*tau + flux) * ratio;
+}
+
+} // namespace
+
+namespace csrt
+{
+
+Sppm::Sppm(const AABB &aabb, const std::vector<uint32_t> &infinite_lights,
+           const bool has_finite_light, const uint32_t num_photon,
+           const float radius, const float alpha)
+    : infinite_lights_(infinite_lights), has_finite_light_(has_finite_light),
+      num_photon_(num_photon), radius_init_(radius), alpha_(alpha),
+      center_(aabb.center()), radius_scene_(0), width_(0), height_(0),
+      flux_scale_(kFluxFixedScale), flux_max_(0), cell_size_(1),
+      node_count_(0)
+{
+    // 略微放大，使场景边界上的点也位于包围球之内
+    radius_scene_ = 0.5f * Length(aabb.max() - aabb.min()) * 1.01f;
+    if (!(radius_scene_ > 0.0f))
+        radius_scene_ = 1.0f;
+    Reset(0, 0);
+}
+
+void Sppm::Reset(const uint32_t width, const uint32_t height)
+{
+    width_ = width;
+    height_ = height;
+    const uint32_t num_pixel = width * height;
+    float radius = radius_init_;
+    if (radius <= 0.0f)
+    {
+        radius = kRadiusPixelRatio * radius_scene_ /
+                 static_cast<float>(std::max(1u, std::max(width, height)));
+    }
+
+    pixels_.assign(num_pixel, SppmPixel());
+    for (SppmPixel &pixel : pixels_)
+    {
+        pixel.radius_surface = radius;
+        pixel.radius_volume = radius;
+    }
+    counts_.reset(new std::atomic<uint32_t>[num_pixel]);
+    fluxes_.reset(new std::atomic<uint64_t>[num_pixel * 3]);
+    heads_.reset(new std::atomic<uint32_t>[num_pixel]);
+    for (uint32_t i = 0; i < num_pixel; ++i)
+    {
+        counts_[i].store(0, std::memory_order_relaxed);
+        for (int channel = 0; channel < 3; ++channel)
+            fluxes_[i * 3 + channel].store(0, std::memory_order_relaxed);
+        heads_[i].store(kInvalidId, std::memory_order_relaxed);
+    }
+    nodes_.assign(static_cast<size_t>(num_pixel) * kNodePerPixel, {});
+    node_count_.store(0, std::memory_order_relaxed);
+    cell_size_ = 2.0f * radius;
+    flux_scale_ = kFluxFixedScale;
+    flux_max_.store(0, std::memory_order_relaxed);
+}
+
+void Sppm::BeginIteration()
+{
+    for (size_t i = 0; i < pixels_.size(); ++i)
+        heads_[i].store(kInvalidId, std::memory_order_relaxed);
+    node_count_.store(0, std::memory_order_relaxed);
+}
+
+void Sppm::TraceCamera(const IntegratorData *data, const uint32_t id_pixel,
+                       const Vec3 &eye, const Vec3 &look_dir, Sampler *sampler)
+{
+    SppmPixel &pixel = pixels_[id_pixel];
+    counts_[id_pixel].store(0, std::memory_order_relaxed);
+    for (int channel = 0; channel < 3; ++channel)
+        fluxes_[id_pixel * 3 + channel].store(0, std::memory_order_relaxed);
+
+    Vec3 L = TraceCameraPath(data, eye, look_dir, sampler, &pixel.vp);
+    for (int channel = 0; channel < 3; ++channel)
+    { // 与其它积分器一致，每个样本的辐射亮度截断至 1
+        pixel.vp.ld[channel] =
+            std::isfinite(L[channel])
+                ? std::min(std::max(L[channel], 0.0f), 1.0f)
+                : 0.0f;
+    }
+
+    if (pixel.vp.valid)
+    {
+        const Vec3 &beta = pixel.vp.beta;
+        if (!(fmaxf(fmaxf(beta.x, beta.y), beta.z) > 0.0f))
+            pixel.vp.valid = false;
+        else
+            Insert(id_pixel);
+    }
+}
+
+void Sppm::Insert(const uint32_t id_pixel)
+{
+    const SppmVisiblePoint &vp = pixels_[id_pixel].vp;
+    const float radius = vp.medium != nullptr
+                             ? pixels_[id_pixel].radius_volume
+                             : pixels_[id_pixel].radius_surface,
+                cell_size_rcp = 1.0f / cell_size_;
+    int64_t first[3], last[3];
+    for (int dim = 0; dim < 3; ++dim)
+    {
+        first[dim] = LocateCell(vp.hit.position[dim] - radius, cell_size_rcp);
+        last[dim] = LocateCell(vp.hit.position[dim] + radius, cell_size_rcp);
+    }
+
+    const uint32_t num_bucket = static_cast<uint32_t>(pixels_.size());
+    for (int64_t z = first[2]; z <= last[2]; ++z)
+    {
+        for (int64_t y = first[1]; y <= last[1]; ++y)
+        {
+            for (int64_t x = first[0]; x <= last[0]; ++x)
+            {
+                const uint32_t id_node =
+                    node_count_.fetch_add(1, std::memory_order_relaxed);
+                if (id_node >= nodes_.size())
+                    return;
+                GridNode &node = nodes_[id_node];
+                node.key = GetCellKey(x, y, z);
+                node.id_pixel = id_pixel;
+                node.next = heads_[GetBucket(node.key, num_bucket)].exchange(
+                    id_node, std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+void Sppm::TracePhoton(const IntegratorData *data, Sampler *sampler)
+{
+    uint32_t *seed = sampler->seed();
+    const float xi_group = sampler->Next1D(), xi_light = sampler->Next1D(),
+                xi_0 = sampler->Next1D();
+    const Vec2 xi = sampler->Next2D(), xi_dir = sampler->Next2D();
+    if (data->tlas == nullptr || pixels_.empty())
+        return;
+
+    // 位于无穷远处的光源各自为一组，其余光源为一组，等概率地选择一组
+    const uint32_t num_infinite = static_cast<uint32_t>(infinite_lights_.size()),
+                   num_group = num_infinite + (has_finite_light_ ? 1 : 0);
+    if (num_group == 0)
+        return;
+    const uint32_t id_group = std::min(
+        static_cast<uint32_t>(xi_group * num_group), num_group - 1);
+
+    Vec3 position, dir, beta;
+    if (id_group < num_infinite)
+    { // 从垂直于光线方向、覆盖整个场景的圆盘上均匀地发出平行光线
+        const Emitter &emitter = data->emitters[infinite_lights_[id_group]];
+        const EmitterSampleRec rec = emitter.Sample(center_, xi.u, xi.v);
+        if (!rec.valid)
+            return;
+        const float pdf_dir = rec.harsh ? 1.0f : emitter.Pdf(-rec.wi);
+        if (pdf_dir <= 0.0f)
+            return;
+        dir = rec.wi;
+        // LocalToWorld 会把结果归一化，先求圆盘上的方向，再乘以到圆心的距离
+        const float r = sqrtf(xi_dir.u), phi = k2Pi * xi_dir.v;
+        position = center_ +
+                   radius_scene_ *
+                       (r * LocalToWorld({cosf(phi), sinf(phi), 0.0f}, dir) -
+                        dir);
+        beta = emitter.Evaluate(rec) * (kPi * Sqr(radius_scene_) / pdf_dir);
+    }
+    else
+    { // 按功率抽样点光源、聚光灯或面光源
+        float pdf_light = 0;
+        const uint32_t id_light =
+            data->light_bvh.SamplePower(xi_light, &pdf_light);
+        if (id_light == kInvalidId || pdf_light == 0.0f)
+            return;
+
+        float pdf_dir = 0;
+        if (id_light < data->num_emitter)
+        {
+            const Emitter &emitter = data->emitters[id_light];
+            position =
+                emitter.SampleEmission(xi_dir.u, xi_dir.v, &dir, &pdf_dir);
+            if (pdf_dir <= 0.0f)
+                return;
+            // 单位距离处的辐射强度
+            const EmitterSampleRec rec = {true, true, 1.0f, dir};
+            beta = emitter.Evaluate(rec) / (pdf_light * pdf_dir);
+        }
+        else
+        {
+            const uint32_t id_instance =
+                data->map_id_area_light_instance[id_light - data->num_emitter];
+            Hit hit = data->instances[id_instance].Sample(xi_0, xi.u, xi.v);
+            if (!hit.valid)
+                return;
+            hit.id_instance = id_instance;
+            Bsdf *bsdf = GetBsdf(data, hit);
+
+            // 两面都发光时，复用随机数等概率地选择发光的一面
+            Vec3 normal = hit.normal;
+            float xi_cos = xi_dir.u, pdf_side = 1;
+            if (bsdf->IsTwosided())
+            {
+                pdf_side = 0.5f;
+                if (xi_cos < 0.5f)
+                {
+                    xi_cos = 2.0f * xi_cos;
+                }
+                else
+                {
+                    xi_cos = 2.0f * xi_cos - 1.0f;
+                    normal = -normal;
+                }
+            }
+            Vec3 dir_local;
+            SampleHemisCos(xi_cos, xi_dir.v, &dir_local, &pdf_dir);
+            pdf_dir *= pdf_side;
+            if (pdf_dir <= 0.0f)
+                return;
+            dir = LocalToWorld(dir_local, normal);
+            position = hit.position;
+
+            const float pdf_area = data->list_pdf_area_instance[id_instance];
+            beta = bsdf->GetRadiance(hit.texcoord) * dir_local.z /
+                   (pdf_light * pdf_area * pdf_dir);
+        }
+    }
+    // 光子的通量在更新像素时才除以每一轮的光子数量
+    beta *= static_cast<float>(num_group);
+
+    // 追踪光子。光源直接照亮的表面与参与介质由相机路径上的阴影光线负责，
+    // 光子只有在散射过、或者穿过没有 BSDF 的表面之后才累加到可见点上
+    bool interacted = false;
+    Medium *medium_scatter = nullptr;
+    for (uint32_t depth = 1;; ++depth)
+    {
+        Ray ray = {position, dir};
+        const Hit hit = data->tlas->Intersect(
+            data->bsdfs, data->map_instance_bsdf, seed, &ray);
+
+        // 处理参与介质的影响
+        Medium *medium = medium_scatter;
+        if (medium == nullptr && hit.valid)
+            medium = GetMedium(data, hit, dir);
+        medium_scatter = nullptr;
+        bool scattered = false;
+        if (medium != nullptr)
+        {
+            MediumSampleRec medium_rec;
+            medium->Sample(ray.t_max, sampler, &medium_rec);
+            if (medium_rec.valid)
+            {
+                if (medium_rec.scattered)
+                {
+                    scattered = true;
+                    position = ray.origin + dir * medium_rec.distance;
+                    if (interacted)
+                    { // 按透射率计入光子，散射系数由可见点的路径通量计入
+                        MediumSampleRec rec_transmittance;
+                        rec_transmittance.distance = medium_rec.distance;
+                        medium->Evaluate(&rec_transmittance);
+                        if (rec_transmittance.valid)
+                        {
+                            Deposit(position, medium, dir,
+                                    beta * rec_transmittance.attenuation /
+                                        medium_rec.pdf);
+                        }
+                    }
+                }
+                beta *= medium_rec.attenuation / medium_rec.pdf;
+            }
+        }
+
+        if (scattered)
+        {
+            interacted = true;
+            if (depth >= data->info.depth_max)
+                break;
+            if (depth >= data->info.depth_rr)
+            {
+                if (sampler->Next1D() >= data->info.pdf_rr)
+                    break;
+                beta *= data->pdf_rr_rcp;
+            }
+
+            PhaseSampleRec phase_rec;
+            phase_rec.wo = -dir;
+            medium->SamplePhase(sampler, &phase_rec);
+            if (!phase_rec.valid)
+                break;
+            beta *= phase_rec.attenuation / phase_rec.pdf;
+            if (fmaxf(fmaxf(beta.x, beta.y), beta.z) <= 0.0f)
+                break;
+            dir = -phase_rec.wi;
+            medium_scatter = medium;
+            continue;
+        }
+
+        if (!hit.valid)
+            break;
+        Bsdf *bsdf = GetBsdf(data, hit);
+        if (bsdf == nullptr)
+        { // 穿过参与介质的边界，阴影光线不能穿过这样的表面
+            interacted = true;
+            position = hit.position;
+            continue;
+        }
+        if ((hit.inside && !bsdf->IsTwosided()) || bsdf->IsEmitter())
+        { // 光子抵达景物的背面且景物的背面吸收一切光照，或者抵达其它光源
+            break;
+        }
+
+        if (interacted && bsdf->IsDiffuse())
+            Deposit(hit.position, nullptr, dir, beta);
+        interacted = true;
+
+        if (depth >= data->info.depth_max)
+            break;
+        if (depth >= data->info.depth_rr)
+        {
+            if (sampler->Next1D() >= data->info.pdf_rr)
+                break;
+            beta *= data->pdf_rr_rcp;
+        }
+
+        // 按 BSDF 抽样光子的出射方向，光子沿 dir 到达当前交点，之后沿 dir_next 离开
+        const Vec3 wo = -dir;
+        const BsdfSampleRec rec = SampleRayPath(wo, hit, bsdf, sampler);
+        if (!rec.valid)
+            break;
+        const Vec3 dir_next = -rec.wi;
+        const BsdfSampleRec rec_adjoint =
+            EvaluateRayPath(dir, dir_next, hit, bsdf);
+        const float cos_theta_in = fabsf(Dot(hit.normal, wo));
+        if (!rec_adjoint.valid || cos_theta_in < kEpsilonFloat)
+            break;
+        beta *= rec_adjoint.attenuation *
+                (fabsf(Dot(hit.normal, dir_next)) / (cos_theta_in * rec.pdf));
+        if (fmaxf(fmaxf(beta.x, beta.y), beta.z) <= 0.0f)
+            break;
+
+        position = hit.position;
+        dir = dir_next;
+    }
+}
+
+void Sppm::Deposit(const Vec3 &position, const Medium *medium,
+                   const Vec3 &dir, const Vec3 &beta)
+{
+    const float cell_size_rcp = 1.0f / cell_size_;
+    const uint64_t key =
+        GetCellKey(LocateCell(position.x, cell_size_rcp),
+                   LocateCell(position.y, cell_size_rcp),
+                   LocateCell(position.z, cell_size_rcp));
+    const uint32_t num_bucket = static_cast<uint32_t>(pixels_.size());
+    for (uint32_t id_node = heads_[GetBucket(key, num_bucket)].load(
+             std::memory_order_relaxed);
+         id_node != kInvalidId; id_node = nodes_[id_node].next)
+    {
+        const GridNode &node = nodes_[id_node];
+        if (node.key != key)
+            continue;
+        const SppmPixel &pixel = pixels_[node.id_pixel];
+        const SppmVisiblePoint &vp = pixel.vp;
+        if ((vp.medium != nullptr) != (medium != nullptr))
+            continue;
+        const float radius = vp.medium != nullptr ? pixel.radius_volume
+                                                  : pixel.radius_surface;
+        const Vec3 d_vec = position - vp.hit.position;
+        if (Dot(d_vec, d_vec) > radius * radius)
+            continue;
+
+        Vec3 flux;
+        if (vp.medium == nullptr)
+        { // 可见点处的 BSDF，不含余弦项
+            const BsdfSampleRec rec =
+                EvaluateRayPath(dir, vp.wo, vp.hit, vp.bsdf);
+            const float cos_theta = fabsf(Dot(vp.hit.normal, dir));
+            if (!rec.valid || cos_theta < kEpsilonFloat)
+                continue;
+            flux = beta * rec.attenuation / cos_theta;
+        }
+        else
+        {
+            PhaseSampleRec phase_rec;
+            phase_rec.wi = dir;
+            phase_rec.wo = vp.wo;
+            vp.medium->EvaluatePhase(&phase_rec);
+            if (!phase_rec.valid)
+                continue;
+            flux = beta * phase_rec.attenuation;
+        }
+
+        counts_[node.id_pixel].fetch_add(1, std::memory_order_relaxed);
+        for (int channel = 0; channel < 3; ++channel)
+        {
+            AddFlux(flux[channel], flux_scale_, &flux_max_,
+                    &fluxes_[node.id_pixel * 3 + channel]);
+        }
+    }
+}
+
+bool Sppm::CheckFluxRange()
+{
+    const uint32_t bits = flux_max_.exchange(0, std::memory_order_relaxed);
+    if (bits == 0)
+        return true;
+
+    // 缩放系数缩小为原来的 2 的整数次幂分之一，使本轮最大的通量恰好不超出上限
+    float value = 0;
+    std::memcpy(&value, &bits, sizeof(value));
+    int exponent = 0;
+    std::frexp(static_cast<double>(value) * flux_scale_ / kMaxFluxFixed,
+               &exponent);
+    flux_scale_ = std::ldexp(flux_scale_, -exponent);
+    fprintf(stderr,
+            "\n[info] photon flux exceeds the fixed-point range, retrace the "
+            "photons of this pass with scale 2^%d.\n",
+            std::ilogb(flux_scale_));
+
+    const size_t num_pixel = pixels_.size();
+    for (size_t i = 0; i < num_pixel; ++i)
+    {
+        counts_[i].store(0, std::memory_order_relaxed);
+        for (int channel = 0; channel < 3; ++channel)
+            fluxes_[i * 3 + channel].store(0, std::memory_order_relaxed);
+    }
+    return false;
+}
+
+void Sppm::Update(const uint32_t id_pixel, uint64_t *sum)
+{
+    SppmPixel &pixel = pixels_[id_pixel];
+    const uint32_t m = counts_[id_pixel].load(std::memory_order_relaxed);
+    if (pixel.vp.valid && m > 0)
+    {
+        Vec3 flux;
+        for (int channel = 0; channel < 3; ++channel)
+        {
+            flux[channel] = static_cast<float>(
+                fluxes_[id_pixel * 3 + channel].load(
+                    std::memory_order_relaxed) /
+                flux_scale_);
+        }
+        flux *= pixel.vp.beta / static_cast<float>(num_photon_);
+        if (pixel.vp.medium != nullptr)
+        {
+            UpdateEstimate(alpha_, 3.0f, m, flux, &pixel.radius_volume,
+                           &pixel.count_volume, &pixel.tau_volume);
+        }
+        else
+        {
+            UpdateEstimate(alpha_, 2.0f, m, flux, &pixel.radius_surface,
+                           &pixel.count_surface, &pixel.tau_surface);
+        }
+    }
+
+    for (int channel = 0; channel < 3; ++channel)
+    {
+        pixel.ld[channel] += static_cast<uint64_t>(
+            static_cast<double>(pixel.vp.ld[channel]) * kFilmFixedScale + 0.5);
+    }
+
+    // tau 中光子的通量已经除以每一轮的光子数量，除以面积或体积即为各轮间接光照之和
+    const Vec3 L =
+        pixel.tau_surface / (kPi * Sqr(pixel.radius_surface)) +
+        pixel.tau_volume /
+            (4.0f / 3.0f * kPi * pixel.radius_volume * Sqr(pixel.radius_volume));
+    for (int channel = 0; channel < 3; ++channel)
+    {
+        const double value =
+            std::isfinite(L[channel])
+                ? std::min(std::max(static_cast<double>(L[channel]), 0.0),
+                           kMaxFilmValue)
+                : 0.0;
+        sum[channel] =
+            pixel.ld[channel] +
+            static_cast<uint64_t>(value * kFilmFixedScale + 0.5);
+    }
+}
+
+void Sppm::EndIteration()
+{
+    float radius_max = 0;
+    for (const SppmPixel &pixel : pixels_)
+    {
+        radius_max = std::max(radius_max, std::max(pixel.radius_surface,
+                                                   pixel.radius_volume));
+    }
+    if (radius_max > 0.0f)
+        cell_size_ = 2.0f * radius_max;
+}
+
+} // namespace csrt
\ No newline at end of file
@@ -2,13 +2,197 @@
 
 #include "csrt/renderer/integrators/integrator.hpp"
 
+namespace
+{
+
+using namespace csrt;
+
+// 散射点对从方向 wi 入射、传播了 distance 的光照的响应，hit 不为空时散射点位于景物表面，
+// 否则位于参与介质 medium_hit 之中。medium 为入射光照途经的参与介质
+QUALIFIER_D_H bool EvaluateScatterVolPath(const IntegratorData *data,
+                                          const Hit *hit,
+                                          const MediumHit *medium_hit,
+                                          Medium *medium, const Vec3 &wi,
+                                          const Vec3 &wo, const float distance,
+                                          Vec3 *attenuation, float *pdf)
+{
+    if (hit != nullptr && Dot(-wi, hit->normal) < kEpsilonFloat)
+        return false;
+
+    Vec3 medium_attenuation = {1.0f};
+    if (medium != nullptr)
+    {
+        MediumSampleRec medium_rec;
+        medium_rec.distance = distance;
+        medium->Evaluate(&medium_rec);
+        if (!medium_rec.valid)
+            return false;
+        medium_attenuation = medium_rec.attenuation / medium_rec.pdf;
+    }
+
+    if (hit != nullptr)
+    {
+        Bsdf *bsdf = nullptr;
+        if (data->map_instance_bsdf[hit->id_instance] != kInvalidId)
+            bsdf = data->bsdfs + data->map_instance_bsdf[hit->id_instance];
+
+        const BsdfSampleRec rec = EvaluateRayPath(wi, wo, *hit, bsdf);
+        if (!rec.valid)
+            return false;
+        *attenuation = medium_attenuation * rec.attenuation;
+        *pdf = PdfRayPathGuided(data, wi, *hit, bsdf, rec.pdf);
+    }
+    else
+    {
+        PhaseSampleRec phase_rec;
+        phase_rec.wi = wi;
+        phase_rec.wo = wo;
+        medium_hit->medium->EvaluatePhase(&phase_rec);
+        if (!phase_rec.valid)
+            return false;
+        *attenuation = medium_attenuation * phase_rec.attenuation;
+        *pdf = phase_rec.pdf;
+    }
+    return true;
+}
+
+// 抽样光源 emitter 得到阴影光线，返回其贡献的直接光照，pdf_light 为选中该光源的概率
+QUALIFIER_D_H Vec3 EvaluateEmitterVolPath(
+    const IntegratorData *data, const Emitter &emitter, const float pdf_light,
+    const Vec2 &xi, const Vec3 &position, const Hit *hit,
+    const MediumHit *medium_hit, Medium *medium, const Vec3 &wo, uint32_t *seed)
+{
+    const EmitterSampleRec rec = emitter.Sample(position, xi.u, xi.v);
+    if (!rec.valid)
+        return {0};
+
+    // 光源与当前散射点之间不能被其它物体遮挡
+    Ray ray_test = {position, -rec.wi};
+    ray_test.t_max = rec.distance - kEpsilonDistance;
+    if (data->tlas->IntersectAny(data->bsdfs, data->map_instance_bsdf, seed,
+                                 &ray_test))
+        return {0};
+
+    Vec3 attenuation;
+    float pdf_scatter = 0;
+    if (!EvaluateScatterVolPath(data, hit, medium_hit, medium, rec.wi, wo,
+                                rec.distance, &attenuation, &pdf_scatter))
+        return {0};
+
+    const Vec3 radiance = emitter.Evaluate(rec);
+    if (rec.harsh)
+        return radiance * attenuation / pdf_light;
+
+    const float pdf_direct = pdf_light * emitter.Pdf(-rec.wi);
+    if (pdf_direct <= kEpsilonFloat)
+        return {0};
+    const float weight_direct = MisWeight(pdf_direct, pdf_scatter);
+    return weight_direct * radiance * attenuation / pdf_direct;
+}
+
+// 按表面积抽样面光源 index_area_light 上的一点得到阴影光线，返回其贡献的直接光照，
+// pdf_light 为选中该面光源的概率
+QUALIFIER_D_H Vec3 EvaluateAreaLightVolPath(
+    const IntegratorData *data, const uint32_t index_area_light,
+    const float pdf_light, const float xi_0, const Vec2 &xi,
+    const Vec3 &position, const Hit *hit, const MediumHit *medium_hit,
+    Medium *medium, const Vec3 &wo, uint32_t *seed)
+{
+    const uint32_t id_area_light_instance =
+        data->map_id_area_light_instance[index_area_light];
+    float pdf_area_light = 0;
+    const Hit hit_pre = data->instances[id_area_light_instance].Sample(
+        position, xi_0, xi.u, xi.v, &pdf_area_light);
+    if (!hit_pre.valid || pdf_area_light <= 0.0f)
+        return {0};
+
+    // 抽样点与当前散射点之间不能被其它物体遮挡
+    const Vec3 d_vec = position - hit_pre.position;
+    const float distance = Length(d_vec);
+    Ray ray_test = {hit_pre.position, Normalize(d_vec)};
+    ray_test.t_max = distance - kEpsilonDistance;
+    if (data->tlas->IntersectAny(data->bsdfs, data->map_instance_bsdf, seed,
+                                 &ray_test))
+        return {0};
+
+    const Vec3 wi = Normalize(d_vec);
+    const float cos_theta_prime = Dot(wi, hit_pre.normal);
+    if (cos_theta_prime < kEpsilonFloat)
+        return {0};
+
+    Vec3 attenuation;
+    float pdf_scatter = 0;
+    if (!EvaluateScatterVolPath(data, hit, medium_hit, medium, wi, wo,
+                                distance, &attenuation, &pdf_scatter))
+        return {0};
+
+    // 根据多重重要抽样（MIS，multiple importance sampling）合并抽样面光源得到的阴影光线贡献的直接光照
+    const float pdf_direct = pdf_light * pdf_area_light,
+                weight_direct = MisWeight(pdf_direct, pdf_scatter);
+    Bsdf *bsdf_pre =
+        data->bsdfs + data->map_instance_bsdf[id_area_light_instance];
+    const Vec3 radiance = bsdf_pre->GetRadiance(hit_pre.texcoord);
+    return weight_direct * (radiance * attenuation / pdf_direct);
+}
+
+// 逐个抽样位于无穷远处的光源，并根据光源层次包围盒抽样一个点光源、聚光灯或面光源，
+// 返回阴影光线贡献的直接光照。normal 为零向量时散射点位于参与介质之中
+QUALIFIER_D_H Vec3 SampleDirectLightVolPath(const IntegratorData *data,
+                                            const Vec3 &position,
+                                            const Vec3 &normal, const Hit *hit,
+                                            const MediumHit *medium_hit,
+                                            Medium *medium, const Vec3 &wo,
+                                            Sampler *sampler)
+{
+    Vec3 L(0);
+    uint32_t *seed = sampler->seed();
+
+    for (uint32_t i = 0; i < data->num_emitter; ++i)
+    {
+        if (data->emitters[i].IsInfinite())
+        {
+            const Vec2 xi = sampler->Next2D();
+            L += EvaluateEmitterVolPath(data, data->emitters[i], 1.0f, xi,
+                                        position, hit, medium_hit, medium, wo,
+                                        seed);
+        }
+    }
+
+    const float xi_light = sampler->Next1D(), xi_0 = sampler->Next1D();
+    const Vec2 xi = sampler->Next2D();
+    float pdf_light = 0;
+    const uint32_t id_light =
+        data->light_bvh.Sample(position, normal, xi_light, &pdf_light);
+    if (id_light == kInvalidId)
+        return L;
+
+    if (id_light < data->num_emitter)
+    {
+        L += EvaluateEmitterVolPath(data, data->emitters[id_light], pdf_light,
+                                    xi, position, hit, medium_hit, medium, wo,
+                                    seed);
+    }
+    else
+    {
+        L += EvaluateAreaLightVolPath(data, id_light - data->num_emitter,
+                                      pdf_light, xi_0, xi, position, hit,
+                                      medium_hit, medium, wo, seed);
+    }
+    return L;
+}
+
+} // namespace
+
 namespace csrt
 {
 
 QUALIFIER_D_H Vec3 ShadeVolPath(const IntegratorData *data, const Vec3 &eye,
-                                const Vec3 &look_dir, uint32_t *seed)
+                                const Vec3 &look_dir, Sampler *sampler,
+                                GuidingPath *path)
 {
     Vec3 L(0);
+    // 遍历加速结构时的透明度测试使用独立的伪随机数，不占用采样器的维度
+    uint32_t *seed = sampler->seed();
 
     //
     // 求取原初光线与场景的交点
@@ -47,7 +231,7 @@ QUALIFIER_D_H Vec3 ShadeVolPath(const IntegratorData *data, const Vec3 &eye,
     {
         Medium *medium = data->media + id_medium;
         MediumSampleRec medium_rec;
-        medium->Sample(ray.t_max, seed, &medium_rec);
+        medium->Sample(ray.t_max, sampler, &medium_rec);
         if (medium_rec.valid)
         { //光线在参与介质中传播，存在明显衰减
             attenuation *= medium_rec.attenuation / medium_rec.pdf;
@@ -84,20 +268,33 @@ QUALIFIER_D_H Vec3 ShadeVolPath(const IntegratorData *data, const Vec3 &eye,
 
     Vec3 wi = {};
     float pdf_sample = 0;
+    // 上一个散射点，用于计算按光源层次包围盒抽样到下一个交点的概率
+    Vec3 position_pre = {}, normal_pre = {};
+    // 上一个散射点是否抽样了阴影光线。穿过没有 BSDF 的表面之后阴影光线不可能抵达同一个光源，
+    // 次生光线贡献的直接光照不需合并
+    bool mis = false;
     for (uint32_t depth = 1;
          depth < data->info.depth_rr || (depth < data->info.depth_max &&
-                                         RandomFloat(seed) < data->info.pdf_rr);
+                                         sampler->Next1D() < data->info.pdf_rr);
          ++depth)
     {
+        if (depth >= data->info.depth_rr)
+        { // 根据俄罗斯轮盘赌算法的概率处理场景的反射率，使之符合应有的数学期望
+            attenuation *= data->pdf_rr_rcp;
+        }
+
         if (scattering)
         { //当前散射点在参与介质之中
             // 按表面积进行抽样得到阴影光线，合并阴影光线贡献的直接光照
-            L += attenuation * EvaluateDirectLightVolPath(data, medium_hit, wo, seed);
+            L += attenuation *
+                 EvaluateDirectLightVolPath(data, medium_hit, wo, sampler);
+
+            mis = true;
 
             // 抽样次生光线光线
             PhaseSampleRec phase_rec;
             phase_rec.wo = wo;
-            medium_hit.medium->SamplePhase(seed, &phase_rec);
+            medium_hit.medium->SamplePhase(sampler, &phase_rec);
             if (!phase_rec.valid)
                 break;
             wi = phase_rec.wi;
@@ -110,13 +307,15 @@ QUALIFIER_D_H Vec3 ShadeVolPath(const IntegratorData *data, const Vec3 &eye,
                 break;
 
             // 继续溯源光线
+            position_pre = medium_hit.position;
+            normal_pre = {};
             ray = Ray(medium_hit.position, -wi);
             hit = data->tlas->Intersect(data->bsdfs, data->map_instance_bsdf,
                                         seed, &ray);
 
             // 处理参与介质的影响
             MediumSampleRec medium_rec;
-            medium_hit.medium->Sample(ray.t_max, seed, &medium_rec);
+            medium_hit.medium->Sample(ray.t_max, sampler, &medium_rec);
             if (medium_rec.valid)
             { //光线在参与介质中传播，存在明显衰减
                 attenuation *= medium_rec.attenuation / medium_rec.pdf;
@@ -138,11 +337,18 @@ QUALIFIER_D_H Vec3 ShadeVolPath(const IntegratorData *data, const Vec3 &eye,
         }
         else
         { //当前散射点在景物表面
-            // 按表面积进行抽样得到阴影光线，合并阴影光线贡献的直接光照
-            L += attenuation * EvaluateDirectLightVolPath(data, hit, wo, seed);
+            // 按表面积进行抽样得到阴影光线，合并阴影光线贡献的直接光照。
+            // 没有 BSDF 的表面只是参与介质的边界，光线原样穿过，不抽样阴影光线
+            mis = bsdf != nullptr;
+            if (mis)
+            {
+                L += attenuation *
+                     EvaluateDirectLightVolPath(data, hit, wo, sampler);
+            }
 
-            // 抽样次生光线光线
-            BsdfSampleRec rec = SampleRayPath(wo, hit, bsdf, seed);
+            // 抽样次生光线光线，参与介质中的散射点只按相函数抽样
+            BsdfSampleRec rec =
+                SampleRayPathGuided(data, wo, hit, bsdf, sampler);
             if (!rec.valid)
                 break;
             wi = rec.wi;
@@ -153,8 +359,11 @@ QUALIFIER_D_H Vec3 ShadeVolPath(const IntegratorData *data, const Vec3 &eye,
             if (fmaxf(fmaxf(attenuation.x, attenuation.y), attenuation.z) <
                 kEpsilon)
                 break;
+            RecordGuidingVertex(rec, attenuation, L, bsdf, path);
 
             // 继续溯源光线
+            position_pre = hit.position;
+            normal_pre = hit.normal;
             ray = Ray(rec.position, -wi);
             hit = data->tlas->Intersect(data->bsdfs, data->map_instance_bsdf,
                                         seed, &ray);
@@ -168,7 +377,7 @@ QUALIFIER_D_H Vec3 ShadeVolPath(const IntegratorData *data, const Vec3 &eye,
             {
                 Medium *medium = data->media + id_medium;
                 MediumSampleRec medium_rec;
-                medium->Sample(ray.t_max, seed, &medium_rec);
+                medium->Sample(ray.t_max, sampler, &medium_rec);
                 if (medium_rec.valid)
                 { //光线在参与介质中传播，存在明显衰减
                     attenuation *= medium_rec.attenuation / medium_rec.pdf;
@@ -189,10 +398,9 @@ QUALIFIER_D_H Vec3 ShadeVolPath(const IntegratorData *data, const Vec3 &eye,
             { // 次生光线逃逸出场景
                 if (data->id_envmap != kInvalidId)
                 {
-                    const Vec3 radiance =
-                        data->emitters[data->id_envmap].Evaluate(-wi);
-                    const float pdf_direct =
-                                    data->emitters[data->id_envmap].Pdf(-wi),
+                    const Emitter &envmap = data->emitters[data->id_envmap];
+                    const Vec3 radiance = envmap.Evaluate(-wi);
+                    const float pdf_direct = mis ? envmap.Pdf(-wi) : 0.0f,
                                 weight_bsdf = MisWeight(pdf_sample, pdf_direct);
                     L += weight_bsdf * attenuation * radiance;
                 }
@@ -214,16 +422,20 @@ QUALIFIER_D_H Vec3 ShadeVolPath(const IntegratorData *data, const Vec3 &eye,
                     const float cos_theta_prime = Dot(wi, hit.normal);
                     if (cos_theta_prime < kEpsilonFloat)
                         break;
-                    const uint32_t id_instance_area_light =
+                    const uint32_t id_light =
+                        data->num_emitter +
                         data->map_id_instance_area_light[hit.id_instance];
-                    const float
-                        pdf_area =
-                            (data->cdf_area_light[id_instance_area_light + 1] -
-                             data->cdf_area_light[id_instance_area_light]) *
-                            data->list_pdf_area_instance[hit.id_instance],
+                    // 抽样光源时只会得到光源朝向散射点的一面
+                    float pdf_direct = 0;
+                    if (mis && !hit.inside)
+                    {
                         pdf_direct =
-                            pdf_area * Sqr(ray.t_max) / cos_theta_prime,
-                        weight_bsdf = MisWeight(pdf_sample, pdf_direct);
+                            data->light_bvh.Pdf(position_pre, normal_pre,
+                                                id_light) *
+                            data->instances[hit.id_instance].Pdf(position_pre,
+                                                                 hit);
+                    }
+                    const float weight_bsdf = MisWeight(pdf_sample, pdf_direct);
                     // 场景中的面光源以类似漫反射的形式向各个方向均匀地发光
                     const Vec3 radiance = bsdf->GetRadiance(hit.texcoord),
                                L_dir = weight_bsdf * attenuation * radiance;
@@ -234,254 +446,34 @@ QUALIFIER_D_H Vec3 ShadeVolPath(const IntegratorData *data, const Vec3 &eye,
 
             // 原初光线溯源至不发光的景物表面，被散射
             wo = wi;
-            if (depth >= data->info.depth_rr)
-            { // 根据俄罗斯轮盘赌算法的概率处理场景的反射率，使之符合应有的数学期望
-                attenuation *= data->pdf_rr_rcp;
-            }
         }
     }
 
+    if (path != nullptr)
+        path->L = L;
     return L;
 }
 
 QUALIFIER_D_H Vec3 EvaluateDirectLightVolPath(const IntegratorData *data,
                                               const Hit &hit, const Vec3 &wo,
-                                              uint32_t *seed)
+                                              Sampler *sampler)
 {
-    Vec3 L(0);
-
     const bool inside = Dot(wo, hit.normal) > 0 ? hit.inside : !hit.inside;
     const uint32_t id_medium = inside ? hit.id_medium_int : hit.id_medium_ext;
     Medium *medium = nullptr;
     if (id_medium != kInvalidId)
         medium = data->media + id_medium;
 
-    for (uint32_t i = 0; i < data->num_emitter; ++i)
-    {
-        Emitter *emitter = data->emitters + i;
-
-        EmitterSampleRec rec =
-            emitter->Sample(hit.position, RandomFloat(seed), RandomFloat(seed));
-
-        // 光源与当前着色点之间不能被其它物体遮挡
-        Ray ray_test = {hit.position, -rec.wi};
-        ray_test.t_max = rec.distance - kEpsilonDistance;
-        if (data->tlas->IntersectAny(data->bsdfs, data->map_instance_bsdf, seed,
-                                     &ray_test))
-            continue;
-
-        if (Dot(-rec.wi, hit.normal) < kEpsilonFloat)
-            continue;
-
-        Vec3 medium_attenuation = {1.0f};
-        if (medium != nullptr)
-        {
-            MediumSampleRec medium_rec;
-            medium_rec.distance = rec.distance;
-            medium->Evaluate(&medium_rec);
-            if (!medium_rec.valid)
-                continue;
-            medium_attenuation = medium_rec.attenuation / medium_rec.pdf;
-        }
-
-        Bsdf *bsdf = nullptr;
-        if (data->map_instance_bsdf[hit.id_instance] != kInvalidId)
-            bsdf = data->bsdfs + data->map_instance_bsdf[hit.id_instance];
-
-        const BsdfSampleRec rec1 = EvaluateRayPath(rec.wi, wo, hit, bsdf);
-        if (!rec1.valid)
-            continue;
-
-        const Vec3 radiance = emitter->Evaluate(rec);
-        if (rec.harsh)
-        {
-            L += radiance * medium_attenuation * rec1.attenuation;
-        }
-        else
-        {
-            const float pdf_direct = emitter->Pdf(-rec.wi);
-            if (pdf_direct > kEpsilonFloat)
-            {
-                const float weight_direct = MisWeight(pdf_direct, rec1.pdf);
-                L += weight_direct * radiance * medium_attenuation *
-                     rec1.attenuation / pdf_direct;
-            }
-        }
-    }
-
-    if (data->num_area_light != 0)
-    {
-        // 抽样得到的面光源上一点
-        const uint32_t index_area_light =
-                           BinarySearch(data->size_cdf_area_light,
-                                        data->cdf_area_light,
-                                        RandomFloat(seed)) -
-                           1,
-                       id_area_light_instance =
-                           data->map_id_area_light_instance[index_area_light];
-        const Hit hit_pre = data->instances[id_area_light_instance].Sample(
-            RandomFloat(seed), RandomFloat(seed), RandomFloat(seed));
-
-        // 抽样点与当前着色点之间不能被其它物体遮挡
-        const Vec3 d_vec = hit.position - hit_pre.position;
-        const float distance = Length(d_vec);
-        Ray ray_test = {hit_pre.position, Normalize(d_vec)};
-        ray_test.t_max = distance - kEpsilonDistance;
-        if (data->tlas->IntersectAny(data->bsdfs, data->map_instance_bsdf, seed,
-                                     &ray_test))
-            return L;
-
-        const Vec3 wi = Normalize(d_vec);
-        const float cos_theta_prime = Dot(wi, hit_pre.normal);
-        if (cos_theta_prime < kEpsilonFloat)
-            return L;
-        if (Dot(-wi, hit.normal) < kEpsilonFloat)
-            return L;
-
-        Vec3 medium_attenuation = {1.0f};
-        if (medium != nullptr)
-        {
-            MediumSampleRec medium_rec;
-            medium_rec.distance = distance;
-            medium->Evaluate(&medium_rec);
-            if (!medium_rec.valid)
-                return L;
-            medium_attenuation = medium_rec.attenuation / medium_rec.pdf;
-        }
-
-        Bsdf *bsdf = nullptr;
-        if (data->map_instance_bsdf[hit.id_instance] != kInvalidId)
-            bsdf = data->bsdfs + data->map_instance_bsdf[hit.id_instance];
-
-        const BsdfSampleRec rec = EvaluateRayPath(wi, wo, hit, bsdf);
-        if (!rec.valid)
-            return L;
-
-        // 根据多重重要抽样（MIS，multiple importance sampling）合并按表面积进行抽样得到的阴影光线贡献的直接光照
-        const float pdf_area =
-                        (data->cdf_area_light[index_area_light + 1] -
-                         data->cdf_area_light[index_area_light]) *
-                        data->list_pdf_area_instance[id_area_light_instance],
-                    pdf_direct = pdf_area * Sqr(distance) / cos_theta_prime,
-                    weight_direct = MisWeight(pdf_direct, rec.pdf);
-        Bsdf *bsdf_pre =
-            data->bsdfs + data->map_instance_bsdf[id_area_light_instance];
-        const Vec3 radiance = bsdf_pre->GetRadiance(hit_pre.texcoord);
-        L += weight_direct *
-             (radiance * medium_attenuation * rec.attenuation / pdf_direct);
-    }
-
-    return L;
+    return SampleDirectLightVolPath(data, hit.position, hit.normal, &hit,
+                                    nullptr, medium, wo, sampler);
 }
 
 QUALIFIER_D_H Vec3 EvaluateDirectLightVolPath(const IntegratorData *data,
                                               const MediumHit &hit,
-                                              const Vec3 &wo, uint32_t *seed)
+                                              const Vec3 &wo, Sampler *sampler)
 {
-    Vec3 L(0);
-
-    for (uint32_t i = 0; i < data->num_emitter; ++i)
-    {
-        Emitter *emitter = data->emitters + i;
-
-        EmitterSampleRec rec =
-            emitter->Sample(hit.position, RandomFloat(seed), RandomFloat(seed));
-
-        // 光源与当前着色点之间不能被其它物体遮挡
-        Ray ray_test = {hit.position, -rec.wi};
-        ray_test.t_max = rec.distance - kEpsilonDistance;
-        if (data->tlas->IntersectAny(data->bsdfs, data->map_instance_bsdf, seed,
-                                     &ray_test))
-            continue;
-
-        MediumSampleRec medium_rec;
-        medium_rec.distance = rec.distance;
-        hit.medium->Evaluate(&medium_rec);
-        if (!medium_rec.valid)
-            continue;
-        const Vec3 medium_attenuation = medium_rec.attenuation / medium_rec.pdf;
-
-        PhaseSampleRec phase_rec;
-        phase_rec.wi = rec.wi;
-        phase_rec.wo = wo;
-        hit.medium->EvaluatePhase(&phase_rec);
-        if (!phase_rec.valid)
-            continue;
-
-        const Vec3 radiance = emitter->Evaluate(rec);
-        if (rec.harsh)
-        {
-            L += radiance * medium_attenuation * phase_rec.attenuation;
-        }
-        else
-        {
-            const float pdf_direct = emitter->Pdf(-rec.wi);
-            if (pdf_direct > kEpsilonFloat)
-            {
-                const float weight_direct =
-                    MisWeight(pdf_direct, phase_rec.pdf);
-                L += weight_direct * radiance * medium_attenuation *
-                     phase_rec.attenuation / pdf_direct;
-            }
-        }
-    }
-
-    if (data->num_area_light != 0)
-    {
-        // 抽样得到的面光源上一点
-        const uint32_t index_area_light =
-                           BinarySearch(data->size_cdf_area_light,
-                                        data->cdf_area_light,
-                                        RandomFloat(seed)) -
-                           1,
-                       id_area_light_instance =
-                           data->map_id_area_light_instance[index_area_light];
-        const Hit hit_pre = data->instances[id_area_light_instance].Sample(
-            RandomFloat(seed), RandomFloat(seed), RandomFloat(seed));
-
-        // 抽样点与当前着色点之间不能被其它物体遮挡
-        const Vec3 d_vec = hit.position - hit_pre.position;
-        const float distance = Length(d_vec);
-        Ray ray_test = {hit_pre.position, Normalize(d_vec)};
-        ray_test.t_max = distance - kEpsilonDistance;
-        if (data->tlas->IntersectAny(data->bsdfs, data->map_instance_bsdf, seed,
-                                     &ray_test))
-            return L;
-
-        const Vec3 wi = Normalize(d_vec);
-        const float cos_theta_prime = Dot(wi, hit_pre.normal);
-        if (cos_theta_prime < kEpsilonFloat)
-            return L;
-
-        MediumSampleRec medium_rec;
-        medium_rec.distance = distance;
-        hit.medium->Evaluate(&medium_rec);
-        if (!medium_rec.valid)
-            return L;
-        const Vec3 medium_attenuation = medium_rec.attenuation / medium_rec.pdf;
-
-        PhaseSampleRec phase_rec;
-        phase_rec.wi = wi;
-        phase_rec.wo = wo;
-        hit.medium->EvaluatePhase(&phase_rec);
-        if (!phase_rec.valid)
-            return L;
-
-        // 根据多重重要抽样（MIS，multiple importance sampling）合并按表面积进行抽样得到的阴影光线贡献的直接光照
-        const float pdf_area =
-                        (data->cdf_area_light[index_area_light + 1] -
-                         data->cdf_area_light[index_area_light]) *
-                        data->list_pdf_area_instance[id_area_light_instance],
-                    pdf_direct = pdf_area * Sqr(distance) / cos_theta_prime,
-                    weight_direct = MisWeight(pdf_direct, phase_rec.pdf);
-        Bsdf *bsdf_pre =
-            data->bsdfs + data->map_instance_bsdf[id_area_light_instance];
-        const Vec3 radiance = bsdf_pre->GetRadiance(hit_pre.texcoord);
-        L += weight_direct * (radiance * medium_attenuation *
-                              phase_rec.attenuation / pdf_direct);
-    }
-
-    return L;
+    return SampleDirectLightVolPath(data, hit.position, {}, nullptr, &hit,
+                                    hit.medium, wo, sampler);
 }
 
 } // namespace csrt
@@ -6,21 +6,22 @@
 namespace csrt
 {
 
-QUALIFIER_D_H void SampleHenyeyGreensteinPhase(const Vec3 &g, uint32_t *seed,
+QUALIFIER_D_H void SampleHenyeyGreensteinPhase(const Vec3 &g, Sampler *sampler,
                                                PhaseSampleRec *rec)
 {
-    const int channel = static_cast<int>(RandomFloat(seed) * 3);
+    const int channel = static_cast<int>(sampler->Next1D() * 3);
+    const Vec2 u = sampler->Next2D();
 
     float cos_theta = 0;
     if (abs(g[channel]) < kEpsilonFloat)
     {
-        cos_theta = 1.0f - 2.0f * RandomFloat(seed);
+        cos_theta = 1.0f - 2.0f * u.u;
     }
     else
     {
         const float sqr_term =
             (1.0f - Sqr(g[channel])) /
-            (1.0f - g[channel] + 2.0f * g[channel] * RandomFloat(seed));
+            (1.0f - g[channel] + 2.0f * g[channel] * u.u);
         cos_theta =
             (1.0f + Sqr(g[channel]) - Sqr(sqr_term)) / (2.0f * g[channel]);
     }
@@ -37,7 +38,7 @@ QUALIFIER_D_H void SampleHenyeyGreensteinPhase(const Vec3 &g, uint32_t *seed,
 
     rec->valid = true;
     const float sin_theta = sqrtf(fmaxf(0.0f, 1.0f - Sqr(cos_theta)));
-    const float phi = k2Pi * RandomFloat(seed);
+    const float phi = k2Pi * u.v;
     rec->wi = {sin_theta * cosf(phi), sin_theta * sinf(phi), cos_theta};
     rec->wi = -LocalToWorld(rec->wi, rec->wo);
 }
@@ -8,13 +8,15 @@ namespace csrt
 
 QUALIFIER_D_H void SampleHomogeneousMedium(const HomogeneousMediumData &data,
                                            const float max_distance,
-                                           uint32_t *seed, MediumSampleRec *rec)
+                                           Sampler *sampler,
+                                           MediumSampleRec *rec)
 {
-    float xi_0 = RandomFloat(seed);
+    const Vec2 xi = sampler->Next2D();
+    float xi_0 = xi.u;
     if (xi_0 < data.sampling_weight)
     { //抽样光线在介质内部是否发生散射
         xi_0 /= data.sampling_weight;
-        const int channel = static_cast<int>(RandomFloat(seed) * 3);
+        const int channel = static_cast<int>(xi.v * 3);
         rec->distance = -log(1.0f - xi_0) / data.sigma_t[channel];
         if (rec->distance < max_distance)
         { //光线在介质内部发生了散射
@@ -6,12 +6,13 @@
 namespace csrt
 {
 
-QUALIFIER_D_H void SampleIsotropicPhase(uint32_t *seed, PhaseSampleRec *rec)
+QUALIFIER_D_H void SampleIsotropicPhase(Sampler *sampler, PhaseSampleRec *rec)
 {
     rec->valid = true;
     rec->attenuation = Vec3(k1Div4Pi);
     rec->pdf = k1Div4Pi;
-    rec->wi = SampleSphereUniform(RandomFloat(seed), RandomFloat(seed));
+    const Vec2 u = sampler->Next2D();
+    rec->wi = SampleSphereUniform(u.u, u.v);
 }
 
 QUALIFIER_D_H void EvaluateIsotropicPhase(PhaseSampleRec *rec)
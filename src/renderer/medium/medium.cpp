@@ -38,13 +38,13 @@ QUALIFIER_D_H Medium::Medium(const uint32_t id, const MediumInfo &info)
     }
 }
 
-QUALIFIER_D_H void Medium::Sample(const float max_distance, uint32_t *seed,
+QUALIFIER_D_H void Medium::Sample(const float max_distance, Sampler *sampler,
                                   MediumSampleRec *rec) const
 {
     switch (data_.type)
     {
     case MediumType::kHomogeneous:
-        SampleHomogeneousMedium(data_.homogeneous, max_distance, seed, rec);
+        SampleHomogeneousMedium(data_.homogeneous, max_distance, sampler, rec);
         break;
     }
 }
@@ -72,16 +72,16 @@ QUALIFIER_D_H void Medium::EvaluatePhase(PhaseSampleRec *rec) const
     }
 }
 
-QUALIFIER_D_H void Medium::SamplePhase(uint32_t *seed,
+QUALIFIER_D_H void Medium::SamplePhase(Sampler *sampler,
                                        PhaseSampleRec *rec) const
 {
     switch (data_.phase_func.type)
     {
     case PhaseFunctionType::kIsotropic:
-        SampleIsotropicPhase(seed, rec);
+        SampleIsotropicPhase(sampler, rec);
         break;
     case PhaseFunctionType::kHenyeyGreenstein:
-        SampleHenyeyGreensteinPhase(data_.phase_func.g, seed, rec);
+        SampleHenyeyGreensteinPhase(data_.phase_func.g, sampler, rec);
         break;
     }
 }
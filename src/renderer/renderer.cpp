@@ -2,8 +2,9 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <exception>
-#include <mutex>
+#include <memory>
 #include <sstream>
 #include <thread>
 
@@ -14,77 +15,130 @@ namespace
 
 using namespace csrt;
 
-std::mutex g_mutex_patch;
-std::vector<std::vector<std::array<uint32_t, 3>>> g_patches;
 #ifdef ENABLE_CUDA
 dim3 g_threads_per_block = {8, 8, 1};
 dim3 g_num_blocks = {1, 1, 1};
 #endif
 
-void GeneratePatchInfo(const uint32_t width, const uint32_t height)
+// 训练路径引导与估计像素亮度时每个行带的行数
+constexpr uint32_t kPrepassBandHeight = 256;
+// 随机渐进式光子映射中，每个任务追踪的光子数量
+constexpr uint32_t kPhotonPerTask = 256;
+
+// 像素 (i, j) 的第 s 个样本的原初光线方向，sampler 为该样本的采样器
+QUALIFIER_D_H Vec3 GetLookDir(const uint32_t i, const uint32_t j,
+                              const uint32_t s, Camera *camera,
+                              Sampler *sampler)
 {
-    const uint32_t resolution = width * height;
-    std::vector<std::array<uint32_t, 3>> pixels(resolution);
-    auto GetMortonCode = [](const uint32_t column, const uint32_t row)
-    {
-        uint32_t morton = 0;
-        for (uint32_t i = 0; i < sizeof(row) * 8; ++i)
-        {
-            morton |= ((row & static_cast<uint32_t>(1) << i) << i |
-                       (column & static_cast<uint32_t>(1) << i) << (i + 1));
-        }
-        return morton;
-    };
-    for (uint32_t j = 0; j < height; ++j)
+    float u = 0, v = 0;
+    if (sampler->type() == SamplerType::kIndependent)
     {
-        for (uint32_t i = 0; i < width; ++i)
-            pixels[j * width + i] = {i, j, GetMortonCode(i, j)};
+        // 超出 spp 的样本（如限时渲染）改用 3 为底的 Van der Corput 序列
+        u = s < camera->spp() ? s * camera->spp_inv()
+                              : GetVanDerCorputSequence<3>(s + 1);
+        v = GetVanDerCorputSequence<2>(s + 1);
+    }
+    else
+    { // 低差异序列的第一个维度用于像素内的样本位置
+        const Vec2 xi = sampler->Next2D();
+        u = xi.u;
+        v = xi.v;
     }
-    std::sort(
-        pixels.begin(), pixels.end(),
-        [](const std::array<uint32_t, 3> &a, const std::array<uint32_t, 3> &b)
-        { return a.at(2) < b.at(2); });
+    const float x = 2.0f * (i + u) / camera->width() - 1.0f,
+                y = 1.0f - 2.0f * (j + v) / camera->height();
+    return Normalize(camera->front() + x * camera->view_dx() +
+                     y * camera->view_dy());
+}
 
-    constexpr uint32_t patch_size = 64;
-    const uint32_t num_patch = (pixels.size() + patch_size - 1) / patch_size;
-    g_patches = std::vector<std::vector<std::array<uint32_t, 3>>>(num_patch);
+// 绘制像素 (i, j) 的第 s 个样本，随机数只由像素与样本序号决定，
+// 因而任意样本区间都可以独立绘制。path 不为空时记录路径，用于训练路径引导；
+// rrs_path 不为空时记录路径，用于估计效率感知的俄罗斯轮盘赌与路径分裂
+QUALIFIER_D_H Vec3 SamplePixel(const uint32_t i, const uint32_t j,
+                               const uint32_t s, Camera *camera,
+                               Integrator *integrator,
+                               GuidingPath *path = nullptr,
+                               RrsPath *rrs_path = nullptr)
+{
+    Sampler sampler(camera->sampler(), i, j, s, camera->width(),
+                    camera->height(), camera->spp());
+    const Vec3 look_dir = GetLookDir(i, j, s, camera, &sampler);
+    Vec3 color = integrator->Shade(camera->eye(), look_dir, &sampler, path,
+                                   j * camera->width() + i, rrs_path);
+    color.x = fminf(color.x, 1.0f);
+    color.y = fminf(color.y, 1.0f);
+    color.z = fminf(color.z, 1.0f);
+    return color;
+}
 
-    uint32_t begin, end;
-    for (uint32_t i = 0; i < num_patch; ++i)
+// 从像素已有的样本数量开始，继续绘制样本直到数量达到 count_target，累积到 film 中，
+// 返回绘制的样本数量。分多轮、多进程绘制与一次绘制的结果逐位相同。
+// sd_tree 不为空时，同时将每条路径记录到 SD-tree 中；
+// rrs_cache 不为空时，同时将每条路径记录到 RRS 网格中
+uint32_t AccumulatePixel(const uint32_t i, const uint32_t j,
+                         const uint32_t count_target, Camera *camera,
+                         Integrator *integrator, SdTree *sd_tree,
+                         RrsCache *rrs_cache, Film *film)
+{
+    uint64_t *sum = film->sum(i, j);
+    float *stats = film->luminance_stats(i, j);
+    uint32_t *count = film->count(i, j);
+    if (*count >= count_target)
+        return 0;
+    const uint32_t num_sample = count_target - *count;
+    float mean = stats[0], m2 = stats[1];
+    for (uint32_t k = *count; k < count_target; ++k)
     {
-        begin = i * patch_size,
-        end = std::min((i + 1) * patch_size, resolution);
-        g_patches[i] = std::vector<std::array<uint32_t, 3>>(
-            pixels.begin() + begin, pixels.begin() + end);
+        Vec3 temp;
+        if (sd_tree != nullptr)
+        {
+            GuidingPath path;
+            temp = SamplePixel(i, j, film->sample_begin() + k, camera,
+                               integrator, &path);
+            sd_tree->Record(path);
+        }
+        else if (rrs_cache != nullptr)
+        {
+            RrsPath rrs_path;
+            temp = SamplePixel(i, j, film->sample_begin() + k, camera,
+                               integrator, nullptr, &rrs_path);
+            rrs_cache->Record(rrs_path);
+        }
+        else
+        {
+            temp = SamplePixel(i, j, film->sample_begin() + k, camera,
+                               integrator);
+        }
+        for (int channel = 0; channel < 3; ++channel)
+        {
+            sum[channel] += static_cast<uint64_t>(
+                fmaxf(temp[channel], 0.0f) * kFilmFixedScale + 0.5);
+        }
+
+        // Welford 算法更新亮度的均值与离差平方和
+        const float luminance = LinearRgbToLuminance(temp),
+                    delta = luminance - mean;
+        mean += delta / (k + 1);
+        m2 += delta * (luminance - mean);
     }
+    stats[0] = mean;
+    stats[1] = m2;
+    *count = count_target;
+    return num_sample;
 }
 
+#ifdef ENABLE_CUDA
 QUALIFIER_D_H void DrawPixel(const uint32_t i, const uint32_t j, Camera *camera,
                              Integrator *integrator, float *frame)
 {
     const uint32_t pixel_offset = (j * camera->width() + i) * 3;
-    uint32_t seed = Tea<4>(pixel_offset, 0);
-    Vec3 color, temp;
+    Vec3 color;
     for (uint32_t s = 0; s < camera->spp(); ++s)
-    {
-        const float u = s * camera->spp_inv(),
-                    v = GetVanDerCorputSequence<2>(s + 1),
-                    x = 2.0f * (i + u) / camera->width() - 1.0f,
-                    y = 1.0f - 2.0f * (j + v) / camera->height();
-        const Vec3 look_dir = Normalize(
-            camera->front() + x * camera->view_dx() + y * camera->view_dy());
-        temp = integrator->Shade(camera->eye(), look_dir, &seed);
-        temp.x = fminf(temp.x, 1.0f);
-        temp.y = fminf(temp.y, 1.0f);
-        temp.z = fminf(temp.z, 1.0f);
-        color += temp;
-    }
+        color += SamplePixel(i, j, s, camera, integrator);
     color *= camera->spp_inv();
     for (int channel = 0; channel < 3; ++channel)
         frame[pixel_offset + channel] = color[channel];
 }
 
-#ifdef ENABLE_CUDA
 __global__ void DispathRaysCuda(Camera *camera, Integrator *integrator,
                                 float *frame)
 {
@@ -102,10 +156,15 @@ __global__ void DispathRaysCuda(Camera *camera, Integrator *integrator,
                    j = blockIdx.y * blockDim.y + threadIdx.y;
     if (i < camera->width() && j < camera->height())
     {
-        const float u = GetVanDerCorputSequence<2>(index_frame + 1),
-                    v = GetVanDerCorputSequence<3>(index_frame + 1),
-                    x = 2.0f * (i + u) / camera->width() - 1.0f,
-                    y = 1.0f - 2.0f * (j + v) / camera->height();
+        // 实时预览的帧数没有上限，kZSobol 在帧数超出 spp 后退化为 kSobol
+        Sampler sampler(camera->sampler(), i, j, index_frame, camera->width(),
+                        camera->height(), camera->spp());
+        Vec2 xi = {GetVanDerCorputSequence<2>(index_frame + 1),
+                   GetVanDerCorputSequence<3>(index_frame + 1)};
+        if (sampler.type() != SamplerType::kIndependent)
+            xi = sampler.Next2D();
+        const float x = 2.0f * (i + xi.u) / camera->width() - 1.0f,
+                    y = 1.0f - 2.0f * (j + xi.v) / camera->height();
         const Vec3 look_dir = Normalize(
             camera->front() + x * camera->view_dx() + y * camera->view_dy());
 
@@ -113,9 +172,8 @@ __global__ void DispathRaysCuda(Camera *camera, Integrator *integrator,
                        offset_dest =
                            ((camera->height() - 1 - j) * camera->width() + i) *
                            3;
-        uint32_t seed = Tea<4>(pixel_offset, index_frame);
 
-        Vec3 color = integrator->Shade(camera->eye(), look_dir, &seed);
+        Vec3 color = integrator->Shade(camera->eye(), look_dir, &sampler);
         for (int c = 0; c < 3; ++c)
         {
             color[c] = fminf(color[c], 1.0f);
@@ -139,12 +197,32 @@ __global__ void DispathRaysCuda(Camera *camera, Integrator *integrator,
 
 #endif
 
-void DispathRaysCpu(Camera *camera, Integrator *integrator, float *frame)
+// 将每个图块的样本数量补足到 count_target，返回实际绘制的样本总数。
+// stride 大于 1 时只绘制坐标均为 stride 整数倍的像素，用于低分辨率的预览。
+// 多进程分布式渲染时，只绘制 partition 指定的那一组图块。
+// 启用自适应采样时，样本数量达到下限且相对误差低于阈值的图块不再绘制。
+// stop 被置位后，各线程完成当前图块即返回，余下的图块保持原有的样本数量。
+// integrators 为各个 NUMA 节点使用的积分器，线程使用所属节点的场景数据副本。
+// sd_tree 不为空时，绘制的路径同时用于训练路径引导；
+// rrs_cache 不为空时，绘制的路径同时用于构建 RRS 网格。
+// frame 不为空时，图块完成后即将其结果写入 frame，再调用 callbacks 中的 tile 回调。
+uint64_t DispathRaysCpu(ThreadPool *thread_pool, TileScheduler *tile_scheduler,
+                        Camera *camera, Integrator *const *integrators,
+                        SdTree *sd_tree, RrsCache *rrs_cache,
+                        const PartitionInfo &partition,
+                        const AdaptiveInfo &adaptive,
+                        const uint32_t count_target, const uint32_t stride,
+                        const double progress_begin, const double progress_end,
+                        const Timer &timer, const std::atomic<bool> *stop,
+                        Film *film, float *frame,
+                        const DrawCallbacks *callbacks)
 {
-    Timer timer;
-    uint64_t count_pacth = 0;
-    const uint64_t size_patch = g_patches.size();
-    const double size_patch_rcp = 1.0 / size_patch;
+    const uint64_t num_tile = tile_scheduler->num_tile();
+    const double num_tile_rcp = 1.0 / num_tile,
+                 progress_scale = progress_end - progress_begin;
+    std::atomic<uint64_t> count_tile(0);
+    std::atomic<uint32_t> progress_printed(0);
+    std::atomic<uint64_t> num_sample_drawn(0);
 
 #if defined(DEBUG) || defined(_DEBUG)
 
@@ -181,14 +259,15 @@ void DispathRaysCpu(Camera *camera, Integrator *integrator, float *frame)
         int cnt = 0;
         for (auto [i, j] : pixel)
         {
-            const uint32_t pixel_offset = (j * camera->width() + i) * 3;
-            uint32_t seed = Tea<4>(pixel_offset, 0);
             Vec3 color;
             colors.push_back(std::vector<Vec3>());
             seeds.push_back(std::vector<uint32_t>());
             for (uint32_t s = 0; s < camera->spp(); ++s)
             {
-                seeds[cnt].push_back(seed);
+                Sampler sampler(SamplerType::kIndependent, i, j, s,
+                                camera->width(), camera->height(),
+                                camera->spp());
+                seeds[cnt].push_back(*sampler.seed());
                 const float u = s * camera->spp_inv(),
                             v = GetVanDerCorputSequence<2>(s + 1),
                             x = 2.0f * (i + u) / camera->width() - 1.0f,
@@ -197,7 +276,7 @@ void DispathRaysCpu(Camera *camera, Integrator *integrator, float *frame)
                                                 x * camera->view_dx() +
                                                 y * camera->view_dy()),
                            eye = camera->eye();
-                Vec3 temp = integrator->Shade(eye, look_dir, &seed);
+                Vec3 temp = integrators[0]->Shade(eye, look_dir, &sampler);
                 colors[cnt].push_back(temp);
                 color += temp;
             }
@@ -216,52 +295,335 @@ void DispathRaysCpu(Camera *camera, Integrator *integrator, float *frame)
 
 #endif
 
-    auto DispatchRay = [&]()
+    auto DispatchRay = [&](const uint32_t id_thread, const uint64_t id_task)
     {
-        uint64_t id_patch = 0;
-        while (true)
+        Tile tile;
+        if ((stop != nullptr && stop->load(std::memory_order_relaxed)) ||
+            !tile_scheduler->GetTile(id_task, &tile))
+            return;
+        const bool skipped =
+            partition.num_tile_part > 1 &&
+            tile.id % partition.num_tile_part != partition.tile_part;
+
+        // 按目标数量而非固定的增量绘制，被中断的一轮继续时只补齐未完成的图块。
+        // 预览绘制过的像素比同一图块中的其它像素多出样本，图块的样本数量取其中的最小值
+        const uint32_t x_first = (tile.x_begin + stride - 1) / stride * stride,
+                       y_first = (tile.y_begin + stride - 1) / stride * stride;
+        uint32_t count = count_target;
+        for (uint32_t j = y_first; j < tile.y_end; j += stride)
+        {
+            for (uint32_t i = x_first; i < tile.x_end; i += stride)
+                count = std::min(count, *film->count(i, j));
+        }
+        bool converged = skipped || count >= count_target;
+        if (!converged && stride == 1 && adaptive.enable &&
+            count >= adaptive.spp_min)
+        {
+            float error = 0;
+            for (uint32_t j = tile.y_begin; j < tile.y_end; ++j)
+            {
+                for (uint32_t i = tile.x_begin; i < tile.x_end; ++i)
+                    error = std::max(error, film->RelativeError(i, j));
+            }
+            converged = error < adaptive.threshold;
+        }
+
+        if (!converged)
         {
+            Integrator *integrator = integrators[thread_pool->node(id_thread)];
+            uint64_t num_sample = 0;
+            for (uint32_t j = y_first; j < tile.y_end; j += stride)
             {
-                std::lock_guard<std::mutex> lock(g_mutex_patch);
-                if (count_pacth == size_patch)
-                    break;
-                id_patch = count_pacth++;
+                for (uint32_t i = x_first; i < tile.x_end; i += stride)
+                {
+                    num_sample +=
+                        AccumulatePixel(i, j, count_target, camera, integrator,
+                                        sd_tree, rrs_cache, film);
+                }
             }
-            for (const std::array<uint32_t, 3> &pixel : g_patches[id_patch])
+            num_sample_drawn.fetch_add(num_sample, std::memory_order_relaxed);
+        }
+        if (frame != nullptr && !skipped)
+        {
+            film->Resolve(tile.x_begin, tile.y_begin, tile.x_end, tile.y_end,
+                          frame);
+            if (callbacks != nullptr && callbacks->tile)
+                callbacks->tile(tile, frame);
+        }
+
+        // 进度以千分之一为单位输出，只有推进了进度的线程负责输出，无需加锁。
+        // 进度区间为空时（如预览）不输出
+        if (progress_scale <= 0)
+            return;
+        const uint64_t count_done =
+            count_tile.fetch_add(1, std::memory_order_relaxed) + 1;
+        const uint32_t permille =
+            static_cast<uint32_t>(count_done * 1000 / num_tile);
+        uint32_t printed = progress_printed.load(std::memory_order_relaxed);
+        if (permille > printed &&
+            progress_printed.compare_exchange_strong(printed, permille,
+                                                     std::memory_order_relaxed))
+        {
+            const double progress =
+                progress_begin + progress_scale * count_done * num_tile_rcp;
+            if (callbacks != nullptr && callbacks->progress)
+                callbacks->progress(progress);
+            else
+                timer.PrintProgress(progress);
+        }
+    };
+
+    thread_pool->ParallelFor(tile_scheduler->num_task(), DispatchRay);
+    return num_sample_drawn.load();
+}
+
+// 随机渐进式光子映射：逐轮绘制，直到裁剪窗口中每个像素的轮数达到 count_target，
+// 返回实际绘制的样本总数（像素数量与轮数之积）。每一轮依次并行地追踪相机路径、
+// 追踪光子、更新像素，各阶段之间同步。film 的起始像素没有样本时从头开始估计。
+// stop 被置位后放弃尚未完成的一轮，各像素保持原有的轮数。
+// frame 不为空时，每完成一轮即将裁剪窗口的结果写入 frame，再调用 callbacks 中的 tile 回调
+uint64_t DispathSppmCpu(ThreadPool *thread_pool, TileScheduler *tile_scheduler,
+                        Camera *camera, Integrator *const *integrators,
+                        Sppm *sppm, const uint32_t count_target,
+                        const double progress_begin, const double progress_end,
+                        const Timer &timer, const std::atomic<bool> *stop,
+                        Film *film, float *frame,
+                        const DrawCallbacks *callbacks)
+{
+    const Tile &crop = tile_scheduler->region();
+    if (crop.x_begin >= crop.x_end || crop.y_begin >= crop.y_end)
+        return 0;
+    const uint32_t width = static_cast<uint32_t>(camera->width()),
+                   height = static_cast<uint32_t>(camera->height()),
+                   count_begin = *film->count(crop.x_begin, crop.y_begin);
+    if (count_begin == 0)
+        sppm->Reset(width, height);
+    if (count_begin >= count_target)
+        return 0;
+
+    const uint64_t num_pixel =
+        static_cast<uint64_t>(crop.x_end - crop.x_begin) *
+        (crop.y_end - crop.y_begin);
+    const uint32_t num_photon = sppm->num_photon(),
+                   num_photon_task =
+                       (num_photon + kPhotonPerTask - 1) / kPhotonPerTask;
+    auto Stopped = [&]()
+    { return stop != nullptr && stop->load(std::memory_order_relaxed); };
+
+    uint32_t count = count_begin;
+    for (; count < count_target; ++count)
+    {
+        const uint32_t s = film->sample_begin() + count;
+        sppm->BeginIteration();
+
+        auto TraceCamera = [&](const uint32_t id_thread, const uint64_t id_task)
+        {
+            Tile tile;
+            if (Stopped() || !tile_scheduler->GetTile(id_task, &tile))
+                return;
+            const IntegratorData *data =
+                integrators[thread_pool->node(id_thread)]->data();
+            for (uint32_t j = tile.y_begin; j < tile.y_end; ++j)
             {
-                const uint32_t i = pixel.at(0), j = pixel.at(1);
-                DrawPixel(i, j, camera, integrator, frame);
+                for (uint32_t i = tile.x_begin; i < tile.x_end; ++i)
+                {
+                    Sampler sampler(camera->sampler(), i, j, s, width, height,
+                                    camera->spp());
+                    const Vec3 look_dir = GetLookDir(i, j, s, camera, &sampler);
+                    sppm->TraceCamera(data, j * width + i, camera->eye(),
+                                      look_dir, &sampler);
+                }
             }
+        };
+        thread_pool->ParallelFor(tile_scheduler->num_task(), TraceCamera);
+        if (Stopped())
+            break;
+
+        // 以 2^31 与轮次之和为扰乱，与像素的样本不重叠，同一轮的光子构成一组 Sobol 点集
+        auto TracePhoton = [&](const uint32_t id_thread, const uint64_t id_task)
+        {
+            if (Stopped())
+                return;
+            const IntegratorData *data =
+                integrators[thread_pool->node(id_thread)]->data();
+            const uint32_t first = static_cast<uint32_t>(id_task) *
+                                   kPhotonPerTask,
+                           last = std::min(first + kPhotonPerTask, num_photon);
+            for (uint32_t p = first; p < last; ++p)
             {
-                std::lock_guard<std::mutex> lock(g_mutex_patch);
-                timer.PrintProgress(count_pacth * size_patch_rcp);
+                Sampler sampler(SamplerType::kSobol, 0x80000000u + s, 0, p,
+                                width, 1, 1);
+                sppm->TracePhoton(data, &sampler);
             }
+        };
+        // 光子的通量超出定点数的范围时，缩小缩放系数后重新追踪本轮的光子。
+        // 是否超出只取决于本轮光子的集合，与线程数量和执行顺序无关
+        do
+        {
+            thread_pool->ParallelFor(num_photon_task, TracePhoton);
+        } while (!Stopped() && !sppm->CheckFluxRange());
+        if (Stopped())
+            break;
+
+        auto Update = [&](const uint32_t, const uint64_t id_task)
+        {
+            Tile tile;
+            if (!tile_scheduler->GetTile(id_task, &tile))
+                return;
+            for (uint32_t j = tile.y_begin; j < tile.y_end; ++j)
+            {
+                for (uint32_t i = tile.x_begin; i < tile.x_end; ++i)
+                {
+                    sppm->Update(j * width + i, film->sum(i, j));
+                    *film->count(i, j) = count + 1;
+                }
+            }
+        };
+        thread_pool->ParallelFor(tile_scheduler->num_task(), Update);
+        sppm->EndIteration();
+
+        if (frame != nullptr)
+        {
+            film->Resolve(crop.x_begin, crop.y_begin, crop.x_end, crop.y_end,
+                          frame);
+            if (callbacks != nullptr && callbacks->tile)
+                callbacks->tile(crop, frame);
         }
-    };
+        if (progress_end > progress_begin)
+        {
+            const double progress =
+                progress_begin + (progress_end - progress_begin) *
+                                     (count + 1 - count_begin) /
+                                     (count_target - count_begin);
+            if (callbacks != nullptr && callbacks->progress)
+                callbacks->progress(progress);
+            else
+                timer.PrintProgress(progress);
+        }
+    }
+    return num_pixel * (count - count_begin);
+}
 
-    std::vector<std::thread> workers;
-    const unsigned int thread_num = std::thread::hardware_concurrency();
-    for (unsigned int i = 0; i < thread_num; ++i)
+// 计算 Kulla-Conty LUT，LUT 与场景无关，启用资源缓存时只计算一次
+void ComputeLut(float *brdf_avg_buffer, float *albedo_avg_buffer)
+{
+    constexpr uint32_t num_brdf = kLutResolution * kLutResolution;
+    AssetCache &cache = GetAssetCache();
+    std::shared_ptr<const std::vector<float>> lut;
+    if (cache.enable())
+        lut = cache.Find<std::vector<float>>(AssetType::kLut, 0);
+    if (!lut)
     {
-        workers.push_back(std::thread{DispatchRay});
+        ComputeKullaConty(brdf_avg_buffer, albedo_avg_buffer);
+        if (cache.enable())
+        {
+            auto computed = std::make_shared<std::vector<float>>(
+                brdf_avg_buffer, brdf_avg_buffer + num_brdf);
+            computed->insert(computed->end(), albedo_avg_buffer,
+                             albedo_avg_buffer + kLutResolution);
+            cache.Insert(AssetType::kLut, 0,
+                         std::shared_ptr<const std::vector<float>>(computed),
+                         computed->size() * sizeof(float));
+        }
+        return;
     }
+    std::copy(lut->begin(), lut->begin() + num_brdf, brdf_avg_buffer);
+    std::copy(lut->begin() + num_brdf, lut->end(), albedo_avg_buffer);
+}
 
-    for (std::thread &worker : workers)
-        worker.join();
+// 网格所有法线（含插值所用的顶点法线）所在的圆锥，无法用半顶角小于 90° 的圆锥包含时
+// 返回整个球面
+void BoundMeshesNormals(const InstanceInfo &info, Vec3 *axis,
+                        float *cos_theta)
+{
+    std::vector<Vec3> normals;
+    const MeshesInfo &meshes = info.meshes;
+    for (const Uvec3 &indices : meshes.indices)
+    {
+        const Vec3 v0 = TransformPoint(info.to_world,
+                                       meshes.positions[indices[0]]),
+                   v1 = TransformPoint(info.to_world,
+                                       meshes.positions[indices[1]]),
+                   v2 = TransformPoint(info.to_world,
+                                       meshes.positions[indices[2]]);
+        const Vec3 normal_geom = Cross(v1 - v0, v2 - v0);
+        if (Length(normal_geom) > 0)
+            normals.push_back(Normalize(normal_geom));
+    }
+    if (!meshes.normals.empty())
+    {
+        const Mat4 normal_to_world = info.to_world.Transpose().Inverse();
+        for (const Vec3 &normal : meshes.normals)
+            normals.push_back(
+                Normalize(TransformVector(normal_to_world, normal)));
+    }
 
-    timer.PrintTimePassed("rendering");
+    Vec3 sum = {};
+    for (const Vec3 &normal : normals)
+        sum += normal;
+    *axis = {0, 0, 1};
+    *cos_theta = -1;
+    if (Length(sum) < kEpsilonFloat)
+        return;
+
+    const Vec3 axis_sum = Normalize(sum);
+    float cos_min = 1;
+    for (const Vec3 &normal : normals)
+        cos_min = fminf(cos_min, Dot(axis_sum, normal));
+    if (cos_min > 0)
+    {
+        *axis = axis_sum;
+        *cos_theta = cos_min;
+    }
 }
+
 } // namespace
 
 namespace csrt
 {
 
-Renderer::Renderer(const RendererConfig &config)
-    : backend_type_(config.backend_type), camera_(nullptr), textures_(nullptr),
+Tile GetCropWindow(const Camera::Info &info)
+{
+    if (info.crop_width <= 0 || info.crop_height <= 0)
+    {
+        Tile window;
+        window.x_end = static_cast<uint32_t>(info.width);
+        window.y_end = static_cast<uint32_t>(info.height);
+        return window;
+    }
+
+    if (info.crop_x < 0 || info.crop_y < 0 ||
+        info.crop_x + info.crop_width > info.width ||
+        info.crop_y + info.crop_height > info.height)
+    {
+        throw MyException("crop window is out of image.");
+    }
+    Tile window;
+    window.x_begin = static_cast<uint32_t>(info.crop_x);
+    window.y_begin = static_cast<uint32_t>(info.crop_y);
+    window.x_end = static_cast<uint32_t>(info.crop_x + info.crop_width);
+    window.y_end = static_cast<uint32_t>(info.crop_y + info.crop_height);
+    return window;
+}
+
+Renderer::Renderer(const RendererConfig &config) : Renderer(config, nullptr)
+{
+}
+
+Renderer::Renderer(const RendererConfig &config, const Renderer *primary)
+    : backend_type_(config.backend_type),
+      tile_size_(config.schedule.tile_size), partition_(config.partition),
+      adaptive_(config.adaptive),
+      guiding_passes_(config.integrator.guiding_passes),
+      rrs_spp_(config.integrator.rrs_spp), thread_pool_(nullptr),
+      tile_scheduler_(nullptr), scene_(nullptr), camera_(nullptr),
+      textures_(nullptr),
       bsdfs_(nullptr), media_(nullptr), emitters_(nullptr),
-      integrator_(nullptr), map_instance_bsdf_(nullptr),
+      integrator_(nullptr), sd_tree_(nullptr), rrs_cache_(nullptr),
+      sppm_(nullptr), map_instance_bsdf_(nullptr),
       map_area_light_instance_(nullptr), map_instance_area_light_(nullptr),
-      cdf_area_light_(nullptr), pixels_(nullptr), data_env_map_(nullptr),
+      light_bvh_nodes_(nullptr), light_bit_trails_(nullptr), pixels_(nullptr),
+      env_map_alias_table_(nullptr), env_map_pdf_(nullptr),
       brdf_avg_buffer_(nullptr), albedo_avg_buffer_(nullptr)
 {
     try
@@ -270,7 +632,6 @@ Renderer::Renderer(const RendererConfig &config)
 
         const size_t num_instance = config.instances.size();
         std::vector<uint32_t> map_area_light_instance;
-        std::vector<float> list_area_light_weight;
         map_instance_bsdf_ = MallocArray<uint32_t>(backend_type_, num_instance);
         for (size_t i = 0; i < num_instance; ++i)
         {
@@ -280,11 +641,7 @@ Renderer::Renderer(const RendererConfig &config)
                 const csrt::BsdfInfo info_bsdf =
                     config.bsdfs[config.instances[i].id_bsdf];
                 if (info_bsdf.type == csrt::BsdfType::kAreaLight)
-                {
                     map_area_light_instance.push_back(i);
-                    list_area_light_weight.push_back(
-                        info_bsdf.area_light.weight);
-                }
             }
         }
         map_area_light_instance_ =
@@ -293,15 +650,9 @@ Renderer::Renderer(const RendererConfig &config)
         map_instance_area_light_ = MallocArray<uint32_t>(
             backend_type_, std::vector<uint32_t>(num_instance, kInvalidId));
         const uint32_t num_area_light =
-            static_cast<uint32_t>(list_area_light_weight.size());
-        cdf_area_light_ = MallocArray<float>(backend_type_, num_area_light + 1);
-        cdf_area_light_[0] = 0;
+            static_cast<uint32_t>(map_area_light_instance.size());
         for (uint32_t i = 0; i < num_area_light; ++i)
-        {
-            cdf_area_light_[i + 1] =
-                list_area_light_weight[i] + cdf_area_light_[i];
             map_instance_area_light_[map_area_light_instance[i]] = i;
-        }
 
         camera_ = MallocElement<Camera>(backend_type_);
         *camera_ = Camera(config.camera);
@@ -311,23 +662,132 @@ Renderer::Renderer(const RendererConfig &config)
         brdf_avg_buffer_ =
             MallocArray<float>(backend_type_, kLutResolution * kLutResolution);
         albedo_avg_buffer_ = MallocArray<float>(backend_type_, kLutResolution);
-        ComputeKullaConty(brdf_avg_buffer_, albedo_avg_buffer_);
+        if (primary != nullptr)
+        {
+            std::copy(primary->brdf_avg_buffer_,
+                      primary->brdf_avg_buffer_ +
+                          kLutResolution * kLutResolution,
+                      brdf_avg_buffer_);
+            std::copy(primary->albedo_avg_buffer_,
+                      primary->albedo_avg_buffer_ + kLutResolution,
+                      albedo_avg_buffer_);
+        }
+        else
+        {
+            ComputeLut(brdf_avg_buffer_, albedo_avg_buffer_);
+        }
 
         CommitBsdfs(config.textures.size(), config.bsdfs);
         CommitMedia(config.media);
 
         uint32_t id_sun = kInvalidId, id_envmap = kInvalidId;
         CommitEmitters(config.textures, config.emitters, &id_sun, &id_envmap);
+        CommitLightBvh(config, num_area_light);
+
+        // 路径引导与 RRS 网格的空间划分都基于场景的包围盒
+        AABB aabb;
+        for (const AABB &aabb_instance : scene_->GetAabbList())
+            aabb += aabb_instance;
+
+        // 路径引导只在 CPU 后端训练，场景数据副本共用主渲染器的 SD-tree
+        const GuidingField *guiding = nullptr;
+        if (config.integrator.guiding)
+        {
+            if (backend_type_ != BackendType::kCpu ||
+                config.integrator.type == IntegratorType::kBdpt ||
+                config.integrator.type == IntegratorType::kSppm)
+            {
+                fprintf(stderr, "[warning] path guiding only supports 'path' "
+                                "and 'volpath' integrators on CPU backend, "
+                                "ignored.\n");
+            }
+            else if (primary != nullptr)
+            {
+                guiding = primary->sd_tree_->field();
+            }
+            else
+            {
+                sd_tree_ = new SdTree(aabb);
+                guiding = sd_tree_->field();
+            }
+        }
 
-        CommitIntegrator(config.integrator, num_area_light,
+        // RRS 同样只在 CPU 后端估计，场景数据副本共用主渲染器的 RRS 网格
+        const RrsField *rrs = nullptr;
+        if (config.integrator.rrs)
+        {
+            if (backend_type_ != BackendType::kCpu ||
+                config.integrator.type != IntegratorType::kPath)
+            {
+                fprintf(stderr, "[warning] efficiency-aware roulette and "
+                                "splitting only supports 'path' integrator "
+                                "on CPU backend, ignored.\n");
+            }
+            else if (primary != nullptr)
+            {
+                rrs = primary->rrs_cache_->field();
+            }
+            else
+            {
+                rrs_cache_ = new RrsCache(aabb);
+                rrs = rrs_cache_->field();
+            }
+        }
+        // 随机渐进式光子映射只在 CPU 后端逐轮绘制，其它后端改用 volpath
+        IntegratorInfo info_integrator = config.integrator;
+        if (info_integrator.type == IntegratorType::kSppm)
+        {
+            if (backend_type_ != BackendType::kCpu)
+            {
+                fprintf(stderr, "[warning] 'sppm' integrator only supports "
+                                "CPU backend, use 'volpath' instead.\n");
+                info_integrator.type = IntegratorType::kVolPath;
+            }
+            else if (primary == nullptr)
+            {
+                std::vector<uint32_t> infinite_lights;
+                bool has_finite_light = num_area_light > 0;
+                for (uint32_t i = 0; i < config.emitters.size(); ++i)
+                {
+                    if (emitters_[i].IsInfinite())
+                        infinite_lights.push_back(i);
+                    else
+                        has_finite_light = true;
+                }
+                sppm_ = new Sppm(aabb, infinite_lights, has_finite_light,
+                                 info_integrator.sppm_photons,
+                                 info_integrator.sppm_radius,
+                                 info_integrator.sppm_alpha);
+            }
+        }
+        if (info_integrator.ris &&
+            info_integrator.type != IntegratorType::kPath)
+        {
+            fprintf(stderr, "[warning] resampled direct lighting only "
+                            "supports 'path' integrator, ignored.\n");
+            info_integrator.ris = false;
+        }
+        CommitIntegrator(info_integrator, num_area_light,
                          static_cast<uint32_t>(config.emitters.size()), id_sun,
-                         id_envmap);
+                         id_envmap, guiding, rrs);
 
 #ifdef ENABLE_CUDA
         if (backend_type_ == BackendType::kCpu)
         {
 #endif
-            GeneratePatchInfo(camera_->width(), camera_->height());
+            // 场景数据副本只用于绘制，由主渲染器调度
+            if (primary == nullptr)
+            {
+                thread_pool_ = new ThreadPool(config.schedule.num_threads,
+                                              config.schedule.affinity,
+                                              config.schedule.numa);
+                tile_scheduler_ =
+                    new TileScheduler(GetCropWindow(config.camera), tile_size_);
+                integrators_.assign(thread_pool_->num_nodes(), integrator_);
+                if (config.schedule.numa_replicate &&
+                    thread_pool_->num_nodes() > 1)
+                    CommitReplicas(config);
+            }
 #ifdef ENABLE_CUDA
         }
         else
@@ -347,9 +807,57 @@ Renderer::Renderer(const RendererConfig &config)
     }
 }
 
+void Renderer::CommitReplicas(const RendererConfig &config)
+{
+    // 主渲染器的场景数据由主线程分配并首次写入，按照 Linux 的首次访问（first-touch）策略
+    // 位于主线程所在的节点；其它节点各自构建一份副本，构建线程绑定在该节点上，
+    // 副本的内存因而也位于该节点
+    const uint32_t num_nodes = thread_pool_->num_nodes();
+    std::vector<std::vector<int>> nodes(num_nodes);
+    for (uint32_t i = 0; i < num_nodes; ++i)
+        nodes[i] = thread_pool_->node_cpus(i);
+    const uint32_t id_node_primary = GetCurrentNumaNode(nodes);
+
+    // Scene 的构建过程使用文件作用域的图元与节点计数，不能并发，
+    // 因此逐个节点启动构建线程，前一个副本构建完成后再构建下一个
+    replicas_.assign(num_nodes, nullptr);
+    for (uint32_t i = 0; i < num_nodes; ++i)
+    {
+        if (i == id_node_primary)
+            continue;
+        std::string error;
+        std::thread thread(
+            [&, i]()
+            {
+                BindThread(nodes[i]);
+                try
+                {
+                    replicas_[i] = new Renderer(config, this);
+                }
+                catch (const std::exception &e)
+                {
+                    error = e.what();
+                }
+            });
+        thread.join();
+        if (!error.empty())
+            throw MyException(error);
+        integrators_[i] = replicas_[i]->integrator_;
+    }
+    fprintf(stderr, "[info] replicate scene data on %u NUMA nodes.\n",
+            num_nodes);
+}
+
 void Renderer::ReleaseData()
 {
+    for (Renderer *&replica : replicas_)
+        DeleteElement(BackendType::kCpu, replica);
+    DeleteElement(BackendType::kCpu, thread_pool_);
+    DeleteElement(BackendType::kCpu, tile_scheduler_);
     DeleteElement(BackendType::kCpu, scene_);
+    DeleteElement(BackendType::kCpu, sd_tree_);
+    DeleteElement(BackendType::kCpu, rrs_cache_);
+    DeleteElement(BackendType::kCpu, sppm_);
 
     DeleteElement(backend_type_, camera_);
     DeleteArray(backend_type_, textures_);
@@ -361,9 +869,11 @@ void Renderer::ReleaseData()
     DeleteArray(backend_type_, map_instance_bsdf_);
     DeleteArray(backend_type_, map_area_light_instance_);
     DeleteArray(backend_type_, map_instance_area_light_);
-    DeleteArray(backend_type_, cdf_area_light_);
+    DeleteArray(backend_type_, light_bvh_nodes_);
+    DeleteArray(backend_type_, light_bit_trails_);
     DeleteArray(backend_type_, pixels_);
-    DeleteArray(backend_type_, data_env_map_);
+    DeleteArray(backend_type_, env_map_alias_table_);
+    DeleteArray(backend_type_, env_map_pdf_);
     DeleteArray(backend_type_, brdf_avg_buffer_);
     DeleteArray(backend_type_, albedo_avg_buffer_);
 }
@@ -580,41 +1090,140 @@ void Renderer::CommitEmitters(const std::vector<TextureInfo> &list_texture_info,
                     throw MyException(oss.str());
                 }
 
-                std::vector<float> cdf_cols, cdf_rows, weight_rows;
-                float normalization;
-
-                CreateEnvMapCdfPdf(radiance_texture_info.bitmap.width,
-                                   radiance_texture_info.bitmap.height,
-                                   textures_[info.envmap.id_radiance],
-                                   &cdf_cols, &cdf_rows, &weight_rows,
-                                   &normalization);
-
-                DeleteArray(backend_type_, data_env_map_);
-                const uint64_t num_data =
-                    cdf_cols.size() + cdf_rows.size() + weight_rows.size();
-                data_env_map_ = MallocArray<float>(backend_type_, num_data);
-
-                for (uint64_t j = 0; j < cdf_rows.size(); ++j)
-                    data_env_map_[j] = cdf_rows[j];
+                std::vector<AliasEntry> alias_rows, alias_cols;
+                std::vector<float> pdf_map;
+                CreateEnvMapAliasTable(radiance_texture_info.bitmap.width,
+                                       radiance_texture_info.bitmap.height,
+                                       textures_[info.envmap.id_radiance],
+                                       &alias_rows, &alias_cols, &pdf_map);
+
+                // 行、列别名表依次存放在同一块内存中
+                std::vector<AliasEntry> alias_table = alias_rows;
+                alias_table.insert(alias_table.end(), alias_cols.begin(),
+                                   alias_cols.end());
+
+                DeleteArray(backend_type_, env_map_alias_table_);
+                DeleteArray(backend_type_, env_map_pdf_);
+                env_map_alias_table_ =
+                    MallocArray<AliasEntry>(backend_type_, alias_table);
+                env_map_pdf_ = MallocArray<float>(backend_type_, pdf_map);
+
+                emitters_[i].InitEnvMap(
+                    radiance_texture_info.bitmap.width,
+                    radiance_texture_info.bitmap.height, env_map_alias_table_,
+                    env_map_alias_table_ + alias_rows.size(), env_map_pdf_);
+            }
+        }
+    }
+    catch (const MyException &e)
+    {
+        std::ostringstream oss;
+        oss << "error when commit BSDFs to renderer." << e.what();
+        throw MyException(oss.str());
+    }
+}
 
-                uint64_t offset = cdf_rows.size();
-                for (uint64_t j = 0; j < weight_rows.size(); ++j)
-                    data_env_map_[j + offset] = weight_rows[j];
+void Renderer::CommitLightBvh(const RendererConfig &config,
+                              const uint32_t num_area_light)
+{
+    try
+    {
+        const uint32_t num_emitter =
+            static_cast<uint32_t>(config.emitters.size());
+        std::vector<LightBounds> lights(num_emitter + num_area_light);
 
-                offset += weight_rows.size();
-                for (uint64_t j = 0; j < cdf_cols.size(); ++j)
-                    data_env_map_[j + offset] = cdf_cols[j];
+        for (uint32_t i = 0; i < num_emitter; ++i)
+        {
+            const EmitterInfo &info = config.emitters[i];
+            LightBounds &bounds = lights[i];
+            switch (info.type)
+            {
+            case EmitterType::kPoint:
+                // 点光源向各个方向均匀地发光
+                bounds.power =
+                    4.0f * kPi * LinearRgbToLuminance(info.point.intensity);
+                bounds.cos_theta_o = -1;
+                bounds.aabb = AABB(info.point.position, info.point.position);
+                break;
+            case EmitterType::kSpot:
+            {
+                // 聚光灯只在截止角以内发光
+                const Vec3 position =
+                    TransformPoint(info.spot.to_world, {0, 0, 0});
+                bounds.power = k2Pi * (1.0f - cosf(info.spot.cutoff_angle)) *
+                               LinearRgbToLuminance(info.spot.intensity);
+                bounds.axis = Normalize(
+                    TransformVector(info.spot.to_world, {0, 0, 1}));
+                bounds.cos_theta_o = 1;
+                bounds.cos_theta_e = cosf(info.spot.cutoff_angle);
+                bounds.aabb = AABB(position, position);
+                break;
+            }
+            default:
+                break;
+            }
+            bounds.power = fmaxf(bounds.power, 0.0f);
+        }
 
-                emitters_[i].InitEnvMap(radiance_texture_info.bitmap.width,
-                                        radiance_texture_info.bitmap.height,
-                                        normalization, data_env_map_);
+        const std::vector<AABB> &aabbs = scene_->GetAabbList();
+        const Instance *instances = scene_->GetInstances();
+        const float *list_pdf_area = scene_->GetPdfAreaList();
+        constexpr uint32_t num_sample = 256;
+        for (uint32_t i = 0; i < num_area_light; ++i)
+        {
+            const uint32_t id_instance = map_area_light_instance_[i];
+            const InstanceInfo &info = config.instances[id_instance];
+            const Bsdf &bsdf = bsdfs_[info.id_bsdf];
+            LightBounds &bounds = lights[num_emitter + i];
+
+            // 按面积均匀抽样，估计发光表面的平均亮度。亮度为 0 的光源也保留很小的功率，
+            // 以免抽样遗漏纹理中没有被估计到的发光部分
+            float luminance = 0;
+            Vec3 normal = {};
+            for (uint32_t k = 0; k < num_sample; ++k)
+            {
+                const Hit hit = instances[id_instance].Sample(
+                    (k + 0.5f) / num_sample, GetVanDerCorputSequence<2>(k + 1),
+                    GetVanDerCorputSequence<3>(k + 1));
+                luminance += fmaxf(
+                    LinearRgbToLuminance(bsdf.GetRadiance(hit.texcoord)), 0.0f);
+                normal = hit.normal;
+            }
+            luminance = fmaxf(luminance / num_sample, kEpsilonFloat);
+
+            // 面光源以类似漫反射的形式向法线一侧的各个方向均匀地发光
+            bounds.two_sided = bsdf.IsTwosided();
+            bounds.power = kPi * luminance / list_pdf_area[id_instance] *
+                           (bounds.two_sided ? 2.0f : 1.0f);
+            bounds.cos_theta_e = 0;
+            bounds.aabb = aabbs[id_instance];
+            switch (info.type)
+            {
+            case InstanceType::kRectangle:
+            case InstanceType::kDisk:
+                bounds.axis = Normalize(normal);
+                bounds.cos_theta_o = 1;
+                break;
+            case InstanceType::kMeshes:
+                BoundMeshesNormals(info, &bounds.axis, &bounds.cos_theta_o);
+                break;
+            default:
+                bounds.cos_theta_o = -1;
+                break;
             }
         }
+
+        std::vector<uint64_t> bit_trails;
+        const std::vector<LightBvhNode> nodes =
+            BuildLightBvh(lights, &bit_trails);
+        if (!nodes.empty())
+            light_bvh_nodes_ = MallocArray<LightBvhNode>(backend_type_, nodes);
+        light_bit_trails_ = MallocArray<uint64_t>(backend_type_, bit_trails);
     }
     catch (const MyException &e)
     {
         std::ostringstream oss;
-        oss << "error when commit BSDFs to renderer." << e.what();
+        oss << "error when build light BVH.\n\t" << e.what();
         throw MyException(oss.str());
     }
 }
@@ -622,7 +1231,9 @@ void Renderer::CommitEmitters(const std::vector<TextureInfo> &list_texture_info,
 void Renderer::CommitIntegrator(const IntegratorInfo &integrator_info,
                                 const uint32_t num_area_light,
                                 const uint32_t num_emitter,
-                                const uint32_t id_sun, const uint32_t id_envmap)
+                                const uint32_t id_sun, const uint32_t id_envmap,
+                                const GuidingField *guiding,
+                                const RrsField *rrs)
 {
     try
     {
@@ -630,8 +1241,8 @@ void Renderer::CommitIntegrator(const IntegratorInfo &integrator_info,
 
         IntegratorData data_integrator;
         data_integrator.info = integrator_info;
-        data_integrator.size_cdf_area_light = num_area_light + 1;
-        data_integrator.pdf_rr_rcp = integrator_info.pdf_rr;
+        data_integrator.pdf_rr_rcp =
+            integrator_info.pdf_rr > 0 ? 1.0f / integrator_info.pdf_rr : 0;
 
         data_integrator.num_area_light = num_area_light;
         data_integrator.num_emitter = num_emitter;
@@ -646,7 +1257,11 @@ void Renderer::CommitIntegrator(const IntegratorInfo &integrator_info,
         data_integrator.emitters = emitters_;
         data_integrator.map_id_area_light_instance = map_area_light_instance_;
         data_integrator.map_id_instance_area_light = map_instance_area_light_;
-        data_integrator.cdf_area_light = cdf_area_light_;
+        data_integrator.light_bvh =
+            LightBvh(light_bvh_nodes_, light_bit_trails_);
+
+        data_integrator.guiding = guiding;
+        data_integrator.rrs = rrs;
 
         data_integrator.tlas = scene_->GetTlas();
         data_integrator.map_instance_bsdf = map_instance_bsdf_;
@@ -660,6 +1275,13 @@ void Renderer::CommitIntegrator(const IntegratorInfo &integrator_info,
             data_integrator.info.type = IntegratorType::kVolPath;
             data_integrator.media = media_;
             break;
+        case IntegratorType::kBdpt:
+            data_integrator.info.type = IntegratorType::kBdpt;
+            break;
+        case IntegratorType::kSppm:
+            data_integrator.info.type = IntegratorType::kSppm;
+            data_integrator.media = media_;
+            break;
         default:
             throw MyException("unknow integrator type");
             break;
@@ -675,6 +1297,26 @@ void Renderer::CommitIntegrator(const IntegratorInfo &integrator_info,
     }
 }
 
+void Renderer::SetCamera(const Camera::Info &info)
+{
+    const Tile crop = GetCropWindow(info);
+    *camera_ = Camera(info);
+#ifdef ENABLE_CUDA
+    if (backend_type_ == BackendType::kCpu)
+    {
+#endif
+        *tile_scheduler_ = TileScheduler(crop, tile_size_);
+#ifdef ENABLE_CUDA
+    }
+    else
+    {
+        g_num_blocks = {static_cast<unsigned int>(camera_->width() / 8 + 1),
+                        static_cast<unsigned int>(camera_->height() / 8 + 1),
+                        1};
+    }
+#endif
+}
+
 void Renderer::Draw(float *frame) const
 {
     try
@@ -685,7 +1327,26 @@ void Renderer::Draw(float *frame) const
         if (backend_type_ == BackendType::kCpu)
         {
 #endif
-            DispathRaysCpu(camera_, integrator_, frame);
+            Timer timer;
+            TrainGuiding(timer);
+            LearnRrs(timer);
+            Film film(camera_->width(), camera_->height());
+            if (sppm_ != nullptr)
+            {
+                DispathSppmCpu(thread_pool_, tile_scheduler_, camera_,
+                               integrators_.data(), sppm_, camera_->spp(), 0.0,
+                               1.0, timer, nullptr, &film, nullptr, nullptr);
+            }
+            else
+            {
+                DispathRaysCpu(thread_pool_, tile_scheduler_, camera_,
+                               integrators_.data(), nullptr, nullptr,
+                               PartitionInfo(), AdaptiveInfo(), camera_->spp(),
+                               1, 0.0, 1.0, timer, nullptr, &film, nullptr,
+                               nullptr);
+            }
+            film.Resolve(frame);
+            timer.PrintTimePassed("rendering");
 #ifdef ENABLE_CUDA
         }
         else
@@ -720,6 +1381,164 @@ void Renderer::Draw(float *frame) const
     }
 }
 
+uint64_t Renderer::Draw(const uint32_t count_target,
+                        const double progress_begin,
+                        const double progress_end, const Timer &timer,
+                        Film *film, const std::atomic<bool> *stop,
+                        float *frame, const DrawCallbacks *callbacks) const
+{
+    if (backend_type_ != BackendType::kCpu)
+        throw MyException("progressive rendering only supports CPU backend.");
+
+    if (film->width() != static_cast<uint32_t>(camera_->width()) ||
+        film->height() != static_cast<uint32_t>(camera_->height()))
+        throw MyException("film size does not match camera.");
+
+    if (sppm_ != nullptr)
+    {
+        return DispathSppmCpu(thread_pool_, tile_scheduler_, camera_,
+                              integrators_.data(), sppm_, count_target,
+                              progress_begin, progress_end, timer, stop, film,
+                              frame, callbacks);
+    }
+    return DispathRaysCpu(thread_pool_, tile_scheduler_, camera_,
+                          integrators_.data(), nullptr, nullptr, partition_,
+                          adaptive_, count_target, 1, progress_begin,
+                          progress_end, timer, stop, film, frame, callbacks);
+}
+
+uint64_t Renderer::DrawPreview(const uint32_t stride, const Timer &timer,
+                               Film *film,
+                               const std::atomic<bool> *stop) const
+{
+    if (backend_type_ != BackendType::kCpu)
+        throw MyException("preview rendering only supports CPU backend.");
+
+    if (film->width() != static_cast<uint32_t>(camera_->width()) ||
+        film->height() != static_cast<uint32_t>(camera_->height()))
+        throw MyException("film size does not match camera.");
+
+    if (stride == 0)
+        throw MyException("invalid preview stride.");
+
+    if (sppm_ != nullptr)
+        throw MyException("'sppm' integrator does not support preview.");
+
+    return DispathRaysCpu(thread_pool_, tile_scheduler_, camera_,
+                          integrators_.data(), nullptr, nullptr, partition_,
+                          adaptive_, 1, stride, 0.0, 0.0, timer, stop, film,
+                          nullptr, nullptr);
+}
+
+uint64_t Renderer::DrawRegion(const Tile &region, const uint32_t count_target,
+                              const double progress_begin,
+                              const double progress_end, const Timer &timer,
+                              Film *film,
+                              const std::atomic<bool> *stop) const
+{
+    if (backend_type_ != BackendType::kCpu)
+        throw MyException("region rendering only supports CPU backend.");
+
+    if (film->width() != static_cast<uint32_t>(camera_->width()) ||
+        region.x_end > film->width() || region.y_begin < film->y_begin() ||
+        region.y_end > film->y_begin() + film->height() ||
+        region.y_end > static_cast<uint32_t>(camera_->height()))
+        throw MyException("film does not cover the region.");
+
+    if (sppm_ != nullptr)
+        throw MyException("'sppm' integrator does not support region "
+                          "rendering.");
+
+    TileScheduler tile_scheduler(region, tile_size_);
+    return DispathRaysCpu(thread_pool_, &tile_scheduler, camera_,
+                          integrators_.data(), nullptr, nullptr,
+                          PartitionInfo(), adaptive_, count_target, 1,
+                          progress_begin, progress_end, timer, stop, film,
+                          nullptr, nullptr);
+}
+
+void Renderer::TrainGuiding(const Timer &timer,
+                            const std::atomic<bool> *stop) const
+{
+    if (sd_tree_ == nullptr)
+        return;
+
+    // 第 k 轮为每个像素绘制 2^k 个样本，样本序号从 2^31 开始，与正式绘制的样本不重叠。
+    // 训练结果不需要保留，按行带绘制以限制内存占用
+    sd_tree_->Reset();
+    const Tile &crop = tile_scheduler_->region();
+    uint32_t spp_total = 0;
+    bool stopped = false;
+    for (uint32_t k = 0; k < guiding_passes_; ++k)
+    {
+        const uint32_t spp = 1u << k;
+        for (uint32_t y_begin = crop.y_begin; y_begin < crop.y_end;
+             y_begin += kPrepassBandHeight)
+        {
+            Tile band = crop;
+            band.y_begin = y_begin;
+            band.y_end = std::min(y_begin + kPrepassBandHeight, crop.y_end);
+            TileScheduler tile_scheduler(band, tile_size_);
+            Film film(camera_->width(), band.y_end - band.y_begin,
+                      0x80000000u + spp_total, band.y_begin);
+            DispathRaysCpu(thread_pool_, &tile_scheduler, camera_,
+                           integrators_.data(), sd_tree_, nullptr,
+                           PartitionInfo(), AdaptiveInfo(), spp, 1, 0.0, 0.0,
+                           timer, stop, &film, nullptr, nullptr);
+            stopped = stop != nullptr && stop->load();
+            if (stopped)
+                break;
+        }
+        if (stopped)
+            break;
+        sd_tree_->Update(spp);
+        spp_total += spp;
+    }
+    fprintf(stderr, "[info] train path guiding with %u spp.\n", spp_total);
+}
+
+void Renderer::LearnRrs(const Timer &timer,
+                        const std::atomic<bool> *stop) const
+{
+    if (rrs_cache_ == nullptr)
+        return;
+
+    // 样本序号从 3 × 2^30 开始，与正式绘制及训练路径引导的样本都不重叠。
+    // 估计期间没有像素亮度估计，使用固定概率的俄罗斯轮盘赌
+    rrs_cache_->Reset(camera_->width(), camera_->height());
+    const Tile &crop = tile_scheduler_->region();
+    for (uint32_t y_begin = crop.y_begin; y_begin < crop.y_end;
+         y_begin += kPrepassBandHeight)
+    {
+        Tile band = crop;
+        band.y_begin = y_begin;
+        band.y_end = std::min(y_begin + kPrepassBandHeight, crop.y_end);
+        TileScheduler tile_scheduler(band, tile_size_);
+        Film film(camera_->width(), band.y_end - band.y_begin, 0xC0000000u,
+                  band.y_begin);
+        DispathRaysCpu(thread_pool_, &tile_scheduler, camera_,
+                       integrators_.data(), nullptr, rrs_cache_,
+                       PartitionInfo(), AdaptiveInfo(), rrs_spp_, 1, 0.0,
+                       0.0, timer, stop, &film, nullptr, nullptr);
+        if (stop != nullptr && stop->load())
+            return;
+        for (uint32_t j = band.y_begin; j < band.y_end; ++j)
+        {
+            for (uint32_t i = band.x_begin; i < band.x_end; ++i)
+            {
+                const float *stats = film.luminance_stats(i, j);
+                const uint32_t count = *film.count(i, j);
+                rrs_cache_->SetPixel(i, j, stats[0],
+                                     count > 1 ? stats[1] / (count - 1) : 0);
+            }
+        }
+    }
+    rrs_cache_->Build(crop.x_begin, crop.y_begin, crop.x_end, crop.y_end);
+    fprintf(stderr,
+            "[info] estimate pixels for roulette and splitting with %u spp.\n",
+            rrs_spp_);
+}
+
 #ifdef ENABLE_VIEWER
 void Renderer::Draw(const uint32_t index_frame, float *frame,
                     float *frame_srgb) const
@@ -0,0 +1,191 @@
+#include "csrt/renderer/sampler.hpp"
+
+namespace
+{
+
+using namespace csrt;
+
+QUALIFIER_D_H uint32_t ReverseBits(uint32_t x)
+{
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+    x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+// MurmurHash3 的 64 位终混函数
+QUALIFIER_D_H uint64_t MixBits(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+QUALIFIER_D_H uint32_t HashUint(const uint32_t a, const uint32_t b)
+{
+    return static_cast<uint32_t>(
+        MixBits((static_cast<uint64_t>(a) << 32) | b) >> 32);
+}
+
+// Owen 扰乱：对 x 的每一位按其更高位的取值随机翻转。
+// 参考 Burley, "Practical Hash-based Owen Scrambling", JCGT 2020
+QUALIFIER_D_H uint32_t NestedUniformScramble(uint32_t x, const uint32_t seed)
+{
+    x = ReverseBits(x);
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return ReverseBits(x);
+}
+
+// Sobol 序列的第 2 维，本原多项式为 x + 1
+QUALIFIER_D_H uint32_t SobolSecondDimension(uint32_t index)
+{
+    uint32_t result = 0;
+    for (uint32_t v = 1u << 31; index != 0; index >>= 1, v ^= v >> 1)
+    {
+        if (index & 1)
+            result ^= v;
+    }
+    return result;
+}
+
+QUALIFIER_D_H float ToUnitFloat(const uint32_t x)
+{
+    return static_cast<float>(x >> 8) / static_cast<float>(0x01000000u);
+}
+
+QUALIFIER_D_H uint32_t Log2Ceil(const uint32_t x)
+{
+    uint32_t result = 0;
+    while (result < 32 && (1ull << result) < x)
+        ++result;
+    return result;
+}
+
+// 将 (i, j) 的各位交错，i 占偶数位
+QUALIFIER_D_H uint64_t EncodeMorton(const uint32_t i, const uint32_t j)
+{
+    uint64_t result = 0;
+    for (uint32_t k = 0; k < 32; ++k)
+    {
+        result |= static_cast<uint64_t>((i >> k) & 1) << (2 * k);
+        result |= static_cast<uint64_t>((j >> k) & 1) << (2 * k + 1);
+    }
+    return result;
+}
+
+// {0, 1, 2, 3} 的 24 种排列中的第 p 种（按 Lehmer 码解码）作用于 digit
+QUALIFIER_D_H uint32_t PermuteDigit(uint32_t p, const uint32_t digit)
+{
+    uint32_t items[4] = {0, 1, 2, 3}, permutation[4] = {};
+    uint32_t factorial = 6;
+    for (uint32_t k = 0; k < 4; ++k)
+    {
+        const uint32_t index = p / factorial;
+        p %= factorial;
+        permutation[k] = items[index];
+        for (uint32_t m = index; m + 1 < 4 - k; ++m)
+            items[m] = items[m + 1];
+        if (k < 3)
+            factorial /= 3 - k;
+    }
+    return permutation[digit];
+}
+
+} // namespace
+
+namespace csrt
+{
+
+QUALIFIER_D_H Sampler::Sampler(const SamplerType type, const uint32_t i,
+                               const uint32_t j, const uint32_t s,
+                               const uint32_t width, const uint32_t height,
+                               const uint32_t spp)
+    : type_(type), dimension_(0), seed_(Tea<4>((j * width + i) * 3, s)),
+      scramble_(0), index_(s), num_base4_digits_(0), log2_spp_(0)
+{
+    if (type_ == SamplerType::kZSobol)
+    {
+        const uint32_t log2_resolution =
+                           Log2Ceil(width > height ? width : height),
+                       log2_spp = Log2Ceil(spp);
+        if (2 * log2_resolution + log2_spp <= 32 && (1ull << log2_spp) > s)
+        {
+            log2_spp_ = log2_spp;
+            num_base4_digits_ = log2_resolution + (log2_spp + 1) / 2;
+            index_ = static_cast<uint32_t>(
+                (EncodeMorton(i, j) << log2_spp) | s);
+            return;
+        }
+        type_ = SamplerType::kSobol;
+    }
+    if (type_ == SamplerType::kSobol)
+        scramble_ = HashUint(j * width + i, 0x9e3779b9u);
+}
+
+QUALIFIER_D_H float Sampler::Next1D()
+{
+    if (type_ == SamplerType::kIndependent)
+        return RandomFloat(&seed_);
+
+    const uint32_t hash = HashUint(scramble_, dimension_),
+                   index = GetSobolIndex(hash);
+    ++dimension_;
+    return ToUnitFloat(
+        NestedUniformScramble(ReverseBits(index), HashUint(hash, 1)));
+}
+
+QUALIFIER_D_H Vec2 Sampler::Next2D()
+{
+    if (type_ == SamplerType::kIndependent)
+    {
+        const float u = RandomFloat(&seed_);
+        return {u, RandomFloat(&seed_)};
+    }
+
+    const uint32_t hash = HashUint(scramble_, dimension_),
+                   index = GetSobolIndex(hash);
+    ++dimension_;
+    return {ToUnitFloat(NestedUniformScramble(ReverseBits(index),
+                                              HashUint(hash, 1))),
+            ToUnitFloat(NestedUniformScramble(SobolSecondDimension(index),
+                                              HashUint(hash, 2)))};
+}
+
+QUALIFIER_D_H uint32_t Sampler::GetSobolIndex(const uint32_t hash) const
+{
+    // 每个维度对样本序号做不同的 Owen 扰乱，相当于打乱样本的顺序，使各维度互不相关
+    if (type_ == SamplerType::kSobol)
+        return NestedUniformScramble(index_, hash);
+
+    // 按维度随机地排列 Morton 码中以 4 为底的每一位，排列只取决于更高的位。
+    // 相邻像素的样本序号因而构成 Sobol 序列中连续的一段，误差呈蓝噪声分布。
+    // 参考 Ahmed and Wonka, "Screen-Space Blue-Noise Diffusion of Monte Carlo
+    // Sampling Error via Hierarchical Ordering of Pixels", SIGGRAPH Asia 2020
+    const uint64_t morton = index_,
+                   salt = 0x55555555ull * dimension_;
+    const bool odd = (log2_spp_ & 1) != 0;
+    uint64_t result = 0;
+    for (int k = static_cast<int>(num_base4_digits_) - 1; k >= (odd ? 1 : 0);
+         --k)
+    {
+        const int shift = 2 * k - (odd ? 1 : 0);
+        const uint32_t digit = static_cast<uint32_t>((morton >> shift) & 3),
+                       p = static_cast<uint32_t>(
+                           (MixBits((morton >> (shift + 2)) ^ salt) >> 24) %
+                           24);
+        result |= static_cast<uint64_t>(PermuteDigit(p, digit)) << shift;
+    }
+    if (odd)
+        result |= (morton & 1) ^ (MixBits((morton >> 1) ^ salt) & 1);
+    return static_cast<uint32_t>(result);
+}
+
+} // namespace csrt
\ No newline at end of file
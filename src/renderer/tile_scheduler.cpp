@@ -0,0 +1,65 @@
+#include "csrt/renderer/tile_scheduler.hpp"
+
+#include <algorithm>
+
+namespace
+{
+
+uint32_t CompactBits(uint64_t x)
+{
+    x &= 0x5555555555555555ull;
+    x = (x | (x >> 1)) & 0x3333333333333333ull;
+    x = (x | (x >> 2)) & 0x0f0f0f0f0f0f0f0full;
+    x = (x | (x >> 4)) & 0x00ff00ff00ff00ffull;
+    x = (x | (x >> 8)) & 0x0000ffff0000ffffull;
+    x = (x | (x >> 16)) & 0x00000000ffffffffull;
+    return static_cast<uint32_t>(x);
+}
+
+} // namespace
+
+namespace csrt
+{
+
+TileScheduler::TileScheduler(const Tile &region, const uint32_t tile_size)
+    : region_(region), tile_size_(std::max(1u, tile_size)), log2_block_(0)
+{
+    const uint32_t width = region_.x_end - region_.x_begin,
+                   height = region_.y_end - region_.y_begin;
+    num_tile_x_ = (width + tile_size_ - 1) / tile_size_;
+    num_tile_y_ = (height + tile_size_ - 1) / tile_size_;
+
+    // 块的边长取不超过图块网格较短边的最大的 2 的幂，填充的下标不超过实际图块数量的 3 倍
+    const uint32_t num_tile_min =
+        std::max(1u, std::min(num_tile_x_, num_tile_y_));
+    while ((2u << log2_block_) <= num_tile_min)
+        ++log2_block_;
+    const uint32_t size_block = 1u << log2_block_;
+    num_block_x_ = (num_tile_x_ + size_block - 1) / size_block;
+    const uint32_t num_block_y = (num_tile_y_ + size_block - 1) / size_block;
+    num_task_ = static_cast<uint64_t>(num_block_x_) * num_block_y *
+                size_block * size_block;
+}
+
+bool TileScheduler::GetTile(const uint64_t id_task, Tile *tile) const
+{
+    const uint64_t id_block = id_task >> (2 * log2_block_),
+                   morton = id_task & ((1ull << (2 * log2_block_)) - 1);
+    const uint32_t x = static_cast<uint32_t>(id_block % num_block_x_)
+                           << log2_block_ |
+                       CompactBits(morton),
+                   y = static_cast<uint32_t>(id_block / num_block_x_)
+                           << log2_block_ |
+                       CompactBits(morton >> 1);
+    if (x >= num_tile_x_ || y >= num_tile_y_)
+        return false;
+
+    tile->x_begin = region_.x_begin + x * tile_size_;
+    tile->y_begin = region_.y_begin + y * tile_size_;
+    tile->x_end = std::min(tile->x_begin + tile_size_, region_.x_end);
+    tile->y_end = std::min(tile->y_begin + tile_size_, region_.y_end);
+    tile->id = static_cast<uint64_t>(y) * num_tile_x_ + x;
+    return true;
+}
+
+} // namespace csrt
\ No newline at end of file
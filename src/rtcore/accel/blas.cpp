@@ -97,4 +97,36 @@ QUALIFIER_D_H Hit BLAS::Sample(const float xi_0, const float xi_1,
     return primitives_[node->id_object].Sample(xi_1, xi_2);
 }
 
+QUALIFIER_D_H Hit BLAS::Sample(const Vec3 &origin, const float xi_0,
+                               const float xi_1, const float xi_2,
+                               float *pdf) const
+{
+    const BvhNode *node = nodes_;
+    float thresh = node->area * xi_0;
+    while (!node->leaf)
+    {
+        if (thresh < nodes_[node->id_left].area)
+        {
+            node = nodes_ + node->id_left;
+        }
+        else
+        {
+            thresh -= nodes_[node->id_left].area;
+            node = nodes_ + node->id_right;
+        }
+    }
+
+    const Hit hit = primitives_[node->id_object].Sample(origin, xi_1, xi_2,
+                                                        pdf);
+    *pdf *= node->area / nodes_->area;
+    return hit;
+}
+
+QUALIFIER_D_H float BLAS::Pdf(const Vec3 &origin, const Hit &hit) const
+{
+    const Primitive &primitive = primitives_[hit.id_primitve];
+    return primitive.Pdf(origin, hit.position) * primitive.area() /
+           nodes_->area;
+}
+
 } // namespace csrt
\ No newline at end of file
@@ -59,4 +59,16 @@ QUALIFIER_D_H Hit Instance::Sample(const float xi_0, const float xi_1,
     return blas_->Sample(xi_0, xi_1, xi_2);
 }
 
+QUALIFIER_D_H Hit Instance::Sample(const Vec3 &origin, const float xi_0,
+                                   const float xi_1, const float xi_2,
+                                   float *pdf) const
+{
+    return blas_->Sample(origin, xi_0, xi_1, xi_2, pdf);
+}
+
+QUALIFIER_D_H float Instance::Pdf(const Vec3 &origin, const Hit &hit) const
+{
+    return blas_->Pdf(origin, hit);
+}
+
 } // namespace csrt
\ No newline at end of file
@@ -18,6 +18,11 @@ QUALIFIER_D_H AABB GetAabbCylinder(const CylinderData &data)
     return aabb;
 }
 
+QUALIFIER_D_H float GetAreaCylinder(const CylinderData &data)
+{
+    return k2Pi * data.radius * data.length;
+}
+
 QUALIFIER_D_H bool IntersectCylinder(const uint32_t id_primitive,
                                      const CylinderData &data, Bsdf *bsdf,
                                      uint32_t *seed, Ray *ray, Hit *hit)
@@ -104,4 +109,61 @@ QUALIFIER_D_H Hit SampleCylinder(const uint32_t id_primitive,
     return Hit(id_primitive, texcoord, position, normal);
 }
 
+QUALIFIER_D_H Hit SampleCylinder(const uint32_t id_primitive,
+                                 const CylinderData &data, const Vec3 &origin,
+                                 const float xi_0, const float xi_1,
+                                 float *pdf)
+{
+    // origin 位于圆柱面之外时，只有方位角在 phi_center ± phi_half 之内的一侧朝向 origin
+    const Vec3 origin_local = TransformPoint(data.to_world.Inverse(), origin);
+    const float rho = sqrtf(Sqr(origin_local.x) + Sqr(origin_local.y));
+    float phi_center = 0, phi_half = kPi;
+    if (rho > data.radius)
+    {
+        phi_center = atan2f(origin_local.y, origin_local.x);
+        phi_half = acosf(data.radius / rho);
+    }
+
+    const float phi = phi_center + (2.0f * xi_0 - 1.0f) * phi_half,
+                z = xi_1 * data.length;
+    const Vec3 position_local = {cosf(phi) * data.radius,
+                                 sinf(phi) * data.radius, z};
+    const Vec2 texcoord = {atan2f(position_local.y, position_local.x) *
+                               k1Div2Pi,
+                           xi_1};
+    const Vec3 position = TransformPoint(data.to_world, position_local);
+    const Mat4 normal_to_world = data.to_world.Transpose().Inverse();
+    const Vec3 normal = Normalize(
+        TransformVector(normal_to_world, {cosf(phi), sinf(phi), 0}));
+
+    const float pdf_area = 1.0f / (2.0f * phi_half * data.radius * data.length);
+    *pdf = PdfAreaToSolidAngle(pdf_area, origin, position, normal);
+    return Hit(id_primitive, texcoord, position, normal);
+}
+
+QUALIFIER_D_H float PdfCylinder(const CylinderData &data, const Vec3 &origin,
+                                const Vec3 &position)
+{
+    const Mat4 to_local = data.to_world.Inverse();
+    const Vec3 origin_local = TransformPoint(to_local, origin),
+               position_local = TransformPoint(to_local, position);
+    const float rho = sqrtf(Sqr(origin_local.x) + Sqr(origin_local.y));
+    float phi_half = kPi;
+    if (rho > data.radius)
+    {
+        // 背向 origin 的一侧不会被抽样
+        if (position_local.x * origin_local.x +
+                position_local.y * origin_local.y <
+            Sqr(data.radius))
+            return 0;
+        phi_half = acosf(data.radius / rho);
+    }
+
+    const Mat4 normal_to_world = data.to_world.Transpose().Inverse();
+    const Vec3 normal = Normalize(TransformVector(
+        normal_to_world, {position_local.x, position_local.y, 0}));
+    const float pdf_area = 1.0f / (2.0f * phi_half * data.radius * data.length);
+    return PdfAreaToSolidAngle(pdf_area, origin, position, normal);
+}
+
 } // namespace csrt
\ No newline at end of file
@@ -14,6 +14,13 @@ QUALIFIER_D_H AABB GetAabbDisk(const DiskData &data)
     return aabb;
 }
 
+QUALIFIER_D_H float GetAreaDisk(const DiskData &data)
+{
+    const Vec3 center = TransformPoint(data.to_world, Vec3{0}),
+               boundary = TransformPoint(data.to_world, Vec3{0.5f, 0, 0});
+    return kPi * Sqr(Length(boundary - center));
+}
+
 QUALIFIER_D_H bool IntersectDisk(const uint32_t id_primitive,
                                  const DiskData &data, Bsdf *bsdf,
                                  uint32_t *seed, Ray *ray, Hit *hit)
@@ -141,4 +148,35 @@ QUALIFIER_D_H Hit SampleDisk(const uint32_t id_primitive, const DiskData &data,
     return Hit(id_primitive, texcoord, position, normal);
 }
 
+QUALIFIER_D_H Hit SampleDisk(const uint32_t id_primitive, const DiskData &data,
+                             const Vec3 &origin, const float xi_0,
+                             const float xi_1, float *pdf)
+{
+    const Vec3 origin_local = TransformPoint(data.to_world.Inverse(), origin);
+    if (origin_local.z <= 0.0f)
+    {
+        *pdf = 0;
+        return {};
+    }
+
+    Hit hit = SampleDisk(id_primitive, data, xi_0, xi_1);
+    hit.normal = Normalize(hit.normal);
+    *pdf = PdfAreaToSolidAngle(1.0f / GetAreaDisk(data), origin, hit.position,
+                               hit.normal);
+    return hit;
+}
+
+QUALIFIER_D_H float PdfDisk(const DiskData &data, const Vec3 &origin,
+                            const Vec3 &position)
+{
+    const Vec3 origin_local = TransformPoint(data.to_world.Inverse(), origin);
+    if (origin_local.z <= 0.0f)
+        return 0;
+
+    const Mat4 normal_to_world = data.to_world.Transpose().Inverse();
+    const Vec3 normal = Normalize(TransformVector(normal_to_world, {0, 0, 1}));
+    return PdfAreaToSolidAngle(1.0f / GetAreaDisk(data), origin, position,
+                               normal);
+}
+
 } // namespace csrt
\ No newline at end of file
@@ -81,6 +81,26 @@ QUALIFIER_D_H AABB Primitive::aabb() const
     return {};
 }
 
+QUALIFIER_D_H float Primitive::area() const
+{
+    switch (data_.type)
+    {
+    case PrimitiveType::kTriangle:
+        return GetAreaTriangle(data_.triangle);
+        break;
+    case PrimitiveType::kSphere:
+        return GetAreaSphere(data_.sphere);
+        break;
+    case PrimitiveType::kDisk:
+        return GetAreaDisk(data_.disk);
+        break;
+    case PrimitiveType::kCylinder:
+        return GetAreaCylinder(data_.cylinder);
+        break;
+    }
+    return 0;
+}
+
 QUALIFIER_D_H bool Primitive::Intersect(Bsdf *bsdf, uint32_t *seed, Ray *ray,
                                         Hit *hit) const
 {
@@ -122,4 +142,46 @@ QUALIFIER_D_H Hit Primitive::Sample(const float xi_0, const float xi_1) const
     return {};
 }
 
+QUALIFIER_D_H Hit Primitive::Sample(const Vec3 &origin, const float xi_0,
+                                    const float xi_1, float *pdf) const
+{
+    switch (data_.type)
+    {
+    case PrimitiveType::kTriangle:
+        return SampleTriangle(id_, data_.triangle, origin, xi_0, xi_1, pdf);
+        break;
+    case PrimitiveType::kSphere:
+        return SampleSphere(id_, data_.sphere, origin, xi_0, xi_1, pdf);
+        break;
+    case PrimitiveType::kDisk:
+        return SampleDisk(id_, data_.disk, origin, xi_0, xi_1, pdf);
+        break;
+    case PrimitiveType::kCylinder:
+        return SampleCylinder(id_, data_.cylinder, origin, xi_0, xi_1, pdf);
+        break;
+    }
+    return {};
+}
+
+QUALIFIER_D_H float Primitive::Pdf(const Vec3 &origin,
+                                   const Vec3 &position) const
+{
+    switch (data_.type)
+    {
+    case PrimitiveType::kTriangle:
+        return PdfTriangle(data_.triangle, origin, position);
+        break;
+    case PrimitiveType::kSphere:
+        return PdfSphere(data_.sphere, origin, position);
+        break;
+    case PrimitiveType::kDisk:
+        return PdfDisk(data_.disk, origin, position);
+        break;
+    case PrimitiveType::kCylinder:
+        return PdfCylinder(data_.cylinder, origin, position);
+        break;
+    }
+    return 0;
+}
+
 } // namespace csrt
\ No newline at end of file
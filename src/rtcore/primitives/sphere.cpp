@@ -3,6 +3,39 @@
 #include "csrt/renderer/bsdfs/bsdf.hpp"
 #include "csrt/utils.hpp"
 
+namespace
+{
+
+using namespace csrt;
+
+// sin^2(1.5°)，球面张成的圆锥更窄时使用泰勒展开，避免 1 - cos_theta_max 的精度损失
+constexpr float kSinThetaMaxSqrSmall = 0.00068523f;
+
+// 球面在世界坐标系下的球心和半径，to_world 不含非均匀缩放
+QUALIFIER_D_H void GetSphereWorld(const SphereData &data, Vec3 *center,
+                                  float *radius)
+{
+    *center = TransformPoint(data.to_world, data.center);
+    const Vec3 boundary = TransformPoint(
+        data.to_world, data.center + Vec3{data.radius, 0.0f, 0.0f});
+    *radius = Length(boundary - *center);
+}
+
+// 从 origin 处观察时，球面张成的圆锥的半顶角的正弦值的平方，以及 1 - cos_theta_max
+QUALIFIER_D_H void GetSphereCone(const float distance_sqr, const float radius,
+                                 float *sin_theta_max_sqr,
+                                 float *one_minus_cos_theta_max)
+{
+    *sin_theta_max_sqr = Sqr(radius) / distance_sqr;
+    if (*sin_theta_max_sqr < kSinThetaMaxSqrSmall)
+        *one_minus_cos_theta_max = 0.5f * *sin_theta_max_sqr;
+    else
+        *one_minus_cos_theta_max =
+            1.0f - sqrtf(fmaxf(0.0f, 1.0f - *sin_theta_max_sqr));
+}
+
+} // namespace
+
 namespace csrt
 {
 
@@ -14,6 +47,14 @@ QUALIFIER_D_H AABB GetAabbSphere(const SphereData &data)
     return aabb;
 }
 
+QUALIFIER_D_H float GetAreaSphere(const SphereData &data)
+{
+    Vec3 center;
+    float radius;
+    GetSphereWorld(data, &center, &radius);
+    return 4.0f * kPi * Sqr(radius);
+}
+
 QUALIFIER_D_H bool IntersectSphere(const uint32_t id_primitive,
                                    const SphereData &data, Bsdf *bsdf,
                                    uint32_t *seed, Ray *ray, Hit *hit)
@@ -105,4 +146,81 @@ QUALIFIER_D_H Hit SampleSphere(const uint32_t id_primitive,
     return Hit(id_primitive, texcoord, position, normal);
 }
 
+QUALIFIER_D_H Hit SampleSphere(const uint32_t id_primitive,
+                               const SphereData &data, const Vec3 &origin,
+                               const float xi_0, const float xi_1, float *pdf)
+{
+    Vec3 center;
+    float radius;
+    GetSphereWorld(data, &center, &radius);
+    const Vec3 d_vec = center - origin;
+    const float distance_sqr = Dot(d_vec, d_vec);
+    if (distance_sqr <= Sqr(radius))
+    { // origin 位于球面之内，按表面积均匀抽样
+        Hit hit = SampleSphere(id_primitive, data, xi_0, xi_1);
+        hit.normal = Normalize(hit.normal);
+        *pdf = PdfAreaToSolidAngle(1.0f / GetAreaSphere(data), origin,
+                                   hit.position, hit.normal);
+        return hit;
+    }
+
+    // 在球面张成的圆锥内抽样方向，theta 为抽样方向与圆锥轴线的夹角
+    float sin_theta_max_sqr, one_minus_cos_theta_max;
+    GetSphereCone(distance_sqr, radius, &sin_theta_max_sqr,
+                  &one_minus_cos_theta_max);
+    float cos_theta, sin_theta_sqr;
+    if (sin_theta_max_sqr < kSinThetaMaxSqrSmall)
+    {
+        sin_theta_sqr = sin_theta_max_sqr * xi_0;
+        cos_theta = sqrtf(1.0f - sin_theta_sqr);
+    }
+    else
+    {
+        cos_theta = 1.0f - one_minus_cos_theta_max * xi_0;
+        sin_theta_sqr = 1.0f - Sqr(cos_theta);
+    }
+
+    // 抽样方向与球面的交点处的法线，它与球心指向 origin 的方向的夹角为 alpha
+    const float cos_alpha =
+                    sin_theta_sqr / sqrtf(sin_theta_max_sqr) +
+                    cos_theta * sqrtf(fmaxf(
+                                    0.0f, 1.0f - sin_theta_sqr /
+                                                     sin_theta_max_sqr)),
+                sin_alpha = sqrtf(fmaxf(0.0f, 1.0f - Sqr(cos_alpha))),
+                phi = k2Pi * xi_1;
+    const Vec3 normal =
+        LocalToWorld({sin_alpha * cosf(phi), sin_alpha * sinf(phi), cos_alpha},
+                     -d_vec / sqrtf(distance_sqr));
+    const Vec3 position = center + radius * normal;
+
+    float theta_local, phi_local;
+    const Vec3 position_local =
+        TransformPoint(data.to_world.Inverse(), position) - data.center;
+    CartesianToSpherical(position_local, &theta_local, &phi_local, nullptr);
+    const Vec2 texcoord = {phi_local * k1Div2Pi, theta_local * k1DivPi};
+
+    *pdf = 1.0f / (k2Pi * one_minus_cos_theta_max);
+    return Hit(id_primitive, texcoord, position, normal);
+}
+
+QUALIFIER_D_H float PdfSphere(const SphereData &data, const Vec3 &origin,
+                              const Vec3 &position)
+{
+    Vec3 center;
+    float radius;
+    GetSphereWorld(data, &center, &radius);
+    const Vec3 d_vec = center - origin;
+    const float distance_sqr = Dot(d_vec, d_vec);
+    if (distance_sqr <= Sqr(radius))
+    {
+        return PdfAreaToSolidAngle(1.0f / GetAreaSphere(data), origin,
+                                   position, Normalize(position - center));
+    }
+
+    float sin_theta_max_sqr, one_minus_cos_theta_max;
+    GetSphereCone(distance_sqr, radius, &sin_theta_max_sqr,
+                  &one_minus_cos_theta_max);
+    return 1.0f / (k2Pi * one_minus_cos_theta_max);
+}
+
 } // namespace csrt
\ No newline at end of file
@@ -3,6 +3,113 @@
 #include "csrt/renderer/bsdfs/bsdf.hpp"
 #include "csrt/utils.hpp"
 
+namespace
+{
+
+using namespace csrt;
+
+// 球面三角形的面积（立体角）不在此范围之内时，按立体角抽样的数值误差较大
+constexpr float kMinSphericalTriangleArea = 3e-4f;
+constexpr float kMaxSphericalTriangleArea = 6.22f;
+
+QUALIFIER_D_H float SafeSqrt(const float x)
+{
+    return sqrtf(fmaxf(0.0f, x));
+}
+
+// 两个单位向量之间的夹角，夹角很小或接近 pi 时仍然精确
+QUALIFIER_D_H float AngleBetween(const Vec3 &v1, const Vec3 &v2)
+{
+    if (Dot(v1, v2) < 0.0f)
+        return kPi - 2.0f * asinf(fminf(1.0f, Length(v1 + v2) * 0.5f));
+    else
+        return 2.0f * asinf(fminf(1.0f, Length(v2 - v1) * 0.5f));
+}
+
+// 从 origin 处观察时，三角形张成的球面三角形的面积
+QUALIFIER_D_H float GetSphericalTriangleArea(const TriangleData &data,
+                                             const Vec3 &origin)
+{
+    const Vec3 a = Normalize(data.positions[0] - origin),
+               b = Normalize(data.positions[1] - origin),
+               c = Normalize(data.positions[2] - origin);
+    return fabsf(2.0f * atan2f(Dot(a, Cross(b, c)),
+                               1.0f + Dot(a, b) + Dot(a, c) + Dot(b, c)));
+}
+
+// 按立体角均匀地抽样球面三角形，返回抽样方向对应的三角形上的点的重心坐标，
+// 参考 Arvo, "Stratified Sampling of Spherical Triangles", SIGGRAPH 1995
+QUALIFIER_D_H bool SampleSphericalTriangle(const TriangleData &data,
+                                           const Vec3 &origin,
+                                           const float xi_0, const float xi_1,
+                                           Vec3 *barycentric)
+{
+    const Vec3 a = Normalize(data.positions[0] - origin),
+               b = Normalize(data.positions[1] - origin),
+               c = Normalize(data.positions[2] - origin);
+    Vec3 n_ab = Cross(a, b), n_bc = Cross(b, c), n_ca = Cross(c, a);
+    if (Dot(n_ab, n_ab) == 0.0f || Dot(n_bc, n_bc) == 0.0f ||
+        Dot(n_ca, n_ca) == 0.0f)
+        return false;
+    n_ab = Normalize(n_ab);
+    n_bc = Normalize(n_bc);
+    n_ca = Normalize(n_ca);
+
+    // 球面三角形的三个内角及其面积
+    const float alpha = AngleBetween(n_ab, -n_ca),
+                beta = AngleBetween(n_bc, -n_ab),
+                gamma = AngleBetween(n_ca, -n_bc);
+    const float area = alpha + beta + gamma - kPi;
+    if (area <= 0.0f)
+        return false;
+
+    // 按面积比例 xi_0 确定子球面三角形的顶点 c'
+    const float area_sub = kPi + xi_0 * area,
+                cos_alpha = cosf(alpha), sin_alpha = sinf(alpha),
+                sin_phi = sinf(area_sub) * cos_alpha -
+                          cosf(area_sub) * sin_alpha,
+                cos_phi = cosf(area_sub) * cos_alpha +
+                          sinf(area_sub) * sin_alpha,
+                k1 = cos_phi + cos_alpha,
+                k2 = sin_phi - sin_alpha * Dot(a, b),
+                cos_b_prime = fminf(
+                    1.0f, fmaxf(-1.0f, (k2 + (k2 * cos_phi - k1 * sin_phi) *
+                                                 cos_alpha) /
+                                           ((k2 * sin_phi + k1 * cos_phi) *
+                                            sin_alpha))),
+                sin_b_prime = SafeSqrt(1.0f - Sqr(cos_b_prime));
+    const Vec3 c_prime =
+        cos_b_prime * a + sin_b_prime * Normalize(c - Dot(c, a) * a);
+
+    // 在 b 与 c' 之间的大圆弧上按 xi_1 确定抽样方向
+    const float cos_theta = 1.0f - xi_1 * (1.0f - Dot(c_prime, b)),
+                sin_theta = SafeSqrt(1.0f - Sqr(cos_theta));
+    const Vec3 dir = cos_theta * b +
+                     sin_theta * Normalize(c_prime - Dot(c_prime, b) * b);
+
+    // 抽样方向与三角形的交点的重心坐标
+    const Vec3 v0v1 = data.positions[1] - data.positions[0],
+               v0v2 = data.positions[2] - data.positions[0],
+               s1 = Cross(dir, v0v2);
+    const float divisor = Dot(s1, v0v1);
+    if (divisor == 0.0f)
+        return false;
+    const Vec3 s = origin - data.positions[0];
+    float u = Dot(s, s1) / divisor, v = Dot(dir, Cross(s, v0v1)) / divisor;
+    u = fminf(1.0f, fmaxf(0.0f, u));
+    v = fminf(1.0f, fmaxf(0.0f, v));
+    if (u + v > 1.0f)
+    {
+        const float sum = u + v;
+        u /= sum;
+        v /= sum;
+    }
+    *barycentric = {1.0f - u - v, u, v};
+    return true;
+}
+
+} // namespace
+
 namespace csrt
 {
 
@@ -14,6 +121,13 @@ QUALIFIER_D_H AABB GetAabbTriangle(const TriangleData &data)
     return aabb;
 }
 
+QUALIFIER_D_H float GetAreaTriangle(const TriangleData &data)
+{
+    const Vec3 v0v1 = data.positions[1] - data.positions[0],
+               v0v2 = data.positions[2] - data.positions[0];
+    return 0.5f * Length(Cross(v0v1, v0v2));
+}
+
 /// \brief Woop's watertight intersection algorithm or Möller–Trumbore
 /// intersection algorithm
 QUALIFIER_D_H bool IntersectTriangle(const uint32_t id_primitive,
@@ -159,4 +273,49 @@ QUALIFIER_D_H Hit SampleTriangle(const uint32_t id_primitive,
     return Hit(id_primitive, texcoord, position, normal);
 }
 
+QUALIFIER_D_H Hit SampleTriangle(const uint32_t id_primitive,
+                                 const TriangleData &data, const Vec3 &origin,
+                                 const float xi_0, const float xi_1,
+                                 float *pdf)
+{
+    const Vec3 v0v1 = data.positions[1] - data.positions[0],
+               v0v2 = data.positions[2] - data.positions[0],
+               normal_geom = Normalize(Cross(v0v1, v0v2));
+
+    const float area_spherical = GetSphericalTriangleArea(data, origin);
+    Vec3 barycentric;
+    if (area_spherical < kMinSphericalTriangleArea ||
+        area_spherical > kMaxSphericalTriangleArea ||
+        !SampleSphericalTriangle(data, origin, xi_0, xi_1, &barycentric))
+    {
+        const Hit hit = SampleTriangle(id_primitive, data, xi_0, xi_1);
+        *pdf = PdfAreaToSolidAngle(1.0f / GetAreaTriangle(data), origin,
+                                   hit.position, normal_geom);
+        return hit;
+    }
+    *pdf = 1.0f / area_spherical;
+
+    const Vec2 texcoord = Lerp(data.texcoords, barycentric.x, barycentric.y,
+                               barycentric.z);
+    const Vec3 position = Lerp(data.positions, barycentric.x, barycentric.y,
+                               barycentric.z),
+               normal = Normalize(Lerp(data.normals, barycentric.x,
+                                       barycentric.y, barycentric.z));
+    return Hit(id_primitive, texcoord, position, normal);
+}
+
+QUALIFIER_D_H float PdfTriangle(const TriangleData &data, const Vec3 &origin,
+                                const Vec3 &position)
+{
+    const float area_spherical = GetSphericalTriangleArea(data, origin);
+    if (kMinSphericalTriangleArea <= area_spherical &&
+        area_spherical <= kMaxSphericalTriangleArea)
+        return 1.0f / area_spherical;
+
+    const Vec3 v0v1 = data.positions[1] - data.positions[0],
+               v0v2 = data.positions[2] - data.positions[0];
+    return PdfAreaToSolidAngle(1.0f / GetAreaTriangle(data), origin, position,
+                               Normalize(Cross(v0v1, v0v2)));
+}
+
 } // namespace csrt
\ No newline at end of file
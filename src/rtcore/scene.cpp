@@ -1,6 +1,7 @@
 #include "csrt/rtcore/scene.hpp"
 
 #include <exception>
+#include <memory>
 
 namespace
 {
@@ -12,6 +13,30 @@ uint64_t g_num_node;
 std::vector<uint64_t> g_list_offset_primitive;
 std::vector<uint64_t> g_list_offset_node;
 
+// 网格在世界坐标系下的图元与 BVH 节点，图元编号从 0 开始，可以在不同场景之间复用
+struct MeshesBlas
+{
+    std::vector<Primitive> primitives;
+    std::vector<BvhNode> nodes;
+};
+
+template <typename T>
+uint64_t HashVector(const std::vector<T> &data, const uint64_t hash)
+{
+    return HashBytes(data.data(), data.size() * sizeof(T), hash);
+}
+
+uint64_t HashMeshes(const MeshesInfo &info, const Mat4 &to_world)
+{
+    uint64_t hash = HashBytes(&to_world, sizeof(to_world));
+    hash = HashVector(info.texcoords, hash);
+    hash = HashVector(info.positions, hash);
+    hash = HashVector(info.normals, hash);
+    hash = HashVector(info.tangents, hash);
+    hash = HashVector(info.bitangents, hash);
+    return HashVector(info.indices, hash);
+}
+
 void SetupMeshes(const MeshesInfo &info,
                  std::vector<PrimitiveData> *list_data_primitve,
                  std::vector<float> *areas)
@@ -46,7 +71,7 @@ void SetupMeshes(const MeshesInfo &info,
             const Vec3 v0v1 = triangle.positions[1] - triangle.positions[0],
                        v0v2 = triangle.positions[2] - triangle.positions[0];
             const Vec3 normal_geom = Cross(v0v1, v0v2);
-            (*areas)[i] = Length(normal_geom);
+            (*areas)[i] = GetAreaTriangle(triangle);
 
             if (info.normals.empty())
             {
@@ -110,6 +135,48 @@ void SetupMeshes(const MeshesInfo &info,
     }
 }
 
+std::shared_ptr<const MeshesBlas> BuildMeshesBlas(InstanceInfo *info)
+{
+    for (Vec3 &position : info->meshes.positions)
+        position = TransformPoint(info->to_world, position);
+
+    if (!info->meshes.normals.empty())
+    {
+        const Mat4 normal_to_world = info->to_world.Transpose().Inverse();
+        for (Vec3 &normal : info->meshes.normals)
+            normal = TransformVector(normal_to_world, normal);
+    }
+
+    if (!info->meshes.tangents.empty())
+    {
+        for (Vec3 &tangent : info->meshes.tangents)
+            tangent = TransformVector(info->to_world, tangent);
+    }
+
+    if (!info->meshes.bitangents.empty())
+    {
+        for (Vec3 &bitangent : info->meshes.bitangents)
+            bitangent = TransformVector(info->to_world, bitangent);
+    }
+
+    std::vector<PrimitiveData> list_data_primitve;
+    std::vector<float> areas;
+    SetupMeshes(info->meshes, &list_data_primitve, &areas);
+    const uint32_t num_primitive =
+        static_cast<uint32_t>(list_data_primitve.size());
+
+    auto blas = std::make_shared<MeshesBlas>();
+    blas->primitives.resize(num_primitive);
+    std::vector<AABB> aabbs(num_primitive);
+    for (uint32_t i = 0; i < num_primitive; ++i)
+    {
+        blas->primitives[i] = Primitive(i, list_data_primitve[i]);
+        aabbs[i] = blas->primitives[i].aabb();
+    }
+    blas->nodes = BvhBuilder::Build(aabbs, areas);
+    return blas;
+}
+
 } // namespace
 
 namespace csrt
@@ -258,59 +325,47 @@ void Scene::CommitMeshes(InstanceInfo info)
                           "instance to scene.");
     }
 
-    for (Vec3 &position : info.meshes.positions)
-        position = TransformPoint(info.to_world, position);
-
-    if (!info.meshes.normals.empty())
-    {
-        const Mat4 normal_to_world = info.to_world.Transpose().Inverse();
-        for (Vec3 &normal : info.meshes.normals)
-            normal = TransformVector(normal_to_world, normal);
-    }
-
-    if (!info.meshes.tangents.empty())
-    {
-        for (Vec3 &tangent : info.meshes.tangents)
-            tangent = TransformVector(info.to_world, tangent);
-    }
-
-    if (!info.meshes.bitangents.empty())
-    {
-        for (Vec3 &bitangent : info.meshes.bitangents)
-            bitangent = TransformVector(info.to_world, bitangent);
-    }
-
     try
     {
-        std::vector<PrimitiveData> list_data_primitve;
-        std::vector<float> areas;
-        SetupMeshes(info.meshes, &list_data_primitve, &areas);
-        const uint32_t num_primitive_local =
-            static_cast<uint32_t>(list_data_primitve.size());
+        // 图元与 BVH 只由网格数据与变换矩阵决定，启用资源缓存时可以在场景之间复用
+        AssetCache &cache = GetAssetCache();
+        uint64_t key = 0;
+        std::shared_ptr<const MeshesBlas> blas;
+        if (cache.enable())
+        {
+            key = HashMeshes(info.meshes, info.to_world);
+            blas = cache.Find<MeshesBlas>(AssetType::kBlas, key);
+        }
+        if (!blas)
+        {
+            blas = BuildMeshesBlas(&info);
+            if (cache.enable())
+            {
+                cache.Insert(AssetType::kBlas, key, blas,
+                             blas->primitives.size() * sizeof(Primitive) +
+                                 blas->nodes.size() * sizeof(BvhNode));
+            }
+        }
 
+        const uint32_t num_primitive_local =
+            static_cast<uint32_t>(blas->primitives.size());
         Primitive *primitives = MallocArray<Primitive>(
             backend_type_, g_num_primitive + num_primitive_local);
         CopyArray(backend_type_, primitives, primitives_, g_num_primitive);
         DeleteArray(backend_type_, primitives_);
-        std::vector<AABB> aabbs(num_primitive_local);
         for (uint32_t i = 0; i < num_primitive_local; ++i)
-        {
-            primitives[g_num_primitive + i] =
-                Primitive(i, list_data_primitve[i]);
-            aabbs[i] = primitives[g_num_primitive + i].aabb();
-        }
+            primitives[g_num_primitive + i] = blas->primitives[i];
         primitives_ = primitives;
         g_list_offset_primitive.push_back(g_num_primitive);
         g_num_primitive += num_primitive_local;
 
-        std::vector<BvhNode> list_node = BvhBuilder::Build(aabbs, areas);
-        const uint64_t num_node_local = list_node.size();
+        const uint64_t num_node_local = blas->nodes.size();
         BvhNode *nodes =
             MallocArray<BvhNode>(backend_type_, g_num_node + num_node_local);
         CopyArray(backend_type_, nodes, nodes_, g_num_node);
         DeleteArray(backend_type_, nodes_);
         for (uint64_t i = 0; i < num_node_local; ++i)
-            nodes[g_num_node + i] = list_node[i];
+            nodes[g_num_node + i] = blas->nodes[i];
         nodes_ = nodes;
         g_list_offset_node.push_back(g_num_node);
         g_num_node += num_node_local;
@@ -343,14 +398,7 @@ void Scene::CommitSphere(const InstanceInfo &info)
         g_list_offset_primitive.push_back(g_num_primitive);
         ++g_num_primitive;
 
-        const Vec3 center_world =
-                       TransformPoint(info.to_world, info.sphere.center),
-                   boundary_local = info.sphere.center +
-                                    Vec3{info.sphere.radius, 0.0f, 0.0f},
-                   boundary_world =
-                       TransformPoint(info.to_world, boundary_local);
-        const float radius_world = Length(center_world - boundary_world);
-        std::vector<float> areas = {4.0f * kPi * Sqr(radius_world)};
+        std::vector<float> areas = {GetAreaSphere(data_primitive.sphere)};
 
         std::vector<BvhNode> list_node = BvhBuilder::Build(aabbs, areas);
         const uint64_t num_node_local = list_node.size();
@@ -390,11 +438,7 @@ void Scene::CommitDisk(const InstanceInfo &info)
         g_list_offset_primitive.push_back(g_num_primitive);
         ++g_num_primitive;
 
-        const Vec3 center_world = TransformPoint(info.to_world, Vec3{0}),
-                   boundary_world =
-                       TransformPoint(info.to_world, Vec3{0.5f, 0, 0});
-        const float radius_world = Length(center_world - boundary_world);
-        std::vector<float> areas = {kPi * Sqr(radius_world)};
+        std::vector<float> areas = {GetAreaDisk(data_primitive.disk)};
 
         std::vector<BvhNode> list_node = BvhBuilder::Build(aabbs, areas);
         const uint64_t num_node_local = list_node.size();
@@ -449,7 +493,7 @@ void Scene::CommitCylinder(const InstanceInfo &info)
         g_list_offset_primitive.push_back(g_num_primitive);
         ++g_num_primitive;
 
-        std::vector<float> areas = {k2Pi * Sqr(data_primitive.cylinder.radius)};
+        std::vector<float> areas = {GetAreaCylinder(data_primitive.cylinder)};
 
         std::vector<BvhNode> list_node = BvhBuilder::Build(aabbs, areas);
         const uint64_t num_node_local = list_node.size();
@@ -489,6 +533,7 @@ void Scene::CommitInstances(const std::vector<InstanceInfo> &list_info_instance)
             aabbs[i] = nodes_[index].aabb;
             areas[i] = nodes_[index].area;
         }
+        list_aabb_ = aabbs;
 
         list_pdf_area_ = MallocArray(backend_type_, areas);
         for (uint32_t i = 0; i < num_instance; ++i)
@@ -0,0 +1,111 @@
+#include "csrt/utils/asset_cache.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+#include "csrt/utils/misc.hpp"
+
+namespace csrt
+{
+
+void AssetCache::SetCapacity(const uint64_t capacity)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    capacity_ = capacity;
+    Evict(capacity_);
+}
+
+std::shared_ptr<const void> AssetCache::FindEntry(const AssetType type,
+                                                  const uint64_t key)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (capacity_ == 0)
+        return nullptr;
+
+    const auto it = map_.find({type, key});
+    if (it == map_.end())
+    {
+        ++num_miss_[static_cast<int>(type)];
+        return nullptr;
+    }
+    ++num_hit_[static_cast<int>(type)];
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second->value;
+}
+
+void AssetCache::InsertEntry(const AssetType type, const uint64_t key,
+                             const std::shared_ptr<const void> &value,
+                             const uint64_t size)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (size > capacity_ || map_.count({type, key}))
+        return;
+
+    Evict(capacity_ - size);
+    entries_.push_front({type, key, size, value});
+    map_[{type, key}] = entries_.begin();
+    size_ += size;
+}
+
+void AssetCache::Evict(const uint64_t capacity)
+{
+    // 被淘汰的资源若仍在使用中，由 shared_ptr 保证使用结束后才释放
+    while (size_ > capacity)
+    {
+        const Entry &entry = entries_.back();
+        size_ -= entry.size;
+        map_.erase({entry.type, entry.key});
+        entries_.pop_back();
+    }
+}
+
+void AssetCache::PrintStatistics() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (capacity_ == 0)
+        return;
+
+    const char *names[] = {"texture", "mesh", "BLAS", "LUT"};
+    fprintf(stderr, "[info] asset cache: %.2f MiB of %.2f MiB used.\n",
+            size_ / 1048576.0, capacity_ / 1048576.0);
+    for (int i = 0; i < static_cast<int>(AssetType::kCount); ++i)
+    {
+        const uint64_t num_query = num_hit_[i] + num_miss_[i];
+        fprintf(stderr, "\t%-8s hit %llu / %llu (%.1f%%)\n", names[i],
+                static_cast<unsigned long long>(num_hit_[i]),
+                static_cast<unsigned long long>(num_query),
+                num_query > 0 ? 100.0 * num_hit_[i] / num_query : 0.0);
+    }
+}
+
+AssetCache &GetAssetCache()
+{
+    static AssetCache cache;
+    return cache;
+}
+
+uint64_t HashFile(const std::string &filename, uint64_t hash)
+{
+    std::ifstream file(filename, std::ios::binary);
+    std::vector<char> buffer(1 << 20);
+    while (file)
+    {
+        file.read(buffer.data(), buffer.size());
+        hash = HashBytes(buffer.data(), static_cast<size_t>(file.gcount()),
+                         hash);
+    }
+    return hash;
+}
+
+FileStamp StampFile(const std::string &filename)
+{
+    std::error_code error;
+    FileStamp stamp = {std::filesystem::file_size(filename, error),
+                       std::filesystem::last_write_time(filename, error)};
+    if (error)
+        stamp = {static_cast<uintmax_t>(-1), {}};
+    return stamp;
+}
+
+} // namespace csrt
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include "csrt/utils/async_image_writer.hpp"
+
+#include <algorithm>
+
+#include "csrt/utils/image_io.hpp"
+
+namespace csrt
+{
+
+AsyncImageWriter::AsyncImageWriter(const size_t max_pending)
+    : exit_(false), busy_(false), max_pending_(max_pending)
+{
+    worker_ = std::thread(&AsyncImageWriter::WorkerLoop, this);
+}
+
+AsyncImageWriter::~AsyncImageWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        exit_ = true;
+    }
+    cv_job_.notify_one();
+    worker_.join();
+}
+
+void AsyncImageWriter::Submit(std::vector<float> data, const int width,
+                              const int height, const std::string &filename,
+                              const bool replace)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (replace)
+        {
+            jobs_.erase(std::remove_if(jobs_.begin(), jobs_.end(),
+                                       [&](const Job &job)
+                                       { return job.filename == filename; }),
+                        jobs_.end());
+        }
+        if (max_pending_ > 0)
+        {
+            cv_space_.wait(lock,
+                           [&]() { return jobs_.size() < max_pending_; });
+        }
+        jobs_.push_back({width, height, filename, std::move(data)});
+    }
+    cv_job_.notify_one();
+}
+
+void AsyncImageWriter::Wait()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_idle_.wait(lock, [&]() { return jobs_.empty() && !busy_; });
+}
+
+void AsyncImageWriter::WorkerLoop()
+{
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_job_.wait(lock, [&]() { return exit_ || !jobs_.empty(); });
+            if (jobs_.empty())
+                return;
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+            busy_ = true;
+        }
+        cv_space_.notify_all();
+
+        image_io::Write(job.data.data(), job.width, job.height, job.filename);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            busy_ = false;
+            if (jobs_.empty())
+                cv_idle_.notify_all();
+        }
+    }
+}
+
+} // namespace csrt
\ No newline at end of file
@@ -18,24 +18,53 @@ extern "C"
 }
 
 #include "csrt/utils/misc.hpp"
+#include "csrt/utils/stream_image_writer.hpp"
 
 namespace csrt
 {
 
+unsigned char image_io::LinearToSrgb8(const float linear)
+{
+    const float value =
+        linear <= 0.0031308f ? (12.92f * linear)
+                             : (1.055f * powf(linear, 1.0f / 2.4f) - 0.055f);
+    return static_cast<unsigned char>(
+        static_cast<int>(value > 1.0f ? 255.0f : value * 255.0f));
+}
+
 void image_io::Write(const float *data, const int width, const int height,
                      std::string filename)
 {
+    const std::string suffix = GetSuffix(filename);
+    if (suffix == "exr" || suffix == "EXR" || suffix == "pfm" ||
+        suffix == "PFM")
+    {
+        try
+        {
+            // 每次至多提交 16 行，不复制整幅图像，以免大分辨率时内存占用翻倍
+            const uint64_t row_size = static_cast<uint64_t>(width) * 3;
+            StreamImageWriter writer(filename, width, height);
+            for (int y = 0; y < height; y += 16)
+            {
+                const int num_rows = std::min(16, height - y);
+                const float *rows = data + y * row_size;
+                writer.Submit(
+                    std::vector<float>(rows, rows + num_rows * row_size),
+                    num_rows);
+            }
+            writer.Close();
+        }
+        catch (const MyException &e)
+        {
+            fprintf(stderr, "[error] %s\n", e.what());
+        }
+        return;
+    }
+
     const uint32_t num_element = static_cast<uint32_t>(width) * height * 3;
     unsigned char *color = new unsigned char[num_element];
     for (uint32_t i = 0; i < num_element; ++i)
-    {
-        const float value =
-            data[i] <= 0.0031308f
-                ? (12.92f * data[i])
-                : (1.055f * powf(data[i], 1.0f / 2.4f) - 0.055f);
-        color[i] = static_cast<unsigned char>(
-            static_cast<int>(value > 1.0f ? 255.0f : value * 255.0f));
-    }
+        color[i] = LinearToSrgb8(data[i]);
 
     int ret =
         stbi_write_png(filename.c_str(), width, height, 3, color, width * 3);
@@ -52,6 +81,52 @@ void image_io::Write(const float *data, const int width, const int height,
     }
 }
 
+void image_io::CheckPatch(const int x, const int y, const int width,
+                          const int height, const std::string &base_filename)
+{
+    int base_width = 0, base_height = 0, base_channel = 0;
+    if (!stbi_info(base_filename.c_str(), &base_width, &base_height,
+                   &base_channel))
+        throw MyException("load image '" + base_filename + "' failed.");
+    if (x < 0 || y < 0 || x + width > base_width || y + height > base_height)
+        throw MyException("patch is out of image '" + base_filename + "'.");
+}
+
+void image_io::WritePatch(const float *data, const int x, const int y,
+                          const int width, const int height,
+                          const std::string &base_filename,
+                          const std::string &filename)
+{
+    int base_width = 0, base_height = 0, base_channel = 0;
+    stbi_uc *color = stbi_load(base_filename.c_str(), &base_width,
+                               &base_height, &base_channel, 3);
+    if (color == nullptr)
+        throw MyException("load image '" + base_filename + "' failed.");
+    if (x < 0 || y < 0 || x + width > base_width || y + height > base_height)
+    {
+        stbi_image_free(color);
+        throw MyException("patch is out of image '" + base_filename + "'.");
+    }
+
+    // 只替换图像块内的像素，其余像素的编码值保持不变
+    for (int j = 0; j < height; ++j)
+    {
+        for (int i = 0; i < width * 3; ++i)
+        {
+            color[((y + j) * base_width + x) * 3 + i] =
+                LinearToSrgb8(data[j * width * 3 + i]);
+        }
+    }
+
+    int ret = stbi_write_png(filename.c_str(), base_width, base_height, 3,
+                             color, base_width * 3);
+    stbi_image_free(color);
+    if (ret == 0)
+        throw MyException("write image '" + filename + "' failed.");
+    fprintf(stderr, "[info] save result as image \"%s\".\n",
+            filename.c_str());
+}
+
 float *image_io::Read(const std::string &filename, const float gamma,
                       const int *width_max, int *width, int *height,
                       int *channel)
@@ -63,9 +138,8 @@ float *image_io::Read(const std::string &filename, const float gamma,
     std::string suffix = GetSuffix(filename);
     if (!support_format.count(suffix))
     {
-        fprintf(stderr, "[error] unsupport input image format for image '%s\n'",
-                filename.c_str());
-        exit(1);
+        throw MyException("unsupport input image format for image '" +
+                          filename + "'.");
     }
 
     float *data = nullptr;
@@ -79,14 +153,13 @@ float *image_io::Read(const std::string &filename, const float gamma,
         if (LoadEXR(&data, width, height, filename.c_str(), &err) !=
             TINYEXR_SUCCESS)
         {
-            fprintf(stderr, "[error] load image '%s' failed.",
-                    filename.c_str());
+            std::string info = "load image '" + filename + "' failed.";
             if (err)
             {
-                fprintf(stderr, "\t%s", err);
+                info += std::string("\n\t") + err;
                 FreeEXRErrorMessage(err);
             }
-            exit(1);
+            throw MyException(info);
         }
         if (gamma != 0.0f)
         {
@@ -103,9 +176,7 @@ float *image_io::Read(const std::string &filename, const float gamma,
         data = stbi_loadf(filename.c_str(), width, height, channel, 0);
         if (data == nullptr)
         {
-            fprintf(stderr, "[error] load image '%s' failed.",
-                    filename.c_str());
-            exit(1);
+            throw MyException("load image '" + filename + "' failed.");
         }
         int num_component = *width * *height * *channel;
         if (gamma == -1.0f)
@@ -130,9 +201,7 @@ float *image_io::Read(const std::string &filename, const float gamma,
             stbi_load(filename.c_str(), width, height, channel, 0);
         if (raw_data_uc == nullptr)
         {
-            fprintf(stderr, "[error] load image '%s' failed.",
-                    filename.c_str());
-            exit(1);
+            throw MyException("load image '" + filename + "' failed.");
         }
         int num_component = *width * *height * *channel;
         data = new float[num_component];
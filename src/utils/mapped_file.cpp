@@ -0,0 +1,100 @@
+#include "csrt/utils/mapped_file.hpp"
+
+#include "csrt/utils/misc.hpp"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace csrt
+{
+
+#if defined(_WIN32)
+
+MappedFile::MappedFile(const std::string &filename)
+    : data_(nullptr), size_(0), file_(INVALID_HANDLE_VALUE), mapping_(nullptr)
+{
+    file_ = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER size = {};
+    if (file_ == INVALID_HANDLE_VALUE || !GetFileSizeEx(file_, &size))
+    {
+        ReleaseData();
+        throw MyException("cannot open file '" + filename + "'.");
+    }
+    size_ = static_cast<uint64_t>(size.QuadPart);
+    if (size_ == 0)
+        return;
+
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_ != nullptr)
+    {
+        data_ = static_cast<const unsigned char *>(
+            MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (data_ == nullptr)
+    {
+        ReleaseData();
+        throw MyException("cannot map file '" + filename + "'.");
+    }
+}
+
+void MappedFile::ReleaseData()
+{
+    if (data_ != nullptr)
+        UnmapViewOfFile(data_);
+    if (mapping_ != nullptr)
+        CloseHandle(mapping_);
+    if (file_ != INVALID_HANDLE_VALUE)
+        CloseHandle(file_);
+    data_ = nullptr;
+    mapping_ = nullptr;
+    file_ = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+MappedFile::MappedFile(const std::string &filename)
+    : data_(nullptr), size_(0), fd_(-1)
+{
+    fd_ = open(filename.c_str(), O_RDONLY);
+    struct stat info = {};
+    if (fd_ < 0 || fstat(fd_, &info) != 0)
+    {
+        ReleaseData();
+        throw MyException("cannot open file '" + filename + "'.");
+    }
+    size_ = static_cast<uint64_t>(info.st_size);
+    if (size_ == 0)
+        return;
+
+    void *data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (data == MAP_FAILED)
+    {
+        ReleaseData();
+        throw MyException("cannot map file '" + filename + "'.");
+    }
+    data_ = static_cast<const unsigned char *>(data);
+}
+
+void MappedFile::ReleaseData()
+{
+    if (data_ != nullptr)
+        munmap(const_cast<unsigned char *>(data_), size_);
+    if (fd_ >= 0)
+        close(fd_);
+    data_ = nullptr;
+    fd_ = -1;
+}
+
+#endif
+
+MappedFile::~MappedFile() { ReleaseData(); }
+
+} // namespace csrt
\ No newline at end of file
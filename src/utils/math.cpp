@@ -1,6 +1,7 @@
 #include "csrt/utils/math.hpp"
 
 #include <cmath>
+#include <vector>
 
 namespace csrt
 {
@@ -37,6 +38,21 @@ QUALIFIER_D_H void SampleHemisCos(const float xi_0, const float xi_1, Vec3 *vec,
     *pdf = k1DivPi * cos_theta;
 }
 
+QUALIFIER_D_H float PdfAreaToSolidAngle(const float pdf_area,
+                                        const Vec3 &origin,
+                                        const Vec3 &position,
+                                        const Vec3 &normal)
+{
+    const Vec3 d_vec = position - origin;
+    const float distance_sqr = Dot(d_vec, d_vec);
+    if (distance_sqr == 0.0f)
+        return 0;
+    const float cos_theta = fabsf(Dot(normal, d_vec)) / sqrtf(distance_sqr);
+    if (cos_theta < kEpsilonFloat)
+        return 0;
+    return pdf_area * distance_sqr / cos_theta;
+}
+
 QUALIFIER_D_H uint32_t BinarySearch(const uint32_t num, float *cdf,
                                     const float target)
 {
@@ -54,6 +70,75 @@ QUALIFIER_D_H uint32_t BinarySearch(const uint32_t num, float *cdf,
     return end;
 }
 
+float CreateAliasTable(const uint32_t num, const float *weights,
+                       AliasEntry *table)
+{
+    double sum = 0;
+    for (uint32_t i = 0; i < num; ++i)
+        sum += weights[i];
+    if (!(sum > 0))
+    {
+        for (uint32_t i = 0; i < num; ++i)
+            table[i] = {1, i};
+        return 0;
+    }
+
+    // 把权重缩放为平均值为 1，不足 1 的项用超过 1 的项补齐
+    std::vector<double> scaled(num);
+    std::vector<uint32_t> small, large;
+    for (uint32_t i = 0; i < num; ++i)
+    {
+        scaled[i] = weights[i] * (num / sum);
+        if (scaled[i] < 1.0)
+            small.push_back(i);
+        else
+            large.push_back(i);
+    }
+
+    while (!small.empty() && !large.empty())
+    {
+        const uint32_t s = small.back(), l = large.back();
+        small.pop_back();
+        table[s] = {static_cast<float>(scaled[s]), l};
+        scaled[l] -= 1.0 - scaled[s];
+        if (scaled[l] < 1.0)
+        {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+
+    // 剩余的项只因舍入误差偏离 1
+    for (const uint32_t i : small)
+        table[i] = {1, i};
+    for (const uint32_t i : large)
+        table[i] = {1, i};
+
+    return static_cast<float>(sum);
+}
+
+QUALIFIER_D_H uint32_t SampleAliasTable(const uint32_t num,
+                                        const AliasEntry *table, float *xi)
+{
+    constexpr float kOneMinusEpsilon = 1.0f - kEpsilonFloat * 0.5f;
+    const float x = *xi * num;
+    uint32_t index = static_cast<uint32_t>(x);
+    if (index >= num)
+        index = num - 1;
+    const float u = fminf(x - index, kOneMinusEpsilon);
+    const AliasEntry entry = table[index];
+    if (u < entry.prob)
+    {
+        *xi = fminf(u / entry.prob, kOneMinusEpsilon);
+        return index;
+    }
+    else
+    {
+        *xi = fminf((u - entry.prob) / (1.0f - entry.prob), kOneMinusEpsilon);
+        return entry.alias;
+    }
+}
+
 QUALIFIER_D_H bool SolveQuadratic(const float a, const float b, const float c,
                                   float *x0, float *x1)
 {
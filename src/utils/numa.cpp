@@ -0,0 +1,101 @@
+#include "csrt/utils/numa.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace csrt
+{
+
+std::vector<std::vector<int>> GetNumaNodes()
+{
+    std::vector<std::vector<int>> nodes;
+#if defined(__linux__)
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return {};
+
+    // 节点编号不一定连续，遍历 sysfs 中所有的 node* 目录
+    const std::string root = "/sys/devices/system/node/";
+    DIR *dir = opendir(root.c_str());
+    if (dir == nullptr)
+        return {};
+    std::vector<int> ids;
+    for (dirent *entry = readdir(dir); entry != nullptr; entry = readdir(dir))
+    {
+        const std::string name = entry->d_name;
+        if (name.size() > 4 && name.compare(0, 4, "node") == 0 &&
+            name.find_first_not_of("0123456789", 4) == std::string::npos)
+            ids.push_back(std::stoi(name.substr(4)));
+    }
+    closedir(dir);
+    std::sort(ids.begin(), ids.end());
+
+    for (const int id : ids)
+    {
+        // cpulist 的格式形如 "0-15,32-47"
+        std::ifstream file(root + "node" + std::to_string(id) + "/cpulist");
+        std::string list;
+        if (!std::getline(file, list))
+            continue;
+        std::vector<int> cpus;
+        std::istringstream iss(list);
+        for (std::string range; std::getline(iss, range, ',');)
+        {
+            if (range.find_first_of("0123456789") == std::string::npos)
+                continue;
+            const size_t pos_dash = range.find('-');
+            const int first = std::stoi(range.substr(0, pos_dash)),
+                      last = pos_dash == std::string::npos
+                                 ? first
+                                 : std::stoi(range.substr(pos_dash + 1));
+            for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu)
+            {
+                if (CPU_ISSET(cpu, &allowed))
+                    cpus.push_back(cpu);
+            }
+        }
+        if (!cpus.empty())
+            nodes.push_back(cpus);
+    }
+#endif
+    if (nodes.size() < 2)
+        return {};
+    return nodes;
+}
+
+void BindThread(const std::vector<int> &cpus)
+{
+#if defined(__linux__)
+    if (cpus.empty())
+        return;
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (const int cpu : cpus)
+        CPU_SET(cpu, &cpu_set);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+#endif
+}
+
+uint32_t GetCurrentNumaNode(const std::vector<std::vector<int>> &nodes)
+{
+#if defined(__linux__)
+    const int cpu = sched_getcpu();
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        if (std::find(nodes[i].begin(), nodes[i].end(), cpu) != nodes[i].end())
+            return static_cast<uint32_t>(i);
+    }
+#endif
+    return 0;
+}
+
+} // namespace csrt
\ No newline at end of file
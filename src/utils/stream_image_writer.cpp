@@ -0,0 +1,541 @@
+#include "csrt/utils/stream_image_writer.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <zlib.h>
+
+#include "csrt/utils/image_io.hpp"
+#include "csrt/utils/misc.hpp"
+
+namespace
+{
+
+using namespace csrt;
+
+// 以 64 位偏移定位文件，图像可能超过 4 GiB
+bool Seek(FILE *file, const uint64_t offset)
+{
+#if defined(_WIN32)
+    return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+    return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+// 按小端字节序追加整数或浮点数，与检查点文件相同，假定本机为小端字节序
+template <typename T>
+void AppendLittleEndian(const T value, std::vector<unsigned char> *buffer)
+{
+    unsigned char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    buffer->insert(buffer->end(), bytes, bytes + sizeof(T));
+}
+
+void AppendBigEndian(const uint32_t value, std::vector<unsigned char> *buffer)
+{
+    for (int shift = 24; shift >= 0; shift -= 8)
+        buffer->push_back(static_cast<unsigned char>(value >> shift));
+}
+
+void AppendString(const char *str, std::vector<unsigned char> *buffer)
+{
+    buffer->insert(buffer->end(), str, str + std::strlen(str) + 1);
+}
+
+// 单精度浮点数到半精度浮点数，就近舍入到偶数，超出范围时为无穷大
+uint16_t FloatToHalf(const float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    const uint32_t abs = bits & 0x7fffffff;
+    if (abs >= 0x7f800000)
+        return sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 : 0);
+    if (abs >= 0x477ff000) // 65520，舍入后超出半精度的最大值
+        return sign | 0x7c00;
+    if (abs < 0x33000000) // 2^-25，舍入后为 0
+        return sign;
+
+    uint32_t result, remainder, halfway;
+    if (abs < 0x38800000) // 2^-14，半精度的非规格化数
+    {
+        const uint32_t mantissa = (abs & 0x7fffff) | 0x800000,
+                       shift = 126 - (abs >> 23);
+        result = mantissa >> shift;
+        remainder = mantissa & ((1u << shift) - 1);
+        halfway = 1u << (shift - 1);
+    }
+    else
+    {
+        result = (abs >> 13) - ((127 - 15) << 10);
+        remainder = abs & 0x1fff;
+        halfway = 0x1000;
+    }
+    if (remainder > halfway || (remainder == halfway && (result & 1)))
+        ++result;
+    return sign | static_cast<uint16_t>(result);
+}
+
+// 写入单个文件的编码器的公共部分
+class FileEncoder : public StreamImageWriter::Encoder
+{
+public:
+    FileEncoder(const std::string &filename, const int width, const int height)
+        : filename_(filename), width_(width), height_(height),
+          num_row_written_(0), file_(fopen(filename.c_str(), "wb"))
+    {
+        if (file_ == nullptr)
+            throw MyException("cannot create image '" + filename + "'.");
+    }
+
+    ~FileEncoder()
+    {
+        if (file_ != nullptr)
+            fclose(file_);
+    }
+
+protected:
+    void Write(const void *data, const size_t size)
+    {
+        if (size > 0 && fwrite(data, 1, size, file_) != size)
+            throw MyException("write image '" + filename_ + "' failed.");
+    }
+
+    void SeekTo(const uint64_t offset)
+    {
+        if (!Seek(file_, offset))
+            throw MyException("write image '" + filename_ + "' failed.");
+    }
+
+    void CloseFile()
+    {
+        const bool ok = fclose(file_) == 0;
+        file_ = nullptr;
+        if (!ok)
+            throw MyException("write image '" + filename_ + "' failed.");
+    }
+
+    std::string filename_;
+    int width_;
+    int height_;
+    int num_row_written_;
+    FILE *file_;
+};
+
+// PFM 的扫描线从下到上存放，各行带按其在文件中的位置直接写入
+class PfmEncoder : public FileEncoder
+{
+public:
+    PfmEncoder(const std::string &filename, const int width, const int height)
+        : FileEncoder(filename, width, height)
+    {
+        // 比例因子为负表示小端字节序
+        const std::string header = "PF\n" + std::to_string(width) + " " +
+                                   std::to_string(height) + "\n-1.0\n";
+        Write(header.data(), header.size());
+        header_size_ = header.size();
+    }
+
+    void WriteRows(const float *rows, const int num_rows) override
+    {
+        const uint64_t row_size = static_cast<uint64_t>(width_) * 3;
+        std::vector<float> reversed(row_size * num_rows);
+        for (int j = 0; j < num_rows; ++j)
+        {
+            std::copy(rows + j * row_size, rows + (j + 1) * row_size,
+                      reversed.begin() + (num_rows - 1 - j) * row_size);
+        }
+        const uint64_t row_first =
+            static_cast<uint64_t>(height_) - num_row_written_ - num_rows;
+        SeekTo(header_size_ + row_first * row_size * sizeof(float));
+        Write(reversed.data(), reversed.size() * sizeof(float));
+        num_row_written_ += num_rows;
+    }
+
+    void Finish() override { CloseFile(); }
+
+private:
+    uint64_t header_size_;
+};
+
+// 8 位 sRGB 的 PNG，扫描线使用 Sub 滤波，压缩数据流每积累一定大小输出一个 IDAT 块
+class PngEncoder : public FileEncoder
+{
+public:
+    PngEncoder(const std::string &filename, const int width, const int height)
+        : FileEncoder(filename, width, height), stream_(),
+          row_(static_cast<uint64_t>(width) * 3 + 1), output_(kChunkSize)
+    {
+        if (deflateInit(&stream_, Z_DEFAULT_COMPRESSION) != Z_OK)
+            throw MyException("cannot initialize zlib.");
+
+        const unsigned char signature[8] = {0x89, 'P',  'N',  'G',
+                                            '\r', '\n', 0x1a, '\n'};
+        Write(signature, sizeof(signature));
+        std::vector<unsigned char> header;
+        AppendBigEndian(static_cast<uint32_t>(width), &header);
+        AppendBigEndian(static_cast<uint32_t>(height), &header);
+        // 位深 8，RGB，默认的压缩、滤波与非隔行扫描方式
+        header.insert(header.end(), {8, 2, 0, 0, 0});
+        WriteChunk("IHDR", header.data(), header.size());
+    }
+
+    ~PngEncoder() { deflateEnd(&stream_); }
+
+    void WriteRows(const float *rows, const int num_rows) override
+    {
+        const uint64_t row_size = static_cast<uint64_t>(width_) * 3;
+        std::vector<unsigned char> color(row_size);
+        for (int j = 0; j < num_rows; ++j)
+        {
+            for (uint64_t k = 0; k < row_size; ++k)
+                color[k] = image_io::LinearToSrgb8(rows[j * row_size + k]);
+            row_[0] = 1;
+            for (uint64_t k = 0; k < row_size; ++k)
+            {
+                row_[k + 1] = static_cast<unsigned char>(
+                    color[k] - (k < 3 ? 0 : color[k - 3]));
+            }
+            Deflate(row_.data(), row_.size(), Z_NO_FLUSH);
+        }
+        num_row_written_ += num_rows;
+    }
+
+    void Finish() override
+    {
+        Deflate(nullptr, 0, Z_FINISH);
+        WriteChunk("IEND", nullptr, 0);
+        CloseFile();
+    }
+
+private:
+    static constexpr size_t kChunkSize = 1 << 20;
+
+    void Deflate(const unsigned char *data, const size_t size, const int flush)
+    {
+        stream_.next_in = const_cast<Bytef *>(data);
+        stream_.avail_in = static_cast<uInt>(size);
+        while (true)
+        {
+            stream_.next_out = output_.data() + num_output_;
+            stream_.avail_out = static_cast<uInt>(kChunkSize - num_output_);
+            const int ret = deflate(&stream_, flush);
+            if (ret == Z_STREAM_ERROR)
+            {
+                throw MyException("compress image '" + filename_ +
+                                  "' failed.");
+            }
+            num_output_ = kChunkSize - stream_.avail_out;
+            // 输出缓冲区未满说明输入已经全部压缩
+            const bool done = flush == Z_FINISH ? ret == Z_STREAM_END
+                                                : stream_.avail_out != 0;
+            if (num_output_ == kChunkSize ||
+                (done && flush == Z_FINISH && num_output_ > 0))
+            {
+                WriteChunk("IDAT", output_.data(), num_output_);
+                num_output_ = 0;
+            }
+            if (done)
+                return;
+        }
+    }
+
+    void WriteChunk(const char *type, const unsigned char *data,
+                    const size_t size)
+    {
+        std::vector<unsigned char> head;
+        AppendBigEndian(static_cast<uint32_t>(size), &head);
+        head.insert(head.end(), type, type + 4);
+        Write(head.data(), head.size());
+        Write(data, size);
+        uLong crc = crc32(0L, reinterpret_cast<const Bytef *>(type), 4);
+        if (size > 0)
+            crc = crc32(crc, data, static_cast<uInt>(size));
+        std::vector<unsigned char> tail;
+        AppendBigEndian(static_cast<uint32_t>(crc), &tail);
+        Write(tail.data(), tail.size());
+    }
+
+    z_stream stream_;
+    std::vector<unsigned char> row_;
+    std::vector<unsigned char> output_;
+    size_t num_output_ = 0;
+};
+
+// 扫描线 EXR，ZIP 压缩，每个数据块包含 16 行，通道按名称排列为 B、G、R。
+// 文件头之后的数据块偏移表先以 0 占位，所有数据块写入之后再回填
+class ExrEncoder : public FileEncoder
+{
+public:
+    ExrEncoder(const std::string &filename, const int width, const int height,
+               const bool half)
+        : FileEncoder(filename, width, height), half_(half), offset_(0)
+    {
+        std::vector<unsigned char> header = {0x76, 0x2f, 0x31, 0x01,
+                                             2,    0,    0,    0};
+        auto AppendAttribute = [&](const char *name, const char *type,
+                                   const std::vector<unsigned char> &value)
+        {
+            AppendString(name, &header);
+            AppendString(type, &header);
+            AppendLittleEndian(static_cast<int32_t>(value.size()), &header);
+            header.insert(header.end(), value.begin(), value.end());
+        };
+
+        std::vector<unsigned char> value;
+        for (const char *channel : {"B", "G", "R"})
+        {
+            AppendString(channel, &value);
+            AppendLittleEndian(static_cast<int32_t>(half ? 1 : 2), &value);
+            value.insert(value.end(), {0, 0, 0, 0});
+            AppendLittleEndian(static_cast<int32_t>(1), &value);
+            AppendLittleEndian(static_cast<int32_t>(1), &value);
+        }
+        value.push_back(0);
+        AppendAttribute("channels", "chlist", value);
+        AppendAttribute("compression", "compression", {3});
+        value.clear();
+        for (const int32_t bound : {0, 0, width - 1, height - 1})
+            AppendLittleEndian(bound, &value);
+        AppendAttribute("dataWindow", "box2i", value);
+        AppendAttribute("displayWindow", "box2i", value);
+        AppendAttribute("lineOrder", "lineOrder", {0});
+        value.clear();
+        AppendLittleEndian(1.0f, &value);
+        AppendAttribute("pixelAspectRatio", "float", value);
+        AppendAttribute("screenWindowWidth", "float", value);
+        value.clear();
+        AppendLittleEndian(0.0f, &value);
+        AppendLittleEndian(0.0f, &value);
+        AppendAttribute("screenWindowCenter", "v2f", value);
+        header.push_back(0);
+
+        Write(header.data(), header.size());
+        offset_table_ = header.size();
+        offsets_.assign((height + kNumBlockRow - 1) / kNumBlockRow, 0);
+        std::vector<unsigned char> table(offsets_.size() * sizeof(uint64_t));
+        Write(table.data(), table.size());
+        offset_ = offset_table_ + table.size();
+    }
+
+    void WriteRows(const float *rows, const int num_rows) override
+    {
+        const uint64_t row_size = static_cast<uint64_t>(width_) * 3;
+        pending_.insert(pending_.end(), rows, rows + row_size * num_rows);
+        num_row_written_ += num_rows;
+        // 凑满一个数据块即写入，最后一个数据块可以不足 16 行
+        const uint64_t num_row_pending = pending_.size() / row_size;
+        uint64_t row = 0;
+        while (num_row_pending - row >= kNumBlockRow ||
+               (num_row_written_ == height_ && row < num_row_pending))
+        {
+            const int num_block_row = static_cast<int>(
+                std::min<uint64_t>(kNumBlockRow, num_row_pending - row));
+            WriteBlock(pending_.data() + row * row_size, num_block_row);
+            row += num_block_row;
+        }
+        pending_.erase(pending_.begin(), pending_.begin() + row * row_size);
+    }
+
+    void Finish() override
+    {
+        std::vector<unsigned char> table;
+        for (const uint64_t offset : offsets_)
+            AppendLittleEndian(offset, &table);
+        SeekTo(offset_table_);
+        Write(table.data(), table.size());
+        CloseFile();
+    }
+
+private:
+    static constexpr int kNumBlockRow = 16;
+
+    void WriteBlock(const float *rows, const int num_rows)
+    {
+        const int y = num_block_written_ * kNumBlockRow;
+        std::vector<unsigned char> raw;
+        raw.reserve(static_cast<uint64_t>(width_) * 3 * num_rows *
+                    (half_ ? 2 : 4));
+        for (int j = 0; j < num_rows; ++j)
+        {
+            const float *row = rows + static_cast<uint64_t>(j) * width_ * 3;
+            for (const int channel : {2, 1, 0})
+            {
+                for (int i = 0; i < width_; ++i)
+                {
+                    if (half_)
+                        AppendLittleEndian(FloatToHalf(row[i * 3 + channel]),
+                                           &raw);
+                    else
+                        AppendLittleEndian(row[i * 3 + channel], &raw);
+                }
+            }
+        }
+
+        // ZIP 压缩之前先将奇偶字节分开，再对相邻字节做差分
+        const size_t size = raw.size();
+        std::vector<unsigned char> shuffled(size);
+        for (size_t k = 0; k < size; ++k)
+            shuffled[k % 2 == 0 ? k / 2 : (size + 1) / 2 + k / 2] = raw[k];
+        for (size_t k = size - 1; k > 0; --k)
+            shuffled[k] = static_cast<unsigned char>(
+                shuffled[k] - shuffled[k - 1] + 128);
+
+        uLongf size_compressed = compressBound(static_cast<uLong>(size));
+        std::vector<unsigned char> compressed(size_compressed);
+        if (compress(compressed.data(), &size_compressed, shuffled.data(),
+                     static_cast<uLong>(size)) != Z_OK)
+            throw MyException("compress image '" + filename_ + "' failed.");
+        // 压缩后没有变小时直接存放原始数据，读取时按数据大小区分
+        const bool store_raw = size_compressed >= size;
+        const unsigned char *data = store_raw ? raw.data() : compressed.data();
+        const uint64_t size_data = store_raw ? size : size_compressed;
+
+        std::vector<unsigned char> head;
+        AppendLittleEndian(static_cast<int32_t>(y), &head);
+        AppendLittleEndian(static_cast<int32_t>(size_data), &head);
+        Write(head.data(), head.size());
+        Write(data, size_data);
+        offsets_[num_block_written_] = offset_;
+        offset_ += head.size() + size_data;
+        ++num_block_written_;
+    }
+
+    bool half_;
+    int num_block_written_ = 0;
+    uint64_t offset_table_;
+    uint64_t offset_;
+    std::vector<uint64_t> offsets_;
+    // 尚未凑满一个数据块的行
+    std::vector<float> pending_;
+};
+
+} // namespace
+
+namespace csrt
+{
+
+StreamImageWriter::StreamImageWriter(const std::string &filename,
+                                     const int width, const int height,
+                                     const bool exr_half,
+                                     const int max_pending)
+    : filename_(filename), width_(width), height_(height),
+      max_pending_(std::max(1, max_pending)), num_row_submitted_(0),
+      closed_(false), exit_(false)
+{
+    if (width <= 0 || height <= 0)
+        throw MyException("invalid image size.");
+
+    const std::string suffix = GetSuffix(filename);
+    if (suffix == "exr" || suffix == "EXR")
+        encoder_.reset(new ExrEncoder(filename, width, height, exr_half));
+    else if (suffix == "pfm" || suffix == "PFM")
+        encoder_.reset(new PfmEncoder(filename, width, height));
+    else
+        encoder_.reset(new PngEncoder(filename, width, height));
+    worker_ = std::thread(&StreamImageWriter::WorkerLoop, this);
+}
+
+StreamImageWriter::~StreamImageWriter()
+{
+    try
+    {
+        Close();
+    }
+    catch (const MyException &e)
+    {
+        fprintf(stderr, "[error] %s\n", e.what());
+    }
+}
+
+void StreamImageWriter::Submit(std::vector<float> rows, const int num_rows)
+{
+    if (closed_ || num_rows <= 0 || num_row_submitted_ + num_rows > height_ ||
+        rows.size() != static_cast<uint64_t>(width_) * num_rows * 3)
+        throw MyException("invalid rows for image '" + filename_ + "'.");
+    num_row_submitted_ += num_rows;
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_space_.wait(lock,
+                       [&]()
+                       {
+                           return static_cast<int>(bands_.size()) <
+                                  max_pending_;
+                       });
+        bands_.push_back({num_rows, std::move(rows)});
+    }
+    cv_band_.notify_one();
+}
+
+void StreamImageWriter::Close()
+{
+    if (closed_)
+        return;
+
+    // 未提交的行以 0 补齐，每次至多补齐 16 行，以免占用过多内存
+    while (num_row_submitted_ < height_)
+    {
+        const int num_rows = std::min(16, height_ - num_row_submitted_);
+        Submit(std::vector<float>(static_cast<uint64_t>(width_) * num_rows * 3),
+               num_rows);
+    }
+    closed_ = true;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        exit_ = true;
+    }
+    cv_band_.notify_one();
+    worker_.join();
+
+    if (error_.empty())
+    {
+        try
+        {
+            encoder_->Finish();
+        }
+        catch (const MyException &e)
+        {
+            error_ = e.what();
+        }
+    }
+    encoder_.reset();
+    if (!error_.empty())
+        throw MyException(error_);
+    fprintf(stderr, "[info] save result as image \"%s\".\n",
+            filename_.c_str());
+}
+
+void StreamImageWriter::WorkerLoop()
+{
+    while (true)
+    {
+        Band band;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_band_.wait(lock, [&]() { return exit_ || !bands_.empty(); });
+            if (bands_.empty())
+                return;
+            band = std::move(bands_.front());
+            bands_.pop_front();
+        }
+        cv_space_.notify_one();
+
+        // 写入失败之后丢弃其余的行带，错误在 Close 中报告
+        if (!error_.empty())
+            continue;
+        try
+        {
+            encoder_->WriteRows(band.rows.data(), band.num_rows);
+        }
+        catch (const MyException &e)
+        {
+            error_ = e.what();
+        }
+    }
+}
+
+} // namespace csrt
@@ -0,0 +1,251 @@
+#include "csrt/utils/thread_pool.hpp"
+
+#include <algorithm>
+
+#include "csrt/utils/numa.hpp"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace
+{
+
+constexpr uint64_t PackRange(const uint64_t begin, const uint64_t end)
+{
+    return (begin << 32) | end;
+}
+
+constexpr uint32_t RangeBegin(const uint64_t range)
+{
+    return static_cast<uint32_t>(range >> 32);
+}
+
+constexpr uint32_t RangeEnd(const uint64_t range)
+{
+    return static_cast<uint32_t>(range & 0xffffffffu);
+}
+
+} // namespace
+
+namespace csrt
+{
+
+ThreadPool::ThreadPool(const uint32_t num_threads, const bool affinity,
+                       const bool numa)
+    : affinity_(affinity), exit_(false), num_nodes_(1), generation_(0),
+      num_active_(0), func_(nullptr)
+{
+    uint32_t num = num_threads;
+    if (num == 0)
+        num = std::max(1u, std::thread::hardware_concurrency());
+
+    ranges_ = std::vector<TaskRange>(num);
+    for (TaskRange &range : ranges_)
+        range.range.store(0, std::memory_order_relaxed);
+
+    // 编号相邻的线程属于同一节点，ParallelFor 划分的连续任务区间因而也落在同一节点中
+    nodes_ = std::vector<uint32_t>(num, 0);
+    node_cpus_ = {std::vector<int>()};
+    if (numa)
+    {
+        const std::vector<std::vector<int>> nodes = GetNumaNodes();
+        if (!nodes.empty())
+        {
+            num_nodes_ = static_cast<uint32_t>(
+                std::min(nodes.size(), static_cast<size_t>(num)));
+            node_cpus_.assign(nodes.begin(), nodes.begin() + num_nodes_);
+            for (uint32_t i = 0; i < num; ++i)
+            {
+                nodes_[i] = static_cast<uint32_t>(
+                    static_cast<uint64_t>(i) * num_nodes_ / num);
+            }
+        }
+    }
+
+    workers_.reserve(num);
+    for (uint32_t i = 0; i < num; ++i)
+        workers_.emplace_back(&ThreadPool::WorkerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        exit_ = true;
+    }
+    cv_start_.notify_all();
+    for (std::thread &worker : workers_)
+        worker.join();
+}
+
+void ThreadPool::ParallelFor(
+    const uint64_t num_task,
+    const std::function<void(uint32_t, uint64_t)> &func)
+{
+    if (num_task == 0)
+        return;
+
+    // 按线程数量均匀地划分任务区间，保持相邻任务（如 Morton 序的相邻图块）在同一线程中
+    const uint64_t num_threads = workers_.size();
+    for (uint64_t i = 0; i < num_threads; ++i)
+    {
+        const uint64_t begin = num_task * i / num_threads,
+                       end = num_task * (i + 1) / num_threads;
+        ranges_[i].range.store(PackRange(begin, end),
+                               std::memory_order_relaxed);
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    func_ = &func;
+    num_active_ = static_cast<uint32_t>(num_threads);
+    ++generation_;
+    cv_start_.notify_all();
+    cv_finish_.wait(lock, [&]() { return num_active_ == 0; });
+    func_ = nullptr;
+}
+
+void ThreadPool::WorkerLoop(const uint32_t id_thread)
+{
+    if (num_nodes_ > 1)
+    {
+        // 节点中的第 k 个线程绑定到节点的第 k 个逻辑处理器，或者整个节点
+        const uint32_t id_node = nodes_[id_thread];
+        const std::vector<int> &cpus = node_cpus_[id_node];
+        const uint32_t index = static_cast<uint32_t>(
+            std::find(nodes_.begin(), nodes_.end(), id_node) - nodes_.begin());
+        BindThread(affinity_ ? std::vector<int>{cpus[(id_thread - index) %
+                                                     cpus.size()]}
+                             : cpus);
+    }
+    else if (affinity_)
+    {
+        PinThread(id_thread);
+    }
+
+    uint64_t generation = 0;
+    while (true)
+    {
+        const std::function<void(uint32_t, uint64_t)> *func = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_start_.wait(lock, [&]()
+                           { return exit_ || generation_ != generation; });
+            if (exit_)
+                return;
+            generation = generation_;
+            func = func_;
+        }
+
+        uint64_t id_task = 0;
+        while (PopTask(id_thread, &id_task) || StealTask(id_thread, &id_task))
+            (*func)(id_thread, id_task);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--num_active_ == 0)
+                cv_finish_.notify_one();
+        }
+    }
+}
+
+bool ThreadPool::PopTask(const uint32_t id_thread, uint64_t *id_task)
+{
+    std::atomic<uint64_t> &range = ranges_[id_thread].range;
+    uint64_t current = range.load(std::memory_order_acquire);
+    while (RangeBegin(current) < RangeEnd(current))
+    {
+        const uint64_t next =
+            PackRange(RangeBegin(current) + 1, RangeEnd(current));
+        if (range.compare_exchange_weak(current, next,
+                                        std::memory_order_acq_rel))
+        {
+            *id_task = RangeBegin(current);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::StealTask(const uint32_t id_thread, uint64_t *id_task)
+{
+    // 先在同一节点中窃取，节点中的任务都完成后再跨节点窃取
+    const uint32_t num_threads = static_cast<uint32_t>(workers_.size());
+    for (uint32_t k = 1; k < 2 * num_threads; ++k)
+    {
+        if (k == num_threads)
+            continue;
+        const uint32_t id_victim = (id_thread + k) % num_threads;
+        if ((nodes_[id_victim] == nodes_[id_thread]) != (k < num_threads))
+            continue;
+        std::atomic<uint64_t> &victim = ranges_[id_victim].range;
+        uint64_t current = victim.load(std::memory_order_acquire);
+        while (RangeBegin(current) < RangeEnd(current))
+        {
+            const uint32_t begin = RangeBegin(current), end = RangeEnd(current),
+                           count = end - begin, mid = end - (count + 1) / 2;
+            if (!victim.compare_exchange_weak(current, PackRange(begin, mid),
+                                              std::memory_order_acq_rel))
+                continue;
+
+            // 窃取到 [mid, end)，第一个任务立即执行，其余的放入自己的区间供其它线程再次窃取
+            *id_task = mid;
+            ranges_[id_thread].range.store(PackRange(mid + 1, end),
+                                           std::memory_order_release);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::PinThread(const uint32_t id_thread)
+{
+#if defined(_WIN32)
+    // 超过 64 个逻辑处理器的机器被划分为多个处理器组
+    const WORD num_group = GetActiveProcessorGroupCount();
+    DWORD index = id_thread % GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+    for (WORD group = 0; group < num_group; ++group)
+    {
+        const DWORD num_processor = GetActiveProcessorCount(group);
+        if (index < num_processor)
+        {
+            GROUP_AFFINITY group_affinity = {};
+            group_affinity.Group = group;
+            group_affinity.Mask = static_cast<KAFFINITY>(1) << index;
+            SetThreadGroupAffinity(GetCurrentThread(), &group_affinity,
+                                   nullptr);
+            return;
+        }
+        index -= num_processor;
+    }
+#elif defined(__linux__)
+    // 只在进程允许使用的逻辑处理器（如容器、taskset 的限制）中轮流选取
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return;
+    const int num_allowed = CPU_COUNT(&allowed);
+    if (num_allowed == 0)
+        return;
+    int index = static_cast<int>(id_thread % num_allowed);
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (!CPU_ISSET(cpu, &allowed))
+            continue;
+        if (index-- == 0)
+        {
+            cpu_set_t cpu_set;
+            CPU_ZERO(&cpu_set);
+            CPU_SET(cpu, &cpu_set);
+            pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+            return;
+        }
+    }
+#endif
+}
+
+} // namespace csrt
\ No newline at end of file
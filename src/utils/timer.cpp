@@ -22,11 +22,11 @@ void Timer::PrintTimePassed(const std::string &work_name)
             work_name.c_str(), hours, mins, secs, ms);
 }
 
-void Timer::PrintProgress(double progress)
+void Timer::PrintProgress(double progress) const
 {
-    time_current_ = std::chrono::steady_clock::now();
+    const auto time_current = std::chrono::steady_clock::now();
     double diff =
-        std::chrono::duration<double>(time_current_ - time_begin_).count();
+        std::chrono::duration<double>(time_current - time_begin_).count();
     int hours = static_cast<int>(diff / 3600),
         mins = static_cast<int>(diff / 60) - hours * 60,
         secs = static_cast<int>(diff) - hours * 3600 - mins * 60;
@@ -0,0 +1,254 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "csrt/ray_tracer.hpp"
+#include "csrt/utils.hpp"
+
+// 验证 CPU 后端的绘制结果与线程数量、图块尺寸、分轮方式和样本区间的划分无关：
+// 各种绘制方式得到的图像须与单线程一轮绘制的结果逐位相同。
+// 另外验证最大深度为 1 时 path 积分器只绘制原初光线直接看到的光源。
+// 命令格式：'RayTracerTest 'RayTracerMerge path''
+
+namespace
+{
+
+uint32_t AddConstant(csrt::RendererConfig *config, const csrt::Vec3 &color)
+{
+    csrt::TextureInfo info;
+    info.type = csrt::TextureType::kConstant;
+    info.constant.color = color;
+    config->textures.push_back(info);
+    return static_cast<uint32_t>(config->textures.size() - 1);
+}
+
+uint32_t AddDiffuse(csrt::RendererConfig *config, const csrt::Vec3 &color)
+{
+    csrt::BsdfInfo info;
+    info.type = csrt::BsdfType::kDiffuse;
+    info.twosided = false;
+    info.id_opacity = csrt::kInvalidId;
+    info.id_bump_map = csrt::kInvalidId;
+    info.diffuse.id_diffuse_reflectance = AddConstant(config, color);
+    config->bsdfs.push_back(info);
+    return static_cast<uint32_t>(config->bsdfs.size() - 1);
+}
+
+uint32_t AddAreaLight(csrt::RendererConfig *config, const csrt::Vec3 &radiance)
+{
+    csrt::BsdfInfo info;
+    info.type = csrt::BsdfType::kAreaLight;
+    info.twosided = false;
+    info.id_opacity = csrt::kInvalidId;
+    info.id_bump_map = csrt::kInvalidId;
+    info.area_light.weight = 1;
+    info.area_light.id_radiance = AddConstant(config, radiance);
+    config->bsdfs.push_back(info);
+    return static_cast<uint32_t>(config->bsdfs.size() - 1);
+}
+
+void AddRectangle(csrt::RendererConfig *config, const uint32_t id_bsdf,
+                  const csrt::Mat4 &to_world)
+{
+    csrt::InstanceInfo info;
+    info.type = csrt::InstanceType::kRectangle;
+    info.id_bsdf = id_bsdf;
+    info.to_world = to_world;
+    config->instances.push_back(info);
+}
+
+// 不读取任何文件，在内存中构建一个小尺寸的 Cornell Box
+csrt::RendererConfig CreateConfig(const csrt::SamplerType sampler)
+{
+    csrt::RendererConfig config;
+    config.camera.width = 40;
+    config.camera.height = 30;
+    config.camera.spp = 16;
+    config.camera.sampler = sampler;
+    config.camera.fov_x = 45;
+    config.camera.eye = {0, 1, 3.5f};
+    config.camera.look_at = {0, 1, 0};
+    config.camera.up = {0, 1, 0};
+    config.cameras = {config.camera};
+    config.integrator.type = csrt::IntegratorType::kPath;
+
+    const uint32_t white = AddDiffuse(&config, {0.7f}),
+                   red = AddDiffuse(&config, {0.7f, 0.1f, 0.1f}),
+                   green = AddDiffuse(&config, {0.1f, 0.7f, 0.1f}),
+                   light = AddAreaLight(&config, {17, 12, 4});
+    AddRectangle(&config, white,
+                 csrt::Rotate(csrt::ToRadians(-90), {1, 0, 0}));
+    AddRectangle(&config, white,
+                 csrt::Mul(csrt::Translate({0, 2, 0}),
+                           csrt::Rotate(csrt::ToRadians(90), {1, 0, 0})));
+    AddRectangle(&config, white, csrt::Translate({0, 1, -1}));
+    AddRectangle(&config, red,
+                 csrt::Mul(csrt::Translate({-1, 1, 0}),
+                           csrt::Rotate(csrt::ToRadians(90), {0, 1, 0})));
+    AddRectangle(&config, green,
+                 csrt::Mul(csrt::Translate({1, 1, 0}),
+                           csrt::Rotate(csrt::ToRadians(-90), {0, 1, 0})));
+    AddRectangle(
+        &config, light,
+        csrt::Mul(csrt::Translate({0, 1.98f, 0}),
+                  csrt::Mul(csrt::Rotate(csrt::ToRadians(90), {1, 0, 0}),
+                            csrt::Scale({0.25f, 0.25f, 1}))));
+
+    csrt::InstanceInfo sphere;
+    sphere.type = csrt::InstanceType::kSphere;
+    sphere.id_bsdf = white;
+    sphere.sphere.radius = 0.35f;
+    sphere.sphere.center = {0.3f, 0.35f, 0.2f};
+    config.instances.push_back(sphere);
+    return config;
+}
+
+std::vector<float> Render(const csrt::RendererConfig &config)
+{
+    std::vector<float> frame(static_cast<uint64_t>(config.camera.width) *
+                             config.camera.height * 3);
+    csrt::RayTracer ray_tracer(config);
+    // 不向 stderr 输出进度
+    csrt::DrawCallbacks callbacks;
+    callbacks.progress = [](double) {};
+    ray_tracer.Draw(frame.data(), callbacks);
+    return frame;
+}
+
+std::vector<char> ReadFile(const std::string &filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file)
+        throw csrt::MyException("cannot open file '" + filename + "'.");
+    return std::vector<char>(std::istreambuf_iterator<char>(file),
+                             std::istreambuf_iterator<char>());
+}
+
+bool Check(const std::string &name, const bool passed)
+{
+    fprintf(stderr, "[%s] %s\n", passed ? "pass" : "FAIL", name.c_str());
+    return passed;
+}
+
+bool Same(const std::vector<float> &a, const std::vector<float> &b)
+{
+    return a.size() == b.size() &&
+           std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+}
+
+// 每个样本的各通道都截断为 1，光源各通道的辐射亮度都大于 1，因而看到光源的像素为
+// 灰色（各通道相等，为看到光源的样本比例），其余像素不含任何景物表面反射的光照，为 0
+bool EmissionOnly(const std::vector<float> &frame)
+{
+    for (size_t i = 0; i < frame.size(); i += 3)
+    {
+        const float r = frame[i], g = frame[i + 1], b = frame[i + 2];
+        if (r != g || r != b || r < 0 || r > 1)
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "[error] no path to RayTracerMerge.\n");
+        return 1;
+    }
+    const std::string merge_path = argv[1];
+
+    uint32_t num_failed = 0;
+    try
+    {
+        for (const csrt::SamplerType sampler :
+             {csrt::SamplerType::kIndependent, csrt::SamplerType::kSobol})
+        {
+            const std::string prefix =
+                sampler == csrt::SamplerType::kSobol ? "sobol" : "independent";
+
+            // 参考结果：单线程，默认图块尺寸，一轮绘制所有样本
+            csrt::RendererConfig config = CreateConfig(sampler);
+            config.schedule.num_threads = 1;
+            const std::vector<float> reference = Render(config);
+
+            config.schedule.num_threads = 4;
+            num_failed +=
+                !Check(prefix + ", 1 thread vs 4 threads",
+                       Same(reference, Render(config)));
+
+            for (const uint32_t tile_size : {1u, 5u, 32u})
+            {
+                config.schedule.tile_size = tile_size;
+                num_failed += !Check(prefix + ", tile size " +
+                                         std::to_string(tile_size),
+                                     Same(reference, Render(config)));
+            }
+            config.schedule = csrt::ScheduleInfo();
+
+            // 16 个样本分为 7 + 7 + 2 三轮
+            config.progressive.spp_pass = 7;
+            num_failed += !Check(prefix + ", 7 spp per pass vs one pass",
+                                 Same(reference, Render(config)));
+            config.progressive = csrt::ProgressiveInfo();
+
+            // 样本区间 [0, 5) 与 [5, 16) 分别绘制，由 RayTracerMerge 合并，
+            // 与参考结果都以 PFM 格式保存后逐字节比较
+            const std::string partial[2] = {prefix + "_0.film",
+                                            prefix + "_1.film"},
+                              merged = prefix + "_merged.pfm",
+                              single = prefix + "_single.pfm";
+            const uint32_t bounds[3] = {0, 5, 16};
+            for (int k = 0; k < 2; ++k)
+            {
+                config.partition.sample_begin = bounds[k];
+                config.partition.sample_end = bounds[k + 1];
+                config.partition.filename = partial[k];
+                Render(config);
+            }
+            config.partition = csrt::PartitionInfo();
+
+            csrt::image_io::Write(reference.data(), config.camera.width,
+                                  config.camera.height, single);
+            const std::string command = "\"" + merge_path + "\" -o \"" +
+                                        merged + "\" \"" + partial[0] +
+                                        "\" \"" + partial[1] + "\"";
+            num_failed +=
+                !Check(prefix + ", samples [0, 5) + [5, 16) merged vs single "
+                                "run",
+                       std::system(command.c_str()) == 0 &&
+                           ReadFile(merged) == ReadFile(single));
+        }
+
+        // 最大深度为 1：不计算直接光照，图像中心的后墙与其它景物表面都为黑色
+        csrt::RendererConfig config =
+            CreateConfig(csrt::SamplerType::kIndependent);
+        config.integrator.depth_max = 1;
+        const std::vector<float> frame = Render(config);
+        const size_t center =
+            (config.camera.height / 2 * config.camera.width +
+             config.camera.width / 2) *
+            3;
+        num_failed += !Check("path, max depth 1 renders emitters only",
+                             EmissionOnly(frame) && frame[center] == 0);
+    }
+    catch (const csrt::MyException &e)
+    {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+
+    if (num_failed > 0)
+    {
+        fprintf(stderr, "[error] %u check(s) failed.\n", num_failed);
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
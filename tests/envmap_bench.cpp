@@ -0,0 +1,132 @@
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "csrt/renderer/emitters/emitter.hpp"
+#include "csrt/renderer/emitters/envmap.hpp"
+
+// 8K 环境映射的微基准：在内存中生成 8192 x 4096 的合成 HDR 环境映射，
+// 分别计时构建别名表（CreateEnvMapAliasTable，逐行调用 CreateAliasTable）、
+// 按亮度抽样方向（SampleEnvMap）与查询概率密度（PdfEnvMap）
+// 命令格式：'RayTracerEnvMapBench ['number of samples']'
+
+namespace
+{
+
+constexpr int kWidth = 8192;
+constexpr int kHeight = 4096;
+
+// 天空的亮度随高度渐变并叠加高频的纹理，再加上一个张角约 1 度、
+// 亮度高出五个数量级的太阳，使各像素的权重与真实的 HDR 环境映射一样悬殊
+std::vector<float> CreateRadiance()
+{
+    std::vector<float> pixels(static_cast<size_t>(kWidth) * kHeight * 3);
+    const csrt::Vec3 dir_sun = csrt::Normalize(csrt::Vec3{0.3f, 0.5f, 1.0f});
+    const float cos_sun = cosf(csrt::ToRadians(0.5f));
+    for (int y = 0; y < kHeight; ++y)
+    {
+        const float theta = (y + 0.5f) * csrt::kPi / kHeight,
+                    cos_theta = cosf(theta), sin_theta = sinf(theta);
+        for (int x = 0; x < kWidth; ++x)
+        {
+            const float phi = (x + 0.5f) * csrt::k2Pi / kWidth;
+            const csrt::Vec3 dir = {cosf(phi) * sin_theta, cos_theta,
+                                    sinf(phi) * sin_theta};
+            float value = 0.2f + 0.8f * fmaxf(0.0f, cos_theta);
+            value *= 1.0f + 0.5f * sinf(0.05f * x) * sinf(0.07f * y);
+            const float sun =
+                csrt::Dot(dir, dir_sun) > cos_sun ? 100000.0f : 0.0f;
+            float *rgb =
+                pixels.data() + (static_cast<size_t>(y) * kWidth + x) * 3;
+            rgb[0] = 0.6f * value + sun;
+            rgb[1] = 0.8f * value + 0.9f * sun;
+            rgb[2] = value + 0.7f * sun;
+        }
+    }
+    return pixels;
+}
+
+double SecondsSince(const std::chrono::steady_clock::time_point &begin)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         begin)
+        .count();
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const size_t num_sample = argc > 1 ? std::stoul(argv[1]) : (1u << 22);
+
+    try
+    {
+        std::vector<float> pixels = CreateRadiance();
+        csrt::TextureData texture_data;
+        texture_data.type = csrt::TextureType::kBitmap;
+        texture_data.bitmap.width = kWidth;
+        texture_data.bitmap.height = kHeight;
+        texture_data.bitmap.channel = 3;
+        texture_data.bitmap.data = pixels.data();
+        csrt::Texture radiance(0, texture_data, 0);
+
+        auto begin = std::chrono::steady_clock::now();
+        std::vector<csrt::AliasEntry> alias_rows, alias_cols;
+        std::vector<float> pdf_map;
+        csrt::CreateEnvMapAliasTable(kWidth, kHeight, radiance, &alias_rows,
+                                     &alias_cols, &pdf_map);
+        const double time_table = SecondsSince(begin);
+
+        csrt::EnvMapData data;
+        data.width = kWidth;
+        data.height = kHeight;
+        data.radiance = &radiance;
+        data.alias_rows = alias_rows.data();
+        data.alias_cols = alias_cols.data();
+        data.pdf_map = pdf_map.data();
+
+        // 随机数预先生成，不计入抽样的用时
+        std::mt19937 engine(0);
+        std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+        std::vector<float> xi(num_sample * 2);
+        for (float &value : xi)
+            value = distribution(engine);
+
+        std::vector<csrt::Vec3> dirs(num_sample);
+        begin = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < num_sample; ++i)
+        {
+            csrt::EmitterSampleRec rec;
+            csrt::SampleEnvMap(data, {}, xi[2 * i], xi[2 * i + 1], &rec);
+            dirs[i] = -rec.wi;
+        }
+        const double time_sample = SecondsSince(begin);
+
+        // 抽样得到的方向处的概率密度之和，同时防止循环被优化掉
+        double sum_pdf = 0;
+        begin = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < num_sample; ++i)
+            sum_pdf += csrt::PdfEnvMap(data, dirs[i]);
+        const double time_pdf = SecondsSince(begin);
+
+        fprintf(stderr, "[info] environment map %d x %d, %zu samples.\n",
+                kWidth, kHeight, num_sample);
+        fprintf(stderr, "[info] CreateEnvMapAliasTable: %.1f ms.\n",
+                time_table * 1e3);
+        fprintf(stderr, "[info] SampleEnvMap: %.1f ns per sample.\n",
+                time_sample * 1e9 / num_sample);
+        fprintf(stderr, "[info] PdfEnvMap: %.1f ns per query.\n",
+                time_pdf * 1e9 / num_sample);
+        fprintf(stderr, "[info] mean pdf of samples: %g.\n",
+                sum_pdf / num_sample);
+    }
+    catch (const csrt::MyException &e)
+    {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file